@@ -1,5 +1,5 @@
 # SPDX-License-Identifier: BSD-3-Clause
-# Copyright 2017-2020, Intel Corporation
+# Copyright 2017-2021, Intel Corporation
 
 if(PKG_CONFIG_FOUND)
 	pkg_check_modules(MEMKIND memkind>=${MEMKIND_REQUIRED_VERSION})
@@ -47,3 +47,24 @@ set(CMAKE_REQUIRED_INCLUDES ${SAVED_CMAKE_REQUIRED_INCLUDES})
 if(LIBMEMKIND_NAMESPACE_PRESENT)
 	add_definitions(-DUSE_LIBMEMKIND_NAMESPACE)
 endif()
+
+# Statistics (used by memory_usage() of memkind based engines)
+# are available since memkind 1.10.
+set(SAVED_CMAKE_REQUIRED_INCLUDES ${CMAKE_REQUIRED_INCLUDES})
+set(SAVED_CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES})
+set(CMAKE_REQUIRED_INCLUDES ${MEMKIND_INCLUDE_DIRS})
+set(CMAKE_REQUIRED_LIBRARIES ${MEMKIND_LIBRARIES})
+CHECK_CXX_SOURCE_COMPILES(
+		"#include <memkind.h>
+		int main(void) {
+		size_t value;
+		memkind_update_cached_stats();
+		return memkind_get_stat(nullptr, MEMKIND_STAT_TYPE_ALLOCATED, &value);
+		}"
+		MEMKIND_STATS_PRESENT)
+set(CMAKE_REQUIRED_INCLUDES ${SAVED_CMAKE_REQUIRED_INCLUDES})
+set(CMAKE_REQUIRED_LIBRARIES ${SAVED_CMAKE_REQUIRED_LIBRARIES})
+
+if(MEMKIND_STATS_PRESENT)
+	add_definitions(-DMEMKIND_STATS_PRESENT)
+endif()
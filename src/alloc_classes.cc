@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "alloc_classes.h"
+#include "exceptions.h"
+
+#include <libpmemobj.h>
+
+#include <algorithm>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+bool alloc_classes::enabled(config &cfg)
+{
+	const char *sizes = nullptr;
+	return cfg.get_string("alloc_classes", &sizes);
+}
+
+alloc_classes::params alloc_classes::from_config(config &cfg)
+{
+	params p;
+	const char *sizes = nullptr;
+	if (cfg.get_string("alloc_classes", &sizes)) {
+		p.sizes = sizes;
+		/* validates the list */
+		if (p.sizes != "auto" && parse(p.sizes).empty())
+			throw internal::invalid_argument(
+				"Config item \"alloc_classes\" must not be empty");
+	}
+	cfg.get_uint64("alloc_classes_samples", &p.samples);
+
+	if (p.samples == 0)
+		throw internal::invalid_argument(
+			"Config item \"alloc_classes_samples\" must be greater than 0");
+
+	return p;
+}
+
+alloc_classes::alloc_classes(PMEMobjpool *pop, params p, string_view recorded)
+    : pop(pop), p(std::move(p)), ready(false)
+{
+	if (!recorded.empty())
+		register_classes(parse(std::string(recorded.data(), recorded.size())));
+	else if (this->p.sizes != "auto")
+		register_classes(parse(this->p.sizes));
+	else
+		return;
+
+	ready = true;
+}
+
+pmem::obj::allocation_flag alloc_classes::flag(size_t size)
+{
+	if (!ready.load(std::memory_order_acquire)) {
+		std::unique_lock<std::mutex> lock(mtx);
+		if (ready.load(std::memory_order_relaxed))
+			return flag(size);
+
+		if (size <= max_size)
+			++histogram[unit_size(size)];
+		if (++sampled >= p.samples)
+			fit();
+
+		return pmem::obj::allocation_flag::none();
+	}
+
+	auto unit = unit_size(size);
+	auto it = std::lower_bound(
+		classes.begin(), classes.end(), unit,
+		[](const alloc_class &c, uint64_t u) { return unit_size(c.size) < u; });
+
+	/* at most 1/8 of the unit may be wasted */
+	if (it == classes.end() || (unit_size(it->size) - unit) * 8 > unit_size(it->size))
+		return pmem::obj::allocation_flag::none();
+
+	return pmem::obj::allocation_flag::class_id(it->id);
+}
+
+std::string alloc_classes::state() const
+{
+	if (!ready.load(std::memory_order_acquire))
+		return "";
+
+	std::string s;
+	for (auto &c : classes) {
+		if (!s.empty())
+			s += ",";
+		s += std::to_string(c.size);
+	}
+
+	return s;
+}
+
+std::vector<uint64_t> alloc_classes::parse(const std::string &sizes)
+{
+	std::vector<uint64_t> result;
+	size_t pos = 0;
+	while (pos < sizes.size()) {
+		auto end = sizes.find(',', pos);
+		if (end == std::string::npos)
+			end = sizes.size();
+
+		auto item = sizes.substr(pos, end - pos);
+		if (item.empty() ||
+		    item.find_first_not_of("0123456789") != std::string::npos)
+			throw internal::invalid_argument(
+				"Config item \"alloc_classes\" must be \"auto\" or a comma separated list of sizes");
+
+		/* longer numbers are out of range (and might not fit in uint64_t) */
+		auto size = item.size() > 5 ? max_size + 1 : std::stoull(item);
+		if (size == 0 || size > max_size)
+			throw internal::invalid_argument(
+				"Allocation class size must be in range [1, " +
+				std::to_string(max_size) + "]");
+
+		result.push_back(size);
+		pos = end + 1;
+	}
+
+	return result;
+}
+
+uint64_t alloc_classes::unit_size(uint64_t size)
+{
+	return (size + header_size + granularity - 1) / granularity * granularity;
+}
+
+void alloc_classes::register_classes(const std::vector<uint64_t> &sizes)
+{
+	std::vector<uint64_t> units;
+	for (auto s : sizes)
+		units.push_back(unit_size(s));
+	std::sort(units.begin(), units.end());
+	units.erase(std::unique(units.begin(), units.end()), units.end());
+
+	for (auto unit : units) {
+		struct pobj_alloc_class_desc desc;
+		desc.unit_size = unit;
+		desc.alignment = 0;
+		desc.units_per_block =
+			static_cast<unsigned>(std::max<uint64_t>(1, run_size / unit));
+		desc.header_type = POBJ_HEADER_COMPACT;
+		desc.class_id = 0;
+
+		if (pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &desc) != 0)
+			throw internal::error(
+				"Cannot register allocation class of size " +
+				std::to_string(unit) + ": " + pmemobj_errormsg());
+
+		classes.push_back({unit - header_size, desc.class_id});
+	}
+}
+
+/*
+ * Picks the most frequent unit sizes (each seen in at least 1% of samples),
+ * skipping the ones already well fitted by a picked class.
+ */
+void alloc_classes::fit()
+{
+	std::vector<std::pair<uint64_t, uint64_t>> by_count(histogram.begin(),
+							    histogram.end());
+	std::stable_sort(by_count.begin(), by_count.end(),
+			 [](const std::pair<uint64_t, uint64_t> &lhs,
+			    const std::pair<uint64_t, uint64_t> &rhs) {
+				 return lhs.second > rhs.second;
+			 });
+
+	std::vector<uint64_t> picked;
+	for (auto &e : by_count) {
+		if (picked.size() == max_classes || e.second * 100 < sampled)
+			break;
+
+		auto fitted = std::any_of(
+			picked.begin(), picked.end(), [&](uint64_t unit) {
+				return unit >= e.first && (unit - e.first) * 8 <= unit;
+			});
+		if (!fitted)
+			picked.push_back(e.first);
+	}
+
+	std::vector<uint64_t> sizes;
+	for (auto unit : picked)
+		sizes.push_back(unit - header_size);
+
+	try {
+		register_classes(sizes);
+	} catch (internal::error &) {
+		/* registered classes are still used, the rest goes to default ones */
+	}
+
+	histogram.clear();
+	ready.store(true, std::memory_order_release);
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_ALLOC_CLASSES_H
+#define LIBPMEMKV_ALLOC_CLASSES_H
+
+#include "config.h"
+#include "libpmemkv.hpp"
+
+#include <libpmemobj++/allocation_flag.hpp>
+#include <libpmemobj/base.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Custom allocation classes of libpmemobj (registered by "heap.alloc_class.new"
+ * ctl), fitted to sizes of objects allocated by an engine, so that they are
+ * not rounded up to the nearest default class.
+ *
+ * Classes are either given in config (as a list of object sizes) or, in the
+ * adaptive mode, fitted to the most frequent sizes of the first 'samples'
+ * allocations. They live only as long as the pool is open, so their sizes
+ * are recorded by the engine (see state()) and registered again on open.
+ */
+class alloc_classes {
+public:
+	struct params {
+		/* "auto" or comma separated list of object sizes [in bytes] */
+		std::string sizes;
+		/* number of allocations sampled in the adaptive mode */
+		uint64_t samples = 10000;
+	};
+
+	/* Returns true if custom allocation classes are requested in the config. */
+	static bool enabled(config &cfg);
+	static params from_config(config &cfg);
+
+	/*
+	 * Registers classes of the recorded sizes if there are any (they take
+	 * precedence over params) or of the sizes from params.
+	 */
+	alloc_classes(PMEMobjpool *pop, params p, string_view recorded);
+
+	alloc_classes(const alloc_classes &) = delete;
+	alloc_classes &operator=(const alloc_classes &) = delete;
+
+	/*
+	 * Returns flag of the class fitting an object of the given size
+	 * or no flag (default classes) if none fits it well enough.
+	 * In the adaptive mode the size is sampled until classes are fitted.
+	 */
+	pmem::obj::allocation_flag flag(size_t size);
+
+	/* Returns sizes of registered classes (to be recorded), in format of params. */
+	std::string state() const;
+
+private:
+	struct alloc_class {
+		uint64_t size;
+		unsigned id;
+	};
+
+	/* size of the header of objects allocated with custom classes */
+	static constexpr uint64_t header_size = 16;
+	static constexpr uint64_t granularity = 8;
+	/* bigger objects are allocated from default classes */
+	static constexpr uint64_t max_size = 16384;
+	/* classes are sized for runs of this size (one chunk) */
+	static constexpr uint64_t run_size = 256 * 1024;
+	static constexpr size_t max_classes = 8;
+
+	static std::vector<uint64_t> parse(const std::string &sizes);
+	static uint64_t unit_size(uint64_t size);
+
+	void register_classes(const std::vector<uint64_t> &sizes);
+	void fit();
+
+	PMEMobjpool *pop;
+	params p;
+
+	/* sorted by size, not modified after 'ready' is set */
+	std::vector<alloc_class> classes;
+	std::atomic<bool> ready;
+
+	/* number of sampled allocations of each unit size (adaptive mode) */
+	std::mutex mtx;
+	std::map<uint64_t, uint64_t> histogram;
+	uint64_t sampled = 0;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_ALLOC_CLASSES_H */
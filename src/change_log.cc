@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "change_log.h"
+#include "exceptions.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+namespace
+{
+
+std::size_t align8(std::size_t n)
+{
+	return (n + 7) & ~static_cast<std::size_t>(7);
+}
+
+} /* anonymous namespace */
+
+change_log::change_log(std::size_t size)
+    : buffer(header_size + align8(size)), persist([](const void *, std::size_t) {})
+{
+	init(buffer.data(), align8(size));
+}
+
+change_log::change_log(char *region, std::size_t size, persist_function persist)
+    : persist(std::move(persist))
+{
+	/* data area is not resized when the region is reused */
+	init(region, size & ~static_cast<std::size_t>(7));
+}
+
+void change_log::init(char *region, std::size_t size)
+{
+	static_assert(sizeof(header) <= header_size, "header does not fit");
+
+	hdr = reinterpret_cast<header *>(region);
+	data = region + header_size;
+
+	if (hdr->magic != magic) {
+		if (size < sizeof(unit_header) + record_size(0, 0))
+			throw internal::invalid_argument("Change log is too small");
+
+		hdr->size = size;
+		hdr->first = 0;
+		hdr->end = 0;
+		hdr->dropped = 0;
+		hdr->deferred = 0;
+		persist(hdr, sizeof(header));
+		hdr->magic = magic;
+		persist(&hdr->magic, sizeof(hdr->magic));
+	}
+
+	recover();
+}
+
+/*
+ * Rebuilds the index of committed units by walking units from the oldest one.
+ * Units reserved, but not committed nor cancelled, wait for resolve_pending.
+ */
+void change_log::recover()
+{
+	last = hdr->dropped;
+	for (auto offset = hdr->first; offset < hdr->end;) {
+		unit_header uh;
+		read_at(offset, &uh, sizeof(uh));
+		if (uh.size < sizeof(uh) || offset + uh.size > hdr->end)
+			throw internal::error("Change log is corrupted");
+
+		if (uh.seq == pending)
+			reserved.emplace(offset, std::thread::id());
+		else if (uh.seq != cancelled && uh.seq > hdr->dropped)
+			units.emplace_back(uh.seq, offset);
+		offset += uh.size;
+	}
+
+	std::sort(units.begin(), units.end());
+	if (!units.empty())
+		last = units.back().first;
+
+	if (hdr->deferred) {
+		report_gap();
+		hdr->deferred = 0;
+		persist(&hdr->deferred, sizeof(hdr->deferred));
+	}
+}
+
+/*
+ * Skips a sequence number and drops all units before it, so readers of any
+ * older sequence number get NOT_FOUND.
+ */
+void change_log::report_gap()
+{
+	last++;
+	units.clear();
+	hdr->dropped = last;
+	persist(&hdr->dropped, sizeof(hdr->dropped));
+}
+
+bool change_log::fits(std::size_t bytes) const
+{
+	return sizeof(unit_header) + bytes <= hdr->size;
+}
+
+std::size_t change_log::record_size(std::size_t key_size, std::size_t value_size)
+{
+	return align8(sizeof(record_header) + key_size + value_size);
+}
+
+uint64_t change_log::reserve(const std::vector<record> &records)
+{
+	std::vector<record_ref> refs;
+	refs.reserve(records.size());
+	for (auto &r : records)
+		refs.push_back({r.type, r.key, r.value});
+
+	return reserve(refs.data(), refs.size());
+}
+
+uint64_t change_log::reserve(change_type type, string_view key, string_view value)
+{
+	record_ref ref{type, key, value};
+	return reserve(&ref, 1);
+}
+
+uint64_t change_log::reserve(const record_ref *records, std::size_t n)
+{
+	std::size_t bytes = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		if (records[i].key.size() > UINT32_MAX)
+			throw internal::invalid_argument(
+				"Key is too long for the change log");
+		bytes += record_size(records[i].key.size(), records[i].value.size());
+	}
+	if (!fits(bytes))
+		throw internal::invalid_argument("Records do not fit in the change log");
+	bytes += sizeof(unit_header);
+
+	std::unique_lock<std::mutex> lock(mtx);
+	make_room(lock, bytes);
+
+	auto unit = hdr->end;
+	unit_header uh{pending, bytes};
+	write_at(unit, &uh, sizeof(uh));
+	auto offset = unit + sizeof(uh);
+	for (std::size_t i = 0; i < n; i++) {
+		auto &r = records[i];
+		record_header rh{static_cast<uint32_t>(r.type),
+				 static_cast<uint32_t>(r.key.size()), r.value.size()};
+		write_at(offset, &rh, sizeof(rh));
+		write_at(offset + sizeof(rh), r.key.data(), r.key.size());
+		write_at(offset + sizeof(rh) + r.key.size(), r.value.data(),
+			 r.value.size());
+		offset += record_size(r.key.size(), r.value.size());
+	}
+
+	/* unit is not seen after a crash until its end is persisted */
+	hdr->end = offset;
+	persist(&hdr->end, sizeof(hdr->end));
+	reserved.emplace(unit, std::this_thread::get_id());
+
+	return unit;
+}
+
+/*
+ * Drops the oldest units (and persistently) before they are overwritten. A unit
+ * dropped with its sequence number drops also all committed before it. Reserved
+ * units cannot be dropped, they are waited for.
+ */
+void change_log::make_room(std::unique_lock<std::mutex> &lock, std::size_t bytes)
+{
+	auto first = hdr->first;
+	auto dropped = hdr->dropped;
+	while (hdr->end + bytes - first > hdr->size) {
+		unit_header uh;
+		read_at(first, &uh, sizeof(uh));
+
+		if (uh.seq == pending) {
+			auto it = reserved.find(first);
+			if (it == reserved.end() ||
+			    it->second == std::this_thread::get_id())
+				throw internal::invalid_argument(
+					"Records do not fit in the change log");
+
+			hdr->dropped = dropped;
+			persist(&hdr->dropped, sizeof(hdr->dropped));
+			hdr->first = first;
+			persist(&hdr->first, sizeof(hdr->first));
+			cv.wait(lock);
+
+			/* others could drop units in the meantime */
+			first = hdr->first;
+			dropped = hdr->dropped;
+			continue;
+		}
+
+		if (uh.seq != cancelled && uh.seq > dropped)
+			dropped = uh.seq;
+		while (!units.empty() && units.front().first <= dropped)
+			units.pop_front();
+		first += uh.size;
+	}
+
+	if (dropped != hdr->dropped) {
+		hdr->dropped = dropped;
+		persist(&hdr->dropped, sizeof(hdr->dropped));
+	}
+	if (first != hdr->first) {
+		hdr->first = first;
+		persist(&hdr->first, sizeof(hdr->first));
+	}
+}
+
+/* persisted at once, so a unit is either committed or not after a crash */
+void change_log::set_seq(uint64_t unit, uint64_t seq)
+{
+	write_at(unit, &seq, sizeof(seq));
+}
+
+void change_log::commit(uint64_t unit)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	/* under the lock, so no later sequence number is persisted before it */
+	set_seq(unit, last + 1);
+	last++;
+	units.emplace_back(last, unit);
+	reserved.erase(unit);
+
+	lock.unlock();
+	cv.notify_all();
+}
+
+void change_log::cancel(uint64_t unit)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	set_seq(unit, cancelled);
+	reserved.erase(unit);
+
+	lock.unlock();
+	cv.notify_all();
+}
+
+void change_log::append(change_type type, string_view key, string_view value)
+{
+	commit(reserve(type, key, value));
+}
+
+void change_log::resolve_pending(const applied_function &applied)
+{
+	std::vector<uint64_t> units_to_resolve;
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		for (auto &r : reserved)
+			units_to_resolve.push_back(r.first);
+	}
+
+	for (auto unit : units_to_resolve) {
+		std::vector<std::pair<uint64_t, record>> batch;
+		read_unit(unit, pending, batch);
+
+		std::vector<record> records;
+		for (auto &e : batch)
+			records.emplace_back(std::move(e.second));
+
+		if (applied(records))
+			commit(unit);
+		else
+			cancel(unit);
+	}
+}
+
+void change_log::begin_deferred()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	hdr->deferred = 1;
+	persist(&hdr->deferred, sizeof(hdr->deferred));
+}
+
+void change_log::end_deferred(bool logged)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	if (!logged)
+		report_gap();
+	hdr->deferred = 0;
+	persist(&hdr->deferred, sizeof(hdr->deferred));
+
+	lock.unlock();
+	cv.notify_all();
+}
+
+uint64_t change_log::last_seq()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	return last;
+}
+
+status change_log::read(uint64_t since, std::chrono::milliseconds timeout,
+			change_callback *callback, void *arg)
+{
+	std::vector<std::pair<uint64_t, record>> batch;
+
+	while (true) {
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait_for(lock, timeout, [&] { return last > since; });
+			/* only the first read waits */
+			timeout = std::chrono::milliseconds(0);
+
+			if (last <= since)
+				return status::OK;
+			if (units.empty() || units.front().first > since + 1)
+				return status::NOT_FOUND;
+
+			auto it = std::upper_bound(
+				units.begin(), units.end(), since,
+				[](uint64_t seq, const std::pair<uint64_t, uint64_t> &u) {
+					return seq < u.first;
+				});
+
+			/* whole units are read, so a unit is never split between calls */
+			std::size_t bytes = 0;
+			for (; it != units.end() && bytes < read_batch_bytes; ++it)
+				bytes += read_unit(it->second, it->first, batch);
+		}
+
+		for (auto &e : batch) {
+			auto &r = e.second;
+			auto type = static_cast<int>(r.type);
+			auto ret = callback(e.first, type, r.key.data(), r.key.size(),
+					    r.value.data(), r.value.size(), arg);
+			if (ret != 0)
+				return status::STOPPED_BY_CB;
+		}
+		since = batch.back().first;
+	}
+}
+
+/* Reads records of the unit at 'offset' to the batch, returns its size in the log. */
+std::size_t change_log::read_unit(uint64_t offset, uint64_t seq,
+				  std::vector<std::pair<uint64_t, record>> &batch) const
+{
+	unit_header uh;
+	read_at(offset, &uh, sizeof(uh));
+
+	auto end = offset + uh.size;
+	for (offset += sizeof(uh); offset < end;) {
+		record_header rh;
+		read_at(offset, &rh, sizeof(rh));
+
+		auto value_size = static_cast<std::size_t>(rh.value_size);
+		batch.emplace_back(seq, record{static_cast<change_type>(rh.type),
+					       std::string(rh.key_size, '\0'),
+					       std::string(value_size, '\0')});
+		auto &r = batch.back().second;
+		read_at(offset + sizeof(rh), &r.key[0], r.key.size());
+		read_at(offset + sizeof(rh) + r.key.size(), &r.value[0],
+			r.value.size());
+		offset += record_size(r.key.size(), r.value.size());
+	}
+
+	return static_cast<std::size_t>(uh.size);
+}
+
+void change_log::write_at(uint64_t offset, const void *src, std::size_t n)
+{
+	auto pos = static_cast<std::size_t>(offset % hdr->size);
+	auto first_part = std::min(n, static_cast<std::size_t>(hdr->size) - pos);
+
+	memcpy(data + pos, src, first_part);
+	persist(data + pos, first_part);
+	if (first_part < n) {
+		memcpy(data, static_cast<const char *>(src) + first_part, n - first_part);
+		persist(data, n - first_part);
+	}
+}
+
+void change_log::read_at(uint64_t offset, void *dest, std::size_t n) const
+{
+	auto pos = static_cast<std::size_t>(offset % hdr->size);
+	auto first_part = std::min(n, static_cast<std::size_t>(hdr->size) - pos);
+
+	memcpy(dest, data + pos, first_part);
+	if (first_part < n)
+		memcpy(static_cast<char *>(dest) + first_part, data, n - first_part);
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
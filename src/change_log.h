@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_CHANGE_LOG_H
+#define LIBPMEMKV_CHANGE_LOG_H
+
+#include "libpmemkv.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Ring buffer of committed puts and removes. Records of a unit (e.g. of a
+ * transaction) share a sequence number and become visible at once. When the
+ * buffer is full, the oldest units are overwritten.
+ *
+ * The log is kept in a region: a header (with logical offsets of the oldest
+ * unit and of the end of the newest one) followed by the data area. A unit is
+ * written (reserved) before its mutation is done and published by persisting
+ * its sequence number afterwards (commit), or marked as cancelled if the
+ * mutation failed. Sequence numbers are given in order of commits, so units
+ * may be placed in the log out of their order. A unit neither committed nor
+ * cancelled before a crash is resolved after reopen (see resolve_pending), so
+ * every done mutation gets its record.
+ */
+class change_log {
+public:
+	struct record {
+		change_type type;
+		std::string key;
+		std::string value;
+	};
+
+	using persist_function = std::function<void(const void *, std::size_t)>;
+	/* tells if mutations of a unit reserved before a crash were done */
+	using applied_function = std::function<bool(const std::vector<record> &)>;
+
+	static const std::size_t header_size = 64;
+
+	/* Volatile log with data area of 'size' bytes. */
+	explicit change_log(std::size_t size);
+	/*
+	 * Log in 'region' of header_size + 'size' bytes (zeroed, if the log is not
+	 * created yet). Size of a log created earlier is read from its header.
+	 * 'persist' makes ranges of the region durable.
+	 */
+	change_log(char *region, std::size_t size, persist_function persist);
+
+	/* Returns false if records of 'bytes' (see record_size) cannot fit. */
+	bool fits(std::size_t bytes) const;
+	static std::size_t record_size(std::size_t key_size, std::size_t value_size);
+
+	/*
+	 * Writes records as a unit, which becomes visible by commit(). Returns
+	 * the unit, which has to be committed or cancelled.
+	 */
+	uint64_t reserve(const std::vector<record> &records);
+	uint64_t reserve(change_type type, string_view key, string_view value);
+	/* Publishes the unit with the next sequence number. */
+	void commit(uint64_t unit);
+	/* Drops the unit, its mutation was not done. */
+	void cancel(uint64_t unit);
+
+	/* Reserves and commits records of mutations which are already done. */
+	void append(change_type type, string_view key, string_view value);
+
+	/*
+	 * Commits units reserved before a crash, for which 'applied' returns true,
+	 * and cancels the others. Has to be called after open, before any unit
+	 * is reserved.
+	 */
+	void resolve_pending(const applied_function &applied);
+
+	/*
+	 * Marks (persistently) that mutations are done, which will be logged only
+	 * after they all are done (by append). If a crash happens before
+	 * end_deferred, or 'logged' is false, readers are told that records are
+	 * missing (by NOT_FOUND), as if they were overwritten.
+	 */
+	void begin_deferred();
+	void end_deferred(bool logged);
+
+	/* sequence number of the newest unit, 0 if there is none */
+	uint64_t last_seq();
+
+	/*
+	 * Calls callback for records with sequence numbers greater than 'since'
+	 * (waiting up to 'timeout' if there are none yet). Returns NOT_FOUND if
+	 * some of them were already overwritten.
+	 */
+	status read(uint64_t since, std::chrono::milliseconds timeout,
+		    change_callback *callback, void *arg);
+
+private:
+	struct header {
+		uint64_t magic;
+		/* size of the data area */
+		uint64_t size;
+		/* logical offsets (growing, taken modulo size) */
+		uint64_t first;
+		uint64_t end;
+		/* sequence number of the newest overwritten unit */
+		uint64_t dropped;
+		/* non-zero between begin_deferred and end_deferred */
+		uint64_t deferred;
+	};
+
+	struct unit_header {
+		/* sequence number, once committed (see pending and cancelled) */
+		uint64_t seq;
+		/* size of the unit, with this header */
+		uint64_t size;
+	};
+
+	struct record_header {
+		uint32_t type;
+		uint32_t key_size;
+		uint64_t value_size;
+	};
+
+	struct record_ref {
+		change_type type;
+		string_view key;
+		string_view value;
+	};
+
+	static const uint64_t magic = 0x474f4c45474e4843ULL; /* "CHNGELOG" */
+	static const uint64_t pending = 0;
+	static const uint64_t cancelled = UINT64_MAX;
+	/* units read at once, before the callback is called outside the lock */
+	static const std::size_t read_batch_bytes = 1 << 20;
+
+	void init(char *region, std::size_t size);
+	void recover();
+	void report_gap();
+	uint64_t reserve(const record_ref *records, std::size_t n);
+	void make_room(std::unique_lock<std::mutex> &lock, std::size_t bytes);
+	void set_seq(uint64_t unit, uint64_t seq);
+	std::size_t read_unit(uint64_t offset, uint64_t seq,
+			      std::vector<std::pair<uint64_t, record>> &batch) const;
+
+	void write_at(uint64_t offset, const void *src, std::size_t n);
+	void read_at(uint64_t offset, void *dest, std::size_t n) const;
+
+	std::vector<char> buffer;
+	header *hdr;
+	char *data;
+	persist_function persist;
+
+	std::mutex mtx;
+	/* notified on commits (for readers) and on ends of pending units */
+	std::condition_variable cv;
+	/* sequence numbers and offsets of committed units, in order of commits */
+	std::deque<std::pair<uint64_t, uint64_t>> units;
+	/* offsets of reserved units, with threads which reserved them */
+	std::map<uint64_t, std::thread::id> reserved;
+	uint64_t last = 0;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_CHANGE_LOG_H */
@@ -0,0 +1,738 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "change_log_engine.h"
+#include "exceptions.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <unordered_set>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+namespace
+{
+
+/* number of logged mutations in progress on this thread (see expire) */
+thread_local unsigned mutations_in_progress = 0;
+
+struct mutation_guard {
+	mutation_guard()
+	{
+		++mutations_in_progress;
+	}
+
+	~mutation_guard()
+	{
+		--mutations_in_progress;
+	}
+};
+
+struct bulk_load_context {
+	change_log_engine *engine;
+	bulk_load_callback *callback;
+	void *arg;
+	/* first, one before last and last of keys taken by the engine */
+	std::string first, prev, last;
+	size_t taken;
+};
+
+} /* anonymous namespace */
+
+std::unique_ptr<engine_base> change_log_engine::wrap(std::unique_ptr<engine_base> engine,
+						     std::size_t size)
+{
+	std::unique_ptr<change_log> log(engine->open_change_log(size));
+	if (!log) {
+		engine->set_expire_hook(expire_hook());
+		return engine;
+	}
+
+	return std::unique_ptr<engine_base>(
+		new change_log_engine(std::move(engine), std::move(log)));
+}
+
+change_log_engine::change_log_engine(std::unique_ptr<engine_base> engine,
+				     std::unique_ptr<change_log> log)
+    : engine(std::move(engine)), log(std::move(log))
+{
+	this->log->resolve_pending([this](const std::vector<change_log::record> &records) {
+		return applied(records);
+	});
+
+	this->engine->set_expire_hook(
+		[this](string_view key, const std::function<bool()> &erase) {
+			return expire(key, erase);
+		});
+}
+
+std::size_t change_log_engine::stripe_index(string_view key)
+{
+	return std::hash<std::string>()(std::string(key.data(), key.size())) %
+		stripes_count;
+}
+
+std::mutex &change_log_engine::stripe(string_view key)
+{
+	return stripes[stripe_index(key)];
+}
+
+std::vector<std::unique_lock<std::mutex>> change_log_engine::lock_all_stripes()
+{
+	std::vector<std::unique_lock<std::mutex>> locks;
+	for (auto &m : stripes)
+		locks.emplace_back(m);
+
+	return locks;
+}
+
+void change_log_engine::check_fits(string_view key, string_view value)
+{
+	if (!log->fits(change_log::record_size(key.size(), value.size())))
+		throw internal::invalid_argument(
+			"Record does not fit in the change log (\"change_log_size\")");
+}
+
+status change_log_engine::apply(uint64_t unit, const std::function<status()> &mutation)
+{
+	status s;
+	try {
+		mutation_guard guard;
+		s = mutation();
+	} catch (...) {
+		log->cancel(unit);
+		throw;
+	}
+
+	if (s == status::OK)
+		log->commit(unit);
+	else
+		log->cancel(unit);
+
+	return s;
+}
+
+/*
+ * Mutations of a unit are checked against the data in the engine, by the last
+ * record of each key. A mutation which does not change the data is reported
+ * as done, its record changes nothing either. Removals of ranges are done
+ * again, as they may be interrupted in the middle (e.g. in stree).
+ */
+bool change_log_engine::applied(const std::vector<change_log::record> &records)
+{
+	std::unordered_set<std::string> checked;
+	for (auto r = records.rbegin(); r != records.rend(); ++r) {
+		switch (r->type) {
+			case change_type::PUT: {
+				if (!checked.insert(r->key).second)
+					continue;
+
+				std::string value;
+				auto s = engine->get(
+					r->key,
+					[](const char *v, size_t vb, void *arg) {
+						static_cast<std::string *>(arg)->assign(v, vb);
+					},
+					&value);
+				if (s != status::OK || value != r->value)
+					return false;
+				break;
+			}
+			case change_type::REMOVE:
+				if (!checked.insert(r->key).second)
+					continue;
+				if (engine->exists(r->key) != status::NOT_FOUND)
+					return false;
+				break;
+			case change_type::REMOVE_RANGE:
+				if (engine->remove_range(r->key, r->value) != status::OK)
+					return false;
+				break;
+			case change_type::REMOVE_PREFIX:
+				if (engine->remove_prefix(r->key) != status::OK)
+					return false;
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Keys expired by the engine on a thread doing a logged mutation (stree expires
+ * them on writes) are removed under stripes of that mutation already, and such
+ * engines are not concurrent. Others lock the key's stripe, as remove does.
+ */
+bool change_log_engine::expire(string_view key, const std::function<bool()> &erase)
+{
+	std::unique_lock<std::mutex> lock;
+	if (mutations_in_progress == 0)
+		lock = std::unique_lock<std::mutex>(stripe(key));
+
+	auto unit = log->reserve(change_type::REMOVE, key, string_view());
+	bool erased;
+	try {
+		mutation_guard guard;
+		erased = erase();
+	} catch (...) {
+		log->cancel(unit);
+		throw;
+	}
+
+	if (erased)
+		log->commit(unit);
+	else
+		log->cancel(unit);
+
+	return erased;
+}
+
+std::string change_log_engine::name()
+{
+	return engine->name();
+}
+
+bool change_log_engine::concurrent() const
+{
+	return engine->concurrent();
+}
+
+status change_log_engine::count_all(std::size_t &cnt)
+{
+	return engine->count_all(cnt);
+}
+
+status change_log_engine::count_above(string_view key, std::size_t &cnt)
+{
+	return engine->count_above(key, cnt);
+}
+
+status change_log_engine::count_equal_above(string_view key, std::size_t &cnt)
+{
+	return engine->count_equal_above(key, cnt);
+}
+
+status change_log_engine::count_equal_below(string_view key, std::size_t &cnt)
+{
+	return engine->count_equal_below(key, cnt);
+}
+
+status change_log_engine::count_below(string_view key, std::size_t &cnt)
+{
+	return engine->count_below(key, cnt);
+}
+
+status change_log_engine::count_between(string_view key1, string_view key2,
+					 std::size_t &cnt)
+{
+	return engine->count_between(key1, key2, cnt);
+}
+
+status change_log_engine::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	return engine->count_prefix(prefix, cnt);
+}
+
+status change_log_engine::get_all(get_kv_callback *callback, void *arg)
+{
+	return engine->get_all(callback, arg);
+}
+
+status change_log_engine::get_above(string_view key, get_kv_callback *callback,
+				    void *arg)
+{
+	return engine->get_above(key, callback, arg);
+}
+
+status change_log_engine::get_equal_above(string_view key, get_kv_callback *callback,
+					  void *arg)
+{
+	return engine->get_equal_above(key, callback, arg);
+}
+
+status change_log_engine::get_equal_below(string_view key, get_kv_callback *callback,
+					  void *arg)
+{
+	return engine->get_equal_below(key, callback, arg);
+}
+
+status change_log_engine::get_below(string_view key, get_kv_callback *callback,
+				    void *arg)
+{
+	return engine->get_below(key, callback, arg);
+}
+
+status change_log_engine::get_between(string_view key1, string_view key2,
+				      get_kv_callback *callback, void *arg)
+{
+	return engine->get_between(key1, key2, callback, arg);
+}
+
+status change_log_engine::get_prefix(string_view prefix, get_kv_callback *callback,
+				     void *arg)
+{
+	return engine->get_prefix(prefix, callback, arg);
+}
+
+status change_log_engine::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	return engine->get_all_desc(callback, arg);
+}
+
+status change_log_engine::get_above_desc(string_view key, get_kv_callback *callback,
+					 void *arg)
+{
+	return engine->get_above_desc(key, callback, arg);
+}
+
+status change_log_engine::get_equal_above_desc(string_view key,
+					       get_kv_callback *callback, void *arg)
+{
+	return engine->get_equal_above_desc(key, callback, arg);
+}
+
+status change_log_engine::get_equal_below_desc(string_view key,
+					       get_kv_callback *callback, void *arg)
+{
+	return engine->get_equal_below_desc(key, callback, arg);
+}
+
+status change_log_engine::get_below_desc(string_view key, get_kv_callback *callback,
+					 void *arg)
+{
+	return engine->get_below_desc(key, callback, arg);
+}
+
+status change_log_engine::get_between_desc(string_view key1, string_view key2,
+					   get_kv_callback *callback, void *arg)
+{
+	return engine->get_between_desc(key1, key2, callback, arg);
+}
+
+status change_log_engine::get_all_parallel(std::size_t num_partitions,
+					   get_kv_callback *callback, void *arg)
+{
+	return engine->get_all_parallel(num_partitions, callback, arg);
+}
+
+status change_log_engine::split_points(std::size_t n, get_v_callback *callback,
+				       void *arg)
+{
+	return engine->split_points(n, callback, arg);
+}
+
+status change_log_engine::exists(string_view key)
+{
+	return engine->exists(key);
+}
+
+status change_log_engine::get(string_view key, get_v_callback *callback, void *arg)
+{
+	return engine->get(key, callback, arg);
+}
+
+status change_log_engine::get_ref(string_view key, std::unique_ptr<value_ref_base> &ref)
+{
+	return engine->get_ref(key, ref);
+}
+
+status change_log_engine::put(string_view key, string_view value)
+{
+	check_fits(key, value);
+
+	std::unique_lock<std::mutex> lock(stripe(key));
+	auto unit = log->reserve(change_type::PUT, key, value);
+	return apply(unit, [&] { return engine->put(key, value); });
+}
+
+/* TTL is not recorded, expiration of the key is logged as a remove */
+status change_log_engine::put_with_ttl(string_view key, string_view value,
+				       uint64_t ttl_ms)
+{
+	check_fits(key, value);
+
+	std::unique_lock<std::mutex> lock(stripe(key));
+	auto unit = log->reserve(change_type::PUT, key, value);
+	return apply(unit, [&] { return engine->put_with_ttl(key, value, ttl_ms); });
+}
+
+status change_log_engine::remove(string_view key)
+{
+	check_fits(key, string_view());
+
+	std::unique_lock<std::mutex> lock(stripe(key));
+	auto unit = log->reserve(change_type::REMOVE, key, string_view());
+	return apply(unit, [&] { return engine->remove(key); });
+}
+
+status change_log_engine::remove_range(string_view key1, string_view key2)
+{
+	check_fits(key1, key2);
+
+	auto locks = lock_all_stripes();
+	auto unit = log->reserve(change_type::REMOVE_RANGE, key1, key2);
+	return apply(unit, [&] { return engine->remove_range(key1, key2); });
+}
+
+status change_log_engine::remove_prefix(string_view prefix)
+{
+	check_fits(prefix, string_view());
+
+	auto locks = lock_all_stripes();
+	auto unit = log->reserve(change_type::REMOVE_PREFIX, prefix, string_view());
+	return apply(unit, [&] { return engine->remove_prefix(prefix); });
+}
+
+status change_log_engine::defrag(double start_percent, double amount_percent)
+{
+	return engine->defrag(start_percent, amount_percent);
+}
+
+status change_log_engine::memory_usage(memory_stats &stats)
+{
+	return engine->memory_usage(stats);
+}
+
+/*
+ * A record taken from the source is loaded only when the engine commits it
+ * (with others), or not at all if the load fails. Keys are taken in ascending
+ * order, so after the load current values of all keys from the first to the
+ * last taken one are logged - including keys which were in the engine before,
+ * whose records change nothing. If a crash interrupts it, a gap is reported by
+ * the log after reopen (see change_log::begin_deferred).
+ */
+status change_log_engine::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	bulk_load_context ctx{this, callback, arg, "", "", "", 0};
+
+	auto locks = lock_all_stripes();
+	log->begin_deferred();
+
+	status s;
+	try {
+		mutation_guard guard;
+		s = engine->bulk_load(
+			[](const char **k, size_t *kb, const char **v, size_t *vb,
+			   void *arg) {
+				auto c = static_cast<bulk_load_context *>(arg);
+				auto ret = c->callback(k, kb, v, vb, c->arg);
+				if (ret != 0)
+					return ret;
+
+				string_view key(*k, *kb), value(*v, *vb);
+				c->engine->check_fits(key, value);
+				if (c->taken++ == 0)
+					c->first.assign(*k, *kb);
+				c->prev.swap(c->last);
+				c->last.assign(*k, *kb);
+
+				return 0;
+			},
+			&ctx);
+	} catch (...) {
+		log_loaded(ctx.taken, ctx.first, ctx.prev, ctx.last);
+		throw;
+	}
+
+	log_loaded(ctx.taken, ctx.first, ctx.prev, ctx.last);
+
+	return s;
+}
+
+/*
+ * The last key may be the one out of order, which made the load fail - then
+ * the keys before it end the loaded range.
+ */
+void change_log_engine::log_loaded(size_t taken, const std::string &first,
+				   const std::string &prev, const std::string &last)
+{
+	try {
+		if (taken > 0)
+			log_range(first, taken > 1 ? &prev : nullptr, last);
+	} catch (...) {
+		log->end_deferred(false);
+		throw;
+	}
+
+	log->end_deferred(true);
+}
+
+void change_log_engine::log_range(const std::string &first, const std::string *prev,
+				  const std::string &last)
+{
+	auto log_put = [](const char *k, size_t kb, const char *v, size_t vb,
+			  void *arg) {
+		static_cast<change_log *>(arg)->append(change_type::PUT,
+						       string_view(k, kb),
+						       string_view(v, vb));
+		return 0;
+	};
+	auto log_key = [&](const std::string &key) {
+		std::pair<change_log *, const std::string *> ctx{log.get(), &key};
+		engine->get(
+			key,
+			[](const char *v, size_t vb, void *arg) {
+				auto c = static_cast<
+					std::pair<change_log *, const std::string *> *>(arg);
+				c->first->append(change_type::PUT, *c->second,
+						 string_view(v, vb));
+			},
+			&ctx);
+	};
+
+	log_key(first);
+	if (prev && *prev != first) {
+		engine->get_between(first, *prev, log_put, log.get());
+		log_key(*prev);
+	}
+	if (last != first && (!prev || last != *prev))
+		log_key(last);
+}
+
+internal::transaction *change_log_engine::begin_tx()
+{
+	return new change_log_transaction(engine->begin_tx(), *this);
+}
+
+iterator_base *change_log_engine::new_iterator()
+{
+	return new change_log_iterator(engine->new_iterator(), *this);
+}
+
+iterator_base *change_log_engine::new_const_iterator()
+{
+	return engine->new_const_iterator();
+}
+
+engine_base *change_log_engine::new_snapshot()
+{
+	return engine->new_snapshot();
+}
+
+status change_log_engine::get_codec_state(std::string &state)
+{
+	return engine->get_codec_state(state);
+}
+
+status change_log_engine::set_codec_state(string_view state)
+{
+	return engine->set_codec_state(state);
+}
+
+status change_log_engine::changes(uint64_t since, std::chrono::milliseconds timeout,
+				  change_callback *callback, void *arg)
+{
+	return log->read(since, timeout, callback, arg);
+}
+
+status change_log_engine::changes_last_seq(uint64_t &seq)
+{
+	seq = log->last_seq();
+
+	return status::OK;
+}
+
+change_log_engine::change_log_iterator::change_log_iterator(iterator_base *it,
+							    change_log_engine &engine)
+    : it(it), engine(engine)
+{
+}
+
+status change_log_engine::change_log_iterator::seek(string_view key)
+{
+	return it->seek(key);
+}
+
+status change_log_engine::change_log_iterator::seek_lower(string_view key)
+{
+	return it->seek_lower(key);
+}
+
+status change_log_engine::change_log_iterator::seek_lower_eq(string_view key)
+{
+	return it->seek_lower_eq(key);
+}
+
+status change_log_engine::change_log_iterator::seek_higher(string_view key)
+{
+	return it->seek_higher(key);
+}
+
+status change_log_engine::change_log_iterator::seek_higher_eq(string_view key)
+{
+	return it->seek_higher_eq(key);
+}
+
+status change_log_engine::change_log_iterator::seek_prefix(string_view prefix)
+{
+	return it->seek_prefix(prefix);
+}
+
+status change_log_engine::change_log_iterator::seek_to_first()
+{
+	return it->seek_to_first();
+}
+
+status change_log_engine::change_log_iterator::seek_to_last()
+{
+	return it->seek_to_last();
+}
+
+status change_log_engine::change_log_iterator::is_next()
+{
+	return it->is_next();
+}
+
+status change_log_engine::change_log_iterator::next()
+{
+	return it->next();
+}
+
+status change_log_engine::change_log_iterator::prev()
+{
+	return it->prev();
+}
+
+result<string_view> change_log_engine::change_log_iterator::key()
+{
+	return it->key();
+}
+
+result<pmem::obj::slice<const char *>>
+change_log_engine::change_log_iterator::read_range(size_t pos, size_t n)
+{
+	return it->read_range(pos, n);
+}
+
+result<size_t> change_log_engine::change_log_iterator::next_batch(
+	size_t n, const char **keys, size_t *kbs, const char **values, size_t *vbs)
+{
+	return it->next_batch(n, keys, kbs, values, vbs);
+}
+
+result<pmem::obj::slice<char *>>
+change_log_engine::change_log_iterator::write_range(size_t pos, size_t n)
+{
+	auto range = it->write_range(pos, n);
+	if (range.is_ok())
+		writes.emplace_back(pos, range.get_value());
+
+	return range;
+}
+
+/*
+ * Modifications are applied to the current record, its whole (new) value is
+ * logged. The stripe is not locked here: the wrapped iterator already holds its
+ * engine's locks, which a put or remove waits for with the stripe held. Instead,
+ * the record stays locked by the wrapped iterator until it moves, so no other
+ * mutation of the key is applied between the commit and its log record.
+ */
+status change_log_engine::change_log_iterator::commit()
+{
+	if (writes.empty())
+		return it->commit();
+
+	auto k = it->key();
+	if (!k.is_ok())
+		return k.get_status();
+	auto key = std::string(k.get_value().data(), k.get_value().size());
+
+	auto current = it->read_range(0, std::numeric_limits<size_t>::max());
+	if (!current.is_ok())
+		return current.get_status();
+	std::string value(current.get_value().begin(), current.get_value().size());
+	for (auto &w : writes)
+		value.replace(w.first, w.second.size(), w.second.begin(),
+			      w.second.size());
+	engine.check_fits(key, value);
+
+	auto unit = engine.log->reserve(change_type::PUT, key, value);
+	auto s = engine.apply(unit, [&] { return it->commit(); });
+	if (s == status::OK)
+		writes.clear();
+
+	return s;
+}
+
+void change_log_engine::change_log_iterator::abort()
+{
+	it->abort();
+	writes.clear();
+}
+
+change_log_engine::change_log_transaction::change_log_transaction(
+	transaction *tx, change_log_engine &engine)
+    : tx(tx), engine(engine)
+{
+}
+
+status change_log_engine::change_log_transaction::put(string_view key, string_view value)
+{
+	auto s = tx->put(key, value);
+	if (s == status::OK) {
+		records.push_back({change_type::PUT, std::string(key.data(), key.size()),
+				   std::string(value.data(), value.size())});
+		bytes += change_log::record_size(key.size(), value.size());
+	}
+
+	return s;
+}
+
+status change_log_engine::change_log_transaction::remove(string_view key)
+{
+	auto s = tx->remove(key);
+	if (s == status::OK) {
+		records.push_back(
+			{change_type::REMOVE, std::string(key.data(), key.size()), ""});
+		bytes += change_log::record_size(key.size(), 0);
+	}
+
+	return s;
+}
+
+/* stripes of all keys are locked (in order) for the commit and its logging */
+status change_log_engine::change_log_transaction::commit()
+{
+	if (!engine.log->fits(bytes))
+		throw internal::invalid_argument(
+			"Transaction does not fit in the change log");
+
+	std::vector<std::size_t> indexes;
+	for (auto &r : records)
+		indexes.push_back(engine.stripe_index(r.key));
+	std::sort(indexes.begin(), indexes.end());
+	indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+	std::vector<std::unique_lock<std::mutex>> locks;
+	for (auto i : indexes)
+		locks.emplace_back(engine.stripes[i]);
+
+	if (records.empty())
+		return tx->commit();
+
+	auto unit = engine.log->reserve(records);
+	auto s = engine.apply(unit, [&] { return tx->commit(); });
+	if (s == status::OK) {
+		records.clear();
+		bytes = 0;
+	}
+
+	return s;
+}
+
+void change_log_engine::change_log_transaction::abort()
+{
+	tx->abort();
+	records.clear();
+	bytes = 0;
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_CHANGE_LOG_ENGINE_H
+#define LIBPMEMKV_CHANGE_LOG_ENGINE_H
+
+#include "change_log.h"
+#include "engine.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Engine which records committed puts and removes of the wrapped engine in
+ * a change log. Records of a mutation are reserved in the log before it is
+ * done and committed after it (see change_log), so a crash between them does
+ * not lose the record. A mutation and its record are done under a lock of the
+ * key's stripe, so records of a key are in the order the mutations were
+ * applied. Commits of write iterators rely on the wrapped iterator's lock of
+ * the record instead (see change_log_iterator::commit). Removals of expired
+ * keys are recorded through the engine's expire hook.
+ *
+ * Log is opened (see engine_base::open_change_log) when it is requested in
+ * config or when it was created earlier; afterwards it is always used.
+ */
+class change_log_engine : public engine_base {
+public:
+	/*
+	 * Returns the engine wrapped with its change log or unwrapped engine if
+	 * there is no log and 'size' is 0.
+	 */
+	static std::unique_ptr<engine_base> wrap(std::unique_ptr<engine_base> engine,
+						 std::size_t size);
+
+	change_log_engine(std::unique_ptr<engine_base> engine,
+			  std::unique_ptr<change_log> log);
+
+	std::string name() final;
+	bool concurrent() const final;
+
+	status count_all(std::size_t &cnt) final;
+	status count_above(string_view key, std::size_t &cnt) final;
+	status count_equal_above(string_view key, std::size_t &cnt) final;
+	status count_equal_below(string_view key, std::size_t &cnt) final;
+	status count_below(string_view key, std::size_t &cnt) final;
+	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
+
+	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_equal_above(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_equal_below(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
+			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
+	status split_points(std::size_t n, get_v_callback *callback, void *arg) final;
+
+	status exists(string_view key) final;
+
+	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key, std::unique_ptr<value_ref_base> &ref) final;
+	status put(string_view key, string_view value) final;
+	status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms) final;
+	status remove(string_view key) final;
+	/* all stripes are locked, so the removal is logged as a single record */
+	status remove_range(string_view key1, string_view key2) final;
+	status remove_prefix(string_view prefix) final;
+	status defrag(double start_percent, double amount_percent) final;
+	status memory_usage(memory_stats &stats) final;
+	/* loaded records are logged after the engine is done with them */
+	status bulk_load(bulk_load_callback *callback, void *arg) final;
+
+	internal::transaction *begin_tx() final;
+
+	iterator_base *new_iterator() final;
+	iterator_base *new_const_iterator() final;
+
+	/* snapshots are read-only, so they are not wrapped */
+	engine_base *new_snapshot() final;
+
+	status get_codec_state(std::string &state) final;
+	status set_codec_state(string_view state) final;
+
+	status changes(uint64_t since, std::chrono::milliseconds timeout,
+		       change_callback *callback, void *arg) final;
+	status changes_last_seq(uint64_t &seq) final;
+
+private:
+	class change_log_iterator;
+	class change_log_transaction;
+
+	static const std::size_t stripes_count = 64;
+
+	std::mutex &stripe(string_view key);
+	std::size_t stripe_index(string_view key);
+	std::vector<std::unique_lock<std::mutex>> lock_all_stripes();
+	/* throws if a record of the key and value could never be logged */
+	void check_fits(string_view key, string_view value);
+
+	/*
+	 * Does the mutation of a reserved unit, commits the unit if the mutation
+	 * succeeds and cancels it otherwise.
+	 */
+	status apply(uint64_t unit, const std::function<status()> &mutation);
+	/* tells if mutations of a unit reserved before a crash were done */
+	bool applied(const std::vector<change_log::record> &records);
+	bool expire(string_view key, const std::function<bool()> &erase);
+	/*
+	 * Logs current values of keys taken by bulk_load (taken of them, from
+	 * first to last) and ends the deferred logging.
+	 */
+	void log_loaded(size_t taken, const std::string &first, const std::string &prev,
+			const std::string &last);
+	void log_range(const std::string &first, const std::string *prev,
+		       const std::string &last);
+
+	/* declared first, so the log is closed before the engine */
+	std::unique_ptr<engine_base> engine;
+	std::unique_ptr<change_log> log;
+	std::array<std::mutex, stripes_count> stripes;
+};
+
+/**
+ * Write iterator which logs the value of the current record (as a put) when
+ * its modifications are committed.
+ */
+class change_log_engine::change_log_iterator : public iterator_base {
+public:
+	change_log_iterator(iterator_base *it, change_log_engine &engine);
+
+	status seek(string_view key) final;
+	status seek_lower(string_view key) final;
+	status seek_lower_eq(string_view key) final;
+	status seek_higher(string_view key) final;
+	status seek_higher_eq(string_view key) final;
+	status seek_prefix(string_view prefix) final;
+
+	status seek_to_first() final;
+	status seek_to_last() final;
+
+	status is_next() final;
+	status next() final;
+	status prev() final;
+
+	result<string_view> key() final;
+
+	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+	result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+				  const char **values, size_t *vbs) final;
+
+	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
+	status commit() final;
+	void abort() final;
+
+private:
+	std::unique_ptr<iterator_base> it;
+	change_log_engine &engine;
+	/* uncommitted modifications of the current record (positions and ranges) */
+	std::vector<std::pair<size_t, pmem::obj::slice<char *>>> writes;
+};
+
+/**
+ * Transaction which logs its puts and removes as a unit, when it is committed.
+ */
+class change_log_engine::change_log_transaction : public transaction {
+public:
+	change_log_transaction(transaction *tx, change_log_engine &engine);
+
+	status put(string_view key, string_view value) final;
+	status remove(string_view key) final;
+	status commit() final;
+	void abort() final;
+
+private:
+	std::unique_ptr<transaction> tx;
+	change_log_engine &engine;
+	std::vector<change_log::record> records;
+	std::size_t bytes = 0;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_CHANGE_LOG_ENGINE_H */
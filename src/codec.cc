@@ -0,0 +1,420 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "codec.h"
+#include "exceptions.h"
+#include "out.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+namespace lz
+{
+
+static constexpr size_t min_match = 4;
+static constexpr size_t max_offset = 65535;
+static constexpr unsigned hash_bits = 12;
+static constexpr uint32_t no_pos = UINT32_MAX;
+
+static uint32_t read32(const char *p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint32_t hash4(const char *p)
+{
+	return (read32(p) * 2654435761U) >> (32 - hash_bits);
+}
+
+/* lengths which do not fit in 4 bits of the token continue in following bytes */
+static void put_length(std::string &dst, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		dst.push_back(static_cast<char>(255));
+	dst.push_back(static_cast<char>(len));
+}
+
+static void put_sequence(std::string &dst, const char *literals, size_t n_literals,
+			 size_t offset, size_t match_len)
+{
+	size_t extra = match_len - min_match;
+	dst.push_back(static_cast<char>((std::min<size_t>(n_literals, 15) << 4) |
+					std::min<size_t>(extra, 15)));
+	if (n_literals >= 15)
+		put_length(dst, n_literals - 15);
+	dst.append(literals, n_literals);
+
+	dst.push_back(static_cast<char>(offset & 0xff));
+	dst.push_back(static_cast<char>(offset >> 8));
+	if (extra >= 15)
+		put_length(dst, extra - 15);
+}
+
+bool compress(string_view src, string_view dict, std::string &dst, size_t limit)
+{
+	thread_local std::string buf;
+	thread_local std::vector<uint32_t> table;
+
+	/* dictionary and the input are searched for matches as one buffer */
+	const char *base = src.data();
+	size_t start = 0;
+	if (dict.size() > 0) {
+		buf.assign(dict.data(), dict.size());
+		buf.append(src.data(), src.size());
+		base = buf.data();
+		start = dict.size();
+	}
+	size_t end = start + src.size();
+
+	table.assign(1U << hash_bits, no_pos);
+	for (size_t i = 0; i + min_match <= start; i++)
+		table[hash4(base + i)] = static_cast<uint32_t>(i);
+
+	size_t dst_start = dst.size();
+	size_t anchor = start;
+	size_t i = start;
+	while (i + min_match <= end) {
+		auto h = hash4(base + i);
+		uint32_t candidate = table[h];
+		table[h] = static_cast<uint32_t>(i);
+
+		if (candidate == no_pos || i - candidate > max_offset ||
+		    read32(base + candidate) != read32(base + i)) {
+			++i;
+			continue;
+		}
+
+		size_t len = min_match;
+		while (i + len < end && base[candidate + len] == base[i + len])
+			++len;
+
+		put_sequence(dst, base + anchor, i - anchor, i - candidate, len);
+		if (dst.size() - dst_start >= limit)
+			return false;
+
+		i += len;
+		anchor = i;
+	}
+
+	/* the last sequence has literals only */
+	size_t n_literals = end - anchor;
+	dst.push_back(static_cast<char>(std::min<size_t>(n_literals, 15) << 4));
+	if (n_literals >= 15)
+		put_length(dst, n_literals - 15);
+	dst.append(base + anchor, n_literals);
+
+	return dst.size() - dst_start < limit;
+}
+
+void decompress(string_view src, string_view dict, char *dst, size_t size)
+{
+	auto in = reinterpret_cast<const unsigned char *>(src.data());
+	auto in_end = in + src.size();
+	size_t out = 0;
+
+	auto corrupted = [] { throw internal::error("Compressed value is corrupted"); };
+	auto get_length = [&](size_t len) {
+		if (len != 15)
+			return len;
+		unsigned char b;
+		do {
+			if (in == in_end)
+				corrupted();
+			b = *in++;
+			len += b;
+		} while (b == 255);
+		return len;
+	};
+
+	while (true) {
+		if (in == in_end)
+			corrupted();
+		unsigned token = *in++;
+
+		size_t n_literals = get_length(token >> 4);
+		if (n_literals > static_cast<size_t>(in_end - in) ||
+		    n_literals > size - out)
+			corrupted();
+		std::memcpy(dst + out, in, n_literals);
+		in += n_literals;
+		out += n_literals;
+
+		if (in == in_end)
+			break;
+
+		if (in_end - in < 2)
+			corrupted();
+		size_t offset = static_cast<size_t>(in[0]) |
+			(static_cast<size_t>(in[1]) << 8);
+		in += 2;
+		size_t len = get_length(token & 15) + min_match;
+		if (offset == 0 || offset > out + dict.size() || len > size - out)
+			corrupted();
+
+		if (offset > out) {
+			/* match starts in the dictionary */
+			size_t from_dict = std::min(offset - out, len);
+			std::memcpy(dst + out, dict.data() + dict.size() - (offset - out),
+				    from_dict);
+			out += from_dict;
+			len -= from_dict;
+		}
+		/* byte by byte, the match may overlap with its own output */
+		for (; len > 0; --len, ++out)
+			dst[out] = dst[out - offset];
+	}
+
+	if (out != size)
+		corrupted();
+}
+
+std::string train_dictionary(const std::vector<std::string> &samples, size_t size)
+{
+	static constexpr size_t gram = 8;
+	static constexpr size_t segment = 64;
+
+	size_t total = 0;
+	for (auto &s : samples)
+		total += s.size();
+
+	std::string dict;
+	if (total <= size) {
+		for (auto &s : samples)
+			dict += s;
+		return dict;
+	}
+
+	auto gram_hash = [](const char *p) {
+		uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v * 0x9E3779B97F4A7C15ULL;
+	};
+
+	/* in how many samples each gram occurs */
+	std::unordered_map<uint64_t, uint32_t> freq;
+	for (auto &s : samples) {
+		std::vector<uint64_t> grams;
+		for (size_t i = 0; i + gram <= s.size(); i++)
+			grams.push_back(gram_hash(s.data() + i));
+		std::sort(grams.begin(), grams.end());
+		grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+		for (auto g : grams)
+			++freq[g];
+	}
+
+	/* score of a segment is the sum of frequencies of its (not yet used) grams */
+	auto score = [&](const std::string &s, size_t pos) {
+		uint64_t sum = 0;
+		size_t last = std::min(pos + segment, s.size());
+		for (size_t i = pos; i + gram <= last; i++) {
+			auto it = freq.find(gram_hash(s.data() + i));
+			if (it != freq.end() && it->second > 1)
+				sum += it->second;
+		}
+		return sum;
+	};
+
+	/* (score, (sample, position)) */
+	using candidate = std::pair<uint64_t, std::pair<size_t, size_t>>;
+	std::priority_queue<candidate> queue;
+	for (size_t s = 0; s < samples.size(); s++)
+		for (size_t pos = 0; pos + gram <= samples[s].size(); pos += segment)
+			queue.push({score(samples[s], pos), {s, pos}});
+
+	/*
+	 * Greedy selection, with lazily updated scores: a segment is taken only if
+	 * its current score is still the best one. Grams of taken segments are
+	 * not counted anymore, which avoids filling the dictionary with copies.
+	 */
+	std::vector<string_view> chosen;
+	size_t chosen_size = 0;
+	while (!queue.empty() && chosen_size < size) {
+		auto c = queue.top();
+		queue.pop();
+
+		auto &s = samples[c.second.first];
+		auto pos = c.second.second;
+		auto current = score(s, pos);
+		if (current == 0)
+			continue;
+		if (current < c.first && !queue.empty() && current < queue.top().first) {
+			queue.push({current, c.second});
+			continue;
+		}
+
+		size_t len = std::min({segment, s.size() - pos, size - chosen_size});
+		chosen.emplace_back(s.data() + pos, len);
+		chosen_size += len;
+		for (size_t i = pos; i + gram <= pos + len; i++)
+			freq.erase(gram_hash(s.data() + i));
+	}
+
+	/* the best segments go last, closest to the data (shortest offsets) */
+	for (auto it = chosen.rbegin(); it != chosen.rend(); ++it)
+		dict.append(it->data(), it->size());
+
+	return dict;
+}
+
+} /* namespace lz */
+
+static void put_varint(std::string &dst, uint64_t v)
+{
+	for (; v >= 0x80; v >>= 7)
+		dst.push_back(static_cast<char>((v & 0x7f) | 0x80));
+	dst.push_back(static_cast<char>(v));
+}
+
+static uint64_t get_varint(string_view &src)
+{
+	uint64_t v = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		if (src.size() == 0)
+			break;
+		auto b = static_cast<unsigned char>(src.data()[0]);
+		src = string_view(src.data() + 1, src.size() - 1);
+		v |= static_cast<uint64_t>(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return v;
+	}
+	throw internal::error("Compressed value is corrupted");
+}
+
+value_codec::params value_codec::from_config(config &cfg)
+{
+	params p;
+	const char *name = nullptr;
+	p.name = cfg.get_string("value_codec", &name) ? name : "";
+	cfg.get_uint64("value_codec_min_size", &p.min_size);
+	cfg.get_uint64("value_codec_dict_size", &p.dict_size);
+	cfg.get_uint64("value_codec_dict_samples", &p.dict_samples);
+
+	if (!p.name.empty() && p.name != "none" && p.name != "lz" && p.name != "lz_dict")
+		throw internal::invalid_argument(
+			"Config item \"value_codec\" must be one of: none, lz, lz_dict");
+	if (p.dict_size == 0 || p.dict_size > lz::max_offset)
+		throw internal::invalid_argument(
+			"Config item \"value_codec_dict_size\" must be in range [1, 65535]");
+	if (p.dict_samples == 0)
+		throw internal::invalid_argument(
+			"Config item \"value_codec_dict_samples\" must be greater than 0");
+
+	return p;
+}
+
+std::string value_codec::serialize(const std::string &name, string_view dictionary)
+{
+	std::string state = name;
+	state.push_back('\0');
+	state.append(dictionary.data(), dictionary.size());
+	return state;
+}
+
+void value_codec::parse(string_view state, std::string &name, std::string &dictionary)
+{
+	auto s = std::string(state.data(), state.size());
+	auto sep = s.find('\0');
+	if (sep == std::string::npos)
+		throw internal::error("State of the value codec is corrupted");
+
+	name = s.substr(0, sep);
+	dictionary = s.substr(sep + 1);
+}
+
+value_codec::value_codec(const params &p, string_view dictionary, store_fn store)
+    : p(p),
+      store(std::move(store)),
+      dictionary(dictionary.data(), dictionary.size()),
+      trained(dictionary.size() > 0)
+{
+}
+
+void value_codec::encode(string_view value, std::string &out)
+{
+	out.clear();
+
+	if (p.name != "none" && value.size() >= p.min_size) {
+		if (p.name == "lz_dict" && !trained.load(std::memory_order_acquire))
+			sample(value);
+
+		bool use_dict = trained.load(std::memory_order_acquire);
+		string_view dict = use_dict ? string_view(dictionary) : string_view();
+		out.push_back(use_dict ? lz_dict_tag : lz_tag);
+		put_varint(out, value.size());
+
+		/* compression must save at least 1/8 of the value to pay off */
+		size_t limit = value.size() - value.size() / 8;
+		if (limit > out.size() &&
+		    lz::compress(value, dict, out, limit - out.size()))
+			return;
+
+		out.clear();
+	}
+
+	out.push_back(raw_tag);
+	out.append(value.data(), value.size());
+}
+
+string_view value_codec::decode(string_view stored, std::string &buf) const
+{
+	if (stored.size() == 0)
+		throw internal::error("Encoded value is corrupted");
+
+	char tag = stored.data()[0];
+	stored = string_view(stored.data() + 1, stored.size() - 1);
+	if (tag == raw_tag)
+		return stored;
+
+	if (tag != lz_tag && tag != lz_dict_tag)
+		throw internal::error("Encoded value is corrupted");
+	if (tag == lz_dict_tag && !trained.load(std::memory_order_acquire))
+		throw internal::error("Value is compressed with a missing dictionary");
+
+	auto size = get_varint(stored);
+	string_view dict = tag == lz_dict_tag ? string_view(dictionary) : string_view();
+	buf.resize(size);
+	lz::decompress(stored, dict, &buf[0], size);
+
+	return string_view(buf.data(), buf.size());
+}
+
+void value_codec::sample(string_view value)
+{
+	std::unique_lock<std::mutex> lock(samples_mtx);
+	if (trained.load(std::memory_order_relaxed))
+		return;
+
+	if (pending.empty()) {
+		samples.emplace_back(value.data(),
+				     std::min<size_t>(value.size(), p.dict_size));
+		if (samples.size() < p.dict_samples)
+			return;
+
+		pending = lz::train_dictionary(samples, p.dict_size);
+		samples.clear();
+		samples.shrink_to_fit();
+	}
+
+	/* dictionary has to be persisted before any value is compressed with it */
+	if (!store(serialize(p.name, pending)))
+		return;
+
+	dictionary = std::move(pending);
+	pending.clear();
+	trained.store(true, std::memory_order_release);
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_CODEC_H
+#define LIBPMEMKV_CODEC_H
+
+#include "config.h"
+#include "libpmemkv.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * LZ77-class block compression (in the spirit of LZ4): a compressed block is
+ * a sequence of (literals, match) pairs, where a match is an offset (up to 64KiB
+ * back) and a length. Matches may also refer to an optional dictionary, which
+ * acts as data preceding the block.
+ */
+namespace lz
+{
+
+/*
+ * Appends compressed 'src' to 'dst'. Returns false (leaving garbage in 'dst')
+ * if the compressed block would not be smaller than 'limit' bytes.
+ */
+bool compress(string_view src, string_view dict, std::string &dst, size_t limit);
+
+/* Decompresses 'src' to 'size' bytes at 'dst', throws if the block is corrupted. */
+void decompress(string_view src, string_view dict, char *dst, size_t size);
+
+/*
+ * Builds a dictionary (of up to 'size' bytes) from segments of the samples
+ * which contain the most of substrings common for many samples.
+ */
+std::string train_dictionary(const std::vector<std::string> &samples, size_t size);
+
+} /* namespace lz */
+
+/**
+ * Encodes values stored in an engine. Every stored value starts with a tag byte
+ * saying how the rest of it is encoded: raw (small or incompressible values),
+ * compressed or compressed with the dictionary.
+ *
+ * In "lz_dict" mode values are compressed without the dictionary until enough
+ * of them is sampled; then the dictionary is trained, persisted (by store_fn,
+ * as a part of the state) and used for all subsequent values. If the state
+ * cannot be persisted yet, the trained dictionary is kept aside and storing it
+ * is retried with the next sampled value.
+ */
+class value_codec {
+public:
+	struct params {
+		/* "none", "lz" or "lz_dict" */
+		std::string name = "none";
+		/* smaller values are stored raw */
+		uint64_t min_size = 64;
+		uint64_t dict_size = 4096;
+		/* number of values sampled before the dictionary is trained */
+		uint64_t dict_samples = 256;
+	};
+
+	/*
+	 * Persists state of the codec (see serialize()). Returns false if it
+	 * cannot be done now (e.g. inside a transaction).
+	 */
+	using store_fn = std::function<bool(string_view state)>;
+
+	/* name is empty if it is not set in config */
+	static params from_config(config &cfg);
+
+	static std::string serialize(const std::string &name, string_view dictionary);
+	static void parse(string_view state, std::string &name, std::string &dictionary);
+
+	value_codec(const params &p, string_view dictionary, store_fn store);
+
+	value_codec(const value_codec &) = delete;
+	value_codec &operator=(const value_codec &) = delete;
+
+	/* Replaces content of 'out' with the encoded value. */
+	void encode(string_view value, std::string &out);
+
+	/*
+	 * Returns the decoded value. It points either inside 'stored' (raw values)
+	 * or to 'buf', which is used to hold decompressed data.
+	 */
+	string_view decode(string_view stored, std::string &buf) const;
+
+private:
+	static constexpr char raw_tag = 0;
+	static constexpr char lz_tag = 1;
+	static constexpr char lz_dict_tag = 2;
+
+	void sample(string_view value);
+
+	params p;
+	store_fn store;
+
+	std::mutex samples_mtx;
+	std::vector<std::string> samples;
+	/* trained dictionary which is not persisted yet */
+	std::string pending;
+	/* dictionary is immutable once trained is set */
+	std::string dictionary;
+	std::atomic<bool> trained;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_CODEC_H */
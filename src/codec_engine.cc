@@ -0,0 +1,563 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "codec_engine.h"
+#include "exceptions.h"
+#include "out.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+namespace
+{
+
+/* arguments of callbacks which decode values before passing them to the user */
+struct decode_context {
+	const value_codec *codec;
+	void *callback;
+	void *arg;
+};
+
+/* thread local, callbacks of get_all_parallel are called from many threads */
+std::string &decode_buffer()
+{
+	thread_local std::string buf;
+	return buf;
+}
+
+int decode_kv(const char *k, size_t kb, const char *v, size_t vb, void *arg)
+{
+	auto ctx = static_cast<decode_context *>(arg);
+	auto value = ctx->codec->decode(string_view(v, vb), decode_buffer());
+	auto callback = reinterpret_cast<get_kv_callback *>(ctx->callback);
+
+	return callback(k, kb, value.data(), value.size(), ctx->arg);
+}
+
+void decode_v(const char *v, size_t vb, void *arg)
+{
+	auto ctx = static_cast<decode_context *>(arg);
+	auto value = ctx->codec->decode(string_view(v, vb), decode_buffer());
+	auto callback = reinterpret_cast<get_v_callback *>(ctx->callback);
+
+	callback(value.data(), value.size(), ctx->arg);
+}
+
+struct encode_context {
+	value_codec *codec;
+	bulk_load_callback *callback;
+	void *arg;
+	std::string buf;
+};
+
+/* encoded value is valid until the next call, as the one passed by the user */
+int encode_kv(const char **k, size_t *kb, const char **v, size_t *vb, void *arg)
+{
+	auto ctx = static_cast<encode_context *>(arg);
+	auto ret = ctx->callback(k, kb, v, vb, ctx->arg);
+	if (ret != 0)
+		return ret;
+
+	ctx->codec->encode(string_view(*v, *vb), ctx->buf);
+	*v = ctx->buf.data();
+	*vb = ctx->buf.size();
+
+	return 0;
+}
+
+/* holds reference to the stored value as long as the decoded value points to it */
+class decoded_value_ref : public value_ref_base {
+public:
+	decoded_value_ref(std::unique_ptr<value_ref_base> stored,
+			  const value_codec &codec)
+	    : stored(std::move(stored))
+	{
+		value_ = codec.decode(this->stored->value(), decoded);
+	}
+
+private:
+	std::unique_ptr<value_ref_base> stored;
+	std::string decoded;
+};
+
+} /* anonymous namespace */
+
+std::unique_ptr<engine_base> codec_engine::wrap(std::unique_ptr<engine_base> engine,
+						const value_codec::params &p)
+{
+	std::string state;
+	auto s = engine->get_codec_state(state);
+	if (s == status::NOT_SUPPORTED) {
+		if (!p.name.empty() && p.name != "none")
+			throw internal::not_supported(
+				"Value codec is not supported in this engine (or config)");
+		return engine;
+	}
+	if (s != status::OK)
+		throw internal::error("Cannot read state of the value codec",
+				      static_cast<int>(s));
+
+	std::string name, dictionary;
+	if (!state.empty()) {
+		value_codec::parse(state, name, dictionary);
+		if (!p.name.empty() && p.name != name)
+			throw internal::invalid_argument(
+				"Config item \"value_codec\" differs from codec recorded in the pool: " +
+				name);
+	} else {
+		if (p.name.empty() || p.name == "none")
+			return engine;
+
+		/* values stored so far would be misinterpreted */
+		std::size_t cnt = 0;
+		if (engine->count_all(cnt) != status::OK || cnt != 0)
+			throw internal::invalid_argument(
+				"Value codec can be enabled only for an empty database");
+
+		name = p.name;
+		s = engine->set_codec_state(value_codec::serialize(name, dictionary));
+		if (s != status::OK)
+			throw internal::error("Cannot record the value codec",
+					      static_cast<int>(s));
+	}
+
+	if (name == "none")
+		return engine;
+
+	auto params = p;
+	params.name = name;
+	return std::unique_ptr<engine_base>(
+		new codec_engine(std::move(engine), params, dictionary));
+}
+
+codec_engine::codec_engine(std::unique_ptr<engine_base> engine,
+			   const value_codec::params &p, string_view dictionary)
+    : engine(std::move(engine))
+{
+	auto e = this->engine.get();
+	codec.reset(new value_codec(p, dictionary, [e](string_view state) {
+		auto s = e->set_codec_state(state);
+		if (s == status::TRANSACTION_SCOPE_ERROR)
+			return false;
+		if (s != status::OK)
+			throw internal::error("Cannot record the value codec",
+					      static_cast<int>(s));
+		return true;
+	}));
+}
+
+codec_engine::codec_engine(std::unique_ptr<engine_base> engine,
+			   std::shared_ptr<value_codec> codec)
+    : engine(std::move(engine)), codec(std::move(codec))
+{
+}
+
+std::string codec_engine::name()
+{
+	return engine->name();
+}
+
+bool codec_engine::concurrent() const
+{
+	return engine->concurrent();
+}
+
+status codec_engine::count_all(std::size_t &cnt)
+{
+	return engine->count_all(cnt);
+}
+
+status codec_engine::count_above(string_view key, std::size_t &cnt)
+{
+	return engine->count_above(key, cnt);
+}
+
+status codec_engine::count_equal_above(string_view key, std::size_t &cnt)
+{
+	return engine->count_equal_above(key, cnt);
+}
+
+status codec_engine::count_equal_below(string_view key, std::size_t &cnt)
+{
+	return engine->count_equal_below(key, cnt);
+}
+
+status codec_engine::count_below(string_view key, std::size_t &cnt)
+{
+	return engine->count_below(key, cnt);
+}
+
+status codec_engine::count_between(string_view key1, string_view key2,
+				   std::size_t &cnt)
+{
+	return engine->count_between(key1, key2, cnt);
+}
+
+status codec_engine::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	return engine->count_prefix(prefix, cnt);
+}
+
+status codec_engine::get_all(get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_all(decode_kv, &ctx);
+}
+
+status codec_engine::get_above(string_view key, get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_above(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_equal_above(string_view key, get_kv_callback *callback,
+				     void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_equal_above(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_equal_below(string_view key, get_kv_callback *callback,
+				     void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_equal_below(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_below(string_view key, get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_below(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_between(string_view key1, string_view key2,
+				 get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_between(key1, key2, decode_kv, &ctx);
+}
+
+status codec_engine::get_prefix(string_view prefix, get_kv_callback *callback,
+				void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_prefix(prefix, decode_kv, &ctx);
+}
+
+status codec_engine::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_all_desc(decode_kv, &ctx);
+}
+
+status codec_engine::get_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_above_desc(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_equal_above_desc(string_view key, get_kv_callback *callback,
+					  void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_equal_above_desc(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_equal_below_desc(string_view key, get_kv_callback *callback,
+					  void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_equal_below_desc(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_below_desc(key, decode_kv, &ctx);
+}
+
+status codec_engine::get_between_desc(string_view key1, string_view key2,
+				      get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_between_desc(key1, key2, decode_kv, &ctx);
+}
+
+status codec_engine::get_all_parallel(std::size_t num_partitions,
+				      get_kv_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get_all_parallel(num_partitions, decode_kv, &ctx);
+}
+
+status codec_engine::split_points(std::size_t n, get_v_callback *callback, void *arg)
+{
+	/* split points are keys */
+	return engine->split_points(n, callback, arg);
+}
+
+status codec_engine::exists(string_view key)
+{
+	return engine->exists(key);
+}
+
+status codec_engine::get(string_view key, get_v_callback *callback, void *arg)
+{
+	decode_context ctx{codec.get(), reinterpret_cast<void *>(callback), arg};
+	return engine->get(key, decode_v, &ctx);
+}
+
+status codec_engine::get_ref(string_view key, std::unique_ptr<value_ref_base> &ref)
+{
+	std::unique_ptr<value_ref_base> stored;
+	auto s = engine->get_ref(key, stored);
+	if (s != status::OK)
+		return s;
+
+	ref.reset(new decoded_value_ref(std::move(stored), *codec));
+
+	return status::OK;
+}
+
+status codec_engine::put(string_view key, string_view value)
+{
+	thread_local std::string buf;
+	codec->encode(value, buf);
+
+	return engine->put(key, buf);
+}
+
+status codec_engine::put_with_ttl(string_view key, string_view value, uint64_t ttl_ms)
+{
+	thread_local std::string buf;
+	codec->encode(value, buf);
+
+	return engine->put_with_ttl(key, buf, ttl_ms);
+}
+
+status codec_engine::remove(string_view key)
+{
+	return engine->remove(key);
+}
+
+status codec_engine::remove_range(string_view key1, string_view key2)
+{
+	return engine->remove_range(key1, key2);
+}
+
+status codec_engine::remove_prefix(string_view prefix)
+{
+	return engine->remove_prefix(prefix);
+}
+
+status codec_engine::defrag(double start_percent, double amount_percent)
+{
+	return engine->defrag(start_percent, amount_percent);
+}
+
+/* sizes of values are the sizes of encoded values */
+status codec_engine::memory_usage(memory_stats &stats)
+{
+	return engine->memory_usage(stats);
+}
+
+status codec_engine::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	encode_context ctx{codec.get(), callback, arg, std::string()};
+	return engine->bulk_load(encode_kv, &ctx);
+}
+
+internal::transaction *codec_engine::begin_tx()
+{
+	return new codec_transaction(engine->begin_tx(), *codec);
+}
+
+iterator_base *codec_engine::new_iterator()
+{
+	return new codec_iterator(engine->new_iterator(), *codec);
+}
+
+iterator_base *codec_engine::new_const_iterator()
+{
+	return new codec_iterator(engine->new_const_iterator(), *codec);
+}
+
+engine_base *codec_engine::new_snapshot()
+{
+	std::unique_ptr<engine_base> snapshot(engine->new_snapshot());
+	return new codec_engine(std::move(snapshot), codec);
+}
+
+status codec_engine::get_codec_state(std::string &state)
+{
+	return engine->get_codec_state(state);
+}
+
+status codec_engine::set_codec_state(string_view state)
+{
+	return engine->set_codec_state(state);
+}
+
+change_log *codec_engine::open_change_log(std::size_t size)
+{
+	return engine->open_change_log(size);
+}
+
+void codec_engine::set_expire_hook(expire_hook hook)
+{
+	engine->set_expire_hook(std::move(hook));
+}
+
+codec_engine::codec_iterator::codec_iterator(iterator_base *it, const value_codec &codec)
+    : it(it), codec(codec)
+{
+}
+
+/* current record changes with every move of the iterator */
+status codec_engine::codec_iterator::moved(status s)
+{
+	decoded = false;
+	return s;
+}
+
+status codec_engine::codec_iterator::seek(string_view key)
+{
+	return moved(it->seek(key));
+}
+
+status codec_engine::codec_iterator::seek_lower(string_view key)
+{
+	return moved(it->seek_lower(key));
+}
+
+status codec_engine::codec_iterator::seek_lower_eq(string_view key)
+{
+	return moved(it->seek_lower_eq(key));
+}
+
+status codec_engine::codec_iterator::seek_higher(string_view key)
+{
+	return moved(it->seek_higher(key));
+}
+
+status codec_engine::codec_iterator::seek_higher_eq(string_view key)
+{
+	return moved(it->seek_higher_eq(key));
+}
+
+status codec_engine::codec_iterator::seek_prefix(string_view prefix)
+{
+	return moved(it->seek_prefix(prefix));
+}
+
+status codec_engine::codec_iterator::seek_to_first()
+{
+	return moved(it->seek_to_first());
+}
+
+status codec_engine::codec_iterator::seek_to_last()
+{
+	return moved(it->seek_to_last());
+}
+
+status codec_engine::codec_iterator::is_next()
+{
+	return it->is_next();
+}
+
+status codec_engine::codec_iterator::next()
+{
+	return moved(it->next());
+}
+
+status codec_engine::codec_iterator::prev()
+{
+	return moved(it->prev());
+}
+
+result<string_view> codec_engine::codec_iterator::key()
+{
+	return it->key();
+}
+
+result<pmem::obj::slice<const char *>>
+codec_engine::codec_iterator::read_range(size_t pos, size_t n)
+{
+	if (!decoded) {
+		auto stored = it->read_range(0, std::numeric_limits<size_t>::max());
+		if (!stored.is_ok())
+			return stored.get_status();
+
+		auto slice = stored.get_value();
+		value = codec.decode(string_view(slice.begin(), slice.size()), buf);
+		decoded = true;
+	}
+
+	if (pos + n > value.size() || pos + n < pos)
+		n = value.size() - pos;
+
+	return {{value.data() + pos, value.data() + pos + n}};
+}
+
+result<size_t> codec_engine::codec_iterator::next_batch(size_t n, const char **keys,
+							size_t *kbs,
+							const char **values,
+							size_t *vbs)
+{
+	decoded = false;
+	auto count = it->next_batch(n, keys, kbs, values, vbs);
+	if (!count.is_ok())
+		return count;
+
+	/* every decoded value of the batch needs its own buffer */
+	auto cnt = count.get_value();
+	if (batch_bufs.size() < cnt)
+		batch_bufs.resize(cnt);
+
+	for (size_t i = 0; i < cnt; i++) {
+		auto v = codec.decode(string_view(values[i], vbs[i]), batch_bufs[i]);
+		values[i] = v.data();
+		vbs[i] = v.size();
+	}
+
+	return count;
+}
+
+codec_engine::codec_transaction::codec_transaction(transaction *tx, value_codec &codec)
+    : tx(tx), codec(codec)
+{
+}
+
+status codec_engine::codec_transaction::put(string_view key, string_view value)
+{
+	codec.encode(value, buf);
+	return tx->put(key, buf);
+}
+
+status codec_engine::codec_transaction::remove(string_view key)
+{
+	return tx->remove(key);
+}
+
+status codec_engine::codec_transaction::commit()
+{
+	return tx->commit();
+}
+
+void codec_engine::codec_transaction::abort()
+{
+	tx->abort();
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_CODEC_ENGINE_H
+#define LIBPMEMKV_CODEC_ENGINE_H
+
+#include "codec.h"
+#include "engine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Engine which encodes values (see value_codec) on their way to the wrapped
+ * engine and decodes them on the way back. Keys are passed unchanged.
+ *
+ * Codec is recorded in the engine (set_codec_state) when it is enabled for
+ * an empty database; afterwards the recorded one is always used.
+ */
+class codec_engine : public engine_base {
+public:
+	/*
+	 * Returns the engine wrapped with the codec recorded in it or, if none is,
+	 * with the one requested in params. Returns unwrapped engine if no codec
+	 * is recorded nor requested.
+	 */
+	static std::unique_ptr<engine_base> wrap(std::unique_ptr<engine_base> engine,
+						 const value_codec::params &p);
+
+	codec_engine(std::unique_ptr<engine_base> engine, const value_codec::params &p,
+		     string_view dictionary);
+
+	std::string name() final;
+	bool concurrent() const final;
+
+	status count_all(std::size_t &cnt) final;
+	status count_above(string_view key, std::size_t &cnt) final;
+	status count_equal_above(string_view key, std::size_t &cnt) final;
+	status count_equal_below(string_view key, std::size_t &cnt) final;
+	status count_below(string_view key, std::size_t &cnt) final;
+	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
+
+	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_equal_above(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_equal_below(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
+			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
+	status split_points(std::size_t n, get_v_callback *callback, void *arg) final;
+
+	status exists(string_view key) final;
+
+	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key, std::unique_ptr<value_ref_base> &ref) final;
+	status put(string_view key, string_view value) final;
+	status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms) final;
+	status remove(string_view key) final;
+	status remove_range(string_view key1, string_view key2) final;
+	status remove_prefix(string_view prefix) final;
+	status defrag(double start_percent, double amount_percent) final;
+	status memory_usage(memory_stats &stats) final;
+	status bulk_load(bulk_load_callback *callback, void *arg) final;
+
+	internal::transaction *begin_tx() final;
+
+	iterator_base *new_iterator() final;
+	iterator_base *new_const_iterator() final;
+
+	/* snapshot of the wrapped engine, decoded with the same codec */
+	engine_base *new_snapshot() final;
+
+	status get_codec_state(std::string &state) final;
+	status set_codec_state(string_view state) final;
+
+	/* change log is recorded in the wrapped engine */
+	change_log *open_change_log(std::size_t size) final;
+	/* keys are expired by the wrapped engine */
+	void set_expire_hook(expire_hook hook) final;
+
+private:
+	class codec_iterator;
+	class codec_transaction;
+
+	codec_engine(std::unique_ptr<engine_base> engine,
+		     std::shared_ptr<value_codec> codec);
+
+	std::unique_ptr<engine_base> engine;
+	std::shared_ptr<value_codec> codec;
+};
+
+/**
+ * Iterator decoding values of the wrapped one. Values cannot be modified
+ * in place (write_range is not supported), as their stored size differs.
+ */
+class codec_engine::codec_iterator : public iterator_base {
+public:
+	codec_iterator(iterator_base *it, const value_codec &codec);
+
+	status seek(string_view key) final;
+	status seek_lower(string_view key) final;
+	status seek_lower_eq(string_view key) final;
+	status seek_higher(string_view key) final;
+	status seek_higher_eq(string_view key) final;
+	status seek_prefix(string_view prefix) final;
+
+	status seek_to_first() final;
+	status seek_to_last() final;
+
+	status is_next() final;
+	status next() final;
+	status prev() final;
+
+	result<string_view> key() final;
+
+	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+	result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+				  const char **values, size_t *vbs) final;
+
+private:
+	status moved(status s);
+
+	std::unique_ptr<iterator_base> it;
+	const value_codec &codec;
+
+	/* decoded value of the current record, valid if 'decoded' is set */
+	bool decoded = false;
+	string_view value;
+	std::string buf;
+	std::vector<std::string> batch_bufs;
+};
+
+class codec_engine::codec_transaction : public transaction {
+public:
+	codec_transaction(transaction *tx, value_codec &codec);
+
+	status put(string_view key, string_view value) final;
+	status remove(string_view key) final;
+	status commit() final;
+	void abort() final;
+
+private:
+	std::unique_ptr<transaction> tx;
+	value_codec &codec;
+	std::string buf;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_CODEC_ENGINE_H */
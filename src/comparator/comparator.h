@@ -54,6 +54,18 @@ static inline const comparator &binary_comparator()
 	return cmp;
 }
 
+/*
+ * Keys sharing a prefix are adjacent (and not lower than the prefix) only in
+ * byte-wise order, prefix functions of sorted engines rely on it.
+ */
+template <typename Compare>
+static inline void check_prefix_support(const Compare &cmp)
+{
+	if (cmp.get_comparator()->name() != binary_comparator().name())
+		throw internal::not_supported(
+			"Prefix functions are not supported with a custom comparator");
+}
+
 template <typename T,
 	  typename Enable = typename std::enable_if<std::is_same<
 		  const char *, decltype(std::declval<T>().c_str())>::value>::type>
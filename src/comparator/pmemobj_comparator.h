@@ -65,6 +65,11 @@ public:
 		return (cmp->compare(key1, key2) < 0);
 	}
 
+	const comparator *get_comparator() const
+	{
+		return cmp;
+	}
+
 private:
 	pmem::obj::string name;
 	const comparator *cmp = nullptr;
@@ -31,6 +31,11 @@ public:
 		return (cmp->compare(key1, key2) < 0);
 	}
 
+	const comparator *get_comparator() const
+	{
+		return cmp;
+	}
+
 private:
 	const comparator *cmp;
 };
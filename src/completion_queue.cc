@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "completion_queue.h"
+
+#include <memory>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+void completion_queue::complete(int status, const char *value, size_t valuebytes,
+				void *arg)
+{
+	std::unique_ptr<request> req(static_cast<request *>(arg));
+	auto cq = req->cq;
+
+	{
+		std::unique_lock<std::mutex> lock(cq->mtx);
+		cq->queue.push_back({status,
+				     value ? std::string(value, valuebytes) : std::string(),
+				     req->arg});
+	}
+	cq->cv.notify_one();
+}
+
+size_t completion_queue::poll(pmemkv_completion *completions, size_t max,
+			      std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait_for(lock, timeout, [&] { return !queue.empty(); });
+
+	polled.clear();
+	while (!queue.empty() && polled.size() < max) {
+		polled.emplace_back(std::move(queue.front()));
+		queue.pop_front();
+	}
+
+	for (size_t i = 0; i < polled.size(); i++) {
+		completions[i].status = polled[i].status;
+		completions[i].value = polled[i].value.data();
+		completions[i].valuebytes = polled[i].value.size();
+		completions[i].arg = polled[i].arg;
+	}
+
+	return polled.size();
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_COMPLETION_QUEUE_H
+#define LIBPMEMKV_COMPLETION_QUEUE_H
+
+#include "libpmemkv.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Queue of completions of asynchronous operations, polled by the user
+ * (e.g. from an event loop) instead of being called back from the executor.
+ */
+class completion_queue {
+public:
+	/* Argument of complete() - the queue and user's argument of the operation. */
+	struct request {
+		completion_queue *cq;
+		void *arg;
+	};
+
+	/* Callback of asynchronous operations, 'arg' is an allocated request. */
+	static void complete(int status, const char *value, size_t valuebytes, void *arg);
+
+	/*
+	 * Moves up to 'max' completions to 'completions', waiting up to 'timeout'
+	 * if there are none. Values are valid until the next poll.
+	 */
+	size_t poll(pmemkv_completion *completions, size_t max,
+		    std::chrono::milliseconds timeout);
+
+private:
+	struct entry {
+		int status;
+		std::string value;
+		void *arg;
+	};
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<entry> queue;
+	/* completions returned by the last poll */
+	std::vector<entry> polled;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_COMPLETION_QUEUE_H */
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "defrag_scheduler.h"
+#include "exceptions.h"
+#include "out.h"
+
+#include <algorithm>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+defrag_scheduler::latency_probe::latency_probe(defrag_scheduler *s) : sched(nullptr)
+{
+	if (!s)
+		return;
+
+	static thread_local unsigned counter = 0;
+	if (++counter % sample_rate != 0)
+		return;
+
+	sched = s;
+	start = std::chrono::steady_clock::now();
+}
+
+defrag_scheduler::latency_probe::~latency_probe()
+{
+	if (!sched)
+		return;
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	sched->record_latency(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+}
+
+bool defrag_scheduler::enabled(config &cfg)
+{
+	uint64_t background = 0;
+	cfg.get_uint64("defrag_background", &background);
+
+	return background != 0;
+}
+
+defrag_scheduler::params defrag_scheduler::from_config(config &cfg)
+{
+	params p;
+	cfg.get_uint64("defrag_threshold", &p.threshold);
+	cfg.get_uint64("defrag_steps", &p.steps);
+	cfg.get_uint64("defrag_cpu_budget", &p.cpu_budget);
+	cfg.get_uint64("defrag_latency_threshold_us", &p.latency_threshold_us);
+	cfg.get_uint64("defrag_interval_ms", &p.interval_ms);
+
+	if (p.threshold > 100)
+		throw internal::invalid_argument(
+			"Config item \"defrag_threshold\" must be in range [0, 100]");
+	if (p.steps == 0)
+		throw internal::invalid_argument(
+			"Config item \"defrag_steps\" must be greater than 0");
+	if (p.cpu_budget == 0 || p.cpu_budget > 100)
+		throw internal::invalid_argument(
+			"Config item \"defrag_cpu_budget\" must be in range [1, 100]");
+	if (p.interval_ms == 0)
+		throw internal::invalid_argument(
+			"Config item \"defrag_interval_ms\" must be greater than 0");
+
+	return p;
+}
+
+defrag_scheduler::defrag_scheduler(params p, sample_fn sample, step_fn step)
+    : p(p),
+      sample(std::move(sample)),
+      step(std::move(step)),
+      latency_us(0),
+      latency_samples(0)
+{
+	thread = std::thread([this] { run(); });
+}
+
+defrag_scheduler::~defrag_scheduler()
+{
+	stop();
+}
+
+void defrag_scheduler::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		stopped = true;
+	}
+	cv.notify_one();
+
+	if (thread.joinable())
+		thread.join();
+}
+
+/* exponential moving average (weight 1/8), races between threads are harmless */
+void defrag_scheduler::record_latency(uint64_t us)
+{
+	auto avg = latency_us.load(std::memory_order_relaxed);
+	latency_us.store(avg - avg / 8 + us / 8, std::memory_order_relaxed);
+	latency_samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void defrag_scheduler::run()
+{
+	using std::chrono::microseconds;
+	using std::chrono::milliseconds;
+
+	const double step_percent = 100.0 / static_cast<double>(p.steps);
+	const microseconds interval = milliseconds(p.interval_ms);
+
+	bool in_pass = false;
+	double pos = 0;
+	uint64_t backoff = 1;
+	microseconds delay = interval;
+
+	std::unique_lock<std::mutex> lock(mtx);
+	while (!cv.wait_for(lock, delay, [&] { return stopped; })) {
+		delay = interval;
+		lock.unlock();
+
+		/* the average is not updated without samples, it would stay high */
+		if (latency_samples.exchange(0, std::memory_order_relaxed) == 0)
+			latency_us.store(0, std::memory_order_relaxed);
+
+		if (!in_pass) {
+			in_pass = sample() * 100 >= static_cast<double>(p.threshold);
+			pos = 0;
+		}
+
+		if (!in_pass) {
+			lock.lock();
+			continue;
+		}
+
+		if (latency_us.load(std::memory_order_relaxed) > p.latency_threshold_us) {
+			/* foreground is slow, give it some time */
+			backoff = std::min(backoff * 2, max_backoff);
+			delay = interval * backoff;
+			lock.lock();
+			continue;
+		}
+		backoff = 1;
+
+		auto amount = std::min(step_percent, 100 - pos);
+		auto start = std::chrono::steady_clock::now();
+		status s;
+		try {
+			s = step(pos, amount);
+		} catch (std::exception &e) {
+			out_err_stream("defrag_scheduler") << e.what();
+			s = status::UNKNOWN_ERROR;
+		}
+		auto elapsed = std::chrono::duration_cast<microseconds>(
+			std::chrono::steady_clock::now() - start);
+
+		pos += amount;
+		if (s != status::OK || pos >= 100) {
+			/* next pass starts only if fragmentation is still high */
+			in_pass = false;
+		} else {
+			/* stay within the budget: step time is cpu_budget% of the period */
+			delay = elapsed * (100 - p.cpu_budget) / p.cpu_budget;
+		}
+
+		lock.lock();
+	}
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_DEFRAG_SCHEDULER_H
+#define LIBPMEMKV_DEFRAG_SCHEDULER_H
+
+#include "config.h"
+#include "libpmemkv.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Runs engine's defrag() in the background, in small steps. A pass over
+ * the whole engine is started when sampled fragmentation exceeds the threshold;
+ * it is split into 'steps' calls of defrag(start_percent, amount_percent).
+ *
+ * Time spent in defrag steps is limited to 'cpu_budget' percent (the scheduler
+ * sleeps proportionally after every step). While sampled latency of foreground
+ * operations is above 'latency_threshold_us', steps are postponed with
+ * exponential backoff. The latency is forgotten if no operation was sampled
+ * since the previous tick of the scheduler (e.g. after a burst of slow ones).
+ */
+class defrag_scheduler {
+public:
+	struct params {
+		/* fragmentation [percent] which starts a pass */
+		uint64_t threshold = 20;
+		/* number of steps a pass is split into */
+		uint64_t steps = 1000;
+		/* percent of time which may be spent in defrag steps */
+		uint64_t cpu_budget = 10;
+		uint64_t latency_threshold_us = 1000;
+		/* how often fragmentation is sampled */
+		uint64_t interval_ms = 1000;
+	};
+
+	/* returns fragmentation as a ratio in range [0, 1] */
+	using sample_fn = std::function<double()>;
+	using step_fn = std::function<status(double start_percent, double amount_percent)>;
+
+	/**
+	 * Measures a foreground operation (only every sample_rate-th one, the rest
+	 * costs one thread-local increment) and reports it to the scheduler.
+	 */
+	class latency_probe {
+	public:
+		latency_probe(defrag_scheduler *s);
+		~latency_probe();
+
+		latency_probe(const latency_probe &) = delete;
+		latency_probe &operator=(const latency_probe &) = delete;
+
+	private:
+		defrag_scheduler *sched;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	/* Returns true if background defrag is enabled in the config. */
+	static bool enabled(config &cfg);
+	static params from_config(config &cfg);
+
+	defrag_scheduler(params p, sample_fn sample, step_fn step);
+	~defrag_scheduler();
+
+	defrag_scheduler(const defrag_scheduler &) = delete;
+	defrag_scheduler &operator=(const defrag_scheduler &) = delete;
+
+	void stop();
+
+private:
+	static constexpr unsigned sample_rate = 64;
+	static constexpr uint64_t max_backoff = 64;
+
+	void record_latency(uint64_t us);
+	void run();
+
+	params p;
+	sample_fn sample;
+	step_fn step;
+
+	/* moving average of sampled foreground latency */
+	std::atomic<uint64_t> latency_us;
+	/* number of samples since the last tick of the scheduler */
+	std::atomic<uint64_t> latency_samples;
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stopped = false;
+	std::thread thread;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_DEFRAG_SCHEDULER_H */
@@ -0,0 +1,842 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "dump.h"
+#include "exceptions.h"
+#include "out.h"
+#include "parallel.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+namespace dump
+{
+
+namespace
+{
+
+const char magic[] = "PMKVDUMP";
+const std::size_t magic_size = sizeof(magic) - 1;
+const uint32_t version = 1;
+const uint32_t flag_sorted = 1;
+
+const std::size_t file_header_size = magic_size + 8;
+const std::size_t block_header_size = 32;
+
+enum block_type : uint32_t { data_block = 1, end_block = 2 };
+
+/* CRC-32 (IEEE 802.3, reflected), computed with a byte-wise table */
+uint32_t crc32(const char *data, std::size_t size, uint32_t crc = 0)
+{
+	static const std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> t;
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (std::size_t i = 0; i < size; i++)
+		crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+void put_u32(std::string &out, uint32_t v)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void put_u64(std::string &out, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void put_varint(std::string &out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+		v >>= 7;
+	}
+	out.push_back(static_cast<char>(v));
+}
+
+uint32_t get_u32(const char *p)
+{
+	uint32_t v = 0;
+	for (int i = 0; i < 4; i++)
+		v |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+	return v;
+}
+
+uint64_t get_u64(const char *p)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++)
+		v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+	return v;
+}
+
+/* Decodes a varint from [p, end), returns false if it is truncated. */
+bool get_varint(const char *&p, const char *end, uint64_t &v)
+{
+	v = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7) {
+		auto byte = static_cast<uint8_t>(*p++);
+		v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+void corrupted(const std::string &msg)
+{
+	throw internal::invalid_argument("Dump is corrupted: " + msg);
+}
+
+/* Output shared by all partitions, blocks are written whole. */
+class output {
+public:
+	output(int fd) : fd(fd), flags(0), header_written(false), records(0), blocks(0)
+	{
+	}
+
+	/* Sets flags of the header, which is written with the first block. */
+	void set_flags(uint32_t f)
+	{
+		flags = f;
+	}
+
+	void write_block(block_type type, uint32_t run, uint32_t seq, uint32_t count,
+			 const std::string &payload)
+	{
+		std::string header;
+		header.reserve(block_header_size);
+		put_u32(header, type);
+		put_u32(header, run);
+		put_u32(header, seq);
+		put_u32(header, count);
+		put_u64(header, payload.size());
+		put_u32(header, crc32(payload.data(), payload.size()));
+		put_u32(header, crc32(header.data(), header.size()));
+
+		std::unique_lock<std::mutex> lock(mtx);
+		if (!header_written) {
+			std::string file_header(magic, magic_size);
+			put_u32(file_header, version);
+			put_u32(file_header, flags);
+			write_all(file_header.data(), file_header.size());
+			header_written = true;
+		}
+		write_all(header.data(), header.size());
+		write_all(payload.data(), payload.size());
+
+		if (type == data_block) {
+			records += count;
+			blocks++;
+		}
+	}
+
+	void write_end()
+	{
+		std::string payload;
+		put_u64(payload, records);
+		put_u64(payload, blocks);
+		write_block(end_block, 0, 0, 0, payload);
+	}
+
+private:
+	void write_all(const char *data, std::size_t size)
+	{
+		while (size > 0) {
+			auto ret = ::write(fd, data, size);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+				throw internal::error(std::string("Cannot write dump: ") +
+						      strerror(errno));
+			data += ret;
+			size -= static_cast<std::size_t>(ret);
+		}
+	}
+
+	int fd;
+	std::mutex mtx;
+	uint32_t flags;
+	bool header_written;
+	uint64_t records;
+	uint64_t blocks;
+};
+
+/* Encodes records of a single run into blocks. */
+class encoder {
+public:
+	encoder(output &out, uint32_t run) : out(out), run(run), seq(0), count(0)
+	{
+		payload.reserve(block_size + block_size / 8);
+	}
+
+	void add(const char *k, std::size_t kb, const char *v, std::size_t vb)
+	{
+		put_varint(payload, kb);
+		payload.append(k, kb);
+		put_varint(payload, vb);
+		payload.append(v, vb);
+
+		if (++count == UINT32_MAX || payload.size() >= block_size)
+			flush();
+	}
+
+	void flush()
+	{
+		if (count == 0)
+			return;
+
+		out.write_block(data_block, run, seq++, count, payload);
+		payload.clear();
+		count = 0;
+	}
+
+	static int add_cb(const char *k, std::size_t kb, const char *v, std::size_t vb,
+			  void *arg)
+	{
+		static_cast<encoder *>(arg)->add(k, kb, v, vb);
+		return 0;
+	}
+
+private:
+	output &out;
+	uint32_t run;
+	uint32_t seq;
+	uint32_t count;
+	std::string payload;
+};
+
+void check(status s, const char *op)
+{
+	if (s != status::OK && s != status::NOT_FOUND)
+		throw internal::error(std::string("Cannot dump, ") + op + " failed",
+				      static_cast<int>(s));
+}
+
+/*
+ * Dumps ranges between split points as sorted runs: [-inf, p0), [p0, p1) ...
+ * [p_last, +inf). Returns false if the engine cannot split its keys.
+ */
+bool write_sorted(engine_base &engine, output &out, std::size_t threads)
+{
+	std::vector<std::string> points;
+	auto s = engine.split_points(
+		threads,
+		[](const char *k, size_t kb, void *arg) {
+			static_cast<std::vector<std::string> *>(arg)->emplace_back(k, kb);
+		},
+		&points);
+	if (s == status::NOT_SUPPORTED)
+		return false;
+	check(s, "split_points");
+
+	out.set_flags(flag_sorted);
+
+	parallel_exec(points.size() + 1, [&](std::size_t i) {
+		encoder enc(out, static_cast<uint32_t>(i));
+		if (points.empty()) {
+			check(engine.get_all(encoder::add_cb, &enc), "get_all");
+		} else if (i == 0) {
+			check(engine.get_below(points[0], encoder::add_cb, &enc),
+			      "get_below");
+		} else {
+			/* the lower bound itself starts the run */
+			struct context {
+				encoder *enc;
+				const std::string *key;
+			} ctx{&enc, &points[i - 1]};
+			check(engine.get(points[i - 1],
+					 [](const char *v, size_t vb, void *arg) {
+						 auto c = static_cast<context *>(arg);
+						 c->enc->add(c->key->data(),
+							     c->key->size(), v, vb);
+					 },
+					 &ctx),
+			      "get");
+
+			if (i == points.size())
+				check(engine.get_above(points[i - 1], encoder::add_cb,
+						       &enc),
+				      "get_above");
+			else
+				check(engine.get_between(points[i - 1], points[i],
+							 encoder::add_cb, &enc),
+				      "get_between");
+		}
+		enc.flush();
+	});
+
+	return true;
+}
+
+/*
+ * Dumps partitions of get_all_parallel() as unsorted runs - every thread
+ * which calls the callback gets its own encoder. Returns false if the engine
+ * cannot scan in parallel (nothing is written then).
+ */
+bool write_parallel(engine_base &engine, output &out, std::size_t threads)
+{
+	static std::atomic<uint64_t> dumps(0);
+
+	struct context {
+		output *out;
+		uint64_t id;
+		std::mutex mtx;
+		std::vector<std::unique_ptr<encoder>> encoders;
+	} ctx;
+	ctx.out = &out;
+	ctx.id = ++dumps;
+
+	auto s = engine.get_all_parallel(
+		threads,
+		[](const char *k, size_t kb, const char *v, size_t vb, void *arg) {
+			/* encoder of this thread in the current dump */
+			thread_local uint64_t owner = 0;
+			thread_local encoder *enc = nullptr;
+
+			auto c = static_cast<context *>(arg);
+			if (owner != c->id) {
+				std::unique_lock<std::mutex> lock(c->mtx);
+				c->encoders.emplace_back(new encoder(
+					*c->out,
+					static_cast<uint32_t>(c->encoders.size())));
+				enc = c->encoders.back().get();
+				owner = c->id;
+			}
+
+			enc->add(k, kb, v, vb);
+			return 0;
+		},
+		&ctx);
+	if (s == status::NOT_SUPPORTED && ctx.encoders.empty())
+		return false;
+	check(s, "get_all_parallel");
+
+	for (auto &enc : ctx.encoders)
+		enc->flush();
+
+	return true;
+}
+
+/* Dump in a regular file, mapped (if possible). */
+class input {
+public:
+	input(int fd) : fd(fd), map(nullptr), map_size(0), offset(0)
+	{
+		struct stat st;
+		auto pos = lseek(fd, 0, SEEK_CUR);
+		if (pos >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+		    st.st_size > pos) {
+			auto m = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+				      PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m != MAP_FAILED) {
+				map = m;
+				map_size = static_cast<std::size_t>(st.st_size);
+				offset = static_cast<std::size_t>(pos);
+				madvise(map, map_size, MADV_SEQUENTIAL);
+			}
+		}
+	}
+
+	~input()
+	{
+		if (map)
+			munmap(map, map_size);
+	}
+
+	/* pipes, sockets etc. are not mapped, see stream */
+	bool mapped() const
+	{
+		return map != nullptr;
+	}
+
+	const char *data() const
+	{
+		return static_cast<const char *>(map) + offset;
+	}
+
+	std::size_t size() const
+	{
+		return map_size - offset;
+	}
+
+	/* Moves the file offset past the consumed dump. */
+	void consume(std::size_t bytes)
+	{
+		lseek(fd, static_cast<off_t>(offset + bytes), SEEK_SET);
+	}
+
+private:
+	int fd;
+	void *map;
+	std::size_t map_size;
+	std::size_t offset;
+};
+
+struct block {
+	uint32_t type;
+	uint32_t run;
+	uint32_t seq;
+	uint32_t count;
+	const char *payload;
+	std::size_t size;
+};
+
+/* Checks the file header, returns its 'sorted' flag. */
+bool check_file_header(const char *p)
+{
+	if (memcmp(p, magic, magic_size) != 0)
+		corrupted("wrong magic");
+	if (get_u32(p + magic_size) != version)
+		corrupted("unsupported version");
+
+	return get_u32(p + magic_size + 4) & flag_sorted;
+}
+
+/* Checks the block header at p and reads it into b, returns the payload size. */
+uint64_t check_block_header(const char *p, block &b)
+{
+	if (crc32(p, block_header_size - 4) != get_u32(p + block_header_size - 4))
+		corrupted("wrong block header checksum");
+
+	b.type = get_u32(p);
+	b.run = get_u32(p + 4);
+	b.seq = get_u32(p + 8);
+	b.count = get_u32(p + 12);
+
+	return get_u64(p + 16);
+}
+
+/*
+ * Checks the payload of a block (with header at p) - its checksum and records.
+ * 'records' and 'blocks' count data blocks before it, which the end block has
+ * to match. Returns false for the end block.
+ */
+bool check_block(const char *p, const block &b, uint64_t &records, uint64_t &blocks)
+{
+	if (crc32(b.payload, b.size) != get_u32(p + 24))
+		corrupted("wrong block checksum");
+
+	if (b.type == end_block) {
+		if (b.size != 16 || get_u64(b.payload) != records ||
+		    get_u64(b.payload + 8) != blocks)
+			corrupted("wrong number of records");
+		return false;
+	}
+	if (b.type != data_block)
+		corrupted("unknown block type");
+
+	/* records have to fill the payload exactly */
+	const char *r = b.payload;
+	const char *r_end = b.payload + b.size;
+	for (uint32_t i = 0; i < b.count; i++) {
+		for (int field = 0; field < 2; field++) {
+			uint64_t len;
+			if (!get_varint(r, r_end, len) ||
+			    len > static_cast<uint64_t>(r_end - r))
+				corrupted("truncated record");
+			r += len;
+		}
+	}
+	if (r != r_end)
+		corrupted("wrong number of records in a block");
+
+	records += b.count;
+	blocks++;
+
+	return true;
+}
+
+/*
+ * Validates the whole mapped dump (headers, checksums and records) before
+ * anything is written. Returns data blocks and the number of consumed bytes.
+ */
+std::size_t parse(const input &in, bool &sorted, std::vector<block> &blocks)
+{
+	const char *p = in.data();
+	const char *end = p + in.size();
+
+	if (in.size() < file_header_size)
+		corrupted("wrong magic");
+	sorted = check_file_header(p);
+	p += file_header_size;
+
+	uint64_t records = 0, count = 0;
+	while (true) {
+		if (static_cast<std::size_t>(end - p) < block_header_size)
+			corrupted("no end block");
+
+		block b;
+		auto size = check_block_header(p, b);
+		b.payload = p + block_header_size;
+		if (size > static_cast<uint64_t>(end - b.payload))
+			corrupted("truncated block");
+		b.size = static_cast<std::size_t>(size);
+
+		bool data = check_block(p, b, records, count);
+		p = b.payload + b.size;
+		if (!data)
+			break;
+		blocks.push_back(b);
+	}
+
+	return static_cast<std::size_t>(p - in.data());
+}
+
+/*
+ * Dump read from a pipe, socket etc. - a block at a time, so it is not kept
+ * in memory whole. Blocks are validated as they are read.
+ */
+class stream {
+public:
+	stream(int fd) : fd(fd), records(0), blocks(0)
+	{
+	}
+
+	/* Reads the file header, returns its 'sorted' flag. */
+	bool read_header()
+	{
+		char header[file_header_size];
+		if (!read_all(header, sizeof(header)))
+			corrupted("wrong magic");
+
+		return check_file_header(header);
+	}
+
+	/*
+	 * Reads the next block, with its payload in 'payload'. Returns false
+	 * after the end block.
+	 */
+	bool next(block &b, std::string &payload)
+	{
+		char header[block_header_size];
+		if (!read_all(header, sizeof(header)))
+			corrupted("no end block");
+
+		auto size = check_block_header(header, b);
+		payload.resize(static_cast<std::size_t>(size));
+		if (!read_all(&payload[0], payload.size()))
+			corrupted("truncated block");
+		b.payload = payload.data();
+		b.size = payload.size();
+
+		return check_block(header, b, records, blocks);
+	}
+
+private:
+	/* Returns false if the stream ends before 'size' bytes are read. */
+	bool read_all(char *data, std::size_t size)
+	{
+		while (size > 0) {
+			auto ret = ::read(fd, data, size);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+				throw internal::error(std::string("Cannot read dump: ") +
+						      strerror(errno));
+			if (ret == 0)
+				return false;
+			data += ret;
+			size -= static_cast<std::size_t>(ret);
+		}
+
+		return true;
+	}
+
+	int fd;
+	uint64_t records;
+	uint64_t blocks;
+};
+
+/* Calls f(key, value) for every record of a (validated) block. */
+template <typename F>
+void for_each_record(const block &b, F f)
+{
+	const char *r = b.payload;
+	const char *r_end = b.payload + b.size;
+	for (uint32_t i = 0; i < b.count; i++) {
+		uint64_t kb, vb;
+		get_varint(r, r_end, kb);
+		string_view key(r, kb);
+		r += kb;
+		get_varint(r, r_end, vb);
+		string_view value(r, vb);
+		r += vb;
+		f(key, value);
+	}
+}
+
+/* Reads the next record of a (validated) block. */
+void next_record(const char *&r, const char *r_end, const char **k, size_t *kb,
+		 const char **v, size_t *vb)
+{
+	uint64_t len;
+	get_varint(r, r_end, len);
+	*k = r;
+	*kb = len;
+	r += len;
+	get_varint(r, r_end, len);
+	*v = r;
+	*vb = len;
+	r += len;
+}
+
+/* Source of bulk_load - records of blocks in order. */
+struct bulk_source {
+	std::vector<block>::const_iterator it, end;
+	const char *r;
+	const char *r_end;
+	uint32_t left;
+
+	static int next(const char **k, size_t *kb, const char **v, size_t *vb,
+			void *arg)
+	{
+		auto s = static_cast<bulk_source *>(arg);
+		while (s->left == 0) {
+			if (s->it == s->end)
+				return 1;
+			s->r = s->it->payload;
+			s->r_end = s->it->payload + s->it->size;
+			s->left = s->it->count;
+			++s->it;
+		}
+
+		next_record(s->r, s->r_end, k, kb, v, vb);
+		s->left--;
+
+		return 0;
+	}
+};
+
+/*
+ * Source of bulk_load reading a sorted dump from a stream. Blocks of runs are
+ * loaded while each one follows the previous one (the next block of its run or
+ * the first block of a later run). A block out of this order, e.g. of a run
+ * dumped by another thread, ends the load and is left in 'b' to be put.
+ */
+struct stream_source {
+	stream *in;
+	std::string *payload;
+	block b;
+	bool started;
+	/* b holds a block whose records were not all loaded */
+	bool pending;
+	bool held;
+	bool ended;
+	/* corruption of the stream, rethrown after the load */
+	std::exception_ptr error;
+	const char *r;
+	const char *r_end;
+	uint32_t left;
+
+	static int next(const char **k, size_t *kb, const char **v, size_t *vb,
+			void *arg)
+	{
+		auto s = static_cast<stream_source *>(arg);
+		while (s->left == 0) {
+			if (s->ended || s->held)
+				return 1;
+
+			auto prev = s->b;
+			try {
+				s->ended = !s->in->next(s->b, *s->payload);
+			} catch (...) {
+				s->error = std::current_exception();
+				s->ended = true;
+			}
+			if (s->ended)
+				return 1;
+
+			bool follows = s->b.seq == 0
+				? !s->started || s->b.run > prev.run
+				: s->started && s->b.run == prev.run &&
+					s->b.seq == prev.seq + 1;
+			s->started = true;
+			s->pending = true;
+			if (!follows) {
+				s->held = true;
+				return 1;
+			}
+
+			s->r = s->b.payload;
+			s->r_end = s->b.payload + s->b.size;
+			s->left = s->b.count;
+		}
+
+		next_record(s->r, s->r_end, k, kb, v, vb);
+		if (--s->left == 0)
+			s->pending = false;
+
+		return 0;
+	}
+};
+
+bool is_empty(engine_base &engine)
+{
+	std::size_t cnt;
+	return engine.count_all(cnt) == status::OK && cnt == 0;
+}
+
+/*
+ * Bulk loads records of a sorted dump (from 'source') into the engine. Returns
+ * false if it is not supported or if keys are not sorted by the engine's
+ * comparator - records loaded until then are kept.
+ */
+bool bulk_load(engine_base &engine, bulk_load_callback *source, void *arg)
+{
+	try {
+		auto s = engine.bulk_load(source, arg);
+		if (s == status::OK)
+			return true;
+		if (s != status::NOT_SUPPORTED)
+			throw internal::error("Cannot restore, bulk_load failed",
+					      static_cast<int>(s));
+	} catch (internal::invalid_argument &e) {
+		/* keys are not sorted by the engine's comparator */
+		out_err_stream("restore") << e.what();
+	}
+
+	return false;
+}
+
+/* Bulk loads a sorted dump into an empty engine, returns false if it cannot. */
+bool read_sorted(engine_base &engine, std::vector<block> &blocks)
+{
+	if (!is_empty(engine))
+		return false;
+
+	std::sort(blocks.begin(), blocks.end(), [](const block &a, const block &b) {
+		return a.run < b.run || (a.run == b.run && a.seq < b.seq);
+	});
+
+	bulk_source source{blocks.begin(), blocks.end(), nullptr, nullptr, 0};
+	return bulk_load(engine, bulk_source::next, &source);
+}
+
+/*
+ * Restores a dump from a stream. Records are written as blocks are read, so a
+ * corruption found later leaves records of the preceding blocks written. What
+ * is not bulk loaded is put by up to 'threads' threads, a block each.
+ */
+void read_stream(engine_base &engine, int fd, std::size_t threads)
+{
+	stream in(fd);
+	bool sorted = in.read_header();
+
+	auto put = [&](string_view k, string_view v) {
+		auto s = engine.put(k, v);
+		if (s != status::OK)
+			throw internal::error("Cannot restore, put failed",
+					      static_cast<int>(s));
+	};
+
+	threads = std::max<std::size_t>(threads, 1);
+	/* not resized, as blocks point to the payloads */
+	std::vector<std::string> payloads(threads);
+	std::vector<block> blocks(threads);
+	bool ended = false;
+
+	if (sorted && is_empty(engine)) {
+		stream_source source{&in,   &payloads[0], block(), false,
+				     false, false,	  false,   nullptr,
+				     nullptr, nullptr,	  0};
+		bulk_load(engine, stream_source::next, &source);
+		if (source.error)
+			std::rethrow_exception(source.error);
+
+		/* the block out of order, or the one rejected by the engine */
+		if (source.pending)
+			for_each_record(source.b, put);
+		ended = source.ended;
+	}
+
+	while (!ended) {
+		std::size_t n = 0;
+		while (n < threads && !(ended = !in.next(blocks[n], payloads[n])))
+			n++;
+
+		parallel_exec(n, [&](std::size_t i) { for_each_record(blocks[i], put); });
+	}
+}
+
+} /* anonymous namespace */
+
+void write(engine_base &engine, int fd, std::size_t threads)
+{
+	output out(fd);
+
+	if (!write_sorted(engine, out, threads) &&
+	    !write_parallel(engine, out, threads)) {
+		encoder enc(out, 0);
+		check(engine.get_all(encoder::add_cb, &enc), "get_all");
+		enc.flush();
+	}
+
+	out.write_end();
+}
+
+void read(engine_base &engine, int fd, std::size_t threads)
+{
+	input in(fd);
+	if (!in.mapped()) {
+		read_stream(engine, fd, threads);
+		return;
+	}
+
+	bool sorted;
+	std::vector<block> blocks;
+	auto consumed = parse(in, sorted, blocks);
+
+	if (!sorted || !read_sorted(engine, blocks)) {
+		auto put = [&](string_view k, string_view v) {
+			auto s = engine.put(k, v);
+			if (s != status::OK)
+				throw internal::error("Cannot restore, put failed",
+						      static_cast<int>(s));
+		};
+
+		threads = std::max<std::size_t>(std::min(threads, blocks.size()), 1);
+		parallel_exec(threads, [&](std::size_t t) {
+			for (std::size_t i = t; i < blocks.size(); i += threads)
+				for_each_record(blocks[i], put);
+		});
+	}
+
+	in.consume(consumed);
+}
+
+} /* namespace dump */
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_DUMP_H
+#define LIBPMEMKV_DUMP_H
+
+#include "engine.h"
+
+#include <cstddef>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Dump is a stream of checksummed blocks of records, independent of the
+ * engine's layout. All integers are little-endian.
+ *
+ * header:  magic "PMKVDUMP", version (u32), flags (u32)
+ * block:   type (u32), run (u32), sequence (u32), count (u32),
+ *          payload size (u64), payload crc32 (u32), header crc32 (u32), payload
+ *
+ * Payload of a data block is 'count' records - key size (varint), key,
+ * value size (varint), value. Payload of the end block (the last one) holds
+ * the number of records and the number of data blocks (u64 each).
+ *
+ * Blocks of a run are numbered by 'sequence' and may be interleaved with
+ * blocks of other runs. If the 'sorted' flag is set, records of every run are
+ * in ascending order and keys of a run are lower than keys of the next one.
+ */
+namespace dump
+{
+
+const std::size_t block_size = 1 << 20;
+
+/* Writes all records of the engine to fd, scanning up to 'threads' partitions. */
+void write(engine_base &engine, int fd, std::size_t threads);
+
+/*
+ * Reads a dump from fd and puts its records into the engine, using up to
+ * 'threads' threads. A sorted dump is bulk loaded into an empty engine, if the
+ * engine supports it. A regular file is mapped and validated whole, so nothing
+ * is written if it is corrupted. Other descriptors are read a block at a time,
+ * records of blocks before a corrupted one are written.
+ */
+void read(engine_base &engine, int fd, std::size_t threads);
+
+} /* namespace dump */
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_DUMP_H */
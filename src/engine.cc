@@ -87,6 +87,11 @@ status engine_base::count_between(string_view key1, string_view key2, std::size_
 	return status::NOT_SUPPORTED;
 }
 
+status engine_base::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	return status::NOT_SUPPORTED;
+}
+
 status engine_base::get_all(get_kv_callback *callback, void *arg)
 {
 	return status::NOT_SUPPORTED;
@@ -118,21 +123,220 @@ status engine_base::get_between(string_view key1, string_view key2,
 	return status::NOT_SUPPORTED;
 }
 
+status engine_base::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_equal_above_desc(string_view key, get_kv_callback *callback,
+					 void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_equal_below_desc(string_view key, get_kv_callback *callback,
+					 void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_between_desc(string_view key1, string_view key2,
+				     get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::get_all_parallel(std::size_t num_partitions,
+				     get_kv_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::split_points(std::size_t n, get_v_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
 status engine_base::exists(string_view key)
 {
 	return status::NOT_SUPPORTED;
 }
 
+/*
+ * Default implementation copies the value using get(). Engines which can keep
+ * the value in place (and protect it from concurrent writers) should override it.
+ */
+status engine_base::get_ref(string_view key,
+			    std::unique_ptr<internal::value_ref_base> &ref)
+{
+	std::string copy;
+	auto s = get(
+		key,
+		[](const char *v, size_t vb, void *arg) {
+			static_cast<std::string *>(arg)->assign(v, vb);
+		},
+		&copy);
+	if (s != status::OK)
+		return s;
+
+	ref.reset(new internal::value_copy_ref(std::move(copy)));
+
+	return status::OK;
+}
+
+bool engine_base::concurrent() const
+{
+	return false;
+}
+
 status engine_base::defrag(double start_percent, double amount_percent)
 {
 	return status::NOT_SUPPORTED;
 }
 
+status engine_base::memory_usage(memory_stats &stats)
+{
+	return status::NOT_SUPPORTED;
+}
+
+/* sums sizes of keys and values of all elements */
+status engine_base::count_data_size(memory_stats &stats)
+{
+	stats.count = 0;
+	stats.keys = 0;
+	stats.values = 0;
+
+	return get_all(
+		[](const char *k, size_t kb, const char *v, size_t vb, void *arg) {
+			auto s = static_cast<memory_stats *>(arg);
+			++s->count;
+			s->keys += kb;
+			s->values += vb;
+			return 0;
+		},
+		&stats);
+}
+
+void engine_base::set_bytes_per_key(memory_stats &stats)
+{
+	auto used = stats.keys + stats.values + stats.metadata + stats.allocator_overhead;
+	stats.bytes_per_key =
+		stats.count ? static_cast<double>(used) / static_cast<double>(stats.count)
+			    : 0;
+}
+
+void engine_base::set_async_params(const internal::executor::params &p)
+{
+	async_params = p;
+}
+
+void engine_base::async_get(string_view key, async_callback *callback, void *arg)
+{
+	async_executor().get(key, callback, arg);
+}
+
+void engine_base::async_put(string_view key, string_view value,
+			    async_callback *callback, void *arg)
+{
+	async_executor().put(key, value, callback, arg);
+}
+
+void engine_base::async_remove(string_view key, async_callback *callback, void *arg)
+{
+	async_executor().remove(key, callback, arg);
+}
+
+void engine_base::stop_async()
+{
+	if (async_exec)
+		async_exec->stop();
+}
+
+void engine_base::set_expire_hook(expire_hook hook)
+{
+	on_expire = std::move(hook);
+}
+
+bool engine_base::expire_key(string_view key, const std::function<bool()> &erase)
+{
+	return on_expire ? on_expire(key, erase) : erase();
+}
+
+internal::executor &engine_base::async_executor()
+{
+	std::call_once(async_once, [&] {
+		async_exec.reset(new internal::executor(*this, async_params));
+	});
+
+	return *async_exec;
+}
+
+status engine_base::put_with_ttl(string_view key, string_view value, uint64_t ttl_ms)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::remove_range(string_view key1, string_view key2)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::remove_prefix(string_view prefix)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
 internal::transaction *engine_base::begin_tx()
 {
 	throw internal::not_supported("Transactions are not supported in this engine");
 }
 
+status engine_base::get_codec_state(std::string &state)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::set_codec_state(string_view state)
+{
+	return status::NOT_SUPPORTED;
+}
+
+internal::change_log *engine_base::open_change_log(std::size_t size)
+{
+	return size ? new internal::change_log(size) : nullptr;
+}
+
+status engine_base::changes(uint64_t since, std::chrono::milliseconds timeout,
+			    change_callback *callback, void *arg)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status engine_base::changes_last_seq(uint64_t &seq)
+{
+	return status::NOT_SUPPORTED;
+}
+
 engine_base::iterator *engine_base::new_iterator()
 {
 	throw internal::not_supported("Iterators are not supported in this engine");
@@ -143,5 +347,10 @@ engine_base::iterator *engine_base::new_const_iterator()
 	throw internal::not_supported("Iterators are not supported in this engine");
 }
 
+engine_base *engine_base::new_snapshot()
+{
+	throw internal::not_supported("Snapshots are not supported in this engine");
+}
+
 } // namespace kv
 } // namespace pmem
@@ -4,14 +4,19 @@
 #ifndef LIBPMEMKV_ENGINE_H
 #define LIBPMEMKV_ENGINE_H
 
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
+#include "change_log.h"
 #include "config.h"
+#include "executor.h"
 #include "iterator.h"
 #include "libpmemkv.hpp"
 #include "transaction.h"
+#include "value_ref.h"
 
 namespace pmem
 {
@@ -37,6 +42,8 @@ public:
 	virtual ~engine_base() = default;
 
 	virtual std::string name() = 0;
+	/* Tells if get, put and remove can be called by many threads at once. */
+	virtual bool concurrent() const;
 
 	virtual status count_all(std::size_t &cnt);
 	virtual status count_above(string_view key, std::size_t &cnt);
@@ -45,6 +52,7 @@ public:
 	virtual status count_below(string_view key, std::size_t &cnt);
 	virtual status count_between(string_view key1, string_view key2,
 				     std::size_t &cnt);
+	virtual status count_prefix(string_view prefix, std::size_t &cnt);
 
 	virtual status get_all(get_kv_callback *callback, void *arg);
 	virtual status get_above(string_view key, get_kv_callback *callback, void *arg);
@@ -55,19 +63,95 @@ public:
 	virtual status get_below(string_view key, get_kv_callback *callback, void *arg);
 	virtual status get_between(string_view key1, string_view key2,
 				   get_kv_callback *callback, void *arg);
+	virtual status get_prefix(string_view prefix, get_kv_callback *callback,
+				  void *arg);
+
+	/* Same as get_* above, but records are passed in descending order of keys. */
+	virtual status get_all_desc(get_kv_callback *callback, void *arg);
+	virtual status get_above_desc(string_view key, get_kv_callback *callback,
+				      void *arg);
+	virtual status get_equal_above_desc(string_view key, get_kv_callback *callback,
+					    void *arg);
+	virtual status get_equal_below_desc(string_view key, get_kv_callback *callback,
+					    void *arg);
+	virtual status get_below_desc(string_view key, get_kv_callback *callback,
+				      void *arg);
+	virtual status get_between_desc(string_view key1, string_view key2,
+					get_kv_callback *callback, void *arg);
+
+	virtual status get_all_parallel(std::size_t num_partitions,
+					get_kv_callback *callback, void *arg);
+	virtual status split_points(std::size_t n, get_v_callback *callback, void *arg);
 
 	virtual status exists(string_view key);
 
 	virtual status get(string_view key, get_v_callback *callback, void *arg) = 0;
+	virtual status get_ref(string_view key,
+			       std::unique_ptr<internal::value_ref_base> &ref);
 	virtual status put(string_view key, string_view value) = 0;
+	virtual status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms);
 	virtual status remove(string_view key) = 0;
+	/* Remove all keys in [key1, key2) or starting with the prefix. */
+	virtual status remove_range(string_view key1, string_view key2);
+	virtual status remove_prefix(string_view prefix);
 	virtual status defrag(double start_percent, double amount_percent);
+	virtual status memory_usage(memory_stats &stats);
+	virtual status bulk_load(bulk_load_callback *callback, void *arg);
 
 	virtual internal::transaction *begin_tx();
 
 	virtual iterator *new_iterator();
 	virtual iterator *new_const_iterator();
 
+	/*
+	 * Returns a read-only engine with the data as it is now, not affected by
+	 * later writes. It has to be destroyed before this engine.
+	 */
+	virtual engine_base *new_snapshot();
+
+	/*
+	 * State of the value codec, persisted together with the data.
+	 * Empty state means that no codec was recorded. set_codec_state returns
+	 * TRANSACTION_SCOPE_ERROR if the state cannot be persisted right now.
+	 */
+	virtual status get_codec_state(std::string &state);
+	virtual status set_codec_state(string_view state);
+
+	/*
+	 * Returns the change log recorded in the engine or, if there is none,
+	 * creates one with data area of 'size' bytes (or returns nullptr if 'size'
+	 * is 0). Default log is volatile.
+	 */
+	virtual internal::change_log *open_change_log(std::size_t size);
+	/* Reads the change log (see change_log::read), if it is enabled. */
+	virtual status changes(uint64_t since, std::chrono::milliseconds timeout,
+			       change_callback *callback, void *arg);
+	virtual status changes_last_seq(uint64_t &seq);
+
+	/*
+	 * Asynchronous get, put and remove, run by the executor (started on first
+	 * use) on top of the synchronous ones. Callback is called in a thread of
+	 * the executor.
+	 */
+	void set_async_params(const internal::executor::params &p);
+	void async_get(string_view key, async_callback *callback, void *arg);
+	void async_put(string_view key, string_view value, async_callback *callback,
+		       void *arg);
+	void async_remove(string_view key, async_callback *callback, void *arg);
+	/* Completes submitted operations, must be called before engine's destruction. */
+	void stop_async();
+
+	/*
+	 * Removes an expired key by calling 'erase' and returns its result (false
+	 * if the key was not removed). Engines wrapping this one set it to record
+	 * removals of expired keys (see change_log_engine). It is set by
+	 * pmemkv_open (also to an empty function), engines with a reaper thread
+	 * do not expire keys before.
+	 */
+	using expire_hook =
+		std::function<bool(string_view key, const std::function<bool()> &erase)>;
+	virtual void set_expire_hook(expire_hook hook);
+
 	/**
 	 * factory_base is an interface for engine factory.
 	 * Should be implemented for registration purposes.
@@ -80,6 +164,23 @@ public:
 			create(std::unique_ptr<internal::config>) = 0;
 		virtual std::string get_name() = 0;
 	};
+
+protected:
+	/* helpers for memory_usage() implementations */
+	status count_data_size(memory_stats &stats);
+	static void set_bytes_per_key(memory_stats &stats);
+
+	/* Removes an expired key by 'erase', through the expire hook if it is set. */
+	bool expire_key(string_view key, const std::function<bool()> &erase);
+
+private:
+	internal::executor &async_executor();
+
+	expire_hook on_expire;
+
+	internal::executor::params async_params;
+	std::unique_ptr<internal::executor> async_exec;
+	std::once_flag async_once;
 };
 
 /**
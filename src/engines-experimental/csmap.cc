@@ -5,6 +5,7 @@
 
 #include "../iterator.h"
 #include "../out.h"
+#include "../parallel.h"
 
 namespace pmem
 {
@@ -28,6 +29,11 @@ std::string csmap::name()
 	return "csmap";
 }
 
+bool csmap::concurrent() const
+{
+	return true;
+}
+
 status csmap::count_all(std::size_t &cnt)
 {
 	LOG("count_all");
@@ -116,6 +122,22 @@ status csmap::count_between(string_view key1, string_view key2, std::size_t &cnt
 	return status::OK;
 }
 
+status csmap::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(container->key_comp());
+
+	shared_global_lock_type lock(mtx);
+
+	auto first = container->lower_bound(prefix);
+	auto last = container->end();
+
+	cnt = internal::prefix_distance(first, last, prefix);
+
+	return status::OK;
+}
+
 status csmap::iterate(typename container_type::iterator first,
 		      typename container_type::iterator last, get_kv_callback *callback,
 		      void *arg)
@@ -215,6 +237,169 @@ status csmap::get_between(string_view key1, string_view key2, get_kv_callback *c
 	return status::OK;
 }
 
+status csmap::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(container->key_comp());
+
+	shared_global_lock_type lock(mtx);
+
+	for (auto it = container->lower_bound(prefix); it != container->end(); ++it) {
+		if (!internal::has_prefix(string_view(it->first.c_str(), it->first.size()),
+					  prefix))
+			break;
+
+		shared_node_lock_type node_lock(it->second.mtx);
+
+		auto ret = callback(it->first.c_str(), it->first.size(),
+				    it->second.val.c_str(), it->second.val.size(), arg);
+
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+
+	return status::OK;
+}
+
+template <typename InRange>
+status csmap::iterate_desc(typename container_type::iterator it, InRange &&in_range,
+			   get_kv_callback *callback, void *arg)
+{
+	for (; it != container->end() && in_range(it->first);
+	     it = container->find_lower(it->first)) {
+		shared_node_lock_type lock(it->second.mtx);
+
+		auto ret = callback(it->first.c_str(), it->first.size(),
+				    it->second.val.c_str(), it->second.val.size(), arg);
+
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+
+	return status::OK;
+}
+
+static bool any_key(const internal::csmap::key_type &)
+{
+	return true;
+}
+
+status csmap::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	return iterate_desc(last_element(), any_key, callback, arg);
+}
+
+status csmap::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	auto &cmp = container->key_comp();
+	return iterate_desc(
+		last_element(),
+		[&](const internal::csmap::key_type &k) { return cmp(key, k); },
+		callback, arg);
+}
+
+status csmap::get_equal_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	auto &cmp = container->key_comp();
+	return iterate_desc(
+		last_element(),
+		[&](const internal::csmap::key_type &k) { return !cmp(k, key); },
+		callback, arg);
+}
+
+status csmap::get_equal_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	return iterate_desc(container->find_lower_eq(key), any_key, callback, arg);
+}
+
+status csmap::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	return iterate_desc(container->find_lower(key), any_key, callback, arg);
+}
+
+status csmap::get_between_desc(string_view key1, string_view key2,
+			       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc for key1=" << key1.data() << ", key2=" << key2.data());
+	check_outside_tx();
+
+	auto &cmp = container->key_comp();
+	if (cmp(key1, key2)) {
+		shared_global_lock_type lock(mtx);
+
+		return iterate_desc(
+			container->find_lower(key2),
+			[&](const internal::csmap::key_type &k) { return cmp(key1, k); },
+			callback, arg);
+	}
+
+	return status::OK;
+}
+
+/*
+ * concurrent_map does not expose its skip list levels, so partition bounds
+ * are found by walking the elements (without reading values) under the shared
+ * global lock, which is held until all partitions are scanned.
+ */
+status csmap::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+			       void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	auto bounds = internal::split_range(container->begin(), container->end(),
+					    container->size(), num_partitions);
+
+	return internal::parallel_scan(
+		bounds.size() - 1, callback, arg,
+		[&](std::size_t i, get_kv_callback *cb, void *cb_arg) {
+			iterate(bounds[i], bounds[i + 1], cb, cb_arg);
+		});
+}
+
+status csmap::split_points(std::size_t n, get_v_callback *callback, void *arg)
+{
+	LOG("split_points n=" << n);
+	check_outside_tx();
+
+	shared_global_lock_type lock(mtx);
+
+	auto bounds = internal::split_range(container->begin(), container->end(),
+					    container->size(), n);
+	for (std::size_t i = 1; i + 1 < bounds.size(); i++)
+		callback(bounds[i]->first.c_str(), bounds[i]->first.size(), arg);
+
+	return status::OK;
+}
+
 status csmap::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
@@ -241,11 +426,37 @@ status csmap::get(string_view key, get_v_callback *callback, void *arg)
 	return status::NOT_FOUND;
 }
 
+/*
+ * The returned reference holds the global lock and the element's lock (both
+ * shared), so the value cannot be modified nor removed until it is released.
+ */
+status csmap::get_ref(string_view key, std::unique_ptr<internal::value_ref_base> &ref)
+{
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	using ref_type = internal::guarded_value_ref<value_guard>;
+	std::unique_ptr<ref_type> result(new ref_type());
+	result->guard.global_lock = shared_global_lock_type(mtx);
+	auto it = container->find(key);
+	if (it == container->end()) {
+		LOG("  key not found");
+		return status::NOT_FOUND;
+	}
+
+	result->guard.node_lock = shared_node_lock_type(it->second.mtx);
+	result->set_value(string_view(it->second.val.c_str(), it->second.val.size()));
+	ref = std::move(result);
+
+	return status::OK;
+}
+
 status csmap::put(string_view key, string_view value)
 {
 	LOG("put key=" << std::string(key.data(), key.size())
 		       << ", value.size=" << std::to_string(value.size()));
 	check_outside_tx();
+	auto arena = assign_arena();
 
 	shared_global_lock_type lock(mtx);
 
@@ -257,6 +468,8 @@ status csmap::put(string_view key, string_view value)
 		pmem::obj::transaction::run(pmpool, [&] {
 			it->second.val.assign(value.data(), value.size());
 		});
+	} else {
+		update_last_key(result.first);
 	}
 
 	return status::OK;
@@ -266,8 +479,213 @@ status csmap::remove(string_view key)
 {
 	LOG("remove key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto arena = assign_arena();
+	unique_global_lock_type lock(mtx);
+	if (container->unsafe_erase(key) == 0)
+		return status::NOT_FOUND;
+
+	refresh_last_key();
+
+	return status::OK;
+}
+
+/*
+ * Range is erased by concurrent_map, element by element (each one in its own
+ * transaction), with a single lookup of the bounds.
+ */
+status csmap::remove_range(string_view key1, string_view key2)
+{
+	LOG("remove_range for key1=" << std::string(key1.data(), key1.size())
+				     << ", key2=" << std::string(key2.data(), key2.size()));
+	check_outside_tx();
+	auto arena = assign_arena();
+
+	if (container->key_comp()(key1, key2)) {
+		unique_global_lock_type lock(mtx);
+
+		auto first = container->lower_bound(key1);
+		auto last = container->lower_bound(key2);
+		container->unsafe_erase(first, last);
+		refresh_last_key();
+	}
+
+	return status::OK;
+}
+
+status csmap::remove_prefix(string_view prefix)
+{
+	LOG("remove_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(container->key_comp());
+	auto arena = assign_arena();
 	unique_global_lock_type lock(mtx);
-	return container->unsafe_erase(key) > 0 ? status::OK : status::NOT_FOUND;
+
+	auto first = container->lower_bound(prefix);
+	auto last = internal::prefix_end(first, container->end(), prefix);
+	container->unsafe_erase(first, last);
+	refresh_last_key();
+
+	return status::OK;
+}
+
+/*
+ * concurrent_map cannot be modified inside a transaction, so elements are
+ * inserted one by one. The global lock is taken once per batch instead of
+ * once per element.
+ */
+status csmap::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	LOG("bulk_load");
+	check_outside_tx();
+	auto arena = assign_arena();
+
+	/* elements are copied to DRAM, so the callback is not called under the lock */
+	const size_t batch_size = 1024;
+	std::vector<std::pair<std::string, std::string>> batch;
+	batch.reserve(batch_size);
+	const char *k, *v;
+	size_t kb, vb;
+	bool has_next = callback(&k, &kb, &v, &vb, arg) == 0;
+	bool sorted = true;
+
+	while (has_next && sorted) {
+		batch.clear();
+		do {
+			batch.emplace_back(std::string(k, kb), std::string(v, vb));
+			has_next = callback(&k, &kb, &v, &vb, arg) == 0;
+			sorted = !has_next ||
+				container->key_comp()(batch.back().first, string_view(k, kb));
+		} while (has_next && sorted && batch.size() < batch_size);
+
+		shared_global_lock_type lock(mtx);
+		for (auto &e : batch) {
+			string_view key(e.first), value(e.second);
+			auto result = container->try_emplace(key, value);
+			if (result.second == false) {
+				auto &it = result.first;
+				unique_node_lock_type node_lock(it->second.mtx);
+				pmem::obj::transaction::run(pmpool, [&] {
+					it->second.val.assign(value.data(), value.size());
+				});
+			} else {
+				update_last_key(result.first);
+			}
+		}
+	}
+
+	if (!sorted)
+		throw internal::invalid_argument(
+			"Keys passed to bulk_load are not in strictly ascending order");
+
+	return status::OK;
+}
+
+/*
+ * Nodes of concurrent_map cannot be relocated (nor erased and inserted again
+ * atomically), so only buffers of keys and values are defragmented. Operations
+ * are blocked by the global lock for the duration of a call.
+ */
+status csmap::defrag(double start_percent, double amount_percent)
+{
+	LOG("defrag: start_percent = " << start_percent
+				       << " amount_percent = " << amount_percent);
+	check_outside_tx();
+
+	if (start_percent < 0 || start_percent >= 100 || amount_percent <= 0 ||
+	    amount_percent > 100 || start_percent + amount_percent > 100)
+		throw internal::invalid_argument("incorrect range");
+
+	unique_global_lock_type lock(mtx);
+
+	auto size = static_cast<double>(container->size());
+	auto first = static_cast<size_t>(size * start_percent / 100);
+	auto last = static_cast<size_t>(size * (start_percent + amount_percent) / 100);
+	if (start_percent + amount_percent >= 100)
+		last = container->size();
+
+	auto it = container->begin();
+	std::advance(it, first);
+
+	pmem::obj::defrag defrag(pmpool);
+	for (size_t i = first; i < last && it != container->end(); ++i, ++it) {
+		/* key buffer can be moved, the key object itself stays in place */
+		defrag.add(const_cast<internal::csmap::key_type &>(it->first));
+		defrag.add(it->second.val);
+	}
+
+	try {
+		defrag.run();
+	} catch (pmem::defrag_error &e) {
+		out_err_stream("defrag") << e.what();
+		return status::DEFRAG_ERROR;
+	}
+
+	return status::OK;
+}
+
+/*
+ * Walks the whole map if the greatest key is not known yet. Elements inserted
+ * at the end meanwhile are either visited or update the key afterwards.
+ */
+bool csmap::last_key(std::string &key)
+{
+	std::unique_lock<std::mutex> lock(last_mtx);
+
+	if (!last_valid) {
+		auto it = container->begin();
+		if (it == container->end())
+			return false;
+
+		for (auto next = std::next(it); next != container->end(); ++next)
+			it = next;
+
+		last.assign(it->first.c_str(), it->first.size());
+		last_valid = true;
+	}
+
+	key = last;
+
+	return true;
+}
+
+typename csmap::container_type::iterator csmap::last_element()
+{
+	std::string key;
+	if (!last_key(key))
+		return container->end();
+
+	/* keys greater than the cached one may have been inserted meanwhile */
+	auto it = container->find_lower_eq(key);
+	for (auto next = std::next(it); next != container->end(); ++next)
+		it = next;
+
+	return it;
+}
+
+/* only an element inserted at the end can be greater than the cached key */
+void csmap::update_last_key(typename container_type::iterator inserted)
+{
+	if (std::next(inserted) != container->end())
+		return;
+
+	std::unique_lock<std::mutex> lock(last_mtx);
+
+	string_view key(inserted->first.c_str(), inserted->first.size());
+	if (last_valid && container->key_comp()(last, key))
+		last.assign(key.data(), key.size());
+}
+
+/* must be called under the unique global lock, after elements are removed */
+void csmap::refresh_last_key()
+{
+	if (!last_valid || container->contains(last))
+		return;
+
+	auto it = container->find_lower(last);
+	if (it == container->end())
+		last_valid = false;
+	else
+		last.assign(it->first.c_str(), it->first.size());
 }
 
 void csmap::Recover()
@@ -298,21 +716,24 @@ void csmap::Recover()
 
 internal::iterator_base *csmap::new_iterator()
 {
-	return new csmap_iterator<false>{container, mtx};
+	return new csmap_iterator<false>{this};
 }
 
 internal::iterator_base *csmap::new_const_iterator()
 {
-	return new csmap_iterator<true>{container, mtx};
+	return new csmap_iterator<true>{this};
 }
 
-csmap::csmap_iterator<true>::csmap_iterator(container_type *c, global_mutex_type &mtx)
-    : container(c), lock(mtx), pop(pmem::obj::pool_by_vptr(c))
+csmap::csmap_iterator<true>::csmap_iterator(csmap *engine)
+    : engine(engine),
+      container(engine->container),
+      lock(engine->mtx),
+      pop(pmem::obj::pool_by_vptr(container))
 {
 }
 
-csmap::csmap_iterator<false>::csmap_iterator(container_type *c, global_mutex_type &mtx)
-    : csmap::csmap_iterator<true>(c, mtx)
+csmap::csmap_iterator<false>::csmap_iterator(csmap *engine)
+    : csmap::csmap_iterator<true>(engine)
 {
 }
 
@@ -382,6 +803,12 @@ status csmap::csmap_iterator<true>::seek_higher_eq(string_view key)
 	return status::OK;
 }
 
+status csmap::csmap_iterator<true>::seek_prefix(string_view prefix)
+{
+	internal::check_prefix_support(container->key_comp());
+	return iterator_base::seek_prefix(prefix);
+}
+
 status csmap::csmap_iterator<true>::seek_to_first()
 {
 	init_seek();
@@ -396,6 +823,19 @@ status csmap::csmap_iterator<true>::seek_to_first()
 	return status::OK;
 }
 
+status csmap::csmap_iterator<true>::seek_to_last()
+{
+	init_seek();
+
+	it_ = engine->last_element();
+	if (it_ == container->end())
+		return status::NOT_FOUND;
+
+	node_lock = csmap::unique_node_lock_type(it_->second.mtx);
+
+	return status::OK;
+}
+
 status csmap::csmap_iterator<true>::is_next()
 {
 	auto tmp = it_;
@@ -417,6 +857,39 @@ status csmap::csmap_iterator<true>::next()
 	return status::OK;
 }
 
+/*
+ * At the first element the iterator (and its lock of the node) is left as it is.
+ * Otherwise the lock of the current node is released before the predecessor is
+ * locked, as nodes are locked in ascending order by next(). An element can be
+ * inserted between them meanwhile (elements are not erased while the global
+ * lock is shared), so the predecessor is looked up again once it is locked.
+ */
+status csmap::csmap_iterator<true>::prev()
+{
+	if (it_ == container->end())
+		return status::NOT_FOUND;
+
+	auto current = it_;
+	auto prev = container->find_lower(current->first);
+	if (prev == container->end())
+		return status::NOT_FOUND;
+
+	init_seek();
+
+	while (true) {
+		node_lock = csmap::unique_node_lock_type(prev->second.mtx);
+		auto found = container->find_lower(current->first);
+		if (found == prev)
+			break;
+
+		node_lock.unlock();
+		prev = found;
+	}
+	it_ = prev;
+
+	return status::OK;
+}
+
 result<string_view> csmap::csmap_iterator<true>::key()
 {
 	assert(it_ != container->end());
@@ -8,6 +8,7 @@
 #include "../pmemobj_engine.h"
 
 #include <libpmemobj++/container/string.hpp>
+#include <libpmemobj++/defrag.hpp>
 #include <libpmemobj++/experimental/concurrent_map.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
 #include <libpmemobj++/shared_mutex.hpp>
@@ -83,6 +84,7 @@ public:
 	csmap &operator=(const csmap &) = delete;
 
 	std::string name() final;
+	bool concurrent() const final;
 
 	status count_all(std::size_t &cnt) final;
 	status count_above(string_view key, std::size_t &cnt) final;
@@ -90,6 +92,7 @@ public:
 	status count_equal_below(string_view key, std::size_t &cnt) final;
 	status count_below(string_view key, std::size_t &cnt) final;
 	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
 	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
@@ -100,14 +103,39 @@ public:
 	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
 	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
 			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
+	status split_points(std::size_t n, get_v_callback *callback, void *arg) final;
 
 	status exists(string_view key) final;
 
 	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key,
+		       std::unique_ptr<internal::value_ref_base> &ref) final;
 
 	status put(string_view key, string_view value) final;
 
 	status remove(string_view key) final;
+	status remove_range(string_view key1, string_view key2) final;
+	status remove_prefix(string_view prefix) final;
+
+	status bulk_load(bulk_load_callback *callback, void *arg) final;
+
+	status defrag(double start_percent, double amount_percent) final;
 
 	internal::iterator_base *new_iterator() final;
 	internal::iterator_base *new_const_iterator() final;
@@ -121,11 +149,33 @@ private:
 	using unique_node_lock_type = std::unique_lock<node_mutex_type>;
 	using container_type = internal::csmap::map_type;
 
+	/* locks held by references returned from get_ref() */
+	struct value_guard {
+		shared_global_lock_type global_lock;
+		shared_node_lock_type node_lock;
+	};
+
 	void Recover();
 	status iterate(typename container_type::iterator first,
 		       typename container_type::iterator last, get_kv_callback *callback,
 		       void *arg);
 
+	/*
+	 * Calls callback for elements from 'it' down, for as long as their keys
+	 * are in range. Each step is a predecessor search (there are no backward
+	 * links), so the cost is O(log n) per element.
+	 */
+	template <typename InRange>
+	status iterate_desc(typename container_type::iterator it, InRange &&in_range,
+			    get_kv_callback *callback, void *arg);
+
+	/* returns end() if there are no elements, requires the global lock */
+	typename container_type::iterator last_element();
+	/* returns false if there are no elements */
+	bool last_key(std::string &key);
+	void update_last_key(typename container_type::iterator inserted);
+	void refresh_last_key();
+
 	/*
 	 * We take read lock for thread-safe methods (like get/insert/get_all) to
 	 * synchronize with unsafe_erase() which is not thread-safe.
@@ -133,6 +183,16 @@ private:
 	global_mutex_type mtx;
 	container_type *container;
 	std::unique_ptr<internal::config> config;
+
+	/*
+	 * concurrent_map has no backward links, so the greatest key is cached (in
+	 * DRAM) to find the last element with a single predecessor search. It is
+	 * found by walking the map on first use and then updated by inserts at the
+	 * end and by removals (under the unique global lock).
+	 */
+	std::mutex last_mtx;
+	bool last_valid = false;
+	std::string last;
 };
 
 template <>
@@ -140,24 +200,29 @@ class csmap::csmap_iterator<true> : public internal::iterator_base {
 	using container_type = csmap::container_type;
 
 public:
-	csmap_iterator(container_type *container, global_mutex_type &mtx);
+	csmap_iterator(csmap *engine);
 
 	status seek(string_view key) final;
 	status seek_lower(string_view key) final;
 	status seek_lower_eq(string_view key) final;
 	status seek_higher(string_view key) final;
 	status seek_higher_eq(string_view key) final;
+	status seek_prefix(string_view prefix) final;
 
 	status seek_to_first() final;
+	status seek_to_last() final;
 
 	status is_next() final;
 	status next() final;
+	/* finds predecessor of the current key (there are no backward links) */
+	status prev() final;
 
 	result<string_view> key() final;
 
 	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
 
 protected:
+	csmap *engine;
 	container_type *container;
 	container_type::iterator it_;
 	csmap::shared_global_lock_type lock;
@@ -172,7 +237,7 @@ class csmap::csmap_iterator<false> : public csmap::csmap_iterator<true> {
 	using container_type = csmap::container_type;
 
 public:
-	csmap_iterator(container_type *container, global_mutex_type &mtx);
+	csmap_iterator(csmap *engine);
 
 	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
 
@@ -3,6 +3,7 @@
 
 #include "radix.h"
 #include "../out.h"
+#include "../parallel.h"
 
 namespace pmem
 {
@@ -151,6 +152,26 @@ status radix::count_between(string_view key1, string_view key2, std::size_t &cnt
 	return status::OK;
 }
 
+/*
+ * Keys sharing a prefix form a single subtree of the radix tree, so lower_bound
+ * lands on its leftmost leaf and the walk ends on the first leaf outside of it.
+ * This avoids a second descent and key comparisons needed to find the upper bound.
+ */
+status radix::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+
+	cnt = 0;
+	for (auto it = container->lower_bound(prefix); it != container->end(); ++it) {
+		if (!internal::has_prefix(it->key(), prefix))
+			break;
+		++cnt;
+	}
+
+	return status::OK;
+}
+
 status radix::iterate(typename container_type::const_iterator first,
 		      typename container_type::const_iterator last,
 		      get_kv_callback *callback, void *arg)
@@ -169,6 +190,25 @@ status radix::iterate(typename container_type::const_iterator first,
 	return status::OK;
 }
 
+status radix::iterate_desc(typename container_type::const_iterator first,
+			   typename container_type::const_iterator last,
+			   get_kv_callback *callback, void *arg)
+{
+	while (last != first) {
+		--last;
+		string_view key = last->key();
+		string_view value = last->value();
+
+		auto ret =
+			callback(key.data(), key.size(), value.data(), value.size(), arg);
+
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+
+	return status::OK;
+}
+
 status radix::get_all(get_kv_callback *callback, void *arg)
 {
 	LOG("get_all");
@@ -239,6 +279,135 @@ status radix::get_between(string_view key1, string_view key2, get_kv_callback *c
 	return status::OK;
 }
 
+status radix::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+	check_outside_tx();
+
+	auto first = container->begin();
+	auto last = container->end();
+
+	return iterate_desc(first, last, callback, arg);
+}
+
+status radix::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	auto first = container->upper_bound(key);
+	auto last = container->end();
+
+	return iterate_desc(first, last, callback, arg);
+}
+
+status radix::get_equal_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	auto first = container->lower_bound(key);
+	auto last = container->end();
+
+	return iterate_desc(first, last, callback, arg);
+}
+
+status radix::get_equal_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	auto first = container->begin();
+	auto last = container->upper_bound(key);
+
+	return iterate_desc(first, last, callback, arg);
+}
+
+status radix::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	auto first = container->begin();
+	auto last = container->lower_bound(key);
+
+	return iterate_desc(first, last, callback, arg);
+}
+
+status radix::get_between_desc(string_view key1, string_view key2,
+			       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc for key1=" << key1.data() << ", key2=" << key2.data());
+	check_outside_tx();
+
+	if (key1.compare(key2) < 0) {
+		auto first = container->upper_bound(key1);
+		auto last = container->lower_bound(key2);
+		return iterate_desc(first, last, callback, arg);
+	}
+
+	return status::OK;
+}
+
+status radix::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+
+	for (auto it = container->lower_bound(prefix); it != container->end(); ++it) {
+		string_view key = it->key();
+		if (!internal::has_prefix(key, prefix))
+			break;
+
+		string_view value = it->value();
+
+		auto ret =
+			callback(key.data(), key.size(), value.data(), value.size(), arg);
+
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+
+	return status::OK;
+}
+
+/*
+ * radix_tree does not expose its internal nodes, so partition bounds are found
+ * by walking the leaves (without reading values) and scans run in parallel.
+ */
+status radix::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+			       void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+	check_outside_tx();
+
+	std::vector<container_type::const_iterator> bounds = internal::split_range(
+		container_type::const_iterator(container->begin()),
+		container_type::const_iterator(container->end()), container->size(),
+		num_partitions);
+
+	return internal::parallel_scan(
+		bounds.size() - 1, callback, arg,
+		[&](std::size_t i, get_kv_callback *cb, void *cb_arg) {
+			iterate(bounds[i], bounds[i + 1], cb, cb_arg);
+		});
+}
+
+status radix::split_points(std::size_t n, get_v_callback *callback, void *arg)
+{
+	LOG("split_points n=" << n);
+	check_outside_tx();
+
+	auto bounds = internal::split_range(container->begin(), container->end(),
+					    container->size(), n);
+	for (std::size_t i = 1; i + 1 < bounds.size(); i++) {
+		string_view key = bounds[i]->key();
+		callback(key.data(), key.size(), arg);
+	}
+
+	return status::OK;
+}
+
 status radix::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
@@ -263,6 +432,21 @@ status radix::get(string_view key, get_v_callback *callback, void *arg)
 	return status::NOT_FOUND;
 }
 
+status radix::get_ref(string_view key, std::unique_ptr<internal::value_ref_base> &ref)
+{
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	auto it = container->find(key);
+	if (it != container->end()) {
+		ref.reset(new internal::value_ref_base(string_view(it->value())));
+		return status::OK;
+	}
+
+	LOG("  key not found");
+	return status::NOT_FOUND;
+}
+
 status radix::put(string_view key, string_view value)
 {
 	LOG("put key=" << std::string(key.data(), key.size())
@@ -294,6 +478,99 @@ status radix::remove(string_view key)
 	return status::OK;
 }
 
+/*
+ * radix_tree does not expose its internal nodes, so a subtree cannot be
+ * detached at once. Leaves are erased in order, from 'from' on while in_range
+ * holds, many of them in a single transaction (as in bulk_load).
+ */
+template <typename Pred>
+void radix::erase_range(string_view from, Pred &&in_range)
+{
+	const size_t batch_size = 1024;
+	auto it = container->lower_bound(from);
+	bool done = false;
+
+	while (!done) {
+		pmem::obj::transaction::run(pmpool, [&] {
+			for (size_t i = 0; i < batch_size; i++) {
+				if (it == container->end() || !in_range(it->key())) {
+					done = true;
+					return;
+				}
+				it = container->erase(it);
+			}
+		});
+	}
+}
+
+status radix::remove_range(string_view key1, string_view key2)
+{
+	LOG("remove_range for key1=" << std::string(key1.data(), key1.size())
+				     << ", key2=" << std::string(key2.data(), key2.size()));
+	check_outside_tx();
+
+	if (key1.compare(key2) < 0)
+		erase_range(key1, [&](string_view key) { return key.compare(key2) < 0; });
+
+	return status::OK;
+}
+
+status radix::remove_prefix(string_view prefix)
+{
+	LOG("remove_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+
+	erase_range(prefix,
+		    [&](string_view key) { return internal::has_prefix(key, prefix); });
+
+	return status::OK;
+}
+
+/*
+ * radix_tree has no bottom-up construction, elements are inserted in order,
+ * but many of them in a single transaction to amortize the cost of commits.
+ * Elements of a transaction are copied to DRAM first, so the callback is not
+ * called inside of it.
+ */
+status radix::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	LOG("bulk_load");
+	check_outside_tx();
+
+	const size_t batch_size = 1024;
+	std::vector<std::pair<std::string, std::string>> batch;
+	batch.reserve(batch_size);
+	const char *k, *v;
+	size_t kb, vb;
+	bool has_next = callback(&k, &kb, &v, &vb, arg) == 0;
+	bool sorted = true;
+
+	while (has_next && sorted) {
+		batch.clear();
+		do {
+			batch.emplace_back(std::string(k, kb), std::string(v, vb));
+			has_next = callback(&k, &kb, &v, &vb, arg) == 0;
+			sorted = !has_next || batch.back().first.compare(0, std::string::npos,
+									 k, kb) < 0;
+		} while (has_next && sorted && batch.size() < batch_size);
+
+		pmem::obj::transaction::run(pmpool, [&] {
+			for (auto &e : batch) {
+				string_view key(e.first), value(e.second);
+				auto result = container->try_emplace(key, value);
+				if (result.second == false)
+					result.first.assign_val(value);
+			}
+		});
+	}
+
+	if (!sorted)
+		throw internal::invalid_argument(
+			"Keys passed to bulk_load are not in strictly ascending order");
+
+	return status::OK;
+}
+
 internal::transaction *radix::begin_tx()
 {
 	return new internal::radix::transaction(pmpool, container);
@@ -476,6 +753,26 @@ result<pmem::obj::slice<const char *>> radix::radix_iterator<true>::read_range(s
 	return {{it_->value().cdata() + pos, it_->value().cdata() + pos + n}};
 }
 
+result<size_t> radix::radix_iterator<true>::next_batch(size_t n, const char **keys,
+						       size_t *kbs, const char **values,
+						       size_t *vbs)
+{
+	init_seek();
+
+	assert(it_ != container->end());
+
+	size_t count = 0;
+	for (auto it = it_; it != container->end() && count < n; ++it, ++count) {
+		keys[count] = it->key().cdata();
+		kbs[count] = it->key().size();
+		values[count] = it->value().cdata();
+		vbs[count] = it->value().size();
+		it_ = it;
+	}
+
+	return count;
+}
+
 result<pmem::obj::slice<char *>> radix::radix_iterator<false>::write_range(size_t pos,
 									   size_t n)
 {
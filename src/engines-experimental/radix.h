@@ -90,6 +90,7 @@ public:
 	status count_equal_below(string_view key, std::size_t &cnt) final;
 	status count_below(string_view key, std::size_t &cnt) final;
 	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
 	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
@@ -100,14 +101,37 @@ public:
 	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
 	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
 			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
+	status split_points(std::size_t n, get_v_callback *callback, void *arg) final;
 
 	status exists(string_view key) final;
 
 	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key,
+		       std::unique_ptr<internal::value_ref_base> &ref) final;
 
 	status put(string_view key, string_view value) final;
 
 	status remove(string_view key) final;
+	status remove_range(string_view key1, string_view key2) final;
+	status remove_prefix(string_view prefix) final;
+
+	status bulk_load(bulk_load_callback *callback, void *arg) final;
 
 	internal::transaction *begin_tx() final;
 
@@ -121,6 +145,12 @@ private:
 	status iterate(typename container_type::const_iterator first,
 		       typename container_type::const_iterator last,
 		       get_kv_callback *callback, void *arg);
+	/* same as iterate, but from the element before 'last' down to 'first' */
+	status iterate_desc(typename container_type::const_iterator first,
+			    typename container_type::const_iterator last,
+			    get_kv_callback *callback, void *arg);
+	template <typename Pred>
+	void erase_range(string_view from, Pred &&in_range);
 
 	container_type *container;
 	std::unique_ptr<internal::config> config;
@@ -149,6 +179,8 @@ public:
 	result<string_view> key() final;
 
 	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+	result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+				  const char **values, size_t *vbs) final;
 
 protected:
 	container_type *container;
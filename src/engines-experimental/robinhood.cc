@@ -5,6 +5,7 @@
 #include "../exceptions.h"
 #include "../fast_hash.h"
 #include "../out.h"
+#include "../parallel.h"
 
 #include <unistd.h>
 
@@ -201,7 +202,11 @@ static int insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t
 	uint64_t dist = 0;
 	struct entry *entry_p = NULL;
 
-	for (int n = 0; n < HASHMAP_RP_MAX_SWAPS; ++n) {
+	/*
+	 * Probing stops before it wraps around, as entries modified by not yet
+	 * published actions would be read again.
+	 */
+	for (uint64_t n = 0; n < HASHMAP_RP_MAX_SWAPS && n + 1 < hashmap->capacity; ++n) {
 		entry_p = D_RW(hashmap->entries);
 		entry_p += args.pos;
 
@@ -397,6 +402,16 @@ int hm_rp_insert(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap, uint64_t key
 			return -1;
 	}
 
+	if (insert_helper(pop, D_RW(hashmap), key, value, false) == 0)
+		return 0;
+
+	/*
+	 * Tombstones are not counted in resize threshold and they are purged
+	 * only by a rebuild - after many removals they can fill the hashmap.
+	 */
+	if (hm_rp_rebuild(pop, hashmap, D_RO(hashmap)->capacity) != 0)
+		return -1;
+
 	return insert_helper(pop, D_RW(hashmap), key, value, false);
 }
 
@@ -529,6 +544,11 @@ std::string robinhood::name()
 	return internal::robinhood::name();
 }
 
+bool robinhood::concurrent() const
+{
+	return true;
+}
+
 status robinhood::count_all(std::size_t &cnt)
 {
 	LOG("count_all");
@@ -558,6 +578,36 @@ status robinhood::get_all(get_kv_callback *callback, void *arg)
 	return status::OK;
 }
 
+/*
+ * Partitions are shards, so num_partitions is limited to the number of shards
+ * (and of cores). All shards are locked for the whole scan, so workers do not
+ * take any locks.
+ */
+status robinhood::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				   void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+	check_outside_tx();
+
+	size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	num_partitions = std::min({num_partitions, shards_number, cores});
+
+	std::vector<shared_lock_type> locks;
+	locks.reserve(shards_number);
+	for (size_t i = 0; i < shards_number; ++i)
+		locks.emplace_back(mtxs[i]);
+
+	return internal::parallel_scan(
+		num_partitions, callback, arg,
+		[&](size_t p, get_kv_callback *cb, void *cb_arg) {
+			for (size_t i = p; i < shards_number; i += num_partitions) {
+				if (hm_rp_foreach(pmpool.handle(), container[i], cb,
+						  cb_arg))
+					return;
+			}
+		});
+}
+
 status robinhood::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
@@ -647,6 +697,16 @@ status robinhood::remove(string_view key)
 	return status::OK;
 }
 
+internal::iterator_base *robinhood::new_iterator()
+{
+	return new robinhood_iterator<false>{this};
+}
+
+internal::iterator_base *robinhood::new_const_iterator()
+{
+	return new robinhood_iterator<true>{this};
+}
+
 void robinhood::Recover()
 {
 	auto sn = std::getenv("PMEMKV_ROBINHOOD_SHARDS_NUMBER");
@@ -706,6 +766,196 @@ void robinhood::Recover()
 	mtxs = std::vector<mutex_type>(shards_number);
 }
 
+robinhood::robinhood_iterator<true>::robinhood_iterator(robinhood *engine, bool exclusive)
+    : engine(engine), exclusive(exclusive)
+{
+}
+
+robinhood::robinhood_iterator<true>::~robinhood_iterator()
+{
+	unlock();
+}
+
+robinhood::robinhood_iterator<false>::robinhood_iterator(robinhood *engine)
+    : robinhood::robinhood_iterator<true>(engine, true)
+{
+}
+
+void robinhood::robinhood_iterator<true>::lock(size_t shard)
+{
+	assert(!locked);
+
+	if (exclusive)
+		engine->mtxs[shard].lock();
+	else
+		engine->mtxs[shard].lock_shared();
+
+	this->shard = shard;
+	locked = true;
+}
+
+void robinhood::robinhood_iterator<true>::unlock()
+{
+	if (!locked)
+		return;
+
+	if (exclusive)
+		engine->mtxs[shard].unlock();
+	else
+		engine->mtxs[shard].unlock_shared();
+
+	locked = false;
+	pos = 0;
+}
+
+internal::robinhood::entry *robinhood::robinhood_iterator<true>::current()
+{
+	assert(locked && pos != 0);
+
+	return D_RW(D_RW(engine->container[shard])->entries) + pos;
+}
+
+bool robinhood::robinhood_iterator<true>::find_from(size_t shard, uint64_t pos)
+{
+	for (; shard < engine->shards_number; ++shard, pos = 1) {
+		if (!locked || this->shard != shard) {
+			unlock();
+			lock(shard);
+		}
+
+		auto hashmap = D_RO(engine->container[shard]);
+		if (hashmap->count == 0)
+			continue;
+
+		auto entries = D_RO(hashmap->entries);
+		for (; pos < hashmap->capacity; ++pos) {
+			if (!internal::robinhood::entry_is_empty(entries[pos].hash)) {
+				this->pos = pos;
+				return true;
+			}
+		}
+	}
+
+	unlock();
+
+	return false;
+}
+
+status robinhood::robinhood_iterator<true>::seek(string_view key)
+{
+	init_seek();
+	unlock();
+
+	if (key.size() != ENTRY_SIZE)
+		return status::INVALID_ARGUMENT;
+
+	auto k = *reinterpret_cast<const uint64_t *>(key.data());
+
+	lock(engine->shard_hash(k));
+	pos = internal::robinhood::index_lookup(D_RO(engine->container[shard]), k);
+	if (pos == 0) {
+		unlock();
+		return status::NOT_FOUND;
+	}
+
+	return status::OK;
+}
+
+status robinhood::robinhood_iterator<true>::seek_to_first()
+{
+	init_seek();
+	unlock();
+
+	return find_from(0, 1) ? status::OK : status::NOT_FOUND;
+}
+
+/*
+ * Following shards are checked under their shared locks, taken (in order of
+ * shards) while the current shard is still locked.
+ */
+status robinhood::robinhood_iterator<true>::is_next()
+{
+	if (pos == 0)
+		return status::NOT_FOUND;
+
+	auto hashmap = D_RO(engine->container[shard]);
+	auto entries = D_RO(hashmap->entries);
+	for (uint64_t p = pos + 1; p < hashmap->capacity; ++p) {
+		if (!internal::robinhood::entry_is_empty(entries[p].hash))
+			return status::OK;
+	}
+
+	for (size_t s = shard + 1; s < engine->shards_number; ++s) {
+		shared_lock_type lock(engine->mtxs[s]);
+		if (D_RO(engine->container[s])->count > 0)
+			return status::OK;
+	}
+
+	return status::NOT_FOUND;
+}
+
+status robinhood::robinhood_iterator<true>::next()
+{
+	init_seek();
+
+	if (pos == 0)
+		return status::NOT_FOUND;
+
+	return find_from(shard, pos + 1) ? status::OK : status::NOT_FOUND;
+}
+
+result<string_view> robinhood::robinhood_iterator<true>::key()
+{
+	auto entry_p = current();
+
+	return {string_view(reinterpret_cast<const char *>(&entry_p->key), ENTRY_SIZE)};
+}
+
+result<pmem::obj::slice<const char *>>
+robinhood::robinhood_iterator<true>::read_range(size_t pos, size_t n)
+{
+	auto value = reinterpret_cast<const char *>(&current()->value);
+	if (pos + n > ENTRY_SIZE || pos + n < pos)
+		n = ENTRY_SIZE - pos;
+
+	return {{value + pos, value + pos + n}};
+}
+
+result<pmem::obj::slice<char *>>
+robinhood::robinhood_iterator<false>::write_range(size_t pos, size_t n)
+{
+	auto value = reinterpret_cast<const char *>(&current()->value);
+	if (pos + n > ENTRY_SIZE || pos + n < pos)
+		n = ENTRY_SIZE - pos;
+
+	log.push_back({std::string(value + pos, n), pos});
+	auto &val = log.back().first;
+
+	return {{&val[0], &val[0] + n}};
+}
+
+status robinhood::robinhood_iterator<false>::commit()
+{
+	auto entry_p = current();
+
+	uint64_t value = entry_p->value;
+	for (auto &p : log)
+		std::memcpy(reinterpret_cast<char *>(&value) + p.second, p.first.data(),
+			    p.first.size());
+	log.clear();
+
+	struct pobj_action actv;
+	pmemobj_set_value(engine->pmpool.handle(), &actv, &entry_p->value, value);
+	pmemobj_publish(engine->pmpool.handle(), &actv, 1);
+
+	return status::OK;
+}
+
+void robinhood::robinhood_iterator<false>::abort()
+{
+	log.clear();
+}
+
 static factory_registerer register_robinhood(
 	std::unique_ptr<engine_base::factory_base>(new robinhood_factory));
 
@@ -14,6 +14,7 @@
 #include <libpmemobj++/persistent_ptr.hpp>
 
 #include "../comparator/pmemobj_comparator.h"
+#include "../iterator.h"
 #include "../pmemobj_engine.h"
 
 namespace pmem
@@ -110,10 +111,13 @@ public:
 	robinhood &operator=(const robinhood &) = delete;
 
 	std::string name() final;
+	bool concurrent() const final;
 
 	status count_all(std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
 
 	status exists(string_view key) final;
 
@@ -123,7 +127,13 @@ public:
 
 	status remove(string_view key) final;
 
+	internal::iterator_base *new_iterator() final;
+	internal::iterator_base *new_const_iterator() final;
+
 private:
+	template <bool IsConst>
+	class robinhood_iterator;
+
 	using container_type = internal::robinhood::map_type;
 	using mutex_type = std::shared_timed_mutex;
 	using unique_lock_type = std::unique_lock<mutex_type>;
@@ -140,6 +150,65 @@ private:
 	size_t shards_number;
 };
 
+/*
+ * Iterator walks shards in order and entries of each shard in order of their
+ * positions, so the order of keys is not specified. Only the shard of the current
+ * entry is locked (shared by read iterators, exclusive by write iterators), so
+ * other shards can be modified during a scan - every key which is not removed
+ * meanwhile is visited exactly once. Current shard is locked until the iterator
+ * moves to another one, hence its owner must not modify that shard.
+ */
+template <>
+class robinhood::robinhood_iterator<true> : public internal::iterator_base {
+public:
+	robinhood_iterator(robinhood *engine, bool exclusive = false);
+	~robinhood_iterator();
+
+	status seek(string_view key) final;
+
+	status seek_to_first() final;
+
+	status is_next() final;
+	status next() final;
+
+	result<string_view> key() final;
+
+	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+
+protected:
+	internal::robinhood::entry *current();
+
+	void lock(size_t shard);
+	void unlock();
+	/* moves to the first entry at or after given position, locking its shard */
+	bool find_from(size_t shard, uint64_t pos);
+
+	robinhood *engine;
+	bool exclusive;
+	bool locked = false;
+	size_t shard = 0;
+	/* position of the current entry in its shard, 0 (never used) if there is none */
+	uint64_t pos = 0;
+};
+
+/*
+ * Values are 8 bytes long, so a commit of modified value is published with a single
+ * pmemobj action (redo log), without an undo log transaction.
+ */
+template <>
+class robinhood::robinhood_iterator<false> : public robinhood::robinhood_iterator<true> {
+public:
+	robinhood_iterator(robinhood *engine);
+
+	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
+
+	status commit() final;
+	void abort() final;
+
+private:
+	std::vector<std::pair<std::string, size_t>> log;
+};
+
 class robinhood_factory : public engine_base::factory_base {
 public:
 	std::unique_ptr<engine_base>
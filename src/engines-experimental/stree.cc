@@ -1,13 +1,16 @@
 // SPDX-License-Identifier: BSD-3-Clause
 /* Copyright 2017-2021, Intel Corporation */
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <unistd.h>
 
 #include <libpmemobj++/make_persistent_atomic.hpp>
 #include <libpmemobj++/transaction.hpp>
 
 #include "../out.h"
+#include "../parallel.h"
 #include "stree.h"
 
 using pmem::detail::conditional_add_to_tx;
@@ -20,8 +23,29 @@ namespace kv
 {
 
 stree::stree(std::unique_ptr<internal::config> cfg)
-    : pmemobj_engine_base(cfg, "pmemkv_stree"), config(std::move(cfg))
+    : pmemobj_engine_base(cfg, "pmemkv_stree"), config(std::move(cfg)), open_iterators(0)
 {
+	/*
+	 * Reads of the tree are not synchronized with writes, so expired keys
+	 * are erased by writes and reads (on the caller's thread), not by a
+	 * reaper thread.
+	 */
+	tracker.reset(new internal::expiry_tracker(
+		[this](string_view key) {
+			expire_key(key, [&] {
+				return tracker->erase_expired(key, [&] {
+					std::unique_lock<std::mutex> lock(snapshots_mtx);
+					preserve(key);
+					invalidate_sizes(key);
+					transaction::run(pmpool, [&] {
+						my_btree->erase(key);
+						expiry_index->erase(key);
+					});
+				});
+			});
+		},
+		false));
+
 	Recover();
 	LOG("Started ok");
 }
@@ -36,12 +60,19 @@ std::string stree::name()
 	return "stree";
 }
 
+void stree::set_expire_hook(expire_hook hook)
+{
+	engine_base::set_expire_hook(std::move(hook));
+	tracker->start();
+}
+
 status stree::count_all(std::size_t &cnt)
 {
 	LOG("count_all");
 	check_outside_tx();
+	auto expired = reap_expired();
 
-	cnt = my_btree->size();
+	cnt = my_btree->size() - count_expired(expired, [](string_view) { return true; });
 
 	return status::OK;
 }
@@ -55,16 +86,104 @@ static std::size_t size(It first, It last)
 	return static_cast<std::size_t>(dist);
 }
 
+struct skipping_callback_arg {
+	const std::unordered_set<std::string> *skip;
+	get_kv_callback *callback;
+	void *arg;
+};
+
+static int skipping_callback(const char *k, size_t kb, const char *v, size_t vb,
+			     void *arg)
+{
+	auto c = static_cast<skipping_callback_arg *>(arg);
+	if (c->skip->count(std::string(k, kb)))
+		return 0;
+
+	return c->callback(k, kb, v, vb, c->arg);
+}
+
+/*
+ * Reads are not run concurrently with writes, so they also remove expired keys
+ * (as writes do) - except when an iterator is open, whose position could be
+ * removed. Keys expired within the current tick of the tracker are left for
+ * later, reads skip them.
+ */
+std::unordered_set<std::string> stree::reap_expired()
+{
+	if (!tracker->active())
+		return {};
+
+	if (open_iterators.load() == 0)
+		tracker->expire_due();
+
+	return tracker->expired_keys();
+}
+
+template <typename Pred>
+std::size_t stree::count_expired(const std::unordered_set<std::string> &expired,
+				 Pred &&in_range)
+{
+	std::size_t cnt = 0;
+	for (auto &key : expired) {
+		string_view k(key);
+		if (in_range(k) && my_btree->find(k) != my_btree->end())
+			cnt++;
+	}
+
+	return cnt;
+}
+
+template <typename Scan>
+status stree::scan_skipping(const std::unordered_set<std::string> &expired,
+			    get_kv_callback *callback, void *arg, Scan &&scan)
+{
+	if (expired.empty())
+		return scan(callback, arg);
+
+	skipping_callback_arg c{&expired, callback, arg};
+	return scan(&skipping_callback, &c);
+}
+
+/*
+ * Counts entries from key1 (or the first one) to key2 (or the end) by their
+ * ranks, see b_tree_base::rank. The lock guards subtree_sizes, which are also
+ * used by readers of snapshots.
+ */
+std::size_t stree::count_ranked(const string_view *key1, bool inclusive1,
+				const string_view *key2, bool inclusive2)
+{
+	assert(use_subtree_sizes);
+	std::unique_lock<std::mutex> lock(snapshots_mtx);
+
+	auto last = key2 ? my_btree->rank(*key2, inclusive2, subtree_sizes)
+			 : my_btree->size();
+	auto first = key1 ? my_btree->rank(*key1, !inclusive1, subtree_sizes) : 0;
+
+	return last - first;
+}
+
+void stree::invalidate_sizes(string_view key)
+{
+	my_btree->invalidate_sizes(key, subtree_sizes);
+}
+
 /* above key, key exclusive */
 status stree::count_above(string_view key, std::size_t &cnt)
 {
 	LOG("count_above key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto expired = reap_expired();
 
-	auto first = my_btree->upper_bound(key);
-	auto last = my_btree->end();
+	if (use_subtree_sizes) {
+		cnt = count_ranked(&key, false, nullptr, false);
+	} else {
+		auto first = my_btree->upper_bound(key);
+		auto last = my_btree->end();
 
-	cnt = size(first, last);
+		cnt = size(first, last);
+	}
+	cnt -= count_expired(expired,
+			     [&](string_view k) { return my_btree->key_comp()(key, k); });
 
 	return status::OK;
 }
@@ -74,11 +193,18 @@ status stree::count_equal_above(string_view key, std::size_t &cnt)
 {
 	LOG("count_equal_above key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto expired = reap_expired();
 
-	auto first = my_btree->lower_bound(key);
-	auto last = my_btree->end();
+	if (use_subtree_sizes) {
+		cnt = count_ranked(&key, true, nullptr, false);
+	} else {
+		auto first = my_btree->lower_bound(key);
+		auto last = my_btree->end();
 
-	cnt = size(first, last);
+		cnt = size(first, last);
+	}
+	cnt -= count_expired(expired,
+			     [&](string_view k) { return !my_btree->key_comp()(k, key); });
 
 	return status::OK;
 }
@@ -88,11 +214,18 @@ status stree::count_below(string_view key, std::size_t &cnt)
 {
 	LOG("count_below key<" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto expired = reap_expired();
 
-	auto first = my_btree->begin();
-	auto last = my_btree->lower_bound(key);
+	if (use_subtree_sizes) {
+		cnt = count_ranked(nullptr, true, &key, false);
+	} else {
+		auto first = my_btree->begin();
+		auto last = my_btree->lower_bound(key);
 
-	cnt = size(first, last);
+		cnt = size(first, last);
+	}
+	cnt -= count_expired(expired,
+			     [&](string_view k) { return my_btree->key_comp()(k, key); });
 
 	return status::OK;
 }
@@ -102,11 +235,18 @@ status stree::count_equal_below(string_view key, std::size_t &cnt)
 {
 	LOG("count_equal_below key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto expired = reap_expired();
 
-	auto first = my_btree->begin();
-	auto last = my_btree->upper_bound(key);
+	if (use_subtree_sizes) {
+		cnt = count_ranked(nullptr, true, &key, true);
+	} else {
+		auto first = my_btree->begin();
+		auto last = my_btree->upper_bound(key);
 
-	cnt = size(first, last);
+		cnt = size(first, last);
+	}
+	cnt -= count_expired(expired,
+			     [&](string_view k) { return !my_btree->key_comp()(key, k); });
 
 	return status::OK;
 }
@@ -116,15 +256,43 @@ status stree::count_between(string_view key1, string_view key2, std::size_t &cnt
 	LOG("count_between key range=[" << std::string(key1.data(), key1.size()) << ","
 					<< std::string(key2.data(), key2.size()) << ")");
 	check_outside_tx();
+	auto expired = reap_expired();
+
+	if (!my_btree->key_comp()(key1, key2)) {
+		cnt = 0;
+		return status::OK;
+	}
 
-	if (my_btree->key_comp()(key1, key2)) {
+	if (use_subtree_sizes) {
+		cnt = count_ranked(&key1, false, &key2, false);
+	} else {
 		auto first = my_btree->upper_bound(key1);
 		auto last = my_btree->lower_bound(key2);
 
 		cnt = size(first, last);
-	} else {
-		cnt = 0;
 	}
+	cnt -= count_expired(expired, [&](string_view k) {
+		return my_btree->key_comp()(key1, k) && my_btree->key_comp()(k, key2);
+	});
+
+	return status::OK;
+}
+
+/* keys starting with prefix, bounded scan from the prefix lower bound */
+status stree::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(my_btree->key_comp());
+	auto expired = reap_expired();
+
+	auto first = my_btree->lower_bound(prefix);
+	auto last = my_btree->end();
+
+	cnt = internal::prefix_distance(first, last, prefix) -
+		count_expired(expired, [&](string_view k) {
+			return internal::has_prefix(k, prefix);
+		});
 
 	return status::OK;
 }
@@ -134,10 +302,14 @@ status stree::get_all(get_kv_callback *callback, void *arg)
 	LOG("get_all");
 	check_outside_tx();
 
-	auto first = my_btree->begin();
-	auto last = my_btree->end();
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->end();
 
-	return internal::iterate_through_pairs(first, last, callback, arg);
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
 }
 
 /* (key, end), above key */
@@ -146,10 +318,14 @@ status stree::get_above(string_view key, get_kv_callback *callback, void *arg)
 	LOG("get_above start key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
-	auto first = my_btree->upper_bound(key);
-	auto last = my_btree->end();
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->upper_bound(key);
+				     auto last = my_btree->end();
 
-	return internal::iterate_through_pairs(first, last, callback, arg);
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
 }
 
 /* [key, end), above or equal to key */
@@ -158,10 +334,14 @@ status stree::get_equal_above(string_view key, get_kv_callback *callback, void *
 	LOG("get_equal_above start key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
-	auto first = my_btree->lower_bound(key);
-	auto last = my_btree->end();
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->lower_bound(key);
+				     auto last = my_btree->end();
 
-	return internal::iterate_through_pairs(first, last, callback, arg);
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
 }
 
 /* [start, key], below or equal to key */
@@ -170,10 +350,14 @@ status stree::get_equal_below(string_view key, get_kv_callback *callback, void *
 	LOG("get_equal_below start key>=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
-	auto first = my_btree->begin();
-	auto last = my_btree->upper_bound(key);
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->upper_bound(key);
 
-	return internal::iterate_through_pairs(first, last, callback, arg);
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
 }
 
 /* [start, key), less than key, key exclusive */
@@ -182,10 +366,14 @@ status stree::get_below(string_view key, get_kv_callback *callback, void *arg)
 	LOG("get_below key<" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
-	auto first = my_btree->begin();
-	auto last = my_btree->lower_bound(key);
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->lower_bound(key);
 
-	return internal::iterate_through_pairs(first, last, callback, arg);
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
 }
 
 /* get between (key1, key2), key1 exclusive, key2 exclusive */
@@ -196,12 +384,169 @@ status stree::get_between(string_view key1, string_view key2, get_kv_callback *c
 				      << std::string(key2.data(), key2.size()) << ")");
 	check_outside_tx();
 
-	if (my_btree->key_comp()(key1, key2)) {
-		auto first = my_btree->upper_bound(key1);
-		auto last = my_btree->lower_bound(key2);
+	if (!my_btree->key_comp()(key1, key2))
+		return status::OK;
 
-		return internal::iterate_through_pairs(first, last, callback, arg);
-	}
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->upper_bound(key1);
+				     auto last = my_btree->lower_bound(key2);
+
+				     return internal::iterate_through_pairs(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+status stree::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+	check_outside_tx();
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->end();
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+/* (key, end), above key, from the last one - leaves are walked by prev links */
+status stree::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above_desc start key>=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->upper_bound(key);
+				     auto last = my_btree->end();
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+/* [key, end), above or equal to key, from the last one */
+status stree::get_equal_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc start key>=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->lower_bound(key);
+				     auto last = my_btree->end();
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+/* [start, key], below or equal to key, from key down */
+status stree::get_equal_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc start key<=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->upper_bound(key);
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+/* [start, key), less than key, from key down */
+status stree::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below_desc key<" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->begin();
+				     auto last = my_btree->lower_bound(key);
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+/* (key1, key2), both exclusive, from key2 down */
+status stree::get_between_desc(string_view key1, string_view key2,
+			       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc key range=[" << std::string(key1.data(), key1.size())
+					   << "," << std::string(key2.data(), key2.size())
+					   << ")");
+	check_outside_tx();
+
+	if (!my_btree->key_comp()(key1, key2))
+		return status::OK;
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->upper_bound(key1);
+				     auto last = my_btree->lower_bound(key2);
+
+				     return internal::iterate_through_pairs_desc(
+					     first, last, cb, cb_arg);
+			     });
+}
+
+status stree::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(my_btree->key_comp());
+
+	return scan_skipping(reap_expired(), callback, arg,
+			     [&](get_kv_callback *cb, void *cb_arg) {
+				     auto first = my_btree->lower_bound(prefix);
+				     auto last = my_btree->end();
+
+				     return internal::iterate_through_prefix(
+					     first, last, prefix, cb, cb_arg);
+			     });
+}
+
+/* partitions are key ranges bounded by keys taken from inner nodes */
+status stree::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+			       void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+	check_outside_tx();
+
+	return scan_skipping(
+		reap_expired(), callback, arg, [&](get_kv_callback *cb, void *cb_arg) {
+			std::vector<internal::stree::btree_type::iterator> bounds;
+			bounds.push_back(my_btree->begin());
+			for (auto key : my_btree->split_keys(num_partitions))
+				bounds.push_back(my_btree->lower_bound(*key));
+			bounds.push_back(my_btree->end());
+
+			return internal::parallel_scan(
+				bounds.size() - 1, cb, cb_arg,
+				[&](std::size_t i, get_kv_callback *part_cb,
+				    void *part_arg) {
+					internal::iterate_through_pairs(
+						bounds[i], bounds[i + 1], part_cb,
+						part_arg);
+				});
+		});
+}
+
+status stree::split_points(std::size_t n, get_v_callback *callback, void *arg)
+{
+	LOG("split_points n=" << n);
+	check_outside_tx();
+
+	for (auto key : my_btree->split_keys(n))
+		callback(key->c_str(), key->size(), arg);
 
 	return status::OK;
 }
@@ -211,6 +556,11 @@ status stree::exists(string_view key)
 	LOG("exists for key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
+	if (tracker->expired(key)) {
+		LOG("  key expired");
+		return status::NOT_FOUND;
+	}
+
 	internal::stree::btree_type::iterator it = my_btree->find(key);
 	if (it == my_btree->end()) {
 		LOG("  key not found");
@@ -224,6 +574,11 @@ status stree::get(string_view key, get_v_callback *callback, void *arg)
 	LOG("get using callback for key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
+	if (tracker->expired(key)) {
+		LOG("  key expired");
+		return status::NOT_FOUND;
+	}
+
 	internal::stree::btree_type::iterator it = my_btree->find(key);
 	if (it == my_btree->end()) {
 		LOG("  key not found");
@@ -234,19 +589,98 @@ status stree::get(string_view key, get_v_callback *callback, void *arg)
 	return status::OK;
 }
 
-status stree::put(string_view key, string_view value)
+status stree::get_ref(string_view key, std::unique_ptr<internal::value_ref_base> &ref)
 {
-	LOG("put key=" << std::string(key.data(), key.size())
-		       << ", value.size=" << std::to_string(value.size()));
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
 
-	auto result = my_btree->try_emplace(key, value);
+	if (tracker->expired(key)) {
+		LOG("  key expired");
+		return status::NOT_FOUND;
+	}
+
+	internal::stree::btree_type::iterator it = my_btree->find(key);
+	if (it == my_btree->end()) {
+		LOG("  key not found");
+		return status::NOT_FOUND;
+	}
+
+	ref.reset(new internal::value_ref_base(
+		string_view(it->second.c_str(), it->second.size())));
+	return status::OK;
+}
+
+static void insert_or_assign(pmem::obj::pool_base &pop,
+			     internal::stree::btree_type *tree, string_view key,
+			     string_view value)
+{
+	auto result = tree->try_emplace(key, value);
 	if (!result.second) { // key already exists, so update
 		typename internal::stree::btree_type::value_type &entry = *result.first;
-		transaction::manual tx(pmpool);
+		transaction::manual tx(pop);
 		entry.second = value;
 		transaction::commit();
 	}
+}
+
+status stree::put(string_view key, string_view value)
+{
+	LOG("put key=" << std::string(key.data(), key.size())
+		       << ", value.size=" << std::to_string(value.size()));
+	check_outside_tx();
+	tracker->expire_due();
+
+	if (!tracker->active()) {
+		std::unique_lock<std::mutex> lock(snapshots_mtx);
+		preserve(key);
+		invalidate_sizes(key);
+		insert_or_assign(pmpool, my_btree, key, value);
+		return status::OK;
+	}
+
+	/* the value and its deadline are changed in a single transaction */
+	auto lock = tracker->lock_key(key);
+	std::unique_lock<std::mutex> snapshots_lock(snapshots_mtx);
+	preserve(key);
+	invalidate_sizes(key);
+	transaction::run(pmpool, [&] {
+		insert_or_assign(pmpool, my_btree, key, value);
+		expiry_index->erase(key);
+	});
+	tracker->clear(key);
+
+	return status::OK;
+}
+
+status stree::put_with_ttl(string_view key, string_view value, uint64_t ttl_ms)
+{
+	LOG("put_with_ttl key=" << std::string(key.data(), key.size())
+				<< ", value.size=" << std::to_string(value.size())
+				<< ", ttl_ms=" << ttl_ms);
+	check_outside_tx();
+	tracker->expire_due();
+
+	if (ttl_ms == 0)
+		throw internal::invalid_argument("TTL must be greater than 0");
+	if (!expiry_oid)
+		throw internal::not_supported(
+			"Expiring keys are supported only in db opened with \"path\"");
+
+	create_expiry_index();
+
+	auto deadline = internal::expiry_tracker::deadline(ttl_ms);
+	auto encoded = internal::expiry_tracker::encode(deadline);
+	auto lock = tracker->lock_key(key);
+	std::unique_lock<std::mutex> snapshots_lock(snapshots_mtx);
+	preserve(key);
+	invalidate_sizes(key);
+	transaction::run(pmpool, [&] {
+		insert_or_assign(pmpool, expiry_index, key,
+				 string_view(encoded.data(), encoded.size()));
+		insert_or_assign(pmpool, my_btree, key, value);
+	});
+	tracker->set(key, deadline);
+
 	return status::OK;
 }
 
@@ -254,13 +688,218 @@ status stree::remove(string_view key)
 {
 	LOG("remove key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	tracker->expire_due();
+
+	if (!tracker->active()) {
+		std::unique_lock<std::mutex> lock(snapshots_mtx);
+		preserve(key);
+		invalidate_sizes(key);
+		auto result = my_btree->erase(key);
+		return (result == 1) ? status::OK : status::NOT_FOUND;
+	}
+
+	auto lock = tracker->lock_key(key);
+	std::unique_lock<std::mutex> snapshots_lock(snapshots_mtx);
+	preserve(key);
+	invalidate_sizes(key);
+	bool expired = tracker->expired(key);
+	size_t result = 0;
+	transaction::run(pmpool, [&] {
+		result = my_btree->erase(key);
+		expiry_index->erase(key);
+	});
+	tracker->clear(key);
+
+	return (result == 1 && !expired) ? status::OK : status::NOT_FOUND;
+}
+
+/*
+ * Erases keys from 'from' on while in_range holds. Leaves are emptied at once
+ * and freed (see b_tree_base::erase_range) in transactions of a few leaves,
+ * so the range is not removed atomically: after a crash some of it may remain.
+ * Deadlines of erased expiring keys are dropped afterwards.
+ */
+template <typename Pred>
+void stree::erase_range(string_view from, Pred &&in_range)
+{
+	using entry_type = internal::stree::btree_type::value_type;
+	const size_t leaves_per_tx = internal::stree::ERASE_LEAVES_PER_TX;
+
+	std::unique_lock<std::mutex> lock(snapshots_mtx);
+	auto preserve_entry = [&](const entry_type &e) {
+		preserve(string_view(e.first.c_str(), e.first.size()), &e.second);
+	};
+	/* sizes of all subtrees with erased leaves would have to be dropped */
+	subtree_sizes.clear();
+	my_btree->erase_range(from, in_range, preserve_entry, leaves_per_tx);
+
+	if (!tracker->active())
+		return;
+
+	/* erased keys are not expired by expire_due afterwards */
+	std::vector<std::string> expiring;
+	auto collect = [&](const entry_type &e) {
+		expiring.emplace_back(e.first.c_str(), e.first.size());
+	};
+	expiry_index->erase_range(from, in_range, collect, leaves_per_tx);
+	for (auto &key : expiring)
+		tracker->clear(key);
+}
+
+status stree::remove_range(string_view key1, string_view key2)
+{
+	LOG("remove_range key1=" << std::string(key1.data(), key1.size())
+				 << ", key2=" << std::string(key2.data(), key2.size()));
+	check_outside_tx();
+	tracker->expire_due();
+
+	auto &cmp = my_btree->key_comp();
+	if (cmp(key1, key2))
+		erase_range(key1, [&](const internal::stree::key_type &key) {
+			return cmp(key, key2);
+		});
+
+	return status::OK;
+}
+
+status stree::remove_prefix(string_view prefix)
+{
+	LOG("remove_prefix prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+	internal::check_prefix_support(my_btree->key_comp());
+	tracker->expire_due();
+
+	erase_range(prefix, [&](const internal::stree::key_type &key) {
+		return internal::has_prefix(string_view(key.c_str(), key.size()), prefix);
+	});
+
+	return status::OK;
+}
+
+status stree::bulk_load(bulk_load_callback *callback, void *arg)
+{
+	LOG("bulk_load");
+	check_outside_tx();
+	tracker->expire_due();
+
+	uint64_t fill_factor = 100;
+	config->get_uint64("bulk_load_fill_factor", &fill_factor);
+	if (fill_factor == 0 || fill_factor > 100)
+		throw internal::invalid_argument(
+			"Config item \"bulk_load_fill_factor\" must be in range [1, 100]");
+
+	auto source = [&](string_view &key, string_view &value) {
+		const char *k, *v;
+		size_t kb, vb;
+		if (callback(&k, &kb, &v, &vb, arg) != 0)
+			return false;
+		key = string_view(k, kb);
+		value = string_view(v, vb);
+		return true;
+	};
+
+	bool sorted = true;
+	if (my_btree->size() == 0) {
+		/*
+		 * Build leaves left to right, appending them to the tree. Entries of
+		 * a leaf are copied to DRAM first, so the source is called outside
+		 * of transactions and locks.
+		 */
+		const size_t capacity = internal::stree::DEGREE - 1;
+		size_t leaf_fill = std::max<size_t>(capacity * fill_factor / 100, 1);
+		std::vector<std::pair<std::string, std::string>> batch;
+		batch.reserve(leaf_fill);
+
+		string_view key, value;
+		bool has_next = source(key, value);
+		while (has_next && sorted) {
+			batch.clear();
+			do {
+				batch.emplace_back(std::string(key.data(), key.size()),
+						   std::string(value.data(), value.size()));
+				has_next = source(key, value);
+				sorted = !has_next ||
+					my_btree->key_comp()(batch.back().first, key);
+			} while (has_next && sorted && batch.size() < leaf_fill);
+
+			/* loaded keys were not present in the tree */
+			std::unique_lock<std::mutex> lock(snapshots_mtx);
+			for (auto &e : batch)
+				preserve(e.first, nullptr);
+			subtree_sizes.clear();
+			my_btree->append_leaf(batch.begin(), batch.end());
+		}
+	} else {
+		/* tree is not empty, keys have to be put one by one */
+		string_view key, value;
+		std::string last_key;
+		bool first = true;
+		while (source(key, value)) {
+			if (!first && !my_btree->key_comp()(last_key, key)) {
+				sorted = false;
+				break;
+			}
+			auto s = put(key, value);
+			if (s != status::OK)
+				return s;
+			last_key.assign(key.data(), key.size());
+			first = false;
+		}
+	}
+
+	if (!sorted)
+		throw internal::invalid_argument(
+			"Keys passed to bulk_load are not in strictly ascending order");
+
+	return status::OK;
+}
+
+status stree::defrag(double start_percent, double amount_percent)
+{
+	LOG("defrag: start_percent = " << start_percent
+				       << " amount_percent = " << amount_percent);
+	check_outside_tx();
+	tracker->expire_due();
+
+	/* data is not changed, but nodes are moved */
+	std::unique_lock<std::mutex> lock(snapshots_mtx);
+	subtree_sizes.clear();
+	try {
+		my_btree->defragment(start_percent, amount_percent);
+	} catch (std::range_error &e) {
+		out_err_stream("defrag") << e.what();
+		return status::INVALID_ARGUMENT;
+	} catch (pmem::defrag_error &e) {
+		out_err_stream("defrag") << e.what();
+		return status::DEFRAG_ERROR;
+	}
+
+	return status::OK;
+}
 
-	auto result = my_btree->erase(key);
-	return (result == 1) ? status::OK : status::NOT_FOUND;
+void stree::create_expiry_index()
+{
+	std::unique_lock<std::mutex> lock(expiry_index_mtx);
+	if (expiry_index)
+		return;
+
+	internal::stree::btree_type *index;
+	pmem::obj::transaction::run(pmpool, [&] {
+		pmem::obj::transaction::snapshot(expiry_oid);
+		*expiry_oid =
+			pmem::obj::make_persistent<internal::stree::btree_type>().raw();
+		index = (internal::stree::btree_type *)pmemobj_direct(*expiry_oid);
+		index->key_comp().initialize(internal::extract_comparator(*config));
+	});
+	expiry_index = index;
 }
 
 void stree::Recover()
 {
+	uint64_t sizes = 0;
+	config->get_uint64("subtree_sizes", &sizes);
+	use_subtree_sizes = sizes != 0;
+
 	if (!OID_IS_NULL(*root_oid)) {
 		my_btree = (internal::stree::btree_type *)pmemobj_direct(*root_oid);
 		my_btree->key_comp().runtime_initialize(
@@ -277,32 +916,83 @@ void stree::Recover()
 				internal::extract_comparator(*config));
 		});
 	}
+
+	/* rebuild the timer wheel from deadlines stored in the expiry index */
+	if (expiry_oid && !OID_IS_NULL(*expiry_oid)) {
+		expiry_index = (internal::stree::btree_type *)pmemobj_direct(*expiry_oid);
+		expiry_index->key_comp().runtime_initialize(
+			internal::extract_comparator(*config));
+		for (auto &e : *expiry_index)
+			tracker->set(string_view(e.first.c_str(), e.first.size()),
+				     internal::expiry_tracker::decode(string_view(
+					     e.second.c_str(), e.second.size())));
+	}
 }
 
 internal::iterator_base *stree::new_iterator()
 {
-	return new stree_iterator<false>{my_btree};
+	return new stree_iterator<false>{my_btree, tracker.get(), this};
 }
 
 internal::iterator_base *stree::new_const_iterator()
 {
-	return new stree_iterator<true>{my_btree};
+	return new stree_iterator<true>{my_btree, tracker.get(), this};
+}
+
+stree::stree_iterator<true>::stree_iterator(container_type *c,
+					  internal::expiry_tracker *t, stree *e)
+    : container(c), tracker(t), it_(nullptr), pop(pmem::obj::pool_by_vptr(c)), engine(e)
+{
+	engine->open_iterators++;
+}
+
+stree::stree_iterator<true>::~stree_iterator()
+{
+	engine->open_iterators--;
+}
+
+stree::stree_iterator<false>::stree_iterator(container_type *c,
+					   internal::expiry_tracker *t, stree *e)
+    : stree::stree_iterator<true>(c, t, e)
+{
+}
+
+bool stree::stree_iterator<true>::expired(container_type::iterator it)
+{
+	return tracker->active() &&
+		tracker->expired(string_view(it->first.c_str(), it->first.size()));
 }
 
-stree::stree_iterator<true>::stree_iterator(container_type *c)
-    : container(c), it_(nullptr), pop(pmem::obj::pool_by_vptr(c))
+/* moves forward from it_ to the first key which is not expired */
+status stree::stree_iterator<true>::skip_forward()
 {
+	while (it_ != container->end() && expired(it_))
+		++it_;
+
+	return it_ == container->end() ? status::NOT_FOUND : status::OK;
 }
 
-stree::stree_iterator<false>::stree_iterator(container_type *c)
-    : stree::stree_iterator<true>(c)
+/* moves backward from it_ (not the end) to the first key which is not expired */
+status stree::stree_iterator<true>::skip_backward()
 {
+	while (expired(it_)) {
+		if (it_ == container->begin()) {
+			it_ = container->end();
+			return status::NOT_FOUND;
+		}
+		--it_;
+	}
+
+	return status::OK;
 }
 
 status stree::stree_iterator<true>::seek(string_view key)
 {
 	init_seek();
 
+	if (tracker->expired(key))
+		return status::NOT_FOUND;
+
 	it_ = container->find(key);
 	if (it_ != container->end())
 		return status::OK;
@@ -322,7 +1012,7 @@ status stree::stree_iterator<true>::seek_lower(string_view key)
 
 	--it_;
 
-	return status::OK;
+	return skip_backward();
 }
 
 status stree::stree_iterator<true>::seek_lower_eq(string_view key)
@@ -337,7 +1027,7 @@ status stree::stree_iterator<true>::seek_lower_eq(string_view key)
 
 	--it_;
 
-	return status::OK;
+	return skip_backward();
 }
 
 status stree::stree_iterator<true>::seek_higher(string_view key)
@@ -345,10 +1035,8 @@ status stree::stree_iterator<true>::seek_higher(string_view key)
 	init_seek();
 
 	it_ = container->upper_bound(key);
-	if (it_ == container->end())
-		return status::NOT_FOUND;
 
-	return status::OK;
+	return skip_forward();
 }
 
 status stree::stree_iterator<true>::seek_higher_eq(string_view key)
@@ -356,10 +1044,14 @@ status stree::stree_iterator<true>::seek_higher_eq(string_view key)
 	init_seek();
 
 	it_ = container->lower_bound(key);
-	if (it_ == container->end())
-		return status::NOT_FOUND;
 
-	return status::OK;
+	return skip_forward();
+}
+
+status stree::stree_iterator<true>::seek_prefix(string_view prefix)
+{
+	internal::check_prefix_support(container->key_comp());
+	return iterator_base::seek_prefix(prefix);
 }
 
 status stree::stree_iterator<true>::seek_to_first()
@@ -371,7 +1063,7 @@ status stree::stree_iterator<true>::seek_to_first()
 
 	it_ = container->begin();
 
-	return status::OK;
+	return skip_forward();
 }
 
 status stree::stree_iterator<true>::seek_to_last()
@@ -384,36 +1076,43 @@ status stree::stree_iterator<true>::seek_to_last()
 	it_ = container->end();
 	--it_;
 
-	return status::OK;
+	return skip_backward();
 }
 
 status stree::stree_iterator<true>::is_next()
 {
 	auto tmp = it_;
-	if (tmp == container->end() || ++tmp == container->end())
+	if (tmp == container->end())
 		return status::NOT_FOUND;
 
-	return status::OK;
+	do
+		++tmp;
+	while (tmp != container->end() && expired(tmp));
+
+	return tmp == container->end() ? status::NOT_FOUND : status::OK;
 }
 
 status stree::stree_iterator<true>::next()
 {
 	init_seek();
 
-	if (it_ == container->end() || ++it_ == container->end())
+	if (it_ == container->end())
 		return status::NOT_FOUND;
 
-	return status::OK;
+	++it_;
+
+	return skip_forward();
 }
 
 status stree::stree_iterator<true>::prev()
 {
 	init_seek();
 
-	if (it_ == container->begin())
-		return status::NOT_FOUND;
-
-	--it_;
+	do {
+		if (it_ == container->begin())
+			return status::NOT_FOUND;
+		--it_;
+	} while (expired(it_));
 
 	return status::OK;
 }
@@ -436,6 +1135,33 @@ result<pmem::obj::slice<const char *>> stree::stree_iterator<true>::read_range(s
 	return {it_->second.crange(pos, n)};
 }
 
+/*
+ * Reads records straight from the container iterator - consecutive records
+ * are in the same leaf, so no lookup is needed between them.
+ */
+result<size_t> stree::stree_iterator<true>::next_batch(size_t n, const char **keys,
+						       size_t *kbs, const char **values,
+						       size_t *vbs)
+{
+	init_seek();
+
+	assert(it_ != container->end());
+
+	size_t count = 0;
+	for (auto it = it_; it != container->end() && count < n; ++it) {
+		if (expired(it))
+			continue;
+		keys[count] = it->first.cdata();
+		kbs[count] = it->first.size();
+		values[count] = it->second.cdata();
+		vbs[count] = it->second.size();
+		it_ = it;
+		++count;
+	}
+
+	return count;
+}
+
 result<pmem::obj::slice<char *>> stree::stree_iterator<false>::write_range(size_t pos,
 									   size_t n)
 {
@@ -452,6 +1178,9 @@ result<pmem::obj::slice<char *>> stree::stree_iterator<false>::write_range(size_
 
 status stree::stree_iterator<false>::commit()
 {
+	std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+	engine->preserve(string_view(it_->first.c_str(), it_->first.size()),
+			 &it_->second);
 	pmem::obj::transaction::run(pop, [&] {
 		for (auto &p : log) {
 			auto dest = it_->second.range(p.second, p.first.size());
@@ -468,6 +1197,700 @@ void stree::stree_iterator<false>::abort()
 	log.clear();
 }
 
+engine_base *stree::new_snapshot()
+{
+	return new stree_snapshot(this);
+}
+
+void stree::preserve(string_view key)
+{
+	if (snapshots.empty())
+		return;
+
+	auto it = my_btree->find(key);
+	preserve(key, it != my_btree->end() ? &it->second : nullptr);
+}
+
+void stree::preserve(string_view key, const internal::stree::value_type *value)
+{
+	if (snapshots.empty())
+		return;
+
+	std::string k(key.data(), key.size());
+	for (auto snapshot : snapshots) {
+		if (snapshot->preimages.count(k))
+			continue;
+
+		std::unique_ptr<std::string> preimage;
+		if (value)
+			preimage.reset(new std::string(value->c_str(), value->size()));
+		snapshot->preimages.emplace(k, std::move(preimage));
+	}
+}
+
+stree::stree_snapshot::stree_snapshot(stree *e)
+    : engine(e), state(e->my_btree->key_comp())
+{
+	std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+	engine->snapshots.push_back(&state);
+}
+
+stree::stree_snapshot::~stree_snapshot()
+{
+	std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+	auto &snapshots = engine->snapshots;
+	snapshots.erase(std::find(snapshots.begin(), snapshots.end(), &state));
+}
+
+std::string stree::stree_snapshot::name()
+{
+	return "stree";
+}
+
+bool stree::stree_snapshot::find(string_view key, entry &e)
+{
+	if (!state.preimages.empty()) {
+		auto p = state.preimages.find(std::string(key.data(), key.size()));
+		if (p != state.preimages.end()) {
+			if (!p->second)
+				return false;
+
+			e.first.assign(key.data(), key.size());
+			e.second = *p->second;
+			return true;
+		}
+	}
+
+	auto &tree = *engine->my_btree;
+	auto it = tree.find(key);
+	if (it == tree.end())
+		return false;
+
+	e.first.assign(key.data(), key.size());
+	e.second.assign(it->second.c_str(), it->second.size());
+	return true;
+}
+
+/*
+ * Merges entries of the tree, skipping keys which have pre-images, with
+ * pre-images of keys present in the snapshot.
+ */
+void stree::stree_snapshot::next_entries(const std::string *key, bool inclusive,
+					 size_t n, std::vector<entry> &entries)
+{
+	auto &tree = *engine->my_btree;
+	auto &preimages = state.preimages;
+
+	auto it = !key ? tree.begin()
+		       : (inclusive ? tree.lower_bound(*key) : tree.upper_bound(*key));
+	auto p = !key ? preimages.begin()
+		      : (inclusive ? preimages.lower_bound(*key)
+				   : preimages.upper_bound(*key));
+
+	/* q follows it over all pre-images, to find keys of the tree which have one */
+	auto q = p;
+	auto has_preimage = [&](const container_iterator &t) {
+		while (q != preimages.end() && tree.key_comp()(q->first, t->first))
+			++q;
+		return q != preimages.end() && !tree.key_comp()(t->first, q->first);
+	};
+
+	for (size_t i = 0; i < n; i++) {
+		while (it != tree.end() && has_preimage(it))
+			++it;
+		while (p != preimages.end() && !p->second)
+			++p;
+
+		if (it != tree.end() &&
+		    (p == preimages.end() || tree.key_comp()(it->first, p->first))) {
+			entries.emplace_back(
+				std::string(it->first.c_str(), it->first.size()),
+				std::string(it->second.c_str(), it->second.size()));
+			++it;
+		} else if (p != preimages.end()) {
+			entries.emplace_back(p->first, *p->second);
+			++p;
+		} else {
+			return;
+		}
+	}
+}
+
+/* Counterpart of next_entries, walks the tree and pre-images backwards. */
+void stree::stree_snapshot::prev_entries(const std::string *key, bool inclusive,
+					 size_t n, std::vector<entry> &entries)
+{
+	auto &tree = *engine->my_btree;
+	auto &preimages = state.preimages;
+
+	/* it and p point after the candidates */
+	auto it = !key ? tree.end()
+		       : (inclusive ? tree.upper_bound(*key) : tree.lower_bound(*key));
+	auto p = !key ? preimages.end()
+		      : (inclusive ? preimages.upper_bound(*key)
+				   : preimages.lower_bound(*key));
+
+	/* q follows it (backwards) over all pre-images, like in next_entries */
+	auto q = p;
+	auto has_preimage = [&](const container_iterator &t) {
+		while (q != preimages.begin() &&
+		       tree.key_comp()(t->first, std::prev(q)->first))
+			--q;
+		return q != preimages.begin() &&
+			!tree.key_comp()(std::prev(q)->first, t->first);
+	};
+
+	for (size_t i = 0; i < n; i++) {
+		auto prev = it;
+		while (it != tree.begin() && has_preimage(--prev))
+			it = prev;
+		while (p != preimages.begin() && !std::prev(p)->second)
+			--p;
+
+		bool in_tree = it != tree.begin();
+		bool in_preimages = p != preimages.begin();
+		if (in_tree && (!in_preimages ||
+				tree.key_comp()(std::prev(p)->first, prev->first))) {
+			entries.emplace_back(
+				std::string(prev->first.c_str(), prev->first.size()),
+				std::string(prev->second.c_str(), prev->second.size()));
+			it = prev;
+		} else if (in_preimages) {
+			--p;
+			entries.emplace_back(p->first, *p->second);
+		} else {
+			return;
+		}
+	}
+}
+
+/*
+ * Calls f for entries after (or at) the key - or before it, in descending order,
+ * if desc is set - until it returns non-zero value, which is then returned.
+ * Entries are copied in batches, so writers wait only for a batch to be copied,
+ * not for f.
+ */
+template <typename F>
+int stree::stree_snapshot::scan(const std::string *from, bool inclusive, bool desc,
+				F &&f)
+{
+	std::vector<entry> batch;
+	std::string last;
+
+	while (true) {
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+			if (desc)
+				prev_entries(from, inclusive, scan_batch, batch);
+			else
+				next_entries(from, inclusive, scan_batch, batch);
+		}
+
+		for (auto &e : batch) {
+			auto ret = f(e.first, e.second);
+			if (ret != 0)
+				return ret;
+		}
+
+		if (batch.size() < scan_batch)
+			return 0;
+
+		last = std::move(batch.back().first);
+		from = &last;
+		inclusive = false;
+	}
+}
+
+template <typename F>
+std::size_t stree::stree_snapshot::count(const std::string *from, bool inclusive,
+					 F &&in_range)
+{
+	std::size_t cnt = 0;
+	scan(from, inclusive, false, [&](const std::string &k, const std::string &) {
+		if (!in_range(k))
+			return 1;
+		cnt++;
+		return 0;
+	});
+
+	return cnt;
+}
+
+template <typename F>
+status stree::stree_snapshot::get_range(const std::string *from, bool inclusive,
+					bool desc, F &&in_range,
+					get_kv_callback *callback, void *arg)
+{
+	auto ret = scan(from, inclusive, desc, [&](const std::string &k,
+						   const std::string &v) {
+		if (!in_range(k))
+			return -1;
+		return callback(k.c_str(), k.size(), v.c_str(), v.size(), arg) != 0 ? 1
+										    : 0;
+	});
+
+	return ret > 0 ? status::STOPPED_BY_CB : status::OK;
+}
+
+/* pre-images replace entries of the tree */
+status stree::stree_snapshot::count_all(std::size_t &cnt)
+{
+	LOG("count_all");
+
+	std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+	auto &tree = *engine->my_btree;
+
+	cnt = tree.size();
+	for (auto &p : state.preimages) {
+		if (tree.find(p.first) != tree.end())
+			cnt--;
+		if (p.second)
+			cnt++;
+	}
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_above(string_view key, std::size_t &cnt)
+{
+	LOG("count_above key>=" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	cnt = count(&from, false, [](const std::string &) { return true; });
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_equal_above(string_view key, std::size_t &cnt)
+{
+	LOG("count_equal_above key>=" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	cnt = count(&from, true, [](const std::string &) { return true; });
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_equal_below(string_view key, std::size_t &cnt)
+{
+	LOG("count_equal_below key<=" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	cnt = count(nullptr, true,
+		    [&](const std::string &k) { return !cmp(key, k); });
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_below(string_view key, std::size_t &cnt)
+{
+	LOG("count_below key<" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	cnt = count(nullptr, true, [&](const std::string &k) { return cmp(k, key); });
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_between(string_view key1, string_view key2,
+					    std::size_t &cnt)
+{
+	LOG("count_between key range=[" << std::string(key1.data(), key1.size()) << ","
+					<< std::string(key2.data(), key2.size()) << ")");
+
+	auto &cmp = engine->my_btree->key_comp();
+	cnt = 0;
+	if (cmp(key1, key2)) {
+		std::string from(key1.data(), key1.size());
+		cnt = count(&from, false,
+			    [&](const std::string &k) { return cmp(k, key2); });
+	}
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix prefix=" << std::string(prefix.data(), prefix.size()));
+	internal::check_prefix_support(engine->my_btree->key_comp());
+
+	std::string from(prefix.data(), prefix.size());
+	cnt = count(&from, true, [&](const std::string &k) {
+		return internal::has_prefix(k, prefix);
+	});
+
+	return status::OK;
+}
+
+status stree::stree_snapshot::get_all(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all");
+
+	return get_range(
+		nullptr, true, false, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_above(string_view key, get_kv_callback *callback,
+					void *arg)
+{
+	LOG("get_above start key>=" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	return get_range(
+		&from, false, false, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_equal_above(string_view key,
+					      get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above start key>=" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	return get_range(
+		&from, true, false, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_equal_below(string_view key,
+					      get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below start key>=" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	return get_range(
+		nullptr, true, false, [&](const std::string &k) { return !cmp(key, k); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_below(string_view key, get_kv_callback *callback,
+					void *arg)
+{
+	LOG("get_below key<" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	return get_range(
+		nullptr, true, false, [&](const std::string &k) { return cmp(k, key); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_between(string_view key1, string_view key2,
+					  get_kv_callback *callback, void *arg)
+{
+	LOG("get_between key range=[" << std::string(key1.data(), key1.size()) << ","
+				      << std::string(key2.data(), key2.size()) << ")");
+
+	auto &cmp = engine->my_btree->key_comp();
+	if (!cmp(key1, key2))
+		return status::OK;
+
+	std::string from(key1.data(), key1.size());
+	return get_range(
+		&from, false, false, [&](const std::string &k) { return cmp(k, key2); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_prefix(string_view prefix, get_kv_callback *callback,
+					 void *arg)
+{
+	LOG("get_prefix prefix=" << std::string(prefix.data(), prefix.size()));
+	internal::check_prefix_support(engine->my_btree->key_comp());
+
+	std::string from(prefix.data(), prefix.size());
+	return get_range(
+		&from, true, false,
+		[&](const std::string &k) { return internal::has_prefix(k, prefix); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+
+	return get_range(
+		nullptr, true, true, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_above_desc(string_view key, get_kv_callback *callback,
+					     void *arg)
+{
+	LOG("get_above_desc start key>" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	return get_range(
+		nullptr, true, true, [&](const std::string &k) { return cmp(key, k); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_equal_above_desc(string_view key,
+						   get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc start key>=" << std::string(key.data(), key.size()));
+
+	auto &cmp = engine->my_btree->key_comp();
+	return get_range(
+		nullptr, true, true, [&](const std::string &k) { return !cmp(k, key); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::get_equal_below_desc(string_view key,
+						   get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc start key<=" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	return get_range(
+		&from, true, true, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_below_desc(string_view key, get_kv_callback *callback,
+					     void *arg)
+{
+	LOG("get_below_desc key<" << std::string(key.data(), key.size()));
+
+	std::string from(key.data(), key.size());
+	return get_range(
+		&from, false, true, [](const std::string &) { return true; }, callback,
+		arg);
+}
+
+status stree::stree_snapshot::get_between_desc(string_view key1, string_view key2,
+					       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc key range=[" << std::string(key1.data(), key1.size())
+					   << "," << std::string(key2.data(), key2.size())
+					   << ")");
+
+	auto &cmp = engine->my_btree->key_comp();
+	if (!cmp(key1, key2))
+		return status::OK;
+
+	std::string from(key2.data(), key2.size());
+	return get_range(
+		&from, false, true, [&](const std::string &k) { return cmp(key1, k); },
+		callback, arg);
+}
+
+status stree::stree_snapshot::exists(string_view key)
+{
+	LOG("exists for key=" << std::string(key.data(), key.size()));
+
+	entry e;
+	std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+	return find(key, e) ? status::OK : status::NOT_FOUND;
+}
+
+status stree::stree_snapshot::get(string_view key, get_v_callback *callback, void *arg)
+{
+	LOG("get using callback for key=" << std::string(key.data(), key.size()));
+
+	entry e;
+	{
+		std::unique_lock<std::mutex> lock(engine->snapshots_mtx);
+		if (!find(key, e))
+			return status::NOT_FOUND;
+	}
+
+	callback(e.second.c_str(), e.second.size(), arg);
+	return status::OK;
+}
+
+status stree::stree_snapshot::put(string_view key, string_view value)
+{
+	return status::NOT_SUPPORTED;
+}
+
+status stree::stree_snapshot::remove(string_view key)
+{
+	return status::NOT_SUPPORTED;
+}
+
+internal::iterator_base *stree::stree_snapshot::new_const_iterator()
+{
+	return new snapshot_iterator(this);
+}
+
+stree::snapshot_iterator::snapshot_iterator(stree_snapshot *s) : snapshot(s)
+{
+}
+
+status stree::snapshot_iterator::seek_next(const std::string *key, bool inclusive)
+{
+	init_seek();
+
+	batch.clear();
+	{
+		std::unique_lock<std::mutex> lock(snapshot->engine->snapshots_mtx);
+		snapshot->next_entries(key, inclusive, 1, batch);
+	}
+
+	valid = !batch.empty();
+	if (!valid)
+		return status::NOT_FOUND;
+
+	current = std::move(batch.back());
+	return status::OK;
+}
+
+status stree::snapshot_iterator::seek_prev(const std::string *key, bool inclusive)
+{
+	init_seek();
+
+	batch.clear();
+	{
+		std::unique_lock<std::mutex> lock(snapshot->engine->snapshots_mtx);
+		snapshot->prev_entries(key, inclusive, 1, batch);
+	}
+
+	valid = !batch.empty();
+	if (!valid)
+		return status::NOT_FOUND;
+
+	current = std::move(batch.back());
+	return status::OK;
+}
+
+status stree::snapshot_iterator::seek(string_view key)
+{
+	init_seek();
+
+	std::unique_lock<std::mutex> lock(snapshot->engine->snapshots_mtx);
+	valid = snapshot->find(key, current);
+
+	return valid ? status::OK : status::NOT_FOUND;
+}
+
+status stree::snapshot_iterator::seek_lower(string_view key)
+{
+	std::string k(key.data(), key.size());
+	valid = false;
+	return seek_prev(&k, false);
+}
+
+status stree::snapshot_iterator::seek_lower_eq(string_view key)
+{
+	std::string k(key.data(), key.size());
+	valid = false;
+	return seek_prev(&k, true);
+}
+
+status stree::snapshot_iterator::seek_higher(string_view key)
+{
+	std::string k(key.data(), key.size());
+	return seek_next(&k, false);
+}
+
+status stree::snapshot_iterator::seek_higher_eq(string_view key)
+{
+	std::string k(key.data(), key.size());
+	return seek_next(&k, true);
+}
+
+status stree::snapshot_iterator::seek_prefix(string_view prefix)
+{
+	internal::check_prefix_support(snapshot->engine->my_btree->key_comp());
+	return iterator_base::seek_prefix(prefix);
+}
+
+status stree::snapshot_iterator::seek_to_first()
+{
+	return seek_next(nullptr, true);
+}
+
+status stree::snapshot_iterator::seek_to_last()
+{
+	valid = false;
+	return seek_prev(nullptr, true);
+}
+
+status stree::snapshot_iterator::is_next()
+{
+	if (!valid)
+		return status::NOT_FOUND;
+
+	std::vector<stree_snapshot::entry> next;
+	std::unique_lock<std::mutex> lock(snapshot->engine->snapshots_mtx);
+	snapshot->next_entries(&current.first, false, 1, next);
+
+	return next.empty() ? status::NOT_FOUND : status::OK;
+}
+
+status stree::snapshot_iterator::next()
+{
+	if (!valid)
+		return status::NOT_FOUND;
+
+	auto key = current.first;
+	return seek_next(&key, false);
+}
+
+/* stays at the current entry if there is no previous one */
+status stree::snapshot_iterator::prev()
+{
+	if (!valid)
+		return status::NOT_FOUND;
+
+	auto key = current.first;
+	return seek_prev(&key, false);
+}
+
+result<string_view> stree::snapshot_iterator::key()
+{
+	if (!valid)
+		return status::NOT_FOUND;
+
+	return string_view(current.first.data(), current.first.size());
+}
+
+result<pmem::obj::slice<const char *>> stree::snapshot_iterator::read_range(size_t pos,
+									    size_t n)
+{
+	if (!valid)
+		return status::NOT_FOUND;
+
+	auto &value = current.second;
+	if (pos > value.size())
+		pos = value.size();
+	if (pos + n > value.size() || pos + n < pos)
+		n = value.size() - pos;
+
+	return pmem::obj::slice<const char *>(value.data() + pos, value.data() + pos + n);
+}
+
+/* records are copied in one go, they are valid until the next call */
+result<size_t> stree::snapshot_iterator::next_batch(size_t n, const char **keys,
+						    size_t *kbs, const char **values,
+						    size_t *vbs)
+{
+	init_seek();
+
+	if (!valid)
+		return status::NOT_FOUND;
+
+	batch.clear();
+	{
+		std::unique_lock<std::mutex> lock(snapshot->engine->snapshots_mtx);
+		snapshot->next_entries(&current.first, true, n, batch);
+	}
+
+	for (size_t i = 0; i < batch.size(); i++) {
+		keys[i] = batch[i].first.data();
+		kbs[i] = batch[i].first.size();
+		values[i] = batch[i].second.data();
+		vbs[i] = batch[i].second.size();
+	}
+
+	/* current entry could be removed from the tree, but not from the snapshot */
+	if (!batch.empty())
+		current = batch.back();
+
+	return batch.size();
+}
+
 static factory_registerer
 	register_stree(std::unique_ptr<engine_base::factory_base>(new stree_factory));
 
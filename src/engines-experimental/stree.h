@@ -8,7 +8,14 @@
 #include <libpmemobj++/make_persistent.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
 #include "../comparator/pmemobj_comparator.h"
+#include "../expiry.h"
 #include "../iterator.h"
 #include "../pmemobj_engine.h"
 #include "stree/persistent_b_tree.h"
@@ -37,6 +44,37 @@ using key_type = string_t;
 using value_type = string_t;
 using btree_type = b_tree<key_type, value_type, internal::pmemobj_compare, DEGREE>;
 
+/**
+ * Indicates the number of leaves erased in a single transaction by
+ * remove_range and remove_prefix.
+ */
+const size_t ERASE_LEAVES_PER_TX = 16;
+
+/* orders std::string keys as the tree does */
+struct key_less {
+	bool operator()(const std::string &lhs, const std::string &rhs) const
+	{
+		return (*cmp)(lhs, rhs);
+	}
+
+	const internal::pmemobj_compare *cmp;
+};
+
+/**
+ * Values of keys as they were when a snapshot was taken, copied on the first
+ * write to each key after that. Null value means the key was not present.
+ * There is one entry per key modified while the snapshot is open, so memory
+ * used by a long-lived snapshot grows with the number of modified keys.
+ */
+struct snapshot_state {
+	explicit snapshot_state(const internal::pmemobj_compare &cmp)
+	    : preimages(key_less{&cmp})
+	{
+	}
+
+	std::map<std::string, std::unique_ptr<std::string>, key_less> preimages;
+};
+
 } /* namespace stree */
 } /* namespace internal */
 
@@ -47,12 +85,16 @@ private:
 
 	template <bool IsConst>
 	class stree_iterator;
+	class stree_snapshot;
+	class snapshot_iterator;
 
 public:
 	stree(std::unique_ptr<internal::config> cfg);
 	~stree();
 
 	std::string name() final;
+	/* keys are expired (on writes and reads) only once the hook is set */
+	void set_expire_hook(expire_hook hook) final;
 
 	status count_all(std::size_t &cnt) final;
 	status count_above(string_view key, std::size_t &cnt) final;
@@ -60,6 +102,7 @@ public:
 	status count_equal_below(string_view key, std::size_t &cnt) final;
 	status count_below(string_view key, std::size_t &cnt) final;
 	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
 	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
@@ -70,21 +113,96 @@ public:
 	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
 	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
 			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
+	status split_points(std::size_t n, get_v_callback *callback, void *arg) final;
 	status exists(string_view key) final;
 	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key,
+		       std::unique_ptr<internal::value_ref_base> &ref) final;
 	status put(string_view key, string_view value) final;
+	status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms) final;
 	status remove(string_view key) final;
+	status remove_range(string_view key1, string_view key2) final;
+	status remove_prefix(string_view prefix) final;
+
+	status bulk_load(bulk_load_callback *callback, void *arg) final;
+
+	status defrag(double start_percent, double amount_percent) final;
 
 	internal::iterator_base *new_iterator() final;
 	internal::iterator_base *new_const_iterator() final;
 
+	engine_base *new_snapshot() final;
+
 private:
 	stree(const stree &);
 	void operator=(const stree &);
 	void Recover();
+	void create_expiry_index();
+
+	/*
+	 * Records the current value of the key in snapshots which have not
+	 * recorded it yet, snapshots_mtx has to be held.
+	 */
+	void preserve(string_view key);
+	void preserve(string_view key, const internal::stree::value_type *value);
+
+	template <typename Pred>
+	void erase_range(string_view from, Pred &&in_range);
+	/* requires use_subtree_sizes, null key1 is the first key, null key2 the end */
+	std::size_t count_ranked(const string_view *key1, bool inclusive1,
+				 const string_view *key2, bool inclusive2);
+	/* has to be called (with snapshots_mtx held) before the key is written */
+	void invalidate_sizes(string_view key);
+
+	/*
+	 * Removes keys whose deadlines have passed (unless an iterator is open)
+	 * and returns expired keys which are still in the tree.
+	 */
+	std::unordered_set<std::string> reap_expired();
+	/* number of keys from 'expired' which are in the tree and in_range */
+	template <typename Pred>
+	std::size_t count_expired(const std::unordered_set<std::string> &expired,
+				  Pred &&in_range);
+	/* calls scan(callback, arg), with keys from 'expired' filtered out */
+	template <typename Scan>
+	status scan_skipping(const std::unordered_set<std::string> &expired,
+			     get_kv_callback *callback, void *arg, Scan &&scan);
 
 	internal::stree::btree_type *my_btree;
+	/* key -> encoded deadline, nullptr until the first put_with_ttl */
+	internal::stree::btree_type *expiry_index = nullptr;
+	std::mutex expiry_index_mtx;
+	std::unique_ptr<internal::expiry_tracker> tracker;
 	std::unique_ptr<internal::config> config;
+
+	/* serializes writers with readers of snapshots */
+	std::mutex snapshots_mtx;
+	/*
+	 * Sizes of subtrees of my_btree used by counts ("subtree_sizes" config
+	 * item), computed on the first count after open, guarded by snapshots_mtx.
+	 */
+	bool use_subtree_sizes = false;
+	internal::stree::btree_type::subtree_sizes subtree_sizes;
+	std::vector<internal::stree::snapshot_state *> snapshots;
+
+	/* iterators keep positions in the tree, reads do not remove keys under them */
+	std::atomic<std::size_t> open_iterators;
 };
 
 template <>
@@ -92,13 +210,16 @@ class stree::stree_iterator<true> : public internal::iterator_base {
 	using container_type = stree::container_type;
 
 public:
-	stree_iterator(container_type *container);
+	stree_iterator(container_type *container, internal::expiry_tracker *tracker,
+		       stree *engine);
+	~stree_iterator();
 
 	status seek(string_view key) final;
 	status seek_lower(string_view key) final;
 	status seek_lower_eq(string_view key) final;
 	status seek_higher(string_view key) final;
 	status seek_higher_eq(string_view key) final;
+	status seek_prefix(string_view prefix) final;
 
 	status seek_to_first() final;
 	status seek_to_last() final;
@@ -110,11 +231,20 @@ public:
 	result<string_view> key() final;
 
 	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+	result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+				  const char **values, size_t *vbs) final;
 
 protected:
+	/* expired keys, not removed yet, are skipped */
+	bool expired(container_type::iterator it);
+	status skip_forward();
+	status skip_backward();
+
 	container_type *container;
+	internal::expiry_tracker *tracker;
 	container_type::iterator it_;
 	pmem::obj::pool_base pop;
+	stree *engine;
 };
 
 template <>
@@ -122,7 +252,8 @@ class stree::stree_iterator<false> : public stree::stree_iterator<true> {
 	using container_type = stree::container_type;
 
 public:
-	stree_iterator(container_type *container);
+	stree_iterator(container_type *container, internal::expiry_tracker *tracker,
+		       stree *engine);
 
 	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
 
@@ -133,6 +264,127 @@ private:
 	std::vector<std::pair<std::string, size_t>> log;
 };
 
+/**
+ * Read-only view of the tree at the time it was created. Reads go to the tree
+ * except for keys written since then, which are read from pre-images recorded
+ * by writers (see stree::preserve). Pre-images are freed with the snapshot.
+ *
+ * Expiring keys are seen as they are in the tree (as by range queries of
+ * the tree), regardless of their deadlines.
+ */
+class stree::stree_snapshot : public engine_base {
+public:
+	using entry = std::pair<std::string, std::string>;
+
+	stree_snapshot(stree *engine);
+	~stree_snapshot();
+
+	std::string name() final;
+
+	status count_all(std::size_t &cnt) final;
+	status count_above(string_view key, std::size_t &cnt) final;
+	status count_equal_above(string_view key, std::size_t &cnt) final;
+	status count_equal_below(string_view key, std::size_t &cnt) final;
+	status count_below(string_view key, std::size_t &cnt) final;
+	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
+
+	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_equal_above(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_equal_below(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
+			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
+
+	status exists(string_view key) final;
+	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status put(string_view key, string_view value) final;
+	status remove(string_view key) final;
+
+	internal::iterator_base *new_const_iterator() final;
+
+private:
+	friend class stree::snapshot_iterator;
+
+	/* number of entries copied at once by scans, with the lock held */
+	static constexpr size_t scan_batch = 256;
+
+	/* Functions below have to be called with engine->snapshots_mtx held. */
+	bool find(string_view key, entry &e);
+	/* Appends up to n entries after (or at, if inclusive) the key (or the first). */
+	void next_entries(const std::string *key, bool inclusive, size_t n,
+			  std::vector<entry> &entries);
+	/*
+	 * Appends up to n entries before (or at, if inclusive) the key (or the last),
+	 * in descending order.
+	 */
+	void prev_entries(const std::string *key, bool inclusive, size_t n,
+			  std::vector<entry> &entries);
+
+	template <typename F>
+	int scan(const std::string *from, bool inclusive, bool desc, F &&f);
+	template <typename F>
+	std::size_t count(const std::string *from, bool inclusive, F &&in_range);
+	template <typename F>
+	status get_range(const std::string *from, bool inclusive, bool desc,
+			 F &&in_range, get_kv_callback *callback, void *arg);
+
+	stree *engine;
+	internal::stree::snapshot_state state;
+};
+
+class stree::snapshot_iterator : public internal::iterator_base {
+public:
+	snapshot_iterator(stree_snapshot *snapshot);
+
+	status seek(string_view key) final;
+	status seek_lower(string_view key) final;
+	status seek_lower_eq(string_view key) final;
+	status seek_higher(string_view key) final;
+	status seek_higher_eq(string_view key) final;
+	status seek_prefix(string_view prefix) final;
+
+	status seek_to_first() final;
+	status seek_to_last() final;
+
+	status is_next() final;
+	status next() final;
+	status prev() final;
+
+	result<string_view> key() final;
+
+	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+	result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+				  const char **values, size_t *vbs) final;
+
+private:
+	status seek_next(const std::string *key, bool inclusive);
+	status seek_prev(const std::string *key, bool inclusive);
+
+	stree_snapshot *snapshot;
+	/* copy of the current entry, valid if 'valid' is set */
+	bool valid = false;
+	stree_snapshot::entry current;
+	/* entries returned by the last next_batch */
+	std::vector<stree_snapshot::entry> batch;
+};
+
 class stree_factory : public engine_base::factory_base {
 public:
 	std::unique_ptr<engine_base>
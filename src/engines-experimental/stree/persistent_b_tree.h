@@ -4,6 +4,7 @@
 #ifndef PERSISTENT_B_TREE
 #define PERSISTENT_B_TREE
 
+#include <libpmemobj++/defrag.hpp>
 #include <libpmemobj++/detail/common.hpp>
 #include <libpmemobj++/detail/life.hpp>
 #include <libpmemobj++/make_persistent.hpp>
@@ -11,8 +12,11 @@
 #include <libpmemobj++/pool.hpp>
 #include <libpmemobj++/transaction.hpp>
 
+#include <algorithm>
 #include <numeric>
+#include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include <cassert>
@@ -128,6 +132,7 @@ public:
 	~leaf_node_t();
 
 	void move(pool_base &pop, persistent_ptr<leaf_node_t> other, const key_compare &);
+	void append(leaf_node_t &other);
 	template <typename K, typename M>
 	iterator insert(iterator idxs_pos, K &&key, M &&obj);
 
@@ -140,6 +145,7 @@ public:
 
 	template <typename K>
 	size_type erase(pool_base &pop, const K &key, const key_compare &);
+	void erase(pool_base &pop, size_type first, size_type last);
 
 	iterator begin();
 	const_iterator begin() const;
@@ -219,6 +225,7 @@ public:
 	void update_splitted_child(pool_base &pop, const_reference key,
 				   node_pptr &left_child, node_pptr &right_child,
 				   const key_compare &);
+	void replace_child(const node_t *child, const node_pptr &new_child);
 
 	template <typename K>
 	std::tuple<node_t *, node_t *, node_t *, iterator>
@@ -348,6 +355,24 @@ public:
 
 	template <typename K>
 	size_type erase(const K &key);
+	template <typename K, typename Pred, typename F>
+	size_type erase_range(const K &key, Pred &&in_range, F &&on_erase,
+			      size_type leaves_per_tx);
+
+	template <typename Iterator>
+	void append_leaf(Iterator first, Iterator last);
+
+	std::vector<const key_type *> split_keys(size_type n) const;
+
+	/* sizes of subtrees of inner nodes, kept in DRAM by the owner of the tree */
+	using subtree_sizes = std::unordered_map<const node_t *, size_type>;
+
+	template <typename K>
+	size_type rank(const K &key, bool inclusive, subtree_sizes &sizes) const;
+	template <typename K>
+	void invalidate_sizes(const K &key, subtree_sizes &sizes) const;
+
+	void defragment(double start_percent = 0, double amount_percent = 100);
 
 	iterator begin();
 	iterator end();
@@ -377,8 +402,11 @@ private:
 	const key_type &get_last_key(const node_pptr &node);
 	leaf_type *leftmost_leaf() const;
 	leaf_type *rightmost_leaf() const;
+	leaf_type *leaf_at(double fraction) const;
+	size_type subtree_size(node_t *node, subtree_sizes &sizes) const;
 
 	void create_new_root(const key_type &, node_pptr &, node_pptr &);
+	void attach_leaf(pool_base &pop, leaf_pptr &leaf);
 	typename inner_type::const_iterator split_half(pool_base &pop, inner_pptr &node,
 						       inner_pptr &other,
 						       key_pptr &partition_key);
@@ -410,6 +438,13 @@ private:
 	void delete_inner_ext(inner_pptr &node, inner_pair &parent,
 			      std::pair<node_pptr, node_pptr> &neighbors,
 			      bool has_left_sibling);
+	void remove_empty_leaf(leaf_pptr &leaf, std::vector<inner_pair> &path,
+			       std::vector<std::pair<node_pptr, node_pptr>> &neighbors,
+			       inner_pair &to_replace);
+	void erase_from_leaf(pool_base &pop, leaf_type *leaf, size_type first,
+			     size_type last);
+	leaf_type *relocate_leaf(pool_base &pop, leaf_type *leaf);
+	void merge_next_leaf(pool_base &pop, leaf_type *leaf);
 
 	static inner_pptr &cast_inner(node_pptr &node);
 	static inner_type *cast_inner(node_t *node);
@@ -644,6 +679,32 @@ void leaf_node_t<Key, T, Compare, capacity>::move(pool_base &pop,
 	assert(is_sorted(comp));
 }
 
+/**
+ * Moves all entries of the 'other' to the end of 'this'.
+ *
+ * @pre must be called in a transaction scope.
+ * @pre size() + other.size() <= capacity
+ * @pre all keys in 'other' are greater than keys in 'this'
+ *
+ * @post other.size() == 0
+ */
+template <typename Key, typename T, typename Compare, uint64_t capacity>
+void leaf_node_t<Key, T, Compare, capacity>::append(leaf_node_t &other)
+{
+	assert(pmemobj_tx_stage() == TX_STAGE_WORK);
+	assert(size() + other.size() <= capacity);
+
+	/* add whole array to tx, entries in 'other' are not sorted by position */
+	other.add_to_tx(0, capacity);
+	for (auto &e : other) {
+		emplace(idxs[size()], std::move(e.first), std::move(e.second));
+		e.first.~key_type();
+		e.second.~mapped_type();
+		++_size;
+	}
+	other._size = 0;
+}
+
 template <typename Key, typename T, typename Compare, uint64_t capacity>
 template <typename K>
 typename leaf_node_t<Key, T, Compare, capacity>::iterator
@@ -716,6 +777,28 @@ leaf_node_t<Key, T, Compare, capacity>::erase(pool_base &pop, const K &key,
 	return size_type(1);
 }
 
+/**
+ * Erases entries at positions [first, last) (in sorted order) of the leaf.
+ */
+template <typename Key, typename T, typename Compare, uint64_t capacity>
+void leaf_node_t<Key, T, Compare, capacity>::erase(pool_base &pop, size_type first,
+						   size_type last)
+{
+	assert(first <= last && last <= size());
+	pmem::obj::transaction::run(pop, [&] {
+		for (size_type i = first; i < last; ++i) {
+			(*this)[i].first.~key_type();
+			(*this)[i].second.~mapped_type();
+		}
+		/* indexes of erased entries are moved after the remaining ones */
+		auto slice = idxs.range(first, size() - first);
+		std::rotate(slice.begin(),
+			    slice.begin() + static_cast<difference_type>(last - first),
+			    slice.end());
+		_size = size() - (last - first);
+	});
+}
+
 /**
  * Return begin iterator on an array of correct indices.
  */
@@ -1048,6 +1131,23 @@ void inner_node_t<Key, Compare, capacity>::update_splitted_child(pool_base &pop,
 	assert(is_sorted(comp));
 }
 
+/**
+ * Replaces pointer to the 'child' with 'new_child'.
+ *
+ * @pre must be called in a transaction scope.
+ */
+template <typename Key, typename Compare, uint64_t capacity>
+void inner_node_t<Key, Compare, capacity>::replace_child(const node_t *child,
+							 const node_pptr &new_child)
+{
+	assert(pmemobj_tx_stage() == TX_STAGE_WORK);
+
+	auto it = std::find_if(children, children + size() + 1,
+			       [&](const node_pptr &n) { return n.get() == child; });
+	assert(it != children + size() + 1);
+	*it = new_child;
+}
+
 /**
  * Deletes key specified by iterator.
  * Must be followed by node balancing.
@@ -1350,8 +1450,10 @@ b_tree_iterator<LeafType, is_const> &b_tree_iterator<LeafType, is_const>::operat
 	if (leaf_it == current_node->begin()) {
 		leaf_node_ptr tmp = current_node->get_prev().get();
 		if (tmp) {
+			/* last element of the previous leaf (leaves are never empty) */
 			current_node = tmp;
 			leaf_it = current_node->end();
+			--leaf_it;
 		}
 	} else {
 		--leaf_it;
@@ -1724,39 +1826,458 @@ b_tree_base<Key, T, Compare, degree>::erase(const K &key)
 			--_size;
 			return;
 		}
-		/* handle leaf node */
-		auto nbors = neighbors.back();
-		auto parent = path.back();
-		/* if left sibling exists then leaf is right child */
-		delete_leaf_ext(leaf, parent, nbors.first == nullptr);
-		/* handle inner nodes */
-		auto node = path.back().first;
-		if (path.size() > 1 && node->size() == 0) {
-			path.pop_back();
-			neighbors.pop_back();
-
-			delete_inner_ext(node, path.back(), nbors,
-					 neighbors.back().first != nullptr);
+		remove_empty_leaf(leaf, path, neighbors, to_replace);
+		--_size;
+	});
+	/* all done, return */
+	return result;
+}
+
+/**
+ * Removes empty leaf from the tree (and its parent, if it becomes empty).
+ * Arguments are the ones filled by get_path_ext().
+ *
+ * @pre must be called in a transaction scope.
+ * @pre leaf->size() == 0 && !path.empty()
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+void b_tree_base<Key, T, Compare, degree>::remove_empty_leaf(
+	leaf_pptr &leaf, std::vector<inner_pair> &path,
+	std::vector<std::pair<node_pptr, node_pptr>> &neighbors, inner_pair &to_replace)
+{
+	using const_key = const key_type &;
+	assert(pmemobj_tx_stage() == TX_STAGE_WORK);
+	assert(leaf->size() == 0 && !path.empty());
+
+	/* handle leaf node */
+	auto nbors = neighbors.back();
+	auto parent = path.back();
+	/* if left sibling exists then leaf is right child */
+	delete_leaf_ext(leaf, parent, nbors.first == nullptr);
+	/* handle inner nodes */
+	auto node = path.back().first;
+	if (path.size() > 1 && node->size() == 0) {
+		path.pop_back();
+		neighbors.pop_back();
+
+		delete_inner_ext(node, path.back(), nbors,
+				 neighbors.back().first != nullptr);
+	}
+	/* replace pointer in inner node */
+	if (to_replace.first) {
+		const_key new_key = get_suitable_entry(to_replace).first;
+		to_replace.first->replace(to_replace.second, new_key);
+	}
+	/* one of the main subtrees deleted, other will become root */
+	if (path.back().first->size() == 0) {
+		if (nbors.first) {
+			cast_inner(root) = nbors.first;
+		} else if (nbors.second) {
+			cast_inner(root) = nbors.second;
 		}
-		/* replace pointer in inner node */
-		if (to_replace.first) {
+	}
+}
+
+/**
+ * Erases entries starting from the least one not less than 'key', as long as
+ * in_range(entry_key) holds (entries in range have to be adjacent). Entries of
+ * a leaf are erased at once, with a single descent, and leaves left empty are
+ * unlinked and freed. Up to 'leaves_per_tx' leaves are processed in a single
+ * transaction, so the erase is not atomic as a whole, but each leaf is.
+ *
+ * on_erase(entry) is called for every entry, in the transaction erasing it.
+ *
+ * @return number of erased entries
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+template <typename K, typename Pred, typename F>
+typename b_tree_base<Key, T, Compare, degree>::size_type
+b_tree_base<Key, T, Compare, degree>::erase_range(const K &key, Pred &&in_range,
+						  F &&on_erase, size_type leaves_per_tx)
+{
+	assert(leaves_per_tx > 0);
+
+	auto pop = get_pool_base();
+	leaf_type *leaf = find_leaf_node(key);
+	auto pos = static_cast<size_type>(
+		std::distance(leaf->begin(), leaf->lower_bound(key, compare)));
+	size_type erased = 0;
+	bool done = false;
+
+	while (!done) {
+		pmem::obj::transaction::run(pop, [&] {
+			for (size_type n = 0; n < leaves_per_tx && !done; ++n) {
+				size_type last = pos;
+				while (last < leaf->size() &&
+				       in_range((*leaf)[last].first)) {
+					on_erase((*leaf)[last]);
+					++last;
+				}
+
+				/* leaf may be freed below */
+				leaf_type *next = leaf->get_next().get();
+				done = last < leaf->size() || next == nullptr;
+				if (last > pos) {
+					erase_from_leaf(pop, leaf, pos, last);
+					erased += last - pos;
+				}
+
+				leaf = next;
+				pos = 0;
+			}
+		});
+	}
+
+	return erased;
+}
+
+/**
+ * Erases entries at positions [first, last) of the leaf, removing the leaf from
+ * the tree if it becomes empty (as erase() does for a single entry).
+ *
+ * @pre must be called in a transaction scope.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+void b_tree_base<Key, T, Compare, degree>::erase_from_leaf(pool_base &pop,
+							   leaf_type *leaf,
+							   size_type first,
+							   size_type last)
+{
+	using const_key = const key_type &;
+	assert(pmemobj_tx_stage() == TX_STAGE_WORK);
+	assert(first < last && last <= leaf->size());
+
+	/* inner node may refer only to the first entry of the leaf */
+	std::vector<inner_pair> path;
+	std::vector<std::pair<node_pptr, node_pptr>> neighbors;
+	inner_pair to_replace;
+	leaf_pptr leaf_ptr =
+		get_path_ext(leaf->front().first, path, neighbors, to_replace);
+	assert(leaf_ptr.get() == leaf);
+
+	leaf->erase(pop, first, last);
+	_size = size() - (last - first);
+
+	if (leaf->size() > 0) {
+		if (first == 0 && to_replace.first != nullptr) {
 			const_key new_key = get_suitable_entry(to_replace).first;
 			to_replace.first->replace(to_replace.second, new_key);
 		}
-		/* one of the main subtrees deleted, other will become root */
-		if (path.back().first->size() == 0) {
-			if (nbors.first) {
-				cast_inner(root) = nbors.first;
-			} else if (nbors.second) {
-				cast_inner(root) = nbors.second;
-			}
+	} else if (!path.empty()) {
+		remove_empty_leaf(leaf_ptr, path, neighbors, to_replace);
+	}
+}
+
+/**
+ * Appends a leaf with entries [first, last) (pairs of a key and a value, in
+ * strictly ascending order of keys greater than all keys in the tree) for a
+ * bulk load. The leaf is linked after the rightmost leaf and inserted into its
+ * parent (see attach_leaf()) in a single transaction, so the tree is
+ * consistent after each leaf. An empty tree gets the entries in its root leaf.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+template <typename Iterator>
+void b_tree_base<Key, T, Compare, degree>::append_leaf(Iterator first, Iterator last)
+{
+	assert(first != last);
+	assert(static_cast<size_type>(std::distance(first, last)) <= node_capacity);
+
+	auto pop = get_pool_base();
+	pmem::obj::transaction::run(pop, [&] {
+		leaf_pptr leaf;
+		bool attach = size() > 0;
+		if (attach) {
+			path_type path;
+			leaf_pptr prev = find_leaf_to_insert(first->first, path);
+			leaf = allocate_leaf();
+			leaf->set_prev(prev);
+			prev->set_next(leaf);
+		} else {
+			assert(root->leaf());
+			leaf = cast_leaf(root);
 		}
-		--_size;
+
+		for (; first != last; ++first)
+			leaf->insert(leaf->end(), first->first, first->second);
+
+		if (attach)
+			attach_leaf(pop, leaf);
+		_size = size() + leaf->size();
 	});
-	/* all done, return */
+}
+
+/**
+ * Returns up to n - 1 ascending keys which split the tree into ranges of similar
+ * size, i-th range starting at (i - 1)-th key. Keys are taken from the highest
+ * level with at least n nodes (or the leaf level), so no elements are visited.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+std::vector<const typename b_tree_base<Key, T, Compare, degree>::key_type *>
+b_tree_base<Key, T, Compare, degree>::split_keys(size_type n) const
+{
+	std::vector<const key_type *> keys;
+	if (n < 2)
+		return keys;
+
+	/* nodes of the current level and keys separating them */
+	std::vector<node_t *> level{root.get()};
+	while (level.size() < n && !level.front()->leaf()) {
+		std::vector<node_t *> lower;
+		std::vector<const key_type *> lower_keys;
+		for (size_type i = 0; i < level.size(); ++i) {
+			if (i > 0)
+				lower_keys.push_back(keys[i - 1]);
+
+			const inner_type *inner = cast_inner(level[i]);
+			for (auto it = inner->cbegin(); it != inner->cend(); ++it) {
+				lower.push_back(inner->get_left_child(it).get());
+				lower_keys.push_back(&*it);
+			}
+			lower.push_back(inner->get_right_child(inner->cend() - 1).get());
+		}
+		level.swap(lower);
+		keys.swap(lower_keys);
+	}
+
+	if (level.size() <= n)
+		return keys;
+
+	std::vector<const key_type *> result;
+	result.reserve(n - 1);
+	for (size_type i = 1; i < n; ++i)
+		result.push_back(keys[i * level.size() / n - 1]);
+
+	return result;
+}
+
+/**
+ * Returns the number of elements less than (or equal to, if 'inclusive' is set)
+ * the key. Elements of children left of the descent path are counted by sizes
+ * of their subtrees, so it takes O(degree * height) if 'sizes' are filled, and
+ * sizes missing there are computed (and stored) on the way.
+ *
+ * 'sizes' are correct as long as every modification of the tree is preceded
+ * by invalidate_sizes() of the modified key and every erase of more than a
+ * single key (and defragment) by clearing them.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+template <typename K>
+typename b_tree_base<Key, T, Compare, degree>::size_type
+b_tree_base<Key, T, Compare, degree>::rank(const K &key, bool inclusive,
+					   subtree_sizes &sizes) const
+{
+	assert(root != nullptr);
+	size_type result = 0;
+	node_t *node = root.get();
+	while (!node->leaf()) {
+		const inner_type *inner = cast_inner(node);
+		node_t *child = inner->get_child(key, compare).get();
+		for (auto it = inner->cbegin(); inner->get_left_child(it).get() != child;
+		     ++it)
+			result += subtree_size(inner->get_left_child(it).get(), sizes);
+		node = child;
+	}
+
+	const leaf_type *leaf = cast_leaf(node);
+	typename leaf_type::const_iterator leaf_it;
+	if (inclusive)
+		leaf_it = std::upper_bound(leaf->cbegin(), leaf->cend(), key,
+					   [this](const K &key, const_reference e) {
+						   return compare(key, e.first);
+					   });
+	else
+		leaf_it = std::lower_bound(leaf->cbegin(), leaf->cend(), key,
+					   [this](const_reference e, const K &key) {
+						   return compare(e.first, key);
+					   });
+
+	return result + static_cast<size_type>(leaf_it - leaf->cbegin());
+}
+
+/**
+ * Drops sizes of subtrees on the path to the key. Has to be called before
+ * an insert or erase of the key - nodes split or deleted by it are on the path.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+template <typename K>
+void b_tree_base<Key, T, Compare, degree>::invalidate_sizes(const K &key,
+							    subtree_sizes &sizes) const
+{
+	assert(root != nullptr);
+	if (sizes.empty())
+		return;
+
+	node_t *node = root.get();
+	while (!node->leaf()) {
+		sizes.erase(node);
+		node = cast_inner(node)->get_child(key, compare).get();
+	}
+}
+
+template <typename Key, typename T, typename Compare, std::size_t degree>
+typename b_tree_base<Key, T, Compare, degree>::size_type
+b_tree_base<Key, T, Compare, degree>::subtree_size(node_t *node,
+						   subtree_sizes &sizes) const
+{
+	if (node->leaf())
+		return cast_leaf(node)->size();
+
+	auto cached = sizes.find(node);
+	if (cached != sizes.end())
+		return cached->second;
+
+	const inner_type *inner = cast_inner(node);
+	size_type result = 0;
+	for (auto it = inner->cbegin(); it != inner->cend(); ++it)
+		result += subtree_size(inner->get_left_child(it).get(), sizes);
+	result += subtree_size(inner->get_left_child(inner->cend()).get(), sizes);
+	sizes.emplace(node, result);
+
 	return result;
 }
 
+/**
+ * Defragments leaves holding approximately [start_percent, start_percent +
+ * amount_percent) of the tree (position of a leaf is estimated from its path).
+ *
+ * Leaves cannot be moved by pmem::obj::defrag, because inner nodes keep pointers
+ * to keys stored inside them. Instead, every leaf is copied to a newly allocated
+ * one (in a transaction, together with updating all pointers to it) and the
+ * following leaves are merged into it, as long as the entries fit. Buffers of
+ * keys and values from processed leaves are then relocated by pmem::obj::defrag.
+ *
+ * @throw std::range_error if the range is incorrect.
+ * @throw pmem::defrag_error when defragmentation fails.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+void b_tree_base<Key, T, Compare, degree>::defragment(double start_percent,
+						      double amount_percent)
+{
+	double end_percent = start_percent + amount_percent;
+	if (start_percent < 0 || start_percent >= 100 || amount_percent <= 0 ||
+	    amount_percent > 100 || end_percent > 100)
+		throw std::range_error("incorrect range");
+
+	auto pop = get_pool_base();
+	leaf_type *leaf = leaf_at(start_percent / 100);
+	leaf_type *last = end_percent < 100 ? leaf_at(end_percent / 100) : nullptr;
+	/* range too small to reach the next leaf, process at least one */
+	if (last == leaf)
+		last = leaf->get_next().get();
+
+	std::vector<leaf_type *> processed;
+	/* only empty tree has an empty leaf */
+	while (leaf != last && leaf->size() > 0) {
+		leaf = relocate_leaf(pop, leaf);
+		while (leaf->get_next() && leaf->get_next().get() != last &&
+		       leaf->size() + leaf->get_next()->size() <= node_capacity)
+			merge_next_leaf(pop, leaf);
+
+		processed.push_back(leaf);
+		leaf = leaf->get_next().get();
+	}
+
+	pmem::obj::defrag defrag(pop);
+	for (leaf_type *l : processed) {
+		for (auto &e : *l) {
+			defrag.add(e.first);
+			defrag.add(e.second);
+		}
+	}
+	defrag.run();
+}
+
+/**
+ * Returns leaf at approximately the given position (in range [0, 1]) of the tree.
+ * It assumes that subtrees of a node have similar sizes.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+typename b_tree_base<Key, T, Compare, degree>::leaf_type *
+b_tree_base<Key, T, Compare, degree>::leaf_at(double fraction) const
+{
+	assert(root != nullptr);
+	node_pptr node = root;
+	while (!node->leaf()) {
+		inner_type *inner_node = cast_inner(node).get();
+		auto children = static_cast<double>(inner_node->size() + 1);
+		auto pos = std::min(static_cast<size_type>(fraction * children),
+				    inner_node->size());
+		fraction = fraction * children - static_cast<double>(pos);
+		node = inner_node->get_left_child(inner_node->begin() + pos);
+	}
+	return cast_leaf(node).get();
+}
+
+/**
+ * Moves entries of the leaf to a newly allocated one, which replaces it in the tree.
+ *
+ * @pre leaf->size() > 0
+ *
+ * @return the new leaf
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+typename b_tree_base<Key, T, Compare, degree>::leaf_type *
+b_tree_base<Key, T, Compare, degree>::relocate_leaf(pool_base &pop, leaf_type *leaf)
+{
+	assert(leaf->size() > 0);
+	std::vector<inner_pair> path;
+	std::vector<std::pair<node_pptr, node_pptr>> neighbors;
+	inner_pair to_replace;
+	leaf_pptr old_leaf = get_path_ext(leaf->front().first, path, neighbors, to_replace);
+	assert(old_leaf.get() == leaf);
+
+	leaf_pptr new_leaf;
+	pmem::obj::transaction::run(pop, [&] {
+		new_leaf = allocate_leaf();
+		new_leaf->append(*old_leaf);
+
+		new_leaf->set_prev(old_leaf->get_prev());
+		new_leaf->set_next(old_leaf->get_next());
+		if (new_leaf->get_prev())
+			new_leaf->get_prev()->set_next(new_leaf);
+		if (new_leaf->get_next())
+			new_leaf->get_next()->set_prev(new_leaf);
+
+		if (path.empty())
+			root = cast_node(new_leaf);
+		else
+			path.back().first->replace_child(old_leaf.get(),
+							 cast_node(new_leaf));
+		/* key pointer referred to the first entry of the old leaf */
+		if (to_replace.first)
+			to_replace.first->replace(to_replace.second,
+						  new_leaf->front().first);
+
+		deallocate(old_leaf);
+	});
+
+	return new_leaf.get();
+}
+
+/**
+ * Moves entries of the next leaf to the given one and removes the next leaf.
+ *
+ * @pre leaf->size() + leaf->get_next()->size() <= node_capacity
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+void b_tree_base<Key, T, Compare, degree>::merge_next_leaf(pool_base &pop,
+							   leaf_type *leaf)
+{
+	assert(leaf->get_next() != nullptr);
+	assert(leaf->size() + leaf->get_next()->size() <= node_capacity);
+	std::vector<inner_pair> path;
+	std::vector<std::pair<node_pptr, node_pptr>> neighbors;
+	inner_pair to_replace;
+	leaf_pptr next =
+		get_path_ext(leaf->get_next()->front().first, path, neighbors, to_replace);
+	assert(next == leaf->get_next());
+
+	pmem::obj::transaction::run(pop, [&] {
+		leaf->append(*next);
+		remove_empty_leaf(next, path, neighbors, to_replace);
+	});
+}
+
 template <typename Key, typename T, typename Compare, std::size_t degree>
 typename b_tree_base<Key, T, Compare, degree>::iterator
 b_tree_base<Key, T, Compare, degree>::begin()
@@ -1868,6 +2389,48 @@ void b_tree_base<Key, T, Compare, degree>::create_new_root(const key_type &key,
 	cast_inner(root) = allocate_inner(root->level() + 1, key, l_child, r_child);
 }
 
+/**
+ * Inserts 'leaf', linked after the rightmost leaf of the tree (so its keys are
+ * greater than all keys in the tree), into the parent of that leaf. Full inner
+ * nodes on the path are split first, as in try_emplace().
+ *
+ * @pre must be called in a transaction scope.
+ */
+template <typename Key, typename T, typename Compare, std::size_t degree>
+void b_tree_base<Key, T, Compare, degree>::attach_leaf(pool_base &pop, leaf_pptr &leaf)
+{
+	assert(pmemobj_tx_stage() == TX_STAGE_WORK);
+	assert(leaf->size() > 0);
+
+	const key_type &key = leaf->front().first;
+	path_type path;
+	leaf_pptr last = find_leaf_to_insert(key, path);
+	assert(last->get_next() == leaf);
+
+	if (path.empty()) {
+		create_new_root(key, cast_node(last), cast_node(leaf));
+		return;
+	}
+
+	auto i = path.begin() + std::distance(path.cbegin(), find_full_node(path));
+	inner_type *parent_node = nullptr;
+	if ((*i)->full()) {
+		split_inner_node(pop, *i);
+		parent_node = cast_inner(cast_inner(root)->get_child(key, compare).get());
+	} else {
+		parent_node = (*i).get();
+	}
+	++i;
+
+	for (; i != path.end(); ++i) {
+		split_inner_node(pop, *i, parent_node);
+		parent_node = cast_inner(parent_node->get_child(key, compare).get());
+	}
+
+	parent_node->update_splitted_child(pop, key, cast_node(last), cast_node(leaf),
+					   compare);
+}
+
 template <typename Key, typename T, typename Compare, std::size_t degree>
 typename b_tree_base<Key, T, Compare, degree>::inner_type::const_iterator
 b_tree_base<Key, T, Compare, degree>::split_half(pool_base &pop, inner_pptr &node,
@@ -3,12 +3,14 @@
 
 #include "tree3.h"
 #include "../out.h"
+#include "../parallel.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
-#include <list>
+#include <iterator>
+#include <thread>
 #include <unistd.h>
 
 namespace pmem
@@ -37,23 +39,130 @@ std::string tree3::name()
 // KEY/VALUE METHODS
 // ===============================================================================================
 
+/* Calls callback for records from the position of the cursor on (or down, if
+ * not forward), for as long as their keys are in range. */
+template <typename InRange>
+static status iterate_from(internal::tree3::KVCursor &cursor, InRange in_range,
+			   get_kv_callback *callback, void *arg, bool forward = true)
+{
+	for (; cursor.valid() && in_range(cursor.key());
+	     forward ? cursor.next() : cursor.prev()) {
+		auto &kvslot = cursor.slot();
+		auto ret = callback(kvslot.key(), kvslot.get_ks(), kvslot.val(),
+				    kvslot.get_vs(), arg);
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+
+	return status::OK;
+}
+
+/* Counts records from the position of the cursor on, for as long as their keys
+ * are in range. */
+template <typename InRange>
+static std::size_t count_from(internal::tree3::KVCursor &cursor, InRange in_range)
+{
+	std::size_t result = 0;
+	for (; cursor.valid() && in_range(cursor.key()); cursor.next())
+		result++;
+
+	return result;
+}
+
+static bool any_key(const std::string &)
+{
+	return true;
+}
+
 status tree3::count_all(std::size_t &cnt)
 {
 	LOG("count_all");
 	check_outside_tx();
-	std::size_t result = 0;
-	auto leaf = (pmem::kv::internal::tree3::KVLeaf *)pmemobj_direct(*root_oid);
-	while (leaf) {
-		for (int slot = LEAF_KEYS; slot--;) {
-			auto kvslot = leaf->slots[slot].get_ro();
-			if (kvslot.empty() || kvslot.hash() == 0)
-				continue;
-			result++;
-		}
-		leaf = leaf->next.get(); // advance to next linked leaf
+
+	cnt = elements;
+
+	return status::OK;
+}
+
+status tree3::count_above(string_view key, std::size_t &cnt)
+{
+	LOG("count_above for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(key, false);
+	cnt = count_from(cursor, any_key);
+
+	return status::OK;
+}
+
+status tree3::count_equal_above(string_view key, std::size_t &cnt)
+{
+	LOG("count_equal_above for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(key, true);
+	cnt = count_from(cursor, any_key);
+
+	return status::OK;
+}
+
+status tree3::count_equal_below(string_view key, std::size_t &cnt)
+{
+	LOG("count_equal_below for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_first();
+	cnt = count_from(cursor, [&](const std::string &k) {
+		return string_view(k).compare(key) <= 0;
+	});
+
+	return status::OK;
+}
+
+status tree3::count_below(string_view key, std::size_t &cnt)
+{
+	LOG("count_below for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_first();
+	cnt = count_from(cursor, [&](const std::string &k) {
+		return string_view(k).compare(key) < 0;
+	});
+
+	return status::OK;
+}
+
+status tree3::count_between(string_view key1, string_view key2, std::size_t &cnt)
+{
+	LOG("count_between for key1=" << key1.data() << ", key2=" << key2.data());
+	check_outside_tx();
+
+	cnt = 0;
+	if (key1.compare(key2) < 0) {
+		internal::tree3::KVCursor cursor(tree_top);
+		cursor.seek_higher(key1, false);
+		cnt = count_from(cursor, [&](const std::string &k) {
+			return string_view(k).compare(key2) < 0;
+		});
 	}
 
-	cnt = result;
+	return status::OK;
+}
+
+status tree3::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(prefix, true);
+	cnt = count_from(cursor, [&](const std::string &k) {
+		return internal::has_prefix(k, prefix);
+	});
 
 	return status::OK;
 }
@@ -62,21 +171,172 @@ status tree3::get_all(get_kv_callback *callback, void *arg)
 {
 	LOG("get_all");
 	check_outside_tx();
-	auto leaf = (pmem::kv::internal::tree3::KVLeaf *)pmemobj_direct(*root_oid);
-	while (leaf) {
-		for (int slot = LEAF_KEYS; slot--;) {
-			auto kvslot = leaf->slots[slot].get_ro();
-			if (kvslot.empty() || kvslot.hash() == 0)
-				continue;
-			auto ret = callback(kvslot.key(), kvslot.get_ks(), kvslot.val(),
-					    kvslot.get_vs(), arg);
-			if (ret != 0)
-				return status::STOPPED_BY_CB;
-		}
-		leaf = leaf->next.get(); // advance to next linked leaf
-	}
 
-	return status::OK;
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_first();
+
+	return iterate_from(cursor, any_key, callback, arg);
+}
+
+status tree3::get_above(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(key, false);
+
+	return iterate_from(cursor, any_key, callback, arg);
+}
+
+status tree3::get_equal_above(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(key, true);
+
+	return iterate_from(cursor, any_key, callback, arg);
+}
+
+status tree3::get_equal_below(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_first();
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key) <= 0; },
+		callback, arg);
+}
+
+status tree3::get_below(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_first();
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key) < 0; },
+		callback, arg);
+}
+
+status tree3::get_between(string_view key1, string_view key2, get_kv_callback *callback,
+			  void *arg)
+{
+	LOG("get_between for key1=" << key1.data() << ", key2=" << key2.data());
+	check_outside_tx();
+
+	if (key1.compare(key2) >= 0)
+		return status::OK;
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(key1, false);
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key2) < 0; },
+		callback, arg);
+}
+
+status tree3::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_last();
+
+	return iterate_from(cursor, any_key, callback, arg, false);
+}
+
+status tree3::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_last();
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key) > 0; },
+		callback, arg, false);
+}
+
+status tree3::get_equal_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_last();
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key) >= 0; },
+		callback, arg, false);
+}
+
+status tree3::get_equal_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_lower(key, true);
+
+	return iterate_from(cursor, any_key, callback, arg, false);
+}
+
+status tree3::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below_desc for key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_lower(key, false);
+
+	return iterate_from(cursor, any_key, callback, arg, false);
+}
+
+status tree3::get_between_desc(string_view key1, string_view key2,
+			       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc for key1=" << key1.data() << ", key2=" << key2.data());
+	check_outside_tx();
+
+	if (key1.compare(key2) >= 0)
+		return status::OK;
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_lower(key2, false);
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return string_view(k).compare(key1) > 0; },
+		callback, arg, false);
+}
+
+status tree3::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	check_outside_tx();
+
+	internal::tree3::KVCursor cursor(tree_top);
+	cursor.seek_higher(prefix, true);
+
+	return iterate_from(
+		cursor,
+		[&](const std::string &k) { return internal::has_prefix(k, prefix); },
+		callback, arg);
 }
 
 status tree3::exists(string_view key)
@@ -159,6 +419,7 @@ status tree3::put(string_view key, string_view value)
 					     std::string(value.data(), value.size()), 0);
 		});
 		tree_top = move(new_node);
+		elements++;
 	} else if (LeafFillSlotForKey(leafnode, hash, std::string(key.data(), key.size()),
 				      std::string(value.data(), value.size()))) {
 		// nothing else to do
@@ -194,6 +455,8 @@ status tree3::remove(string_view key)
 				transaction::run(pmpool, [&] {
 					leaf->slots[slot].get_rw().clear();
 				});
+				leafnode->sorted = false;
+				elements--;
 				return status::OK; // no duplicate keys allowed
 			}
 		}
@@ -201,6 +464,16 @@ status tree3::remove(string_view key)
 	return status::NOT_FOUND;
 }
 
+internal::iterator_base *tree3::new_iterator()
+{
+	return new tree3_iterator<false>{tree_top, pmpool};
+}
+
+internal::iterator_base *tree3::new_const_iterator()
+{
+	return new tree3_iterator<true>{tree_top};
+}
+
 // ===============================================================================================
 // PROTECTED LEAF METHODS
 // ===============================================================================================
@@ -267,6 +540,8 @@ bool tree3::LeafFillSlotForKey(internal::tree3::KVLeafNode *leafnode, const uint
 		transaction::run(pmpool, [&] {
 			LeafFillSpecificSlot(leafnode, hash, key, value, slot);
 		});
+		if (key_match_slot < 0)
+			elements++;
 	}
 	return slot >= 0;
 }
@@ -276,6 +551,8 @@ void tree3::LeafFillSpecificSlot(internal::tree3::KVLeafNode *leafnode,
 				 const std::string &value, const int slot)
 {
 	leafnode->leaf->slots[slot].get_rw().set(hash, key, value);
+	if (leafnode->hashes[slot] == 0)
+		leafnode->sorted = false; // new key, order of slots has changed
 	leafnode->hashes[slot] = hash;
 	leafnode->keys[slot] = key;
 }
@@ -323,9 +600,11 @@ void tree3::LeafSplitFull(internal::tree3::KVLeafNode *leafnode, const uint8_t h
 				leafnode->keys[slot].clear();
 			}
 		}
+		leafnode->sorted = false;
 		auto target = key.compare(split_key) > 0 ? new_leafnode.get() : leafnode;
 		LeafFillEmptySlot(target, hash, key, value);
 	});
+	elements++;
 
 	// recursively update volatile parents outside persistent transaction
 	InnerUpdateAfterSplit(leafnode, move(new_leafnode), &split_key);
@@ -407,80 +686,516 @@ void tree3::InnerUpdateAfterSplit(internal::tree3::KVNode *node,
 // PROTECTED LIFECYCLE METHODS
 // ===============================================================================================
 
+/* Decodes given leaf, recovering hashes and keys of all used slots.
+ * Returns leaf node paired with its highest sorting key or leaf node
+ * set to nullptr if the leaf does not contain any key. */
+static internal::tree3::KVRecoveredLeaf
+recover_leaf(const persistent_ptr<internal::tree3::KVLeaf> &leaf)
+{
+	unique_ptr<internal::tree3::KVLeafNode> leafnode(
+		new internal::tree3::KVLeafNode());
+	leafnode->leaf = leaf;
+	leafnode->is_leaf = true;
+
+	// find highest sorting key in leaf, while recovering all hashes
+	bool empty_leaf = true;
+	std::string max_key;
+	for (int slot = LEAF_KEYS; slot--;) {
+		leafnode->hashes[slot] = 0;
+		auto kvslot = leaf->slots[slot].get_ro();
+		if (kvslot.empty())
+			continue;
+		leafnode->hashes[slot] = kvslot.hash();
+		if (leafnode->hashes[slot] == 0)
+			continue;
+		const char *key = kvslot.key();
+		if (empty_leaf) {
+			max_key = std::string(kvslot.key(), kvslot.get_ks());
+			empty_leaf = false;
+		} else if (max_key.compare(0, std::string::npos, kvslot.key(),
+					   kvslot.get_ks()) < 0) {
+			max_key = std::string(kvslot.key(), kvslot.get_ks());
+		}
+		leafnode->keys[slot] = std::string(key, kvslot.get_ks());
+	}
+
+	if (empty_leaf)
+		leafnode.reset(nullptr);
+
+	return {move(leafnode), move(max_key)};
+}
+
+static bool recovered_leaf_less(const internal::tree3::KVRecoveredLeaf &lhs,
+				const internal::tree3::KVRecoveredLeaf &rhs)
+{
+	return (lhs.max_key.compare(rhs.max_key) < 0);
+}
+
 void tree3::Recover()
 {
 	LOG("Recovering");
 
-	// traverse persistent leaves to build list of leaves to recover
-	std::list<internal::tree3::KVRecoveredLeaf> leaves;
-
+	// gather persistent leaves, following the list is inherently sequential
+	std::vector<persistent_ptr<internal::tree3::KVLeaf>> chain;
 	auto root_leaf = persistent_ptr<internal::tree3::KVLeaf>(*root_oid);
-
 	while (root_leaf) {
-		unique_ptr<internal::tree3::KVLeafNode> leafnode(
-			new internal::tree3::KVLeafNode());
-		leafnode->leaf = root_leaf;
-		leafnode->is_leaf = true;
+		chain.push_back(root_leaf);
+		root_leaf = root_leaf->next.get(); // advance to next linked leaf
+	}
+
+	// decode and sort partitions of the chain in parallel
+	size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	workers = std::min(workers, chain.size() / RECOVERY_LEAVES_PER_THREAD + 1);
+
+	std::vector<std::vector<internal::tree3::KVRecoveredLeaf>> parts(workers);
+	std::vector<std::vector<persistent_ptr<internal::tree3::KVLeaf>>> empty(
+		workers);
+	internal::parallel_exec(workers, [&](size_t w) {
+		size_t first = chain.size() * w / workers;
+		size_t last = chain.size() * (w + 1) / workers;
+		auto &part = parts[w];
+		part.reserve(last - first);
+		for (size_t i = first; i < last; i++) {
+			auto recovered = recover_leaf(chain[i]);
+			if (recovered.leafnode)
+				part.push_back(move(recovered));
+			else
+				empty[w].push_back(chain[i]);
+		}
+		std::sort(part.begin(), part.end(), recovered_leaf_less);
+	});
+
+	for (auto &e : empty)
+		leaves_prealloc.insert(leaves_prealloc.end(), e.begin(), e.end());
+	chain.clear();
+	chain.shrink_to_fit();
+
+	// merge sorted partitions pairwise, each round in parallel
+	while (parts.size() > 1) {
+		std::vector<std::vector<internal::tree3::KVRecoveredLeaf>> merged(
+			(parts.size() + 1) / 2);
+		internal::parallel_exec(merged.size(), [&](size_t m) {
+			auto &lhs = parts[2 * m];
+			if (2 * m + 1 == parts.size()) {
+				merged[m] = move(lhs);
+				return;
+			}
+			auto &rhs = parts[2 * m + 1];
+			merged[m].reserve(lhs.size() + rhs.size());
+			std::merge(std::make_move_iterator(lhs.begin()),
+				   std::make_move_iterator(lhs.end()),
+				   std::make_move_iterator(rhs.begin()),
+				   std::make_move_iterator(rhs.end()),
+				   std::back_inserter(merged[m]), recovered_leaf_less);
+			lhs.clear();
+			rhs.clear();
+		});
+		parts = move(merged);
+	}
+
+	// reconstruct top/inner nodes bottom-up, one level at a time
+	tree_top.reset(nullptr);
+	elements = 0;
+
+	if (parts.empty() || parts.front().empty()) {
+		LOG("Recovered ok");
+		return;
+	}
 
-		// find highest sorting key in leaf, while recovering all hashes
-		bool empty_leaf = true;
-		std::string max_key;
+	for (auto &recovered : parts.front()) {
+		auto leafnode = (internal::tree3::KVLeafNode *)recovered.leafnode.get();
 		for (int slot = LEAF_KEYS; slot--;) {
-			auto kvslot = root_leaf->slots[slot].get_ro();
-			if (kvslot.empty())
-				continue;
-			leafnode->hashes[slot] = kvslot.hash();
-			if (leafnode->hashes[slot] == 0)
-				continue;
-			const char *key = kvslot.key();
-			if (empty_leaf) {
-				max_key = std::string(kvslot.key(), kvslot.get_ks());
-				empty_leaf = false;
-			} else if (max_key.compare(0, std::string::npos, kvslot.key(),
-						   kvslot.get_ks()) < 0) {
-				max_key = std::string(kvslot.key(), kvslot.get_ks());
+			if (leafnode->hashes[slot] != 0)
+				elements++;
+		}
+	}
+
+	std::vector<internal::tree3::KVRecoveredLeaf> level = move(parts.front());
+	while (level.size() > 1) {
+		// spread children evenly so that every inner node has at least two
+		const size_t fanout = INNER_KEYS + 1;
+		const size_t nodes = (level.size() + fanout - 1) / fanout;
+		std::vector<internal::tree3::KVRecoveredLeaf> upper;
+		upper.reserve(nodes);
+		for (size_t n = 0; n < nodes; n++) {
+			size_t first = level.size() * n / nodes;
+			size_t last = level.size() * (n + 1) / nodes;
+			unique_ptr<internal::tree3::KVInnerNode> inner(
+				new internal::tree3::KVInnerNode());
+			inner->parent = nullptr;
+			inner->keycount = (uint8_t)(last - first - 1);
+			for (size_t i = first; i < last; i++) {
+				if (i + 1 < last)
+					inner->keys[i - first] = level[i].max_key;
+				level[i].leafnode->parent = inner.get();
+				inner->children[i - first] = move(level[i].leafnode);
 			}
-			leafnode->keys[slot] = std::string(key, kvslot.get_ks());
+#ifndef NDEBUG
+			inner->assert_invariants();
+#endif
+			upper.push_back({move(inner), move(level[last - 1].max_key)});
 		}
+		level = move(upper);
+	}
+	tree_top = move(level.front().leafnode);
 
-		// use highest sorting key to decide how to recover the leaf
-		if (empty_leaf) {
-			leaves_prealloc.push_back(root_leaf);
-		} else {
-			leaves.push_back({move(leafnode), max_key});
+	LOG("Recovered ok");
+}
+
+// ===============================================================================================
+// ITERATOR METHODS
+// ===============================================================================================
+
+tree3::tree3_iterator<true>::tree3_iterator(
+	const unique_ptr<internal::tree3::KVNode> &top)
+    : cursor(top)
+{
+}
+
+tree3::tree3_iterator<false>::tree3_iterator(
+	const unique_ptr<internal::tree3::KVNode> &top, pmem::obj::pool_base &pop)
+    : tree3::tree3_iterator<true>(top), pop(pop)
+{
+}
+
+status tree3::tree3_iterator<true>::seek(string_view key)
+{
+	init_seek();
+
+	cursor.seek_higher(key, true);
+	if (cursor.valid() && key.compare(cursor.key()) == 0)
+		return status::OK;
+
+	cursor.reset();
+	return status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_lower(string_view key)
+{
+	init_seek();
+
+	cursor.seek_lower(key, false);
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_lower_eq(string_view key)
+{
+	init_seek();
+
+	cursor.seek_lower(key, true);
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_higher(string_view key)
+{
+	init_seek();
+
+	cursor.seek_higher(key, false);
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_higher_eq(string_view key)
+{
+	init_seek();
+
+	cursor.seek_higher(key, true);
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_to_first()
+{
+	init_seek();
+
+	cursor.seek_first();
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::seek_to_last()
+{
+	init_seek();
+
+	cursor.seek_last();
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::is_next()
+{
+	if (!cursor.valid() || !cursor.has_next())
+		return status::NOT_FOUND;
+
+	return status::OK;
+}
+
+status tree3::tree3_iterator<true>::next()
+{
+	init_seek();
+
+	if (!cursor.valid())
+		return status::NOT_FOUND;
+
+	cursor.next();
+
+	return cursor.valid() ? status::OK : status::NOT_FOUND;
+}
+
+status tree3::tree3_iterator<true>::prev()
+{
+	init_seek();
+
+	if (!cursor.valid() || !cursor.has_prev())
+		return status::NOT_FOUND;
+
+	cursor.prev();
+
+	return status::OK;
+}
+
+result<string_view> tree3::tree3_iterator<true>::key()
+{
+	assert(cursor.valid());
+
+	auto &key = cursor.key();
+	return {string_view(key.data(), key.size())};
+}
+
+result<pmem::obj::slice<const char *>> tree3::tree3_iterator<true>::read_range(size_t pos,
+									       size_t n)
+{
+	assert(cursor.valid());
+
+	auto &kvslot = cursor.slot();
+	if (pos + n > kvslot.get_vs() || pos + n < pos)
+		n = kvslot.get_vs() - pos;
+
+	return {{kvslot.val() + pos, kvslot.val() + pos + n}};
+}
+
+result<pmem::obj::slice<char *>> tree3::tree3_iterator<false>::write_range(size_t pos,
+									   size_t n)
+{
+	assert(cursor.valid());
+
+	auto &kvslot = cursor.slot();
+	if (pos + n > kvslot.get_vs() || pos + n < pos)
+		n = kvslot.get_vs() - pos;
+
+	log.push_back({std::string(kvslot.val() + pos, n), pos});
+	auto &val = log.back().first;
+
+	return {{&val[0], &val[0] + n}};
+}
+
+status tree3::tree3_iterator<false>::commit()
+{
+	/* value is modified in place, in the buffer of its slot */
+	auto val = const_cast<char *>(cursor.slot().val());
+	pmem::obj::transaction::run(pop, [&] {
+		for (auto &p : log) {
+			pmem::obj::transaction::snapshot(val + p.second, p.first.size());
+			std::copy(p.first.begin(), p.first.end(), val + p.second);
 		}
+	});
+	log.clear();
 
-		root_leaf = root_leaf->next.get(); // advance to next linked leaf
+	return status::OK;
+}
+
+void tree3::tree3_iterator<false>::abort()
+{
+	log.clear();
+}
+
+// ===============================================================================================
+// CURSOR METHODS
+// ===============================================================================================
+
+static internal::tree3::KVLeafNode *first_leaf(internal::tree3::KVNode *node)
+{
+	while (node && !node->is_leaf)
+		node = ((internal::tree3::KVInnerNode *)node)->children[0].get();
+	return (internal::tree3::KVLeafNode *)node;
+}
+
+static internal::tree3::KVLeafNode *last_leaf(internal::tree3::KVNode *node)
+{
+	while (node && !node->is_leaf) {
+		auto inner = (internal::tree3::KVInnerNode *)node;
+		node = inner->children[inner->keycount].get();
 	}
+	return (internal::tree3::KVLeafNode *)node;
+}
 
-	// sort recovered leaves in ascending key order
-	leaves.sort([](const internal::tree3::KVRecoveredLeaf &lhs,
-		       const internal::tree3::KVRecoveredLeaf &rhs) {
-		return (lhs.max_key.compare(rhs.max_key) < 0);
-	});
+/* Returns leaf following (or preceding, if not forward) given node in order of
+ * keys or nullptr, if there is none. */
+static internal::tree3::KVLeafNode *sibling_leaf(internal::tree3::KVNode *node,
+						 bool forward)
+{
+	while (node->parent) {
+		internal::tree3::KVInnerNode *inner = node->parent;
+		int idx = 0;
+		while (inner->children[idx].get() != node)
+			idx++;
+		if (forward && idx < inner->keycount)
+			return first_leaf(inner->children[idx + 1].get());
+		if (!forward && idx > 0)
+			return last_leaf(inner->children[idx - 1].get());
+		node = inner;
+	}
+	return nullptr;
+}
 
-	// reconstruct top/inner nodes using adjacent pairs of recovered leaves
-	tree_top.reset(nullptr);
+internal::tree3::KVLeafNode *internal::tree3::KVCursor::find_leaf(string_view key) const
+{
+	KVNode *node = top.get();
+	while (node && !node->is_leaf) {
+		auto inner = (KVInnerNode *)node;
+		uint8_t idx = 0;
+		while (idx < inner->keycount && key.compare(inner->keys[idx]) > 0)
+			idx++;
+		node = inner->children[idx].get();
+	}
+	return (KVLeafNode *)node;
+}
 
-	if (!leaves.empty()) {
-		tree_top = move(leaves.front().leafnode);
-		auto max_key = leaves.front().max_key;
-		leaves.pop_front();
-
-		auto prevnode = tree_top.get();
-		while (!leaves.empty()) {
-			std::string split_key = std::string(max_key);
-			auto nextnode = leaves.front().leafnode.get();
-			nextnode->parent = prevnode->parent;
-			InnerUpdateAfterSplit(prevnode, move(leaves.front().leafnode),
-					      &split_key);
-			max_key = leaves.front().max_key;
-			leaves.pop_front();
-			prevnode = nextnode;
-		}
+/* Moves to the first (or last, if not forward) key of given leaf, skipping
+ * leaves without keys. */
+void internal::tree3::KVCursor::enter(KVLeafNode *node, bool forward)
+{
+	while (node) {
+		node->sort();
+		if (node->ordered > 0)
+			break;
+		node = sibling_leaf(node, forward);
 	}
+	leafnode = node;
+	if (node)
+		idx = forward ? (uint8_t)0 : (uint8_t)(node->ordered - 1);
+}
 
-	LOG("Recovered ok");
+void internal::tree3::KVCursor::seek_first()
+{
+	enter(first_leaf(top.get()), true);
+}
+
+void internal::tree3::KVCursor::seek_last()
+{
+	enter(last_leaf(top.get()), false);
+}
+
+void internal::tree3::KVCursor::seek_higher(string_view key, bool inclusive)
+{
+	auto node = find_leaf(key);
+	if (!node) {
+		reset();
+		return;
+	}
+
+	// keys of preceding leaves are all lower, of following ones all higher
+	node->sort();
+	uint8_t pos = 0;
+	for (; pos < node->ordered; pos++) {
+		int cmp = string_view(node->keys[node->order[pos]]).compare(key);
+		if (inclusive ? cmp >= 0 : cmp > 0)
+			break;
+	}
+
+	if (pos < node->ordered) {
+		leafnode = node;
+		idx = pos;
+	} else {
+		enter(sibling_leaf(node, true), true);
+	}
+}
+
+void internal::tree3::KVCursor::seek_lower(string_view key, bool inclusive)
+{
+	auto node = find_leaf(key);
+	if (!node) {
+		reset();
+		return;
+	}
+
+	node->sort();
+	uint8_t pos = 0;
+	for (; pos < node->ordered; pos++) {
+		int cmp = string_view(node->keys[node->order[pos]]).compare(key);
+		if (inclusive ? cmp > 0 : cmp >= 0)
+			break;
+	}
+
+	if (pos > 0) {
+		leafnode = node;
+		idx = (uint8_t)(pos - 1);
+	} else {
+		enter(sibling_leaf(node, false), false);
+	}
+}
+
+void internal::tree3::KVCursor::next()
+{
+	assert(valid());
+	if (idx + 1 < leafnode->ordered)
+		idx++;
+	else
+		enter(sibling_leaf(leafnode, true), true);
+}
+
+void internal::tree3::KVCursor::prev()
+{
+	assert(valid());
+	if (idx > 0)
+		idx--;
+	else
+		enter(sibling_leaf(leafnode, false), false);
+}
+
+bool internal::tree3::KVCursor::has_next() const
+{
+	assert(valid());
+	if (idx + 1 < leafnode->ordered)
+		return true;
+	return has_sibling(true);
+}
+
+bool internal::tree3::KVCursor::has_prev() const
+{
+	assert(valid());
+	if (idx > 0)
+		return true;
+	return has_sibling(false);
+}
+
+bool internal::tree3::KVCursor::has_sibling(bool forward) const
+{
+	for (auto node = sibling_leaf(leafnode, forward); node;
+	     node = sibling_leaf(node, forward)) {
+		node->sort();
+		if (node->ordered > 0)
+			return true;
+	}
+	return false;
+}
+
+void internal::tree3::KVLeafNode::sort()
+{
+	if (sorted)
+		return;
+
+	ordered = 0;
+	for (uint8_t slot = 0; slot < LEAF_KEYS; slot++) {
+		if (hashes[slot] != 0)
+			order[ordered++] = slot;
+	}
+	std::sort(order, order + ordered, [this](uint8_t lhs, uint8_t rhs) {
+		return keys[lhs].compare(keys[rhs]) < 0;
+	});
+	sorted = true;
 }
 
 // ===============================================================================================
@@ -4,6 +4,7 @@
 #ifndef LIBPMEMKV_TREE3_H
 #define LIBPMEMKV_TREE3_H
 
+#include "../iterator.h"
 #include "../pmemobj_engine.h"
 
 #include <libpmemobj++/make_persistent.hpp>
@@ -38,6 +39,7 @@ namespace tree3
 #define INNER_KEYS_UPPER ((INNER_KEYS / 2) + 1) // index where upper half of keys begins
 #define LEAF_KEYS 48				// maximum keys in tree nodes
 #define LEAF_KEYS_MIDPOINT (LEAF_KEYS / 2)	// halfway point within the node
+#define RECOVERY_LEAVES_PER_THREAD 4096		// minimum leaves decoded by one thread
 
 class KVSlot {
 public:
@@ -166,11 +168,66 @@ struct KVLeafNode final : KVNode {   // volatile leaf nodes of the tree
 	uint8_t hashes[LEAF_KEYS];   // Pearson hashes of keys
 	std::string keys[LEAF_KEYS]; // keys stored in this leaf
 	persistent_ptr<KVLeaf> leaf; // pointer to persistent leaf
+	bool sorted = false;	     // indicate order is up to date
+	uint8_t ordered;	     // count of used slots in order
+	uint8_t order[LEAF_KEYS];    // used slots in ascending order of keys
+	void sort();		     // update order, if not sorted already
 };
 
-struct KVRecoveredLeaf {		 // temporary wrapper used for recovery
-	unique_ptr<KVLeafNode> leafnode; // leaf node being recovered
-	std::string max_key;		 // highest sorting key present
+struct KVRecoveredLeaf {	     // temporary wrapper used for recovery
+	unique_ptr<KVNode> leafnode; // leaf (or inner) node being recovered
+	std::string max_key;	     // highest sorting key present
+};
+
+/*
+ * Position of a key in the volatile tree, used for ordered reads. Leaves are not
+ * linked, so neighbours are found through parents; slots of a leaf are sorted
+ * lazily, when the cursor enters it. Cursor is invalidated by puts and removes.
+ */
+class KVCursor {
+public:
+	KVCursor(const unique_ptr<KVNode> &top) : top(top)
+	{
+	}
+
+	bool valid() const
+	{
+		return leafnode != nullptr;
+	}
+	void reset()
+	{
+		leafnode = nullptr;
+	}
+
+	void seek_first();
+	void seek_last();
+	/* first key higher than (or equal to, if inclusive) given key */
+	void seek_higher(string_view key, bool inclusive);
+	/* last key lower than (or equal to, if inclusive) given key */
+	void seek_lower(string_view key, bool inclusive);
+
+	void next();
+	void prev();
+	bool has_next() const;
+	bool has_prev() const;
+
+	const std::string &key() const
+	{
+		return leafnode->keys[leafnode->order[idx]];
+	}
+	const KVSlot &slot() const
+	{
+		return leafnode->leaf->slots[leafnode->order[idx]].get_ro();
+	}
+
+private:
+	KVLeafNode *find_leaf(string_view key) const;
+	void enter(KVLeafNode *node, bool forward);
+	bool has_sibling(bool forward) const;
+
+	const unique_ptr<KVNode> &top;
+	KVLeafNode *leafnode = nullptr;
+	uint8_t idx = 0;
 };
 
 } /* namespace tree3 */
@@ -187,8 +244,35 @@ public:
 	std::string name() final;
 
 	status count_all(std::size_t &cnt) final;
+	status count_above(string_view key, std::size_t &cnt) final;
+	status count_equal_above(string_view key, std::size_t &cnt) final;
+	status count_equal_below(string_view key, std::size_t &cnt) final;
+	status count_below(string_view key, std::size_t &cnt) final;
+	status count_between(string_view key1, string_view key2, std::size_t &cnt) final;
+	status count_prefix(string_view prefix, std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_above(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_equal_above(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_equal_below(string_view key, get_kv_callback *callback,
+			       void *arg) final;
+	status get_below(string_view key, get_kv_callback *callback, void *arg) final;
+	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
+			   void *arg) final;
+	status get_prefix(string_view prefix, get_kv_callback *callback, void *arg) final;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) final;
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) final;
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) final;
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) final;
 
 	status exists(string_view key) final;
 
@@ -198,6 +282,9 @@ public:
 
 	status remove(string_view key) final;
 
+	internal::iterator_base *new_iterator() final;
+	internal::iterator_base *new_const_iterator() final;
+
 protected:
 	internal::tree3::KVLeafNode *LeafSearch(const std::string &key);
 	void LeafFillEmptySlot(internal::tree3::KVLeafNode *leafnode, uint8_t hash,
@@ -216,9 +303,55 @@ protected:
 	void Recover();
 
 private:
+	template <bool IsConst>
+	class tree3_iterator;
+
 	vector<persistent_ptr<internal::tree3::KVLeaf>>
 		leaves_prealloc;		      // persisted but unused leaves
 	unique_ptr<internal::tree3::KVNode> tree_top; // pointer to uppermost inner node
+	std::size_t elements = 0;		      // count of stored keys
+};
+
+template <>
+class tree3::tree3_iterator<true> : public internal::iterator_base {
+public:
+	tree3_iterator(const unique_ptr<internal::tree3::KVNode> &top);
+
+	status seek(string_view key) final;
+	status seek_lower(string_view key) final;
+	status seek_lower_eq(string_view key) final;
+	status seek_higher(string_view key) final;
+	status seek_higher_eq(string_view key) final;
+
+	status seek_to_first() final;
+	status seek_to_last() final;
+
+	status is_next() final;
+	status next() final;
+	status prev() final;
+
+	result<string_view> key() final;
+
+	result<pmem::obj::slice<const char *>> read_range(size_t pos, size_t n) final;
+
+protected:
+	internal::tree3::KVCursor cursor;
+};
+
+template <>
+class tree3::tree3_iterator<false> : public tree3::tree3_iterator<true> {
+public:
+	tree3_iterator(const unique_ptr<internal::tree3::KVNode> &top,
+		       pmem::obj::pool_base &pop);
+
+	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
+
+	status commit() final;
+	void abort() final;
+
+private:
+	pmem::obj::pool_base &pop;
+	std::vector<std::pair<std::string, size_t>> log;
 };
 
 class tree3_factory : public engine_base::factory_base {
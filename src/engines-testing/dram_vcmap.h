@@ -21,6 +21,11 @@ public:
 	static allocator_type<T> create(internal::config& cfg) {
 		return allocator_type<T>();
 	}
+
+	static void memory_usage(memory_stats &stats, uint64_t size)
+	{
+		throw internal::not_supported("Memory statistics are not available for std::allocator");
+	}
 };
 } /* namespace internal */
 
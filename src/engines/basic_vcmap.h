@@ -6,6 +6,7 @@
 
 #include "../engine.h"
 #include "../out.h"
+#include "../parallel.h"
 
 #include <cassert>
 #include <memory>
@@ -28,19 +29,26 @@ public:
 	~basic_vcmap();
 
 	std::string name() final;
+	bool concurrent() const final;
 
 	status count_all(std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
 
 	status exists(string_view key) final;
 
 	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key,
+		       std::unique_ptr<internal::value_ref_base> &ref) final;
 
 	status put(string_view key, string_view value) final;
 
 	status remove(string_view key) final;
 
+	status memory_usage(memory_stats &stats) final;
+
 	internal::iterator_base *new_iterator() final;
 	internal::iterator_base *new_const_iterator() final;
 
@@ -58,6 +66,8 @@ private:
 	kv_allocator_t kv_allocator;
 	ch_allocator_t ch_allocator;
 	map_t pmem_kv_container;
+	/* size of the allocator's memory, 0 if not limited */
+	uint64_t size = 0;
 };
 
 template <typename AllocatorFactory>
@@ -66,6 +76,7 @@ basic_vcmap<AllocatorFactory>::basic_vcmap(std::unique_ptr<internal::config> cfg
       ch_allocator(kv_allocator),
       pmem_kv_container(std::scoped_allocator_adaptor<kv_allocator_t>(kv_allocator))
 {
+	cfg->get_uint64("size", &size);
 	LOG("Started ok");
 }
 
@@ -81,6 +92,12 @@ std::string basic_vcmap<AllocatorFactory>::name()
 	return "basic_vcmap";
 }
 
+template <typename AllocatorFactory>
+bool basic_vcmap<AllocatorFactory>::concurrent() const
+{
+	return true;
+}
+
 template <typename AllocatorFactory>
 status basic_vcmap<AllocatorFactory>::count_all(std::size_t &cnt)
 {
@@ -105,6 +122,40 @@ status basic_vcmap<AllocatorFactory>::get_all(get_kv_callback *callback, void *a
 	return status::OK;
 }
 
+/*
+ * Partitions are bucket ranges produced by splitting range() of the map, the
+ * same way tbb::parallel_for would do it.
+ */
+template <typename AllocatorFactory>
+status basic_vcmap<AllocatorFactory>::get_all_parallel(std::size_t num_partitions,
+						       get_kv_callback *callback,
+						       void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+
+	using range_type = typename map_t::const_range_type;
+	std::vector<range_type> ranges{pmem_kv_container.range()};
+	for (bool split = true; split && ranges.size() < num_partitions;) {
+		split = false;
+		auto n = ranges.size();
+		for (std::size_t i = 0; i < n && ranges.size() < num_partitions; i++) {
+			if (ranges[i].is_divisible()) {
+				/* splitting constructor leaves the first half in ranges[i] */
+				range_type second_half(ranges[i], tbb::split());
+				ranges.push_back(second_half);
+				split = true;
+			}
+		}
+	}
+
+	return internal::parallel_scan(
+		ranges.size(), callback, arg,
+		[&](std::size_t i, get_kv_callback *cb, void *cb_arg) {
+			internal::iterate_through_pairs(ranges[i].begin(),
+							ranges[i].end(), cb, cb_arg);
+		});
+}
+
 template <typename AllocatorFactory>
 status basic_vcmap<AllocatorFactory>::exists(string_view key)
 {
@@ -134,6 +185,30 @@ status basic_vcmap<AllocatorFactory>::get(string_view key, get_v_callback *callb
 	return status::OK;
 }
 
+template <typename AllocatorFactory>
+status
+basic_vcmap<AllocatorFactory>::get_ref(string_view key,
+				       std::unique_ptr<internal::value_ref_base> &ref)
+{
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
+
+	using ref_type = internal::guarded_value_ref<typename map_t::const_accessor>;
+	std::unique_ptr<ref_type> result(new ref_type());
+	// XXX - do not create temporary string
+	const bool result_found = pmem_kv_container.find(
+		result->guard, pmem_string(key.data(), key.size(), ch_allocator));
+	if (!result_found) {
+		LOG("  key not found");
+		return status::NOT_FOUND;
+	}
+
+	result->set_value(
+		string_view(result->guard->second.c_str(), result->guard->second.size()));
+	ref = std::move(result);
+
+	return status::OK;
+}
+
 template <typename AllocatorFactory>
 status basic_vcmap<AllocatorFactory>::put(string_view key, string_view value)
 {
@@ -163,6 +238,21 @@ status basic_vcmap<AllocatorFactory>::remove(string_view key)
 	return (erased ? status::OK : status::NOT_FOUND);
 }
 
+template <typename AllocatorFactory>
+status basic_vcmap<AllocatorFactory>::memory_usage(memory_stats &stats)
+{
+	LOG("memory_usage");
+
+	auto s = count_data_size(stats);
+	if (s != status::OK)
+		return s;
+
+	AllocatorFactory::memory_usage(stats, size);
+	set_bytes_per_key(stats);
+
+	return status::OK;
+}
+
 template <typename AllocatorFactory>
 class basic_vcmap<AllocatorFactory>::basic_vcmap_const_iterator
     : virtual public internal::iterator_base {
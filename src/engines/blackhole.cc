@@ -79,6 +79,15 @@ status blackhole::count_between(string_view key1, string_view key2, std::size_t
 	return status::OK;
 }
 
+status blackhole::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+
+	cnt = 0;
+
+	return status::OK;
+}
+
 status blackhole::get_all(get_kv_callback *callback, void *arg)
 {
 	LOG("get_all");
@@ -122,6 +131,13 @@ status blackhole::get_between(string_view key1, string_view key2,
 	return status::NOT_FOUND;
 }
 
+status blackhole::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+
+	return status::NOT_FOUND;
+}
+
 status blackhole::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
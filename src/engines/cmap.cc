@@ -3,7 +3,11 @@
 
 #include "cmap.h"
 #include "../out.h"
+#include "../parallel.h"
 
+#include <new>
+#include <string>
+#include <unordered_set>
 #include <unistd.h>
 
 namespace pmem
@@ -11,18 +15,131 @@ namespace pmem
 namespace kv
 {
 
-cmap::cmap(std::unique_ptr<internal::config> cfg) : pmemobj_engine_base(cfg, "pmemkv")
+namespace
+{
+
+/* Helpers for operations which are the same for containers of both layouts. */
+
+/* Keys from 'skip' (expired, but not removed yet) are not passed to the callback */
+template <typename It>
+status iterate(It first, It last, const std::unordered_set<std::string> &skip,
+	       get_kv_callback *callback, void *arg)
+{
+	for (auto it = first; it != last; ++it) {
+		auto key = internal::cmap::entry_key(*it);
+		if (!skip.empty() && skip.count(std::string(key.data(), key.size())))
+			continue;
+		auto value = internal::cmap::entry_value(*it);
+		auto ret = callback(key.data(), key.size(), value.data(), value.size(),
+				    arg);
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+	return status::OK;
+}
+
+/*
+ * Iterators visit buckets in order, so each partition is a range of buckets.
+ * Bounds are found by walking the nodes (without reading keys and values),
+ * as concurrent_hash_map does not allow to create an iterator at given bucket.
+ */
+template <typename Map>
+status iterate_parallel(Map &map, std::size_t num_partitions,
+			const std::unordered_set<std::string> &skip,
+			get_kv_callback *callback, void *arg)
+{
+	auto bounds = internal::split_range(map.begin(), map.end(), map.size(),
+					    num_partitions);
+
+	return internal::parallel_scan(
+		bounds.size() - 1, callback, arg,
+		[&](std::size_t i, get_kv_callback *cb, void *cb_arg) {
+			iterate(bounds[i], bounds[i + 1], skip, cb, cb_arg);
+		});
+}
+
+template <typename Map>
+status find_value(Map &map, string_view key, get_v_callback *callback, void *arg)
+{
+	typename Map::const_accessor result;
+	bool found = map.find(result, key);
+	if (!found)
+		return status::NOT_FOUND;
+
+	auto value = internal::cmap::entry_value(*result);
+	callback(value.data(), value.size(), arg);
+	return status::OK;
+}
+
+/*
+ * The returned reference holds const_accessor to the element, so the value
+ * cannot be modified nor removed until the reference is released.
+ */
+template <typename Map>
+status find_value_ref(Map &map, string_view key,
+		      std::unique_ptr<internal::value_ref_base> &ref)
+{
+	using ref_type = internal::guarded_value_ref<typename Map::const_accessor>;
+	std::unique_ptr<ref_type> result(new ref_type());
+	bool found = map.find(result->guard, key);
+	if (!found)
+		return status::NOT_FOUND;
+
+	result->set_value(internal::cmap::entry_value(*result->guard));
+	ref = std::move(result);
+
+	return status::OK;
+}
+
+/*
+ * Creates the container in a transaction (as make_persistent does), but with
+ * the type number given explicitly.
+ */
+template <typename Map>
+PMEMoid make_container(pmem::obj::pool_base &pop, uint64_t type_num)
+{
+	PMEMoid oid = OID_NULL;
+	pmem::obj::transaction::run(pop, [&] {
+		oid = pmemobj_tx_xalloc(sizeof(Map), type_num, 0);
+		if (OID_IS_NULL(oid))
+			throw pmem::transaction_alloc_error(
+				"Failed to allocate persistent memory object");
+		new (pmemobj_direct(oid)) Map();
+	});
+
+	return oid;
+}
+
+} /* anonymous namespace */
+
+cmap::cmap(std::unique_ptr<internal::config> cfg)
+    : pmemobj_engine_base(cfg, "pmemkv", true)
 {
 	static_assert(
 		sizeof(internal::cmap::string_t) == 40,
 		"Wrong size of cmap value and key. This probably means that std::string has size > 32");
+	static_assert(sizeof(internal::cmap::compact_entry) == 16,
+		      "Wrong size of cmap compact entry");
+
+	tracker.reset(new internal::expiry_tracker([this](string_view key) {
+		expire_key(key, [&] {
+			return tracker->erase_expired(key, [&] {
+				erase(key);
+				expiry_index->erase(key);
+			});
+		});
+	}));
 
 	LOG("Started ok");
-	Recover();
+	Recover(*cfg);
+	start_defrag_scheduler(*cfg);
 }
 
 cmap::~cmap()
 {
+	/* background threads must not touch the pool after it is closed */
+	stop_defrag_scheduler();
+	tracker->stop();
 	LOG("Stopped ok");
 }
 
@@ -31,11 +148,26 @@ std::string cmap::name()
 	return "cmap";
 }
 
+bool cmap::concurrent() const
+{
+	return true;
+}
+
+void cmap::set_expire_hook(expire_hook hook)
+{
+	engine_base::set_expire_hook(std::move(hook));
+	tracker->start();
+}
+
 status cmap::count_all(std::size_t &cnt)
 {
 	LOG("count_all");
 	check_outside_tx();
-	cnt = container->size();
+	cnt = container_size();
+
+	for (auto &key : tracker->expired_keys())
+		if (exists_in_container(key))
+			cnt--;
 
 	return status::OK;
 }
@@ -44,31 +176,71 @@ status cmap::get_all(get_kv_callback *callback, void *arg)
 {
 	LOG("get_all");
 	check_outside_tx();
-	auto it = container->begin();
-	auto end = container->end();
-	return internal::iterate_through_pairs(it, end, callback, arg);
+
+	auto lock = scan_lock();
+	auto expired = tracker->expired_keys();
+	if (compact_container)
+		return iterate(compact_container->begin(), compact_container->end(),
+			       expired, callback, arg);
+	return iterate(container->begin(), container->end(), expired, callback, arg);
+}
+
+status cmap::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+			      void *arg)
+{
+	LOG("get_all_parallel num_partitions=" << num_partitions);
+	check_outside_tx();
+
+	auto lock = scan_lock();
+	auto expired = tracker->expired_keys();
+	if (compact_container)
+		return iterate_parallel(*compact_container, num_partitions, expired,
+					callback, arg);
+	return iterate_parallel(*container, num_partitions, expired, callback, arg);
 }
 
 status cmap::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
-	return container->count(key) == 1 ? status::OK : status::NOT_FOUND;
+	if (tracker->expired(key))
+		return status::NOT_FOUND;
+	return exists_in_container(key) ? status::OK : status::NOT_FOUND;
 }
 
 status cmap::get(string_view key, get_v_callback *callback, void *arg)
 {
 	LOG("get key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
-	internal::cmap::map_t::const_accessor result;
-	bool found = container->find(result, key);
-	if (!found) {
+	internal::defrag_scheduler::latency_probe probe(defrag_sched.get());
+	if (tracker->expired(key)) {
+		LOG("  key expired");
+		return status::NOT_FOUND;
+	}
+
+	auto s = compact_container ? find_value(*compact_container, key, callback, arg)
+				   : find_value(*container, key, callback, arg);
+	if (s == status::NOT_FOUND)
 		LOG("  key not found");
+
+	return s;
+}
+
+status cmap::get_ref(string_view key, std::unique_ptr<internal::value_ref_base> &ref)
+{
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
+	check_outside_tx();
+	if (tracker->expired(key)) {
+		LOG("  key expired");
 		return status::NOT_FOUND;
 	}
 
-	callback(result->second.c_str(), result->second.size(), arg);
-	return status::OK;
+	auto s = compact_container ? find_value_ref(*compact_container, key, ref)
+				   : find_value_ref(*container, key, ref);
+	if (s == status::NOT_FOUND)
+		LOG("  key not found");
+
+	return s;
 }
 
 status cmap::put(string_view key, string_view value)
@@ -76,8 +248,53 @@ status cmap::put(string_view key, string_view value)
 	LOG("put key=" << std::string(key.data(), key.size())
 		       << ", value.size=" << std::to_string(value.size()));
 	check_outside_tx();
+	auto arena = assign_arena();
+	internal::defrag_scheduler::latency_probe probe(defrag_sched.get());
+
+	if (!tracker->active()) {
+		assign(key, value);
+		return status::OK;
+	}
+
+	/*
+	 * Value is written before the deadline is dropped - if interrupted,
+	 * the new value may be left with the previous deadline.
+	 */
+	auto lock = tracker->lock_key(key);
+	assign(key, value);
+	if (tracker->clear(key))
+		expiry_index->erase(key);
+
+	return status::OK;
+}
+
+/*
+ * Deadline is stored (in the expiry index) before the value, so if interrupted,
+ * previous value of the key may expire, but the new one is never left without
+ * its deadline.
+ */
+status cmap::put_with_ttl(string_view key, string_view value, uint64_t ttl_ms)
+{
+	LOG("put_with_ttl key=" << std::string(key.data(), key.size())
+				<< ", value.size=" << std::to_string(value.size())
+				<< ", ttl_ms=" << ttl_ms);
+	check_outside_tx();
+	auto arena = assign_arena();
+
+	if (ttl_ms == 0)
+		throw internal::invalid_argument("TTL must be greater than 0");
+	if (!expiry_oid)
+		throw internal::not_supported(
+			"Expiring keys are supported only in db opened with \"path\"");
+
+	create_expiry_index();
 
-	container->insert_or_assign(key, value);
+	auto deadline = internal::expiry_tracker::deadline(ttl_ms);
+	auto encoded = internal::expiry_tracker::encode(deadline);
+	auto lock = tracker->lock_key(key);
+	expiry_index->insert_or_assign(key, string_view(encoded.data(), encoded.size()));
+	assign(key, value);
+	tracker->set(key, deadline);
 
 	return status::OK;
 }
@@ -86,9 +303,21 @@ status cmap::remove(string_view key)
 {
 	LOG("remove key=" << std::string(key.data(), key.size()));
 	check_outside_tx();
+	auto arena = assign_arena();
+	internal::defrag_scheduler::latency_probe probe(defrag_sched.get());
 
-	bool erased = container->erase(key);
-	return erased ? status::OK : status::NOT_FOUND;
+	if (!tracker->active()) {
+		bool erased = erase(key);
+		return erased ? status::OK : status::NOT_FOUND;
+	}
+
+	auto lock = tracker->lock_key(key);
+	bool expired = tracker->expired(key);
+	bool erased = erase(key);
+	if (tracker->clear(key))
+		expiry_index->erase(key);
+
+	return erased && !expired ? status::OK : status::NOT_FOUND;
 }
 
 status cmap::defrag(double start_percent, double amount_percent)
@@ -97,8 +326,13 @@ status cmap::defrag(double start_percent, double amount_percent)
 				       << " amount_percent = " << amount_percent);
 	check_outside_tx();
 
+	std::unique_lock<std::mutex> lock(defrag_mtx);
+
 	try {
-		container->defragment(start_percent, amount_percent);
+		if (compact_container)
+			compact_container->defragment(start_percent, amount_percent);
+		else
+			container->defragment(start_percent, amount_percent);
 	} catch (std::range_error &e) {
 		out_err_stream("defrag") << e.what();
 		return status::INVALID_ARGUMENT;
@@ -110,90 +344,217 @@ status cmap::defrag(double start_percent, double amount_percent)
 	return status::OK;
 }
 
-void cmap::Recover()
+void cmap::assign(string_view key, string_view value)
 {
-	if (!OID_IS_NULL(*root_oid)) {
-		container = (pmem::kv::internal::cmap::map_t *)pmemobj_direct(*root_oid);
-		container->runtime_initialize();
+	if (!compact_container) {
+		container->insert_or_assign(key, value);
+		return;
+	}
+
+	/* new entry is allocated (with the key and the value) by the hashmap */
+	internal::cmap::compact_map_t::accessor acc;
+	if (compact_container->insert(
+		    acc, internal::cmap::compact_kv{key, value, alloc_cls.get()}))
+		return;
+
+	pmem::obj::transaction::run(pmpool, [&] {
+		/* does not change the key, on which position in the hashmap depends */
+		const_cast<internal::cmap::compact_entry &>(acc->first)
+			.assign_value(value, alloc_cls.get());
+	});
+}
+
+bool cmap::erase(string_view key)
+{
+	if (compact_container)
+		return compact_container->erase(key);
+	return container->erase(key);
+}
+
+/*
+ * Scans do not lock buckets, so they cannot run concurrently with the background
+ * defrag. Without it, scans are not serialized with each other (defrag called by
+ * the user must not run concurrently with scans, as before).
+ */
+std::unique_lock<std::mutex> cmap::scan_lock()
+{
+	if (!defrag_sched)
+		return std::unique_lock<std::mutex>();
+	return std::unique_lock<std::mutex>(defrag_mtx);
+}
+
+bool cmap::exists_in_container(string_view key)
+{
+	if (compact_container)
+		return compact_container->count(key) == 1;
+	return container->count(key) == 1;
+}
+
+std::size_t cmap::container_size()
+{
+	if (compact_container)
+		return compact_container->size();
+	return container->size();
+}
+
+void cmap::create_expiry_index()
+{
+	std::unique_lock<std::mutex> lock(expiry_index_mtx);
+	if (expiry_index)
+		return;
+
+	pmem::obj::transaction::run(pmpool, [&] {
+		pmem::obj::transaction::snapshot(expiry_oid);
+		*expiry_oid = pmem::obj::make_persistent<internal::cmap::map_t>().raw();
+	});
+	auto index = (internal::cmap::map_t *)pmemobj_direct(*expiry_oid);
+	index->runtime_initialize();
+	expiry_index = index;
+}
+
+void cmap::Recover(internal::config &cfg)
+{
+	/* layout of existing data is recognized by its type number */
+	bool compact;
+	if (OID_IS_NULL(*root_oid)) {
+		uint64_t layout_version = 1;
+		cfg.get_uint64("layout_version", &layout_version);
+		if (layout_version != 1 && layout_version != 2)
+			throw internal::invalid_argument(
+				"Config item \"layout_version\" must be 1 or 2");
+		compact = layout_version == 2;
 	} else {
+		compact = pmemobj_type_num(*root_oid) ==
+			internal::cmap::compact_map_type_num;
+	}
+
+	/* only entries of the compact layout are allocated with custom classes */
+	if (!compact && internal::alloc_classes::enabled(cfg))
+		throw internal::invalid_argument(
+			"Config item \"alloc_classes\" requires layout_version 2");
+
+	if (OID_IS_NULL(*root_oid)) {
 		pmem::obj::transaction::run(pmpool, [&] {
 			pmem::obj::transaction::snapshot(root_oid);
-			*root_oid =
-				pmem::obj::make_persistent<internal::cmap::map_t>().raw();
-			container = (pmem::kv::internal::cmap::map_t *)pmemobj_direct(
-				*root_oid);
-			container->runtime_initialize();
+			if (compact)
+				*root_oid = make_container<internal::cmap::compact_map_t>(
+					pmpool, internal::cmap::compact_map_type_num);
+			else
+				*root_oid = pmem::obj::make_persistent<
+						    internal::cmap::map_t>()
+						    .raw();
 		});
 	}
+
+	if (compact) {
+		compact_container = (internal::cmap::compact_map_t *)pmemobj_direct(
+			*root_oid);
+		compact_container->runtime_initialize();
+		init_alloc_classes(cfg);
+	} else {
+		container = (internal::cmap::map_t *)pmemobj_direct(*root_oid);
+		container->runtime_initialize();
+	}
+
+	/* rebuild the timer wheel from deadlines stored in the expiry index */
+	if (expiry_oid && !OID_IS_NULL(*expiry_oid)) {
+		expiry_index = (internal::cmap::map_t *)pmemobj_direct(*expiry_oid);
+		expiry_index->runtime_initialize();
+		for (auto &e : *expiry_index)
+			tracker->set(string_view(e.first.c_str(), e.first.size()),
+				     internal::expiry_tracker::decode(string_view(
+					     e.second.c_str(), e.second.size())));
+	}
 }
 
 internal::iterator_base *cmap::new_iterator()
 {
-	return new cmap_iterator<false>{container};
+	if (compact_container)
+		return new cmap_iterator<internal::cmap::compact_map_t, false>{
+			compact_container, tracker.get()};
+	return new cmap_iterator<internal::cmap::map_t, false>{container, tracker.get()};
 }
 
 internal::iterator_base *cmap::new_const_iterator()
 {
-	return new cmap_iterator<true>{container};
+	if (compact_container)
+		return new cmap_iterator<internal::cmap::compact_map_t, true>{
+			compact_container, tracker.get()};
+	return new cmap_iterator<internal::cmap::map_t, true>{container, tracker.get()};
 }
 
-cmap::cmap_iterator<true>::cmap_iterator(container_type *c)
-    : container(c), pop(pmem::obj::pool_by_vptr(c))
+template <typename Map>
+cmap::cmap_iterator<Map, true>::cmap_iterator(container_type *c,
+					      internal::expiry_tracker *t)
+    : container(c), tracker(t), pop(pmem::obj::pool_by_vptr(c))
 {
 }
 
-cmap::cmap_iterator<false>::cmap_iterator(container_type *c)
-    : cmap::cmap_iterator<true>(c)
+template <typename Map>
+cmap::cmap_iterator<Map, false>::cmap_iterator(container_type *c,
+					       internal::expiry_tracker *t)
+    : cmap::cmap_iterator<Map, true>(c, t)
 {
 }
 
-status cmap::cmap_iterator<true>::seek(string_view key)
+template <typename Map>
+status cmap::cmap_iterator<Map, true>::seek(string_view key)
 {
 	init_seek();
 
+	if (tracker->expired(key))
+		return status::NOT_FOUND;
+
 	if (container->find(acc_, key))
 		return status::OK;
 
 	return status::NOT_FOUND;
 }
 
-result<string_view> cmap::cmap_iterator<true>::key()
+template <typename Map>
+result<string_view> cmap::cmap_iterator<Map, true>::key()
 {
 	assert(!acc_.empty());
 
-	return {{acc_->first.c_str()}};
+	return {internal::cmap::entry_key(*acc_)};
 }
 
-result<pmem::obj::slice<const char *>> cmap::cmap_iterator<true>::read_range(size_t pos,
-									     size_t n)
+template <typename Map>
+result<pmem::obj::slice<const char *>>
+cmap::cmap_iterator<Map, true>::read_range(size_t pos, size_t n)
 {
 	assert(!acc_.empty());
 
-	if (pos + n > acc_->second.size() || pos + n < pos)
-		n = acc_->second.size() - pos;
+	auto value = internal::cmap::entry_value(*acc_);
+	if (pos + n > value.size() || pos + n < pos)
+		n = value.size() - pos;
 
-	return {{acc_->second.c_str() + pos, acc_->second.c_str() + pos + n}};
+	return {{value.data() + pos, value.data() + pos + n}};
 }
 
-result<pmem::obj::slice<char *>> cmap::cmap_iterator<false>::write_range(size_t pos,
-									 size_t n)
+template <typename Map>
+result<pmem::obj::slice<char *>> cmap::cmap_iterator<Map, false>::write_range(size_t pos,
+									      size_t n)
 {
-	assert(!acc_.empty());
+	assert(!this->acc_.empty());
 
-	if (pos + n > acc_->second.size() || pos + n < pos)
-		n = acc_->second.size() - pos;
+	auto value = internal::cmap::entry_value(*this->acc_);
+	if (pos + n > value.size() || pos + n < pos)
+		n = value.size() - pos;
 
-	log.push_back({std::string(acc_->second.c_str() + pos, n), pos});
+	log.push_back({std::string(value.data() + pos, n), pos});
 	auto &val = log.back().first;
 
 	return {{&val[0], &val[n]}};
 }
 
-status cmap::cmap_iterator<false>::commit()
+template <typename Map>
+status cmap::cmap_iterator<Map, false>::commit()
 {
-	pmem::obj::transaction::run(pop, [&] {
+	pmem::obj::transaction::run(this->pop, [&] {
 		for (auto &p : log) {
-			auto dest = acc_->second.range(p.second, p.first.size());
+			auto dest = internal::cmap::entry_range(*this->acc_, p.second,
+								p.first.size());
 			std::copy(p.first.begin(), p.first.end(), dest.begin());
 		}
 	});
@@ -202,7 +563,8 @@ status cmap::cmap_iterator<false>::commit()
 	return status::OK;
 }
 
-void cmap::cmap_iterator<false>::abort()
+template <typename Map>
+void cmap::cmap_iterator<Map, false>::abort()
 {
 	log.clear();
 }
@@ -4,12 +4,18 @@
 #ifndef LIBPMEMKV_CMAP_H
 #define LIBPMEMKV_CMAP_H
 
+#include "../expiry.h"
 #include "../iterator.h"
 #include "../pmemobj_engine.h"
 #include "../polymorphic_string.h"
 
 #include <libpmemobj++/container/concurrent_hash_map.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <cstring>
+#include <mutex>
 
 namespace pmem
 {
@@ -20,6 +26,136 @@ namespace internal
 namespace cmap
 {
 
+/* key and value of an entry inserted to the compact layout */
+struct compact_kv {
+	string_view key;
+	string_view value;
+	/* custom allocation classes of the engine, may be nullptr */
+	alloc_classes *classes;
+};
+
+/**
+ * Key and value of an entry of the compact layout (version 2), stored together
+ * in a single allocation: sizes of the key and the value, followed by their
+ * bytes. Mapped type of the hashmap is not used in this layout.
+ *
+ * Allocation and deallocation is done in the transaction started by the
+ * hashmap (on insert and erase) or by the caller.
+ */
+class compact_entry {
+public:
+	explicit compact_entry(const compact_kv &kv)
+	{
+		allocate(kv.key, kv.value, kv.classes);
+	}
+
+	compact_entry(const compact_entry &) = delete;
+	compact_entry &operator=(const compact_entry &) = delete;
+
+	~compact_entry()
+	{
+		if (data != nullptr)
+			pmem::obj::delete_persistent<char[]>(data, allocated_size());
+	}
+
+	string_view key() const
+	{
+		return string_view(data.get() + header_size, sizes()[0]);
+	}
+
+	string_view value() const
+	{
+		return string_view(data.get() + header_size + sizes()[0], sizes()[1]);
+	}
+
+	/*
+	 * Replaces the value, must be called in a transaction. The key is left
+	 * unchanged, so the entry may be modified in place in the hashmap.
+	 */
+	void assign_value(string_view value, alloc_classes *classes)
+	{
+		auto key_size = sizes()[0];
+		if (header_size + key_size + value.size() <=
+		    pmemobj_alloc_usable_size(data.raw())) {
+			auto dst = data.get() + header_size + key_size;
+			pmem::obj::transaction::snapshot(&sizes()[1]);
+			pmem::obj::transaction::snapshot(dst, value.size());
+			std::memcpy(dst, value.data(), value.size());
+			sizes()[1] = value.size();
+			return;
+		}
+
+		auto old = data;
+		auto old_size = allocated_size();
+		allocate(string_view(old.get() + header_size, key_size), value, classes);
+		pmem::obj::delete_persistent<char[]>(old, old_size);
+	}
+
+	/* Snapshots the range of the value, must be called in a transaction. */
+	pmem::obj::slice<char *> range(size_t pos, size_t n)
+	{
+		auto begin = data.get() + header_size + sizes()[0] + pos;
+		pmem::obj::transaction::snapshot(begin, n);
+		return {begin, begin + n};
+	}
+
+	bool operator==(string_view rhs) const
+	{
+		return key().compare(rhs) == 0;
+	}
+
+	bool operator==(const compact_kv &rhs) const
+	{
+		return key().compare(rhs.key) == 0;
+	}
+
+	/* for defragmentation */
+	template <typename F>
+	void for_each_ptr(F func)
+	{
+		func(data);
+	}
+
+private:
+	/* sizes of the key and the value */
+	static constexpr size_t header_size = 2 * sizeof(uint64_t);
+
+	uint64_t *sizes() const
+	{
+		return reinterpret_cast<uint64_t *>(data.get());
+	}
+
+	size_t allocated_size() const
+	{
+		return header_size + sizes()[0] + sizes()[1];
+	}
+
+	void allocate(string_view key, string_view value, alloc_classes *classes)
+	{
+		auto size = header_size + key.size() + value.size();
+		data = pmem::obj::make_persistent<char[]>(
+			size, classes ? classes->flag(size)
+				      : pmem::obj::allocation_flag::none());
+		sizes()[0] = key.size();
+		sizes()[1] = value.size();
+		std::memcpy(data.get() + header_size, key.data(), key.size());
+		std::memcpy(data.get() + header_size + key.size(), value.data(),
+			    value.size());
+	}
+
+	pmem::obj::persistent_ptr<char[]> data;
+};
+
+inline bool operator==(string_view lhs, const compact_entry &rhs)
+{
+	return rhs == lhs;
+}
+
+inline bool operator==(const compact_kv &lhs, const compact_entry &rhs)
+{
+	return rhs == lhs;
+}
+
 class key_equal {
 public:
 	template <typename M, typename U>
@@ -46,6 +182,16 @@ public:
 		return hash(str.data(), str.size());
 	}
 
+	size_t operator()(const compact_entry &entry) const
+	{
+		return (*this)(entry.key());
+	}
+
+	size_t operator()(const compact_kv &kv) const
+	{
+		return (*this)(kv.key);
+	}
+
 private:
 	size_t hash(const char *str, size_t size) const
 	{
@@ -59,12 +205,57 @@ private:
 
 using string_t = pmem::kv::polymorphic_string;
 using map_t = pmem::obj::concurrent_hash_map<string_t, string_t, string_hasher>;
+using compact_map_t =
+	pmem::obj::concurrent_hash_map<compact_entry, pmem::obj::p<uint64_t>,
+				       string_hasher>;
+
+/* type number of the compact hashmap, by which the layout is recognized on open */
+static constexpr uint64_t compact_map_type_num = 0x636d617032ULL;
+
+/* accessors of entries of both layouts */
+inline string_view entry_key(const map_t::value_type &e)
+{
+	return string_view(e.first.c_str(), e.first.size());
+}
+
+inline string_view entry_value(const map_t::value_type &e)
+{
+	return string_view(e.second.c_str(), e.second.size());
+}
+
+inline pmem::obj::slice<char *> entry_range(map_t::value_type &e, size_t pos, size_t n)
+{
+	return e.second.range(pos, n);
+}
+
+inline string_view entry_key(const compact_map_t::value_type &e)
+{
+	return e.first.key();
+}
+
+inline string_view entry_value(const compact_map_t::value_type &e)
+{
+	return e.first.value();
+}
+
+inline pmem::obj::slice<char *> entry_range(compact_map_t::value_type &e, size_t pos,
+					    size_t n)
+{
+	/* does not change the key, on which position in the hashmap depends */
+	return const_cast<compact_entry &>(e.first).range(pos, n);
+}
 
 } /* namespace cmap */
 } /* namespace internal */
 
+/**
+ * Keys and values are stored either as persistent strings (layout version 1)
+ * or, in the compact layout (version 2), together in a single allocation.
+ * Layout of existing data is detected on open, "layout_version" from config
+ * is used only when the data is created.
+ */
 class cmap : public pmemobj_engine_base<internal::cmap::map_t> {
-	template <bool IsConst>
+	template <typename Map, bool IsConst>
 	class cmap_iterator;
 
 public:
@@ -76,16 +267,24 @@ public:
 	cmap &operator=(const cmap &) = delete;
 
 	std::string name() final;
+	bool concurrent() const final;
+	/* keys are expired by the reaper only once the hook is set */
+	void set_expire_hook(expire_hook hook) final;
 
 	status count_all(std::size_t &cnt) final;
 
 	status get_all(get_kv_callback *callback, void *arg) final;
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) final;
 
 	status exists(string_view key) final;
 
 	status get(string_view key, get_v_callback *callback, void *arg) final;
+	status get_ref(string_view key,
+		       std::unique_ptr<internal::value_ref_base> &ref) final;
 
 	status put(string_view key, string_view value) final;
+	status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms) final;
 
 	status remove(string_view key) final;
 
@@ -95,16 +294,34 @@ public:
 	internal::iterator_base *new_const_iterator() final;
 
 private:
-	void Recover();
-	internal::cmap::map_t *container;
+	void Recover(internal::config &cfg);
+	void create_expiry_index();
+
+	/* operations on the container of either layout */
+	void assign(string_view key, string_view value);
+	bool erase(string_view key);
+	bool exists_in_container(string_view key);
+	std::size_t container_size();
+	/* held by scans while the background defrag is enabled */
+	std::unique_lock<std::mutex> scan_lock();
+
+	/* exactly one of container and compact_container is set */
+	internal::cmap::map_t *container = nullptr;
+	internal::cmap::compact_map_t *compact_container = nullptr;
+	/* key -> encoded deadline, nullptr until the first put_with_ttl */
+	internal::cmap::map_t *expiry_index = nullptr;
+	std::mutex expiry_index_mtx;
+	std::unique_ptr<internal::expiry_tracker> tracker;
+	/* serializes defrag (also the background one) with scans, see scan_lock() */
+	std::mutex defrag_mtx;
 };
 
-template <>
-class cmap::cmap_iterator<true> : public internal::iterator_base {
-	using container_type = internal::cmap::map_t;
+template <typename Map>
+class cmap::cmap_iterator<Map, true> : public internal::iterator_base {
+	using container_type = Map;
 
 public:
-	cmap_iterator(container_type *container);
+	cmap_iterator(container_type *container, internal::expiry_tracker *tracker);
 
 	status seek(string_view key) final;
 
@@ -114,16 +331,17 @@ public:
 
 protected:
 	container_type *container;
-	container_type::accessor acc_;
+	internal::expiry_tracker *tracker;
+	typename container_type::accessor acc_;
 	pmem::obj::pool_base pop;
 };
 
-template <>
-class cmap::cmap_iterator<false> : public cmap::cmap_iterator<true> {
-	using container_type = internal::cmap::map_t;
+template <typename Map>
+class cmap::cmap_iterator<Map, false> : public cmap::cmap_iterator<Map, true> {
+	using container_type = Map;
 
 public:
-	cmap_iterator(container_type *container);
+	cmap_iterator(container_type *container, internal::expiry_tracker *tracker);
 
 	result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n) final;
 
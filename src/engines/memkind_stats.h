@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_MEMKIND_STATS_H
+#define LIBPMEMKV_MEMKIND_STATS_H
+
+#include "../exceptions.h"
+#include "../libpmemkv.hpp"
+
+#include <memkind.h>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/*
+ * Fills fields of the stats (except for keys, values and count, which have
+ * to be set beforehand) from memkind statistics. The statistics are global,
+ * they cover all kinds used in the process. 'size' is the size of the kind.
+ */
+static inline void memkind_memory_usage(memory_stats &stats, uint64_t size)
+{
+#ifdef MEMKIND_STATS_PRESENT
+	size_t allocated, active, resident;
+	if (memkind_update_cached_stats() != 0 ||
+	    memkind_get_stat(nullptr, MEMKIND_STAT_TYPE_ALLOCATED, &allocated) != 0 ||
+	    memkind_get_stat(nullptr, MEMKIND_STAT_TYPE_ACTIVE, &active) != 0 ||
+	    memkind_get_stat(nullptr, MEMKIND_STAT_TYPE_RESIDENT, &resident) != 0)
+		throw internal::error("Cannot read memkind statistics");
+
+	auto data = stats.keys + stats.values;
+	stats.metadata = allocated > data ? allocated - data : 0;
+	/* rounding of allocations to size classes */
+	stats.allocator_overhead = active > allocated ? active - allocated : 0;
+	/* pages not returned (yet) by the allocator */
+	stats.fragmented = resident > active ? resident - active : 0;
+	stats.free = size > resident ? size - resident : 0;
+#else
+	throw internal::not_supported("Memory statistics require memkind >= 1.10");
+#endif
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_MEMKIND_STATS_H */
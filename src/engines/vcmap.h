@@ -5,6 +5,7 @@
 #define LIBPMEMKV_VCMAP_H
 
 #include "basic_vcmap.h"
+#include "memkind_stats.h"
 #include "pmem_allocator.h"
 
 #ifdef USE_LIBMEMKIND_NAMESPACE
@@ -30,6 +31,11 @@ public:
 	{
 		return allocator_type<T>(cfg.get_path(), cfg.get_size());
 	}
+
+	static void memory_usage(memory_stats &stats, uint64_t size)
+	{
+		memkind_memory_usage(stats, size);
+	}
 };
 }
 
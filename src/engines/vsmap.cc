@@ -2,6 +2,7 @@
 /* Copyright 2017-2021, Intel Corporation */
 
 #include "vsmap.h"
+#include "memkind_stats.h"
 
 #include "../comparator/comparator.h"
 #include "../comparator/volatile_comparator.h"
@@ -106,6 +107,19 @@ status vsmap::count_between(string_view key1, string_view key2, std::size_t &cnt
 	return status::OK;
 }
 
+status vsmap::count_prefix(string_view prefix, std::size_t &cnt)
+{
+	LOG("count_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	internal::check_prefix_support(pmem_kv_container.key_comp());
+	// XXX - do not create temporary string
+	auto it = pmem_kv_container.lower_bound(
+		key_type(prefix.data(), prefix.size(), kv_allocator));
+	auto end = pmem_kv_container.end();
+
+	cnt = internal::prefix_distance(it, end, prefix);
+	return status::OK;
+}
+
 status vsmap::get_all(get_kv_callback *callback, void *arg)
 {
 	LOG("get_all");
@@ -169,6 +183,81 @@ status vsmap::get_between(string_view key1, string_view key2, get_kv_callback *c
 	return status::OK;
 }
 
+status vsmap::get_all_desc(get_kv_callback *callback, void *arg)
+{
+	LOG("get_all_desc");
+	auto first = pmem_kv_container.begin();
+	auto last = pmem_kv_container.end();
+	return internal::iterate_through_pairs_desc(first, last, callback, arg);
+}
+
+status vsmap::get_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_above_desc for key=" << std::string(key.data(), key.size()));
+	// XXX - do not create temporary string
+	auto it = pmem_kv_container.upper_bound(
+		key_type(key.data(), key.size(), kv_allocator));
+	auto end = pmem_kv_container.end();
+	return internal::iterate_through_pairs_desc(it, end, callback, arg);
+}
+
+status vsmap::get_equal_above_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_above_desc for key=" << std::string(key.data(), key.size()));
+	// XXX - do not create temporary string
+	auto it = pmem_kv_container.lower_bound(
+		key_type(key.data(), key.size(), kv_allocator));
+	auto end = pmem_kv_container.end();
+	return internal::iterate_through_pairs_desc(it, end, callback, arg);
+}
+
+status vsmap::get_equal_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_equal_below_desc for key=" << std::string(key.data(), key.size()));
+	auto it = pmem_kv_container.begin();
+	// XXX - do not create temporary string
+	auto end = pmem_kv_container.upper_bound(
+		key_type(key.data(), key.size(), kv_allocator));
+	return internal::iterate_through_pairs_desc(it, end, callback, arg);
+}
+
+status vsmap::get_below_desc(string_view key, get_kv_callback *callback, void *arg)
+{
+	LOG("get_below_desc for key=" << std::string(key.data(), key.size()));
+	auto it = pmem_kv_container.begin();
+	// XXX - do not create temporary string
+	auto end = pmem_kv_container.lower_bound(
+		key_type(key.data(), key.size(), kv_allocator));
+	return internal::iterate_through_pairs_desc(it, end, callback, arg);
+}
+
+status vsmap::get_between_desc(string_view key1, string_view key2,
+			       get_kv_callback *callback, void *arg)
+{
+	LOG("get_between_desc for key1=" << key1.data() << ", key2=" << key2.data());
+	if (pmem_kv_container.key_comp()(key1, key2)) {
+		// XXX - do not create temporary string
+		auto it = pmem_kv_container.upper_bound(
+			key_type(key1.data(), key1.size(), kv_allocator));
+		auto end = pmem_kv_container.lower_bound(
+			key_type(key2.data(), key2.size(), kv_allocator));
+		return internal::iterate_through_pairs_desc(it, end, callback, arg);
+	}
+
+	return status::OK;
+}
+
+status vsmap::get_prefix(string_view prefix, get_kv_callback *callback, void *arg)
+{
+	LOG("get_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	internal::check_prefix_support(pmem_kv_container.key_comp());
+	// XXX - do not create temporary string
+	auto it = pmem_kv_container.lower_bound(
+		key_type(prefix.data(), prefix.size(), kv_allocator));
+	auto end = pmem_kv_container.end();
+	return internal::iterate_through_prefix(it, end, prefix, callback, arg);
+}
+
 status vsmap::exists(string_view key)
 {
 	LOG("exists for key=" << std::string(key.data(), key.size()));
@@ -193,6 +282,22 @@ status vsmap::get(string_view key, get_v_callback *callback, void *arg)
 	return status::OK;
 }
 
+status vsmap::get_ref(string_view key, std::unique_ptr<internal::value_ref_base> &ref)
+{
+	LOG("get_ref key=" << std::string(key.data(), key.size()));
+	// XXX - do not create temporary string
+	const auto pos =
+		pmem_kv_container.find(key_type(key.data(), key.size(), kv_allocator));
+	if (pos == pmem_kv_container.end()) {
+		LOG("  key not found");
+		return status::NOT_FOUND;
+	}
+
+	ref.reset(new internal::value_ref_base(
+		string_view(pos->second.c_str(), pos->second.size())));
+	return status::OK;
+}
+
 status vsmap::put(string_view key, string_view value)
 {
 	LOG("put key=" << std::string(key.data(), key.size())
@@ -219,6 +324,50 @@ status vsmap::remove(string_view key)
 	return (erased ? status::OK : status::NOT_FOUND);
 }
 
+status vsmap::remove_range(string_view key1, string_view key2)
+{
+	LOG("remove_range for key1=" << std::string(key1.data(), key1.size())
+				     << ", key2=" << std::string(key2.data(), key2.size()));
+
+	if (pmem_kv_container.key_comp()(key1, key2)) {
+		// XXX - do not create temporary string
+		auto first = pmem_kv_container.lower_bound(
+			key_type(key1.data(), key1.size(), kv_allocator));
+		auto last = pmem_kv_container.lower_bound(
+			key_type(key2.data(), key2.size(), kv_allocator));
+		pmem_kv_container.erase(first, last);
+	}
+
+	return status::OK;
+}
+
+status vsmap::remove_prefix(string_view prefix)
+{
+	LOG("remove_prefix for prefix=" << std::string(prefix.data(), prefix.size()));
+	internal::check_prefix_support(pmem_kv_container.key_comp());
+	// XXX - do not create temporary string
+	auto first = pmem_kv_container.lower_bound(
+		key_type(prefix.data(), prefix.size(), kv_allocator));
+	auto last = internal::prefix_end(first, pmem_kv_container.end(), prefix);
+	pmem_kv_container.erase(first, last);
+
+	return status::OK;
+}
+
+status vsmap::memory_usage(memory_stats &stats)
+{
+	LOG("memory_usage");
+
+	auto s = count_data_size(stats);
+	if (s != status::OK)
+		return s;
+
+	internal::memkind_memory_usage(stats, config->get_size());
+	set_bytes_per_key(stats);
+
+	return status::OK;
+}
+
 internal::iterator_base *vsmap::new_iterator()
 {
 	return new vsmap_iterator<false>{&pmem_kv_container, &kv_allocator};
@@ -308,6 +457,12 @@ status vsmap::vsmap_iterator<true>::seek_higher_eq(string_view key)
 	return status::OK;
 }
 
+status vsmap::vsmap_iterator<true>::seek_prefix(string_view prefix)
+{
+	internal::check_prefix_support(container->key_comp());
+	return iterator_base::seek_prefix(prefix);
+}
+
 status vsmap::vsmap_iterator<true>::seek_to_first()
 {
 	init_seek();
@@ -382,6 +537,26 @@ result<pmem::obj::slice<const char *>> vsmap::vsmap_iterator<true>::read_range(s
 	return {{it_->second.data() + pos, it_->second.data() + pos + n}};
 }
 
+result<size_t> vsmap::vsmap_iterator<true>::next_batch(size_t n, const char **keys,
+						       size_t *kbs, const char **values,
+						       size_t *vbs)
+{
+	init_seek();
+
+	assert(it_ != container->end());
+
+	size_t count = 0;
+	for (auto it = it_; it != container->end() && count < n; ++it, ++count) {
+		keys[count] = it->first.data();
+		kbs[count] = it->first.size();
+		values[count] = it->second.data();
+		vbs[count] = it->second.size();
+		it_ = it;
+	}
+
+	return count;
+}
+
 result<pmem::obj::slice<char *>> vsmap::vsmap_iterator<false>::write_range(size_t pos,
 									   size_t n)
 {
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "executor.h"
+#include "engine.h"
+#include "exceptions.h"
+#include "out.h"
+
+#include <libpmemobj++/pexceptions.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+namespace
+{
+
+/* Converts exceptions thrown by the engine to statuses (as the C API does). */
+template <typename Function>
+status run_op(const char *name, Function &&f)
+{
+	try {
+		return f();
+	} catch (internal::error &e) {
+		out_err_stream(name) << e.what();
+		return static_cast<status>(e.status_code);
+	} catch (std::bad_alloc &e) {
+		out_err_stream(name) << e.what();
+		return status::OUT_OF_MEMORY;
+	} catch (pmem::transaction_scope_error &e) {
+		out_err_stream(name) << e.what();
+		return status::TRANSACTION_SCOPE_ERROR;
+	} catch (std::exception &e) {
+		out_err_stream(name) << e.what();
+		return status::UNKNOWN_ERROR;
+	} catch (...) {
+		out_err_stream(name) << "Unspecified error";
+		return status::UNKNOWN_ERROR;
+	}
+}
+
+} /* anonymous namespace */
+
+executor::params executor::from_config(config &cfg)
+{
+	params p;
+	if (cfg.get_uint64("async_threads", &p.threads) && p.threads == 0)
+		throw internal::invalid_argument(
+			"Config item \"async_threads\" must be greater than 0");
+	cfg.get_uint64("async_batch_size", &p.batch_size);
+
+	if (p.batch_size == 0)
+		throw internal::invalid_argument(
+			"Config item \"async_batch_size\" must be greater than 0");
+
+	return p;
+}
+
+executor::params executor::for_engine(params p, bool concurrent)
+{
+	if (p.threads == 0)
+		p.threads = concurrent ? std::max(1U, std::thread::hardware_concurrency())
+				       : 1;
+	if (p.threads > 1 && !concurrent)
+		throw internal::invalid_argument(
+			"Config item \"async_threads\" must be 1 for not concurrent engines");
+
+	return p;
+}
+
+executor::executor(engine_base &engine, params p)
+    : engine(engine), p(p), pending(0), tx_supported(true)
+{
+	for (size_t i = 0; i < p.threads * shards_per_thread; i++)
+		shards.emplace_back(new shard);
+
+	for (size_t i = 0; i < p.threads; i++)
+		workers.emplace_back([this, i] { run(i); });
+}
+
+executor::~executor()
+{
+	stop();
+}
+
+void executor::get(string_view key, async_callback *callback, void *arg)
+{
+	submit({op_type::get, std::string(key.data(), key.size()), "", callback, arg});
+}
+
+void executor::put(string_view key, string_view value, async_callback *callback,
+		   void *arg)
+{
+	submit({op_type::put, std::string(key.data(), key.size()),
+		std::string(value.data(), value.size()), callback, arg});
+}
+
+void executor::remove(string_view key, async_callback *callback, void *arg)
+{
+	submit({op_type::remove, std::string(key.data(), key.size()), "", callback,
+		arg});
+}
+
+void executor::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		stopped = true;
+	}
+	cv.notify_all();
+
+	for (auto &w : workers)
+		if (w.joinable())
+			w.join();
+}
+
+void executor::submit(operation op)
+{
+	auto &s = *shards[std::hash<std::string>()(op.key) % shards.size()];
+	{
+		std::unique_lock<std::mutex> lock(s.mtx);
+		s.queue.emplace_back(std::move(op));
+	}
+	++pending;
+
+	{
+		/* a worker checks 'pending' and starts waiting under this lock */
+		std::unique_lock<std::mutex> lock(mtx);
+	}
+	cv.notify_one();
+}
+
+void executor::run(size_t worker)
+{
+	auto home = worker * shards_per_thread;
+
+	while (true) {
+		bool processed = false;
+		for (size_t i = 0; i < shards.size(); i++)
+			processed |= process(*shards[(home + i) % shards.size()]);
+
+		if (processed)
+			continue;
+
+		std::unique_lock<std::mutex> lock(mtx);
+		if (pending == 0) {
+			if (stopped)
+				return;
+			cv.wait(lock);
+		} else {
+			/* remaining operations are in shards processed by other workers */
+			cv.wait_for(lock, std::chrono::milliseconds(1));
+		}
+	}
+}
+
+/* Executes a batch of the shard's operations, returns false if it cannot be taken. */
+bool executor::process(shard &s)
+{
+	std::vector<operation> batch;
+	{
+		std::unique_lock<std::mutex> lock(s.mtx);
+		if (s.busy || s.queue.empty())
+			return false;
+
+		s.busy = true;
+		while (!s.queue.empty() && batch.size() < p.batch_size) {
+			batch.emplace_back(std::move(s.queue.front()));
+			s.queue.pop_front();
+		}
+	}
+
+	execute(batch);
+
+	{
+		std::unique_lock<std::mutex> lock(s.mtx);
+		s.busy = false;
+	}
+	pending -= batch.size();
+
+	return true;
+}
+
+void executor::execute(std::vector<operation> &batch)
+{
+	auto it = batch.begin();
+	while (it != batch.end()) {
+		if (it->type != op_type::put) {
+			execute_one(*it);
+			++it;
+			continue;
+		}
+
+		auto last = std::find_if(it, batch.end(), [](const operation &op) {
+			return op.type != op_type::put;
+		});
+		execute_puts(it, last);
+		it = last;
+	}
+}
+
+/*
+ * Commits puts in a single transaction if the engine supports them. If the
+ * transaction cannot be committed, puts are executed one by one (so each gets
+ * its own status).
+ */
+void executor::execute_puts(std::vector<operation>::iterator first,
+			    std::vector<operation>::iterator last)
+{
+	if (last - first > 1 && tx_supported) {
+		auto s = run_op("async_put", [&] {
+			std::unique_ptr<transaction> tx;
+			try {
+				tx.reset(engine.begin_tx());
+			} catch (internal::not_supported &) {
+				tx_supported = false;
+				return status::NOT_SUPPORTED;
+			}
+
+			for (auto it = first; it != last; ++it) {
+				auto s = tx->put(it->key, it->value);
+				if (s != status::OK)
+					return s;
+			}
+
+			return tx->commit();
+		});
+
+		if (s == status::OK) {
+			for (auto it = first; it != last; ++it)
+				complete(*it, status::OK);
+			return;
+		}
+	}
+
+	for (auto it = first; it != last; ++it)
+		execute_one(*it);
+}
+
+void executor::execute_one(operation &op)
+{
+	status s = status::UNKNOWN_ERROR;
+	switch (op.type) {
+		case op_type::get: {
+			/*
+			 * value is copied out, so the callback is not called while
+			 * the engine holds a lock (or an accessor) of the element
+			 */
+			std::string value;
+			s = run_op("async_get", [&] {
+				return engine.get(
+					op.key,
+					[](const char *v, size_t vb, void *arg) {
+						static_cast<std::string *>(arg)->assign(v, vb);
+					},
+					&value);
+			});
+
+			if (s == status::OK) {
+				run_op("async_complete", [&] {
+					op.callback(PMEMKV_STATUS_OK, value.data(),
+						    value.size(), op.arg);
+					return status::OK;
+				});
+				return;
+			}
+			break;
+		}
+		case op_type::put:
+			s = run_op("async_put", [&] { return engine.put(op.key, op.value); });
+			break;
+		case op_type::remove:
+			s = run_op("async_remove", [&] { return engine.remove(op.key); });
+			break;
+	}
+
+	complete(op, s);
+}
+
+/* errors of the callback (e.g. of a completion queue) cannot be passed anywhere */
+void executor::complete(operation &op, status s)
+{
+	run_op("async_complete", [&] {
+		op.callback(static_cast<int>(s), nullptr, 0, op.arg);
+		return status::OK;
+	});
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
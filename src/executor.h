@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_EXECUTOR_H
+#define LIBPMEMKV_EXECUTOR_H
+
+#include "config.h"
+#include "libpmemkv.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+
+class engine_base;
+
+namespace internal
+{
+
+/**
+ * Runs asynchronous get, put and remove operations of an engine.
+ *
+ * Operations are queued in shards (by hash of the key), each shard is processed
+ * by at most one worker at a time, in order of submission - so operations on
+ * the same key complete in that order. Workers start scanning shards from
+ * their own ones and take over (steal) any other non-empty shard which is
+ * not being processed.
+ *
+ * A worker takes up to 'batch_size' operations of a shard at once. Consecutive
+ * puts of a batch are committed in a single transaction, if the engine
+ * supports transactions, so the cost of flushes and fences is shared by them.
+ *
+ * Engines which are not concurrent have a single worker, so their operations
+ * are serialized. Synchronous functions of such engines must not be called
+ * while asynchronous operations are pending, as for any multi-threaded use.
+ */
+class executor {
+public:
+	struct params {
+		/* number of worker threads, 0 until set by for_engine() */
+		uint64_t threads = 0;
+		uint64_t batch_size = 64;
+	};
+
+	/* Returns params from config, they are completed by for_engine(). */
+	static params from_config(config &cfg);
+	/* Sets default number of threads and checks it for the (non-)concurrent engine. */
+	static params for_engine(params p, bool concurrent);
+
+	executor(engine_base &engine, params p);
+	~executor();
+
+	executor(const executor &) = delete;
+	executor &operator=(const executor &) = delete;
+
+	void get(string_view key, async_callback *callback, void *arg);
+	void put(string_view key, string_view value, async_callback *callback,
+		 void *arg);
+	void remove(string_view key, async_callback *callback, void *arg);
+
+	/* Completes all submitted operations and stops workers. */
+	void stop();
+
+private:
+	enum class op_type { get, put, remove };
+
+	struct operation {
+		op_type type;
+		std::string key;
+		std::string value;
+		async_callback *callback;
+		void *arg;
+	};
+
+	struct shard {
+		std::mutex mtx;
+		std::deque<operation> queue;
+		bool busy = false;
+	};
+
+	static constexpr size_t shards_per_thread = 4;
+
+	void submit(operation op);
+	void run(size_t worker);
+	bool process(shard &s);
+	void execute(std::vector<operation> &batch);
+	void execute_puts(std::vector<operation>::iterator first,
+			  std::vector<operation>::iterator last);
+	void execute_one(operation &op);
+	void complete(operation &op, status s);
+
+	engine_base &engine;
+	params p;
+
+	std::vector<std::unique_ptr<shard>> shards;
+	std::vector<std::thread> workers;
+
+	/* number of submitted, not yet completed operations */
+	std::atomic<uint64_t> pending;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stopped = false;
+
+	/* cleared when the engine turns out not to support transactions */
+	std::atomic<bool> tx_supported;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_EXECUTOR_H */
@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "expiry.h"
+#include "out.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+timer_wheel::timer_wheel(uint64_t now_tick) : current(now_tick)
+{
+}
+
+std::size_t timer_wheel::size() const
+{
+	return cnt;
+}
+
+void timer_wheel::add(std::string key, uint64_t tick)
+{
+	++cnt;
+	add(entry(std::move(key), tick));
+}
+
+void timer_wheel::add(entry &&e)
+{
+	if (e.second <= current) {
+		due.emplace_back(std::move(e));
+		return;
+	}
+
+	/*
+	 * Level l is chosen so that the slot holding the tick is reached (and
+	 * cascaded) before the wheel at that level wraps around.
+	 */
+	uint64_t delta = e.second - current;
+	for (std::size_t l = 0; l < levels; l++) {
+		if (delta < (1ULL << (slot_bits * (l + 1)))) {
+			auto slot = (e.second >> (slot_bits * l)) & (slots - 1);
+			wheel[l][slot].emplace_back(std::move(e));
+			++level_cnt[l];
+			return;
+		}
+	}
+
+	overflow.emplace_back(std::move(e));
+}
+
+void timer_wheel::cascade(std::size_t level, std::size_t slot)
+{
+	std::vector<entry> entries;
+	if (level == levels) {
+		entries.swap(overflow);
+	} else {
+		entries.swap(wheel[level][slot]);
+		level_cnt[level] -= entries.size();
+	}
+	for (auto &e : entries)
+		add(std::move(e));
+}
+
+void timer_wheel::advance(uint64_t now_tick, std::vector<entry> &expired)
+{
+	if (cnt == 0) {
+		current = std::max(current, now_tick);
+		return;
+	}
+
+	auto collect = [&](std::vector<entry> &v) {
+		cnt -= v.size();
+		for (auto &e : v)
+			expired.emplace_back(std::move(e));
+		v.clear();
+	};
+
+	collect(due);
+
+	while (current < now_tick && cnt > 0) {
+		/*
+		 * Nothing happens until the next tick at which the lowest non-empty
+		 * level is cascaded (or level 0 slot collected), so skip to it.
+		 */
+		std::size_t lowest = 0;
+		while (lowest < levels - 1 && level_cnt[lowest] == 0)
+			++lowest;
+		uint64_t span = 1ULL << (slot_bits * lowest);
+		current = std::min(now_tick, (current / span + 1) * span);
+
+		/* the highest level first, its entries may land in lower levels */
+		if (current % (1ULL << (slot_bits * (levels - 1))) == 0)
+			cascade(levels, 0);
+		for (std::size_t l = levels - 1; l > 0; l--) {
+			if (current % (1ULL << (slot_bits * l)) != 0)
+				continue;
+			cascade(l, (current >> (slot_bits * l)) & (slots - 1));
+		}
+
+		auto &slot = wheel[0][current & (slots - 1)];
+		level_cnt[0] -= slot.size();
+		collect(slot);
+		collect(due);
+	}
+
+	current = std::max(current, now_tick);
+}
+
+expiry_tracker::expiry_tracker(expire_fn expire, bool background)
+    : expire(std::move(expire)),
+      wheel(now() / tick_ms),
+      background(background),
+      tracked(0)
+{
+}
+
+expiry_tracker::~expiry_tracker()
+{
+	stop();
+}
+
+uint64_t expiry_tracker::now()
+{
+	using namespace std::chrono;
+	return static_cast<uint64_t>(
+		duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+			.count());
+}
+
+uint64_t expiry_tracker::deadline(uint64_t ttl_ms)
+{
+	auto n = now();
+	return ttl_ms > UINT64_MAX - n ? UINT64_MAX : n + ttl_ms;
+}
+
+std::string expiry_tracker::encode(uint64_t deadline)
+{
+	return std::string(reinterpret_cast<const char *>(&deadline), sizeof(deadline));
+}
+
+uint64_t expiry_tracker::decode(string_view encoded)
+{
+	uint64_t deadline = 0;
+	assert(encoded.size() == sizeof(deadline));
+	std::memcpy(&deadline, encoded.data(), sizeof(deadline));
+	return deadline;
+}
+
+std::unique_lock<std::mutex> expiry_tracker::lock_key(string_view key)
+{
+	auto h = std::hash<std::string>{}(std::string(key.data(), key.size()));
+	return std::unique_lock<std::mutex>(locks[h % key_locks]);
+}
+
+bool expiry_tracker::active() const
+{
+	return tracked.load(std::memory_order_acquire) != 0;
+}
+
+void expiry_tracker::set(string_view key, uint64_t deadline)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	std::string k(key.data(), key.size());
+	deadlines[k] = deadline;
+
+	/* wheel stands still while empty, move it to the current time first */
+	if (wheel.size() == 0) {
+		std::vector<timer_wheel::entry> ignored;
+		wheel.advance(now() / tick_ms, ignored);
+	}
+
+	/* round up, so the reaper never sees a key before its deadline */
+	uint64_t tick = deadline / tick_ms + (deadline % tick_ms != 0);
+	wheel.add(std::move(k), tick);
+
+	tracked.store(deadlines.size(), std::memory_order_release);
+	if (!background || !started)
+		return;
+	if (!thread.joinable())
+		thread = std::thread([this] { reaper(); });
+	cv.notify_one();
+}
+
+bool expiry_tracker::clear(string_view key)
+{
+	if (!active())
+		return false;
+
+	/* entry in the wheel is left and skipped by the reaper */
+	std::unique_lock<std::mutex> lock(mtx);
+	bool erased = deadlines.erase(std::string(key.data(), key.size())) == 1;
+	tracked.store(deadlines.size(), std::memory_order_release);
+	return erased;
+}
+
+bool expiry_tracker::expired(string_view key) const
+{
+	if (!active())
+		return false;
+
+	std::unique_lock<std::mutex> lock(mtx);
+	auto it = deadlines.find(std::string(key.data(), key.size()));
+	return it != deadlines.end() && it->second <= now();
+}
+
+bool expiry_tracker::erase_expired(string_view key, const std::function<void()> &erase)
+{
+	auto key_lock = lock_key(key);
+	/* key could be removed or put again in the meantime */
+	if (!expired(key))
+		return false;
+
+	erase();
+
+	std::unique_lock<std::mutex> lock(mtx);
+	deadlines.erase(std::string(key.data(), key.size()));
+	tracked.store(deadlines.size(), std::memory_order_release);
+	return true;
+}
+
+std::unordered_set<std::string> expiry_tracker::expired_keys() const
+{
+	std::unordered_set<std::string> keys;
+	if (!active())
+		return keys;
+
+	auto n = now();
+	std::unique_lock<std::mutex> lock(mtx);
+	for (auto &d : deadlines)
+		if (d.second <= n)
+			keys.insert(d.first);
+	return keys;
+}
+
+void expiry_tracker::start()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	started = true;
+	if (background && !stopped && wheel.size() != 0 && !thread.joinable())
+		thread = std::thread([this] { reaper(); });
+}
+
+void expiry_tracker::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		stopped = true;
+	}
+	cv.notify_one();
+
+	if (thread.joinable())
+		thread.join();
+}
+
+void expiry_tracker::reaper()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	while (!stopped) {
+		if (wheel.size() == 0)
+			cv.wait(lock);
+		else
+			cv.wait_for(lock, std::chrono::milliseconds(tick_ms));
+
+		if (stopped)
+			break;
+
+		expire_entries(lock);
+	}
+}
+
+void expiry_tracker::expire_due()
+{
+	if (!active())
+		return;
+
+	std::unique_lock<std::mutex> lock(mtx);
+	if (started)
+		expire_entries(lock);
+}
+
+void expiry_tracker::expire_entries(std::unique_lock<std::mutex> &lock)
+{
+	std::vector<timer_wheel::entry> due;
+	wheel.advance(now() / tick_ms, due);
+	if (due.empty())
+		return;
+
+	lock.unlock();
+	for (auto &e : due) {
+		if (!expired(e.first))
+			continue;
+
+		try {
+			expire(e.first);
+		} catch (std::exception &exc) {
+			/* key stays tracked (and invisible for reads) */
+			out_err_stream("reaper") << exc.what();
+		}
+	}
+	lock.lock();
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_EXPIRY_H
+#define LIBPMEMKV_EXPIRY_H
+
+#include "libpmemkv.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Hierarchical timer wheel. Level 0 has one slot per tick, every next level
+ * covers whole rotation of the previous one in a single slot. Entries from
+ * a higher level slot are moved (cascaded) to lower levels when the wheel
+ * reaches the beginning of the time range covered by that slot. Adding and
+ * expiring an entry is O(1), cascading moves every entry at most 'levels' times.
+ */
+class timer_wheel {
+public:
+	using entry = std::pair<std::string, uint64_t>;
+
+	timer_wheel(uint64_t now_tick);
+
+	void add(std::string key, uint64_t tick);
+
+	/* Moves the wheel to now_tick and appends entries which are due to expired. */
+	void advance(uint64_t now_tick, std::vector<entry> &expired);
+
+	std::size_t size() const;
+
+private:
+	static constexpr unsigned slot_bits = 6;
+	static constexpr std::size_t slots = 1ULL << slot_bits;
+	static constexpr std::size_t levels = 4;
+
+	void add(entry &&e);
+	/* re-adds entries from the slot, level == levels means the overflow list */
+	void cascade(std::size_t level, std::size_t slot);
+
+	std::array<std::array<std::vector<entry>, slots>, levels> wheel;
+	/* entries too far in the future to fit in the wheel */
+	std::vector<entry> overflow;
+	/* entries added with tick which has already passed */
+	std::vector<entry> due;
+	uint64_t current;
+	std::size_t cnt = 0;
+	std::array<std::size_t, levels> level_cnt = {};
+};
+
+/**
+ * Tracks deadlines of expiring keys and calls expire_fn for every key whose
+ * deadline has passed - from a background thread (reaper) or, for engines
+ * which cannot be modified concurrently with their reads, from expire_due()
+ * called on the engine user's thread.
+ *
+ * Deadlines are milliseconds since epoch (system clock), so they can be stored
+ * persistently and be meaningful after reopening. Operations which modify
+ * expiring keys are serialized per key by lock_key(). expire_fn is called
+ * without it and removes the key by erase_expired(), which takes the lock - so
+ * engines can take their own locks (e.g. of a wrapping engine) first.
+ */
+class expiry_tracker {
+public:
+	/* called by the reaper (or expire_due), see erase_expired */
+	using expire_fn = std::function<void(string_view key)>;
+
+	/* resolution of the reaper, in milliseconds */
+	static constexpr uint64_t tick_ms = 10;
+
+	/*
+	 * Without the background thread keys are expired only by expire_due().
+	 * No key is expired (by either of them) before start() is called.
+	 */
+	expiry_tracker(expire_fn expire, bool background = true);
+	~expiry_tracker();
+
+	expiry_tracker(const expiry_tracker &) = delete;
+	expiry_tracker &operator=(const expiry_tracker &) = delete;
+
+	static uint64_t now();
+	static uint64_t deadline(uint64_t ttl_ms);
+
+	/* deadlines are stored in engines as 8-byte strings */
+	static std::string encode(uint64_t deadline);
+	static uint64_t decode(string_view encoded);
+
+	std::unique_lock<std::mutex> lock_key(string_view key);
+
+	/*
+	 * Returns true if any key is tracked. Engines skip the tracker (and its
+	 * lock) entirely while it is not active.
+	 */
+	bool active() const;
+
+	void set(string_view key, uint64_t deadline);
+
+	/* Stops tracking the key, returns true if it was tracked. */
+	bool clear(string_view key);
+
+	/* Returns true if the key is tracked and its deadline has passed. */
+	bool expired(string_view key) const;
+
+	/*
+	 * Calls erase with the key lock held if the key is (still) expired and
+	 * stops tracking it. Returns false if the key was not expired.
+	 */
+	bool erase_expired(string_view key, const std::function<void()> &erase);
+
+	/*
+	 * Returns keys whose deadlines have passed but which were not expired
+	 * yet - scans skip them. Usually empty, as the reaper runs every tick.
+	 */
+	std::unordered_set<std::string> expired_keys() const;
+
+	/*
+	 * Calls expire_fn for keys whose deadlines have passed, on the calling
+	 * thread. No key lock can be held by the caller.
+	 */
+	void expire_due();
+
+	/* Enables expiring, starts the background thread (once any key is tracked). */
+	void start();
+	void stop();
+
+private:
+	static constexpr std::size_t key_locks = 64;
+
+	void reaper();
+	/* expires due entries, mtx has to be held (it is released meanwhile) */
+	void expire_entries(std::unique_lock<std::mutex> &lock);
+
+	expire_fn expire;
+
+	mutable std::mutex mtx;
+	std::condition_variable cv;
+	std::unordered_map<std::string, uint64_t> deadlines;
+	timer_wheel wheel;
+	bool stopped = false;
+	bool started = false;
+	bool background;
+	/* number of tracked keys (size of deadlines), read without mtx */
+	std::atomic<std::size_t> tracked;
+	std::thread thread;
+
+	std::array<std::mutex, key_locks> locks;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_EXPIRY_H */
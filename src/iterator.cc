@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2020, Intel Corporation */
+/* Copyright 2020-2021, Intel Corporation */
 
 #include "iterator.h"
 
+#include <limits>
+
 namespace pmem
 {
 namespace kv
@@ -30,6 +32,24 @@ status iterator_base::seek_higher_eq(string_view key)
 	return status::NOT_SUPPORTED;
 }
 
+/*
+ * Default implementation relies on seek_higher_eq(), so it is available in every
+ * sorted engine. Keys sharing the prefix are adjacent, hence the first key not
+ * lower than the prefix is the only candidate.
+ */
+status iterator_base::seek_prefix(string_view prefix)
+{
+	auto s = seek_higher_eq(prefix);
+	if (s != status::OK)
+		return s;
+
+	auto k = key();
+	if (!k.is_ok())
+		return k.get_status();
+
+	return has_prefix(k.get_value(), prefix) ? status::OK : status::NOT_FOUND;
+}
+
 status iterator_base::seek_to_first()
 {
 	return status::NOT_SUPPORTED;
@@ -55,6 +75,41 @@ status iterator_base::prev()
 	return status::NOT_SUPPORTED;
 }
 
+/*
+ * Default implementation reads records one by one, using key(), read_range() and
+ * next(). Engines which can walk their container directly should override it.
+ */
+result<size_t> iterator_base::next_batch(size_t n, const char **keys, size_t *kbs,
+					 const char **values, size_t *vbs)
+{
+	size_t count = 0;
+	while (count < n) {
+		auto k = key();
+		if (!k.is_ok())
+			return k.get_status();
+
+		auto v = read_range(0, std::numeric_limits<size_t>::max());
+		if (!v.is_ok())
+			return v.get_status();
+
+		auto key_view = k.get_value();
+		auto value_slice = v.get_value();
+		keys[count] = key_view.data();
+		kbs[count] = key_view.size();
+		values[count] = value_slice.begin();
+		vbs[count] = value_slice.size();
+
+		if (++count == n || is_next() != status::OK)
+			break;
+
+		auto s = next();
+		if (s != status::OK)
+			return s;
+	}
+
+	return count;
+}
+
 result<pmem::obj::slice<char *>> iterator_base::write_range(size_t pos, size_t n)
 {
 	return {status::NOT_SUPPORTED};
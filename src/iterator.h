@@ -25,6 +25,7 @@ public:
 	virtual status seek_lower_eq(string_view key);
 	virtual status seek_higher(string_view key);
 	virtual status seek_higher_eq(string_view key);
+	virtual status seek_prefix(string_view prefix);
 
 	virtual status seek_to_first();
 	virtual status seek_to_last();
@@ -36,6 +37,8 @@ public:
 	virtual result<string_view> key() = 0;
 	virtual result<pmem::obj::slice<const char *>> read_range(size_t pos,
 								  size_t n) = 0;
+	virtual result<size_t> next_batch(size_t n, const char **keys, size_t *kbs,
+					  const char **values, size_t *vbs);
 
 	virtual result<pmem::obj::slice<char *>> write_range(size_t pos, size_t n);
 
@@ -70,6 +73,85 @@ status iterate_through_pairs(It first, It last, get_kv_callback *callback, void
 	return status::OK;
 }
 
+/**
+ * Helper function to iterate through records in range [first, last) in
+ * descending order (from the one before *last*) and execute callback on every
+ * item. Iterators have to be bidirectional.
+ */
+template <typename It>
+status iterate_through_pairs_desc(It first, It last, get_kv_callback *callback,
+				  void *arg)
+{
+	while (last != first) {
+		--last;
+		auto ret = callback(last->first.c_str(), last->first.size(),
+				    last->second.c_str(), last->second.size(), arg);
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+	return status::OK;
+}
+
+/**
+ * Checks if *key* starts with *prefix* (byte-wise).
+ */
+static inline bool has_prefix(string_view key, string_view prefix)
+{
+	return key.size() >= prefix.size() &&
+		string_view(key.data(), prefix.size()).compare(prefix) == 0;
+}
+
+/**
+ * Helper function to iterate through records with keys starting with *prefix*,
+ * beginning at *first*, and execute callback on every item. As keys sharing
+ * a prefix are adjacent in sorted engines, it stops on the first key outside
+ * the prefix instead of searching for the upper bound.
+ */
+template <typename It>
+status iterate_through_prefix(It first, It last, string_view prefix,
+			      get_kv_callback *callback, void *arg)
+{
+	for (auto it = first; it != last; ++it) {
+		if (!has_prefix(string_view(it->first.c_str(), it->first.size()), prefix))
+			break;
+
+		auto ret = callback(it->first.c_str(), it->first.size(),
+				    it->second.c_str(), it->second.size(), arg);
+		if (ret != 0)
+			return status::STOPPED_BY_CB;
+	}
+	return status::OK;
+}
+
+/**
+ * Returns the first iterator past records with keys starting with *prefix*,
+ * beginning at *first*.
+ */
+template <typename It>
+It prefix_end(It first, It last, string_view prefix)
+{
+	for (auto it = first; it != last; ++it) {
+		if (!has_prefix(string_view(it->first.c_str(), it->first.size()), prefix))
+			return it;
+	}
+	return last;
+}
+
+/**
+ * Counts records with keys starting with *prefix*, beginning at *first*.
+ */
+template <typename It>
+std::size_t prefix_distance(It first, It last, string_view prefix)
+{
+	std::size_t cnt = 0;
+	for (auto it = first; it != last; ++it) {
+		if (!has_prefix(string_view(it->first.c_str(), it->first.size()), prefix))
+			break;
+		++cnt;
+	}
+	return cnt;
+}
+
 } /* namespace internal */
 } /* namespace kv */
 } /* namespace pmem */
@@ -5,8 +5,12 @@
 
 #include <sys/stat.h>
 
+#include "change_log_engine.h"
+#include "codec_engine.h"
 #include "comparator/comparator.h"
+#include "completion_queue.h"
 #include "config.h"
+#include "dump.h"
 #include "engine.h"
 #include "exceptions.h"
 #include "iterator.h"
@@ -15,9 +19,13 @@
 #include "libpmemobj++/pexceptions.hpp"
 #include "out.h"
 #include "transaction.h"
+#include "value_ref.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -64,6 +72,18 @@ static inline pmem::kv::internal::transaction *tx_to_internal(pmemkv_tx *tx)
 	return reinterpret_cast<pmem::kv::internal::transaction *>(tx);
 }
 
+static inline pmem::kv::internal::value_ref_base *
+value_ref_to_internal(pmemkv_value_ref *ref)
+{
+	return reinterpret_cast<pmem::kv::internal::value_ref_base *>(ref);
+}
+
+static inline pmemkv_value_ref *
+value_ref_from_internal(pmem::kv::internal::value_ref_base *ref)
+{
+	return reinterpret_cast<pmemkv_value_ref *>(ref);
+}
+
 pmem::kv::internal::iterator_base *iterator_to_base(pmemkv_iterator *it)
 {
 	return reinterpret_cast<pmem::kv::internal::iterator_base *>(it);
@@ -75,6 +95,18 @@ iterator_from_internal(pmem::kv::internal::iterator_base *it)
 	return reinterpret_cast<pmemkv_iterator *>(it);
 }
 
+static inline pmemkv_completion_queue *
+completion_queue_from_internal(pmem::kv::internal::completion_queue *cq)
+{
+	return reinterpret_cast<pmemkv_completion_queue *>(cq);
+}
+
+static inline pmem::kv::internal::completion_queue *
+completion_queue_to_internal(pmemkv_completion_queue *cq)
+{
+	return reinterpret_cast<pmem::kv::internal::completion_queue *>(cq);
+}
+
 template <typename Function>
 static inline int catch_and_return_status(const char *func_name, Function &&f)
 {
@@ -104,6 +136,30 @@ static inline int catch_and_return_status(const char *func_name, Function &&f)
 	return status;
 }
 
+/*
+ * Submits an asynchronous operation, completed by the callback or in the
+ * completion queue (exactly one of them has to be set).
+ */
+template <typename Function>
+static inline int submit_async(const char *func_name, pmemkv_completion_queue *cq,
+			       pmemkv_async_callback *c, void *arg, Function &&submit)
+{
+	return catch_and_return_status(func_name, [&] {
+		if (!cq) {
+			submit(c, arg);
+			return PMEMKV_STATUS_OK;
+		}
+
+		using request = pmem::kv::internal::completion_queue::request;
+		std::unique_ptr<request> req(
+			new request{completion_queue_to_internal(cq), arg});
+		submit(&pmem::kv::internal::completion_queue::complete, req.get());
+		req.release();
+
+		return PMEMKV_STATUS_OK;
+	});
+}
+
 extern "C" {
 
 pmemkv_config *pmemkv_config_new(void)
@@ -401,6 +457,67 @@ void pmemkv_tx_end(pmemkv_tx *tx)
 	}
 }
 
+int pmemkv_snapshot(pmemkv_db *db, pmemkv_db **snapshot)
+{
+	if (!db || !snapshot)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		*snapshot = db_from_internal(db_to_internal(db)->new_snapshot());
+		return PMEMKV_STATUS_OK;
+	});
+}
+
+int pmemkv_dump(pmemkv_db *db, int fd)
+{
+	if (!db || fd < 0)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		pmem::kv::internal::dump::write(
+			*db_to_internal(db), fd,
+			std::max(1U, std::thread::hardware_concurrency()));
+		return PMEMKV_STATUS_OK;
+	});
+}
+
+int pmemkv_restore(pmemkv_db *db, int fd)
+{
+	if (!db || fd < 0)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		auto engine = db_to_internal(db);
+		/* puts are done by many threads only in concurrent engines */
+		std::size_t threads = engine->concurrent()
+			? std::max(1U, std::thread::hardware_concurrency())
+			: 1;
+		pmem::kv::internal::dump::read(*engine, fd, threads);
+		return PMEMKV_STATUS_OK;
+	});
+}
+
+int pmemkv_changes(pmemkv_db *db, uint64_t since_seq, uint64_t timeout_ms,
+		   pmemkv_change_callback *c, void *arg)
+{
+	if (!db || !c)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->changes(
+			since_seq, std::chrono::milliseconds(timeout_ms), c, arg);
+	});
+}
+
+int pmemkv_changes_last_seq(pmemkv_db *db, uint64_t *seq)
+{
+	if (!db || !seq)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(
+		__func__, [&] { return db_to_internal(db)->changes_last_seq(*seq); });
+}
+
 int pmemkv_open(const char *engine_c_str, pmemkv_config *config, pmemkv_db **db)
 {
 	std::unique_ptr<pmem::kv::internal::config> cfg(config_to_internal(config));
@@ -409,8 +526,26 @@ int pmemkv_open(const char *engine_c_str, pmemkv_config *config, pmemkv_db **db)
 		return PMEMKV_STATUS_INVALID_ARGUMENT;
 
 	return catch_and_return_status(__func__, [&] {
+		pmem::kv::internal::value_codec::params codec_params;
+		if (cfg)
+			codec_params = pmem::kv::internal::value_codec::from_config(*cfg);
+		uint64_t change_log_size = 0;
+		if (cfg)
+			cfg->get_uint64("change_log_size", &change_log_size);
+
+		pmem::kv::internal::config empty_cfg;
+		auto async_params = pmem::kv::internal::executor::from_config(
+			cfg ? *cfg : empty_cfg);
+
 		auto engine = pmem::kv::storage_engine_factory::create_engine(
 			engine_c_str, std::move(cfg));
+		engine = pmem::kv::internal::codec_engine::wrap(std::move(engine),
+							       codec_params);
+		/* puts and removes are logged with values as passed by the user */
+		engine = pmem::kv::internal::change_log_engine::wrap(std::move(engine),
+								    change_log_size);
+		engine->set_async_params(pmem::kv::internal::executor::for_engine(
+			async_params, engine->concurrent()));
 
 		*db = db_from_internal(engine.release());
 
@@ -421,6 +556,8 @@ int pmemkv_open(const char *engine_c_str, pmemkv_config *config, pmemkv_db **db)
 void pmemkv_close(pmemkv_db *db)
 {
 	try {
+		if (db)
+			db_to_internal(db)->stop_async();
 		delete db_to_internal(db);
 	} catch (const std::exception &exc) {
 		ERR() << exc.what();
@@ -495,6 +632,17 @@ int pmemkv_count_between(pmemkv_db *db, const char *k1, size_t kb1, const char *
 	});
 }
 
+int pmemkv_count_prefix(pmemkv_db *db, const char *k, size_t kb, size_t *cnt)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->count_prefix(pmem::kv::string_view(k, kb),
+							*cnt);
+	});
+}
+
 int pmemkv_get_all(pmemkv_db *db, pmemkv_get_kv_callback *c, void *arg)
 {
 	if (!db)
@@ -565,6 +713,109 @@ int pmemkv_get_between(pmemkv_db *db, const char *k1, size_t kb1, const char *k2
 	});
 }
 
+int pmemkv_get_prefix(pmemkv_db *db, const char *k, size_t kb, pmemkv_get_kv_callback *c,
+		      void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_prefix(pmem::kv::string_view(k, kb), c,
+						      arg);
+	});
+}
+
+int pmemkv_get_all_desc(pmemkv_db *db, pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_all_desc(c, arg);
+	});
+}
+
+int pmemkv_get_above_desc(pmemkv_db *db, const char *k, size_t kb,
+			  pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_above_desc(pmem::kv::string_view(k, kb),
+							  c, arg);
+	});
+}
+
+int pmemkv_get_equal_above_desc(pmemkv_db *db, const char *k, size_t kb,
+				pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_equal_above_desc(
+			pmem::kv::string_view(k, kb), c, arg);
+	});
+}
+
+int pmemkv_get_equal_below_desc(pmemkv_db *db, const char *k, size_t kb,
+				pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_equal_below_desc(
+			pmem::kv::string_view(k, kb), c, arg);
+	});
+}
+
+int pmemkv_get_below_desc(pmemkv_db *db, const char *k, size_t kb,
+			  pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_below_desc(pmem::kv::string_view(k, kb),
+							  c, arg);
+	});
+}
+
+int pmemkv_get_between_desc(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
+			    size_t kb2, pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_between_desc(
+			pmem::kv::string_view(k1, kb1), pmem::kv::string_view(k2, kb2), c,
+			arg);
+	});
+}
+
+int pmemkv_get_all_parallel(pmemkv_db *db, size_t num_partitions,
+			    pmemkv_get_kv_callback *c, void *arg)
+{
+	if (!db || num_partitions == 0)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->get_all_parallel(num_partitions, c, arg);
+	});
+}
+
+int pmemkv_split_points(pmemkv_db *db, size_t n, pmemkv_get_v_callback *c, void *arg)
+{
+	if (!db || n == 0)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(
+		__func__, [&] { return db_to_internal(db)->split_points(n, c, arg); });
+}
+
 int pmemkv_exists(pmemkv_db *db, const char *k, size_t kb)
 {
 	if (!db)
@@ -634,6 +885,48 @@ int pmemkv_get_copy(pmemkv_db *db, const char *k, size_t kb, char *buffer,
 	return ctx.result;
 }
 
+int pmemkv_get_ref(pmemkv_db *db, const char *k, size_t kb, pmemkv_value_ref **ref)
+{
+	if (!db || !ref)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		std::unique_ptr<pmem::kv::internal::value_ref_base> value_ref;
+		auto s = db_to_internal(db)->get_ref(pmem::kv::string_view(k, kb),
+						     value_ref);
+		if (s == pmem::kv::status::OK)
+			*ref = value_ref_from_internal(value_ref.release());
+
+		return s;
+	});
+}
+
+int pmemkv_value_ref_get(pmemkv_value_ref *ref, const char **v, size_t *vb)
+{
+	if (!ref || !v || !vb)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	auto value = value_ref_to_internal(ref)->value();
+	*v = value.data();
+	*vb = value.size();
+
+	return PMEMKV_STATUS_OK;
+}
+
+void pmemkv_value_ref_delete(pmemkv_value_ref *ref)
+{
+	if (!ref)
+		return;
+
+	try {
+		delete value_ref_to_internal(ref);
+	} catch (const std::exception &exc) {
+		ERR() << exc.what();
+	} catch (...) {
+		ERR() << "Unspecified failure";
+	}
+}
+
 int pmemkv_put(pmemkv_db *db, const char *k, size_t kb, const char *v, size_t vb)
 {
 	if (!db)
@@ -645,6 +938,19 @@ int pmemkv_put(pmemkv_db *db, const char *k, size_t kb, const char *v, size_t vb
 	});
 }
 
+int pmemkv_put_with_ttl(pmemkv_db *db, const char *k, size_t kb, const char *v,
+			size_t vb, uint64_t ttl_ms)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->put_with_ttl(pmem::kv::string_view(k, kb),
+							pmem::kv::string_view(v, vb),
+							ttl_ms);
+	});
+}
+
 int pmemkv_remove(pmemkv_db *db, const char *k, size_t kb)
 {
 	if (!db)
@@ -655,6 +961,28 @@ int pmemkv_remove(pmemkv_db *db, const char *k, size_t kb)
 	});
 }
 
+int pmemkv_remove_range(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
+			size_t kb2)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->remove_range(pmem::kv::string_view(k1, kb1),
+							pmem::kv::string_view(k2, kb2));
+	});
+}
+
+int pmemkv_remove_prefix(pmemkv_db *db, const char *k, size_t kb)
+{
+	if (!db)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return db_to_internal(db)->remove_prefix(pmem::kv::string_view(k, kb));
+	});
+}
+
 int pmemkv_defrag(pmemkv_db *db, double start_percent, double amount_percent)
 {
 	if (!db)
@@ -665,6 +993,108 @@ int pmemkv_defrag(pmemkv_db *db, double start_percent, double amount_percent)
 	});
 }
 
+int pmemkv_memory_usage(pmemkv_db *db, pmemkv_memory_stats *stats)
+{
+	if (!db || !stats)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		*stats = pmemkv_memory_stats();
+		return db_to_internal(db)->memory_usage(*stats);
+	});
+}
+
+int pmemkv_bulk_load(pmemkv_db *db, pmemkv_bulk_load_callback *c, void *arg)
+{
+	if (!db || !c)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(
+		__func__, [&] { return db_to_internal(db)->bulk_load(c, arg); });
+}
+
+int pmemkv_async_get(pmemkv_db *db, const char *k, size_t kb, pmemkv_completion_queue *cq,
+		     pmemkv_async_callback *c, void *arg)
+{
+	if (!db || !cq == !c)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return submit_async(__func__, cq, c, arg,
+			    [&](pmemkv_async_callback *cb, void *cb_arg) {
+				    db_to_internal(db)->async_get(
+					    pmem::kv::string_view(k, kb), cb, cb_arg);
+			    });
+}
+
+int pmemkv_async_put(pmemkv_db *db, const char *k, size_t kb, const char *v, size_t vb,
+		     pmemkv_completion_queue *cq, pmemkv_async_callback *c, void *arg)
+{
+	if (!db || !cq == !c)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return submit_async(__func__, cq, c, arg,
+			    [&](pmemkv_async_callback *cb, void *cb_arg) {
+				    db_to_internal(db)->async_put(
+					    pmem::kv::string_view(k, kb),
+					    pmem::kv::string_view(v, vb), cb, cb_arg);
+			    });
+}
+
+int pmemkv_async_remove(pmemkv_db *db, const char *k, size_t kb,
+			pmemkv_completion_queue *cq, pmemkv_async_callback *c, void *arg)
+{
+	if (!db || !cq == !c)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return submit_async(__func__, cq, c, arg,
+			    [&](pmemkv_async_callback *cb, void *cb_arg) {
+				    db_to_internal(db)->async_remove(
+					    pmem::kv::string_view(k, kb), cb, cb_arg);
+			    });
+}
+
+pmemkv_completion_queue *pmemkv_completion_queue_new(void)
+{
+	try {
+		return completion_queue_from_internal(
+			new pmem::kv::internal::completion_queue);
+	} catch (const std::exception &exc) {
+		ERR() << exc.what();
+		return nullptr;
+	} catch (...) {
+		ERR() << "Unspecified failure";
+		return nullptr;
+	}
+}
+
+void pmemkv_completion_queue_delete(pmemkv_completion_queue *cq)
+{
+	try {
+		delete completion_queue_to_internal(cq);
+	} catch (const std::exception &exc) {
+		ERR() << exc.what();
+	} catch (...) {
+		ERR() << "Unspecified failure";
+	}
+}
+
+int pmemkv_completion_queue_poll(pmemkv_completion_queue *cq,
+				 pmemkv_completion *completions, size_t max,
+				 size_t *count, uint64_t timeout_ms)
+{
+	if (!cq || !completions || !count)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	/* longer timeouts would overflow the clock */
+	auto timeout = std::min<uint64_t>(timeout_ms, std::numeric_limits<int32_t>::max());
+
+	return catch_and_return_status(__func__, [&] {
+		*count = completion_queue_to_internal(cq)->poll(
+			completions, max, std::chrono::milliseconds(timeout));
+		return PMEMKV_STATUS_OK;
+	});
+}
+
 int pmemkv_iterator_new(pmemkv_db *db, pmemkv_iterator **it)
 {
 	if (!db || !it)
@@ -772,6 +1202,16 @@ int pmemkv_iterator_seek_higher_eq(pmemkv_iterator *it, const char *k, size_t kb
 	});
 }
 
+int pmemkv_iterator_seek_prefix(pmemkv_iterator *it, const char *k, size_t kb)
+{
+	if (!it)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		return iterator_to_base(it)->seek_prefix(pmem::kv::string_view(k, kb));
+	});
+}
+
 int pmemkv_iterator_seek_to_first(pmemkv_iterator *it)
 {
 	if (!it)
@@ -856,6 +1296,27 @@ int pmemkv_iterator_read_range(pmemkv_iterator *it, size_t pos, size_t n,
 	});
 }
 
+int pmemkv_iterator_next_batch(pmemkv_iterator *it, size_t n, const char **keys,
+			       size_t *kbs, const char **values, size_t *vbs, size_t *count)
+{
+	if (!it || !keys || !kbs || !values || !vbs || !count)
+		return PMEMKV_STATUS_INVALID_ARGUMENT;
+
+	return catch_and_return_status(__func__, [&] {
+		*count = 0;
+		if (n == 0)
+			return PMEMKV_STATUS_OK;
+
+		auto ret = iterator_to_base(it)->next_batch(n, keys, kbs, values, vbs);
+		if (!ret.is_ok())
+			return static_cast<int>(ret.get_status());
+
+		*count = ret.get_value();
+
+		return PMEMKV_STATUS_OK;
+	});
+}
+
 int pmemkv_write_iterator_write_range(pmemkv_write_iterator *it, size_t pos, size_t n,
 				      char **data, size_t *wb)
 {
@@ -27,10 +27,17 @@ extern "C" {
 #define PMEMKV_STATUS_DEFRAG_ERROR 11
 #define PMEMKV_STATUS_COMPARATOR_MISMATCH 12
 
+#define PMEMKV_CHANGE_PUT 0
+#define PMEMKV_CHANGE_REMOVE 1
+#define PMEMKV_CHANGE_REMOVE_RANGE 2
+#define PMEMKV_CHANGE_REMOVE_PREFIX 3
+
 typedef struct pmemkv_db pmemkv_db;
 typedef struct pmemkv_config pmemkv_config;
 typedef struct pmemkv_comparator pmemkv_comparator;
 typedef struct pmemkv_tx pmemkv_tx;
+typedef struct pmemkv_value_ref pmemkv_value_ref;
+typedef struct pmemkv_completion_queue pmemkv_completion_queue;
 
 typedef struct pmemkv_iterator pmemkv_iterator;
 typedef struct {
@@ -40,6 +47,48 @@ typedef struct {
 typedef int pmemkv_get_kv_callback(const char *key, size_t keybytes, const char *value,
 				   size_t valuebytes, void *arg);
 typedef void pmemkv_get_v_callback(const char *value, size_t valuebytes, void *arg);
+typedef int pmemkv_bulk_load_callback(const char **key, size_t *keybytes,
+				      const char **value, size_t *valuebytes, void *arg);
+/* value is passed only by completed get (with PMEMKV_STATUS_OK) */
+typedef void pmemkv_async_callback(int status, const char *value, size_t valuebytes,
+				   void *arg);
+/*
+ * type is one of PMEMKV_CHANGE_*; value is empty for PMEMKV_CHANGE_REMOVE and
+ * PMEMKV_CHANGE_REMOVE_PREFIX and is the end of the range for
+ * PMEMKV_CHANGE_REMOVE_RANGE
+ */
+typedef int pmemkv_change_callback(uint64_t seq, int type, const char *key,
+				   size_t keybytes, const char *value, size_t valuebytes,
+				   void *arg);
+
+/*
+ * Memory footprint of the database, see pmemkv_memory_usage(). All sizes are
+ * in bytes.
+ */
+typedef struct pmemkv_memory_stats {
+	/* number of elements and total size of their keys and values */
+	uint64_t count;
+	uint64_t keys;
+	uint64_t values;
+	/* allocated for the engine's structures (e.g. tree nodes, buckets) */
+	uint64_t metadata;
+	/* used by the allocator itself (e.g. allocation headers) */
+	uint64_t allocator_overhead;
+	/* not allocated */
+	uint64_t free;
+	/* not allocated, but in partially used blocks of the allocator */
+	uint64_t fragmented;
+	/*
+	 * per-thread arenas of the allocator (0 if not enabled), assignments
+	 * of threads to them and writes which started while another thread
+	 * was writing through the same arena (so they could contend on it)
+	 */
+	uint64_t arenas;
+	uint64_t arena_threads;
+	uint64_t arena_contended_writes;
+	/* keys, values, metadata and allocator overhead per element */
+	double bytes_per_key;
+} pmemkv_memory_stats;
 
 typedef int pmemkv_compare_function(const char *key1, size_t keybytes1, const char *key2,
 				    size_t keybytes2, void *arg);
@@ -85,6 +134,7 @@ int pmemkv_count_equal_below(pmemkv_db *db, const char *k, size_t kb, size_t *cn
 int pmemkv_count_below(pmemkv_db *db, const char *k, size_t kb, size_t *cnt);
 int pmemkv_count_between(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
 			 size_t kb2, size_t *cnt);
+int pmemkv_count_prefix(pmemkv_db *db, const char *k, size_t kb, size_t *cnt);
 
 int pmemkv_get_all(pmemkv_db *db, pmemkv_get_kv_callback *c, void *arg);
 int pmemkv_get_above(pmemkv_db *db, const char *k, size_t kb, pmemkv_get_kv_callback *c,
@@ -97,6 +147,24 @@ int pmemkv_get_below(pmemkv_db *db, const char *k, size_t kb, pmemkv_get_kv_call
 		     void *arg);
 int pmemkv_get_between(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
 		       size_t kb2, pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_prefix(pmemkv_db *db, const char *k, size_t kb, pmemkv_get_kv_callback *c,
+		      void *arg);
+
+int pmemkv_get_all_desc(pmemkv_db *db, pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_above_desc(pmemkv_db *db, const char *k, size_t kb,
+			  pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_equal_above_desc(pmemkv_db *db, const char *k, size_t kb,
+				pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_equal_below_desc(pmemkv_db *db, const char *k, size_t kb,
+				pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_below_desc(pmemkv_db *db, const char *k, size_t kb,
+			  pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_get_between_desc(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
+			    size_t kb2, pmemkv_get_kv_callback *c, void *arg);
+
+int pmemkv_get_all_parallel(pmemkv_db *db, size_t num_partitions,
+			    pmemkv_get_kv_callback *c, void *arg);
+int pmemkv_split_points(pmemkv_db *db, size_t n, pmemkv_get_v_callback *c, void *arg);
 
 int pmemkv_exists(pmemkv_db *db, const char *k, size_t kb);
 
@@ -104,14 +172,48 @@ int pmemkv_get(pmemkv_db *db, const char *k, size_t kb, pmemkv_get_v_callback *c
 	       void *arg);
 int pmemkv_get_copy(pmemkv_db *db, const char *k, size_t kb, char *buffer,
 		    size_t buffer_size, size_t *value_size);
+int pmemkv_get_ref(pmemkv_db *db, const char *k, size_t kb, pmemkv_value_ref **ref);
+int pmemkv_value_ref_get(pmemkv_value_ref *ref, const char **v, size_t *vb);
+void pmemkv_value_ref_delete(pmemkv_value_ref *ref);
 int pmemkv_put(pmemkv_db *db, const char *k, size_t kb, const char *v, size_t vb);
+int pmemkv_put_with_ttl(pmemkv_db *db, const char *k, size_t kb, const char *v,
+			size_t vb, uint64_t ttl_ms);
 
 int pmemkv_remove(pmemkv_db *db, const char *k, size_t kb);
+int pmemkv_remove_range(pmemkv_db *db, const char *k1, size_t kb1, const char *k2,
+			size_t kb2);
+int pmemkv_remove_prefix(pmemkv_db *db, const char *k, size_t kb);
 
 int pmemkv_defrag(pmemkv_db *db, double start_percent, double amount_percent);
+int pmemkv_memory_usage(pmemkv_db *db, pmemkv_memory_stats *stats);
+
+int pmemkv_bulk_load(pmemkv_db *db, pmemkv_bulk_load_callback *c, void *arg);
 
 const char *pmemkv_errormsg(void);
 
+/* This API is EXPERIMENTAL and might change. */
+typedef struct pmemkv_completion {
+	int status;
+	/* value of completed get, valid until the next poll of the queue */
+	const char *value;
+	size_t valuebytes;
+	/* argument passed to the operation */
+	void *arg;
+} pmemkv_completion;
+
+int pmemkv_async_get(pmemkv_db *db, const char *k, size_t kb, pmemkv_completion_queue *cq,
+		     pmemkv_async_callback *c, void *arg);
+int pmemkv_async_put(pmemkv_db *db, const char *k, size_t kb, const char *v, size_t vb,
+		     pmemkv_completion_queue *cq, pmemkv_async_callback *c, void *arg);
+int pmemkv_async_remove(pmemkv_db *db, const char *k, size_t kb,
+			pmemkv_completion_queue *cq, pmemkv_async_callback *c, void *arg);
+
+pmemkv_completion_queue *pmemkv_completion_queue_new(void);
+void pmemkv_completion_queue_delete(pmemkv_completion_queue *cq);
+int pmemkv_completion_queue_poll(pmemkv_completion_queue *cq,
+				 pmemkv_completion *completions, size_t max,
+				 size_t *count, uint64_t timeout_ms);
+
 /* This API is EXPERIMENTAL and might change. */
 int pmemkv_tx_begin(pmemkv_db *db, pmemkv_tx **tx);
 int pmemkv_tx_put(pmemkv_tx *tx, const char *k, size_t kb, const char *v, size_t vb);
@@ -120,6 +222,27 @@ int pmemkv_tx_commit(pmemkv_tx *tx);
 void pmemkv_tx_abort(pmemkv_tx *tx);
 void pmemkv_tx_end(pmemkv_tx *tx);
 
+/*
+ * This API is EXPERIMENTAL and might change.
+ * Snapshot is a read-only database, closed with pmemkv_close().
+ */
+int pmemkv_snapshot(pmemkv_db *db, pmemkv_db **snapshot);
+
+/*
+ * This API is EXPERIMENTAL and might change.
+ * Dump is read and written at the current offset of fd.
+ */
+int pmemkv_dump(pmemkv_db *db, int fd);
+int pmemkv_restore(pmemkv_db *db, int fd);
+
+/*
+ * This API is EXPERIMENTAL and might change.
+ * Change log is enabled by "change_log_size" config item.
+ */
+int pmemkv_changes(pmemkv_db *db, uint64_t since_seq, uint64_t timeout_ms,
+		   pmemkv_change_callback *c, void *arg);
+int pmemkv_changes_last_seq(pmemkv_db *db, uint64_t *seq);
+
 /* This API is EXPERIMENTAL and might change. */
 int pmemkv_iterator_new(pmemkv_db *db, pmemkv_iterator **it);
 int pmemkv_write_iterator_new(pmemkv_db *db, pmemkv_write_iterator **it);
@@ -132,6 +255,7 @@ int pmemkv_iterator_seek_lower(pmemkv_iterator *it, const char *k, size_t kb);
 int pmemkv_iterator_seek_lower_eq(pmemkv_iterator *it, const char *k, size_t kb);
 int pmemkv_iterator_seek_higher(pmemkv_iterator *it, const char *k, size_t kb);
 int pmemkv_iterator_seek_higher_eq(pmemkv_iterator *it, const char *k, size_t kb);
+int pmemkv_iterator_seek_prefix(pmemkv_iterator *it, const char *k, size_t kb);
 
 int pmemkv_iterator_seek_to_first(pmemkv_iterator *it);
 int pmemkv_iterator_seek_to_last(pmemkv_iterator *it);
@@ -144,6 +268,8 @@ int pmemkv_iterator_key(pmemkv_iterator *it, const char **k, size_t *kb);
 
 int pmemkv_iterator_read_range(pmemkv_iterator *it, size_t pos, size_t n,
 			       const char **data, size_t *rb);
+int pmemkv_iterator_next_batch(pmemkv_iterator *it, size_t n, const char **keys,
+			       size_t *kbs, const char **values, size_t *vbs, size_t *count);
 int pmemkv_write_iterator_write_range(pmemkv_write_iterator *it, size_t pos, size_t n,
 				      char **data, size_t *wb);
 
@@ -6,13 +6,16 @@
 
 #include <cassert>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <libpmemobj++/slice.hpp>
 #include <libpmemobj++/string_view.hpp>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "libpmemkv.h"
 #include <libpmemobj/pool_base.h>
@@ -60,6 +63,15 @@ typedef int get_kv_function(string_view key, string_view value);
  * @param[in] value returned by callback item's data
  */
 typedef void get_v_function(string_view value);
+/**
+ * The C++ idiomatic function type to use as a source of sorted key-value pairs
+ * for bulk load. It should set *key* and *value* and return 0, or return
+ * non-zero value when there are no more elements.
+ *
+ * @param[out] key next element's key
+ * @param[out] value next element's data
+ */
+typedef int bulk_load_function(string_view &key, string_view &value);
 
 /**
  * Key-value pair callback, C-style.
@@ -69,6 +81,22 @@ using get_kv_callback = pmemkv_get_kv_callback;
  * Value-only callback, C-style.
  */
 using get_v_callback = pmemkv_get_v_callback;
+/**
+ * Bulk load source callback, C-style.
+ */
+using bulk_load_callback = pmemkv_bulk_load_callback;
+/**
+ * Asynchronous operation's completion callback, C-style.
+ */
+using async_callback = pmemkv_async_callback;
+/**
+ * Change log callback, C-style.
+ */
+using change_callback = pmemkv_change_callback;
+/**
+ * Memory footprint of the database, returned by db::memory_usage().
+ */
+using memory_stats = pmemkv_memory_stats;
 
 /*! \enum status
 	\brief Status returned by most of pmemkv functions.
@@ -112,6 +140,50 @@ enum class status {
 						      comparator */
 };
 
+/**
+ * The C++ idiomatic function type to use as a callback of asynchronous get.
+ * It is called (in a thread of the executor) with the status of the operation
+ * and the value, which is valid only if status is status::OK.
+ *
+ * @param[in] s status of the operation
+ * @param[in] value returned by callback item's data
+ */
+typedef void async_get_function(status s, string_view value);
+/**
+ * The C++ idiomatic function type to use as a callback of asynchronous put
+ * and remove. It is called (in a thread of the executor) with the status of
+ * the operation.
+ *
+ * @param[in] s status of the operation
+ */
+typedef void async_function(status s);
+
+/*! \enum change_type
+	\brief Type of a mutation recorded in the change log.
+*/
+enum class change_type {
+	PUT = PMEMKV_CHANGE_PUT,       /**< key was put, value is the new one */
+	REMOVE = PMEMKV_CHANGE_REMOVE, /**< key was removed, value is empty */
+	/**< keys in [key, value) were removed */
+	REMOVE_RANGE = PMEMKV_CHANGE_REMOVE_RANGE,
+	/**< keys starting with key were removed, value is empty */
+	REMOVE_PREFIX = PMEMKV_CHANGE_REMOVE_PREFIX,
+};
+
+/**
+ * The C++ idiomatic function type to use as a callback reading the change log.
+ * Records of a single unit (e.g. a transaction) have the same sequence number.
+ * It should return 0 to continue or non-zero value to stop reading.
+ *
+ * @param[in] seq sequence number of the record
+ * @param[in] type type of the mutation
+ * @param[in] key modified key
+ * @param[in] value new value (for change_type::PUT) or end of the removed
+ *	range (for change_type::REMOVE_RANGE)
+ */
+typedef int change_function(uint64_t seq, change_type type, string_view key,
+			    string_view value);
+
 /**
  * Provides string representation of a status, along with its number
  * as specified by enum.
@@ -490,6 +562,101 @@ private:
 	std::unique_ptr<pmemkv_config, decltype(&pmemkv_config_delete)> config_;
 };
 
+namespace internal
+{
+
+/*
+ * Traits which select db overloads taking C++ callables (lambdas, functors, etc.)
+ * with signatures of get_kv_function, get_v_function and bulk_load_function.
+ * Such callables are called directly, without wrapping them in std::function.
+ */
+template <typename F, typename = void>
+struct is_get_kv_callable : std::false_type {
+};
+
+template <typename F>
+struct is_get_kv_callable<
+	F,
+	typename std::enable_if<std::is_convertible<
+		decltype(std::declval<F &>()(std::declval<string_view>(),
+					     std::declval<string_view>())),
+		int>::value>::type> : std::true_type {
+};
+
+template <typename F, typename = void>
+struct is_get_v_callable : std::false_type {
+};
+
+template <typename F>
+struct is_get_v_callable<
+	F,
+	typename std::conditional<
+		true, void,
+		decltype(std::declval<F &>()(std::declval<string_view>()))>::type>
+    : std::true_type {
+};
+
+template <typename F, typename = void>
+struct is_bulk_load_callable : std::false_type {
+};
+
+template <typename F>
+struct is_bulk_load_callable<
+	F,
+	typename std::enable_if<std::is_convertible<
+		decltype(std::declval<F &>()(std::declval<string_view &>(),
+					     std::declval<string_view &>())),
+		int>::value>::type> : std::true_type {
+};
+
+template <typename F>
+using get_kv_callable_status =
+	typename std::enable_if<is_get_kv_callable<F>::value, status>::type;
+
+template <typename F>
+using get_v_callable_status =
+	typename std::enable_if<is_get_v_callable<F>::value, status>::type;
+
+template <typename F>
+using bulk_load_callable_status =
+	typename std::enable_if<is_bulk_load_callable<F>::value, status>::type;
+
+/*
+ * Trampolines passed to the C API as callbacks, *arg* points to the callable.
+ * Function templates cannot be declared extern "C", but on all supported
+ * platforms C and C++ functions use the same calling convention.
+ */
+template <typename F>
+int call_get_kv_callable(const char *key, size_t keybytes, const char *value,
+			 size_t valuebytes, void *arg)
+{
+	return (*static_cast<F *>(arg))(string_view(key, keybytes),
+					string_view(value, valuebytes));
+}
+
+template <typename F>
+void call_get_v_callable(const char *value, size_t valuebytes, void *arg)
+{
+	(*static_cast<F *>(arg))(string_view(value, valuebytes));
+}
+
+template <typename F>
+int call_bulk_load_callable(const char **key, size_t *keybytes, const char **value,
+			    size_t *valuebytes, void *arg)
+{
+	string_view k, v;
+	int ret = (*static_cast<F *>(arg))(k, v);
+	if (ret == 0) {
+		*key = k.data();
+		*keybytes = k.size();
+		*value = v.data();
+		*valuebytes = v.size();
+	}
+	return ret;
+}
+
+} /* namespace internal */
+
 /*! \class tx
 	\brief Pmemkv transaction handle.
 
@@ -518,6 +685,34 @@ private:
 	std::unique_ptr<pmemkv_tx, decltype(&pmemkv_tx_end)> tx_;
 };
 
+/*! \class value_ref
+	\brief Handle to a value stored in db, returned by db::get_ref().
+
+	__This API is EXPERIMENTAL and might change.__
+
+	It exposes the value in place, without copying it. The value stays valid until
+	the handle is released (or destroyed). Concurrent engines protect it by holding
+	a read lock on the record for the whole lifetime of the handle - writers of
+	this record are blocked, so the handle should be released as soon as possible
+	and the record must not be modified by the thread which holds the handle.
+	In single-threaded engines the handle is a plain pointer to the value and it
+	becomes invalid when the record is modified or removed.
+
+	Holding simultaneously in the same thread more than one value_ref is undefined
+	behavior.
+*/
+class value_ref {
+public:
+	value_ref(pmemkv_value_ref *ref) noexcept;
+
+	string_view value() const noexcept;
+	void release() noexcept;
+
+private:
+	std::unique_ptr<pmemkv_value_ref, decltype(&pmemkv_value_ref_delete)> ref_;
+	string_view value_;
+};
+
 /*! \class db
 	\brief Main pmemkv class, it provides functions to operate on data in database.
 
@@ -560,49 +755,156 @@ public:
 	status count_below(string_view key, std::size_t &cnt) noexcept;
 	status count_between(string_view key1, string_view key2,
 			     std::size_t &cnt) noexcept;
+	status count_prefix(string_view prefix, std::size_t &cnt) noexcept;
 
 	status get_all(get_kv_callback *callback, void *arg) noexcept;
 	status get_all(std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_all(F f) noexcept;
 
 	status get_above(string_view key, get_kv_callback *callback, void *arg) noexcept;
 	status get_above(string_view key, std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_above(string_view key, F f) noexcept;
 
 	status get_equal_above(string_view key, get_kv_callback *callback,
 			       void *arg) noexcept;
 	status get_equal_above(string_view key,
 			       std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_equal_above(string_view key,
+							    F f) noexcept;
 
 	status get_equal_below(string_view key, get_kv_callback *callback,
 			       void *arg) noexcept;
 	status get_equal_below(string_view key,
 			       std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_equal_below(string_view key,
+							    F f) noexcept;
 
 	status get_below(string_view key, get_kv_callback *callback, void *arg) noexcept;
 	status get_below(string_view key, std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_below(string_view key, F f) noexcept;
 
 	status get_between(string_view key1, string_view key2, get_kv_callback *callback,
 			   void *arg) noexcept;
 	status get_between(string_view key1, string_view key2,
 			   std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_between(string_view key1,
+							string_view key2, F f) noexcept;
+
+	status get_prefix(string_view prefix, get_kv_callback *callback,
+			  void *arg) noexcept;
+	status get_prefix(string_view prefix, std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_prefix(string_view prefix,
+						       F f) noexcept;
+
+	status get_all_desc(get_kv_callback *callback, void *arg) noexcept;
+	status get_all_desc(std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_all_desc(F f) noexcept;
+
+	status get_above_desc(string_view key, get_kv_callback *callback,
+			      void *arg) noexcept;
+	status get_above_desc(string_view key, std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_above_desc(string_view key, F f) noexcept;
+
+	status get_equal_above_desc(string_view key, get_kv_callback *callback,
+				    void *arg) noexcept;
+	status get_equal_above_desc(string_view key,
+				    std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_equal_above_desc(string_view key,
+								 F f) noexcept;
+
+	status get_equal_below_desc(string_view key, get_kv_callback *callback,
+				    void *arg) noexcept;
+	status get_equal_below_desc(string_view key,
+				    std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_equal_below_desc(string_view key,
+								 F f) noexcept;
+
+	status get_below_desc(string_view key, get_kv_callback *callback,
+			      void *arg) noexcept;
+	status get_below_desc(string_view key, std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_below_desc(string_view key, F f) noexcept;
+
+	status get_between_desc(string_view key1, string_view key2,
+				get_kv_callback *callback, void *arg) noexcept;
+	status get_between_desc(string_view key1, string_view key2,
+				std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_between_desc(string_view key1,
+							     string_view key2,
+							     F f) noexcept;
+
+	status get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				void *arg) noexcept;
+	status get_all_parallel(std::size_t num_partitions,
+				std::function<get_kv_function> f) noexcept;
+	template <typename F>
+	internal::get_kv_callable_status<F> get_all_parallel(std::size_t num_partitions,
+							     F f) noexcept;
+	status split_points(std::size_t n, std::vector<std::string> &points) noexcept;
 
 	status exists(string_view key) noexcept;
 
 	status get(string_view key, get_v_callback *callback, void *arg) noexcept;
 	status get(string_view key, std::function<get_v_function> f) noexcept;
+	template <typename F>
+	internal::get_v_callable_status<F> get(string_view key, F f) noexcept;
 	status get(string_view key, std::string *value) noexcept;
+	result<value_ref> get_ref(string_view key) noexcept;
 
 	status put(string_view key, string_view value) noexcept;
+	status put_with_ttl(string_view key, string_view value, uint64_t ttl_ms) noexcept;
 	status remove(string_view key) noexcept;
+	status remove_range(string_view key1, string_view key2) noexcept;
+	status remove_prefix(string_view prefix) noexcept;
 	status defrag(double start_percent = 0, double amount_percent = 100);
+	status memory_usage(memory_stats &stats) noexcept;
+
+	status async_get(string_view key, std::function<async_get_function> f) noexcept;
+	status async_put(string_view key, string_view value,
+			 std::function<async_function> f) noexcept;
+	status async_remove(string_view key, std::function<async_function> f) noexcept;
+	std::future<result<std::string>> async_get(string_view key);
+	std::future<status> async_put(string_view key, string_view value);
+	std::future<status> async_remove(string_view key);
+
+	status bulk_load(bulk_load_callback *callback, void *arg) noexcept;
+	status bulk_load(std::function<bulk_load_function> f) noexcept;
+	template <typename F>
+	internal::bulk_load_callable_status<F> bulk_load(F f) noexcept;
+	template <typename InputIt>
+	status bulk_load(InputIt first, InputIt last) noexcept;
 
 	result<tx> tx_begin() noexcept;
 
+	result<db> snapshot() noexcept;
+
+	status dump(int fd) noexcept;
+	status restore(int fd) noexcept;
+
+	status changes(uint64_t since_seq, std::function<change_function> f,
+		       uint64_t timeout_ms = 0) noexcept;
+	status changes_last_seq(uint64_t &seq) noexcept;
+
 	result<read_iterator> new_read_iterator();
 	result<write_iterator> new_write_iterator();
 
 	std::string errormsg();
 
 private:
+	explicit db(pmemkv_db *db) noexcept;
+
 	std::unique_ptr<pmemkv_db, decltype(&pmemkv_close)> db_;
 };
 
@@ -643,6 +945,7 @@ public:
 	status seek_lower_eq(string_view key) noexcept;
 	status seek_higher(string_view key) noexcept;
 	status seek_higher_eq(string_view key) noexcept;
+	status seek_prefix(string_view prefix) noexcept;
 
 	status seek_to_first() noexcept;
 	status seek_to_last() noexcept;
@@ -657,6 +960,10 @@ public:
 	read_range(size_t pos = 0,
 		   size_t n = std::numeric_limits<size_t>::max()) noexcept;
 
+	status
+	next_batch(size_t n,
+		   std::vector<std::pair<string_view, string_view>> &batch) noexcept;
+
 	template <bool IC = IsConst>
 	typename std::enable_if<!IC, result<pmem::obj::slice<OutputIterator<char>>>>::type
 	write_range(size_t pos = 0,
@@ -674,6 +981,10 @@ private:
 					  decltype(&pmemkv_write_iterator_delete)>::type>
 		it_;
 
+	/* scratch buffers for next_batch(), reused between calls */
+	std::vector<const char *> batch_data_;
+	std::vector<size_t> batch_sizes_;
+
 	pmemkv_iterator *get_raw_it();
 };
 
@@ -926,6 +1237,29 @@ inline status db::iterator<IsConst>::seek_higher_eq(string_view key) noexcept
 		this->get_raw_it(), key.data(), key.size()));
 }
 
+/**
+ * Changes iterator position to the first record with key starting with given
+ * *prefix* (keys are compared byte-wise). If the record is present and no errors
+ * occurred, returns pmem::kv::status::OK. If the record does not exist,
+ * pmem::kv::status::NOT_FOUND is returned and the iterator position is undefined.
+ * Other possible return values are described in pmem::kv::status.
+ *
+ * Records with keys starting with the *prefix* can be then visited by calling
+ * next() until the key does not start with the *prefix* anymore.
+ *
+ * It internally aborts all changes made to an element previously pointed by the iterator.
+ *
+ * @param[in] prefix prefix of the key of the record on the new iterator position
+ *
+ * @return pmem::kv::status
+ */
+template <bool IsConst>
+inline status db::iterator<IsConst>::seek_prefix(string_view prefix) noexcept
+{
+	return static_cast<status>(pmemkv_iterator_seek_prefix(
+		this->get_raw_it(), prefix.data(), prefix.size()));
+}
+
 /**
  * Changes iterator position to the first record.
  * If db isn't empty, and no errors occurred, returns
@@ -1067,6 +1401,62 @@ inline result<string_view> db::iterator<IsConst>::read_range(size_t pos,
 		return {s};
 }
 
+/**
+ * Reads up to *n* records, starting from the current one, in a single call and
+ * stores their keys and values in *batch* (previous content of *batch* is removed).
+ * The iterator is left on the last record read, so the remaining records can be
+ * read by calling next() and next_batch() again. If fewer than *n* records were
+ * read, the last record in db was reached.
+ *
+ * Returned string_views are valid as long as the records are not modified.
+ * Engines which cannot move the iterator forward return only the current record.
+ *
+ * It internally aborts all changes made to an element previously pointed by the iterator.
+ *
+ * If the iterator is on an undefined position, calling this method is undefined
+ * behaviour.
+ *
+ * @param[in] n maximum number of records to read
+ * @param[out] batch read records (pairs of key and value)
+ *
+ * @return pmem::kv::status
+ */
+template <bool IsConst>
+inline status db::iterator<IsConst>::next_batch(
+	size_t n, std::vector<std::pair<string_view, string_view>> &batch) noexcept
+{
+	try {
+		batch.clear();
+		batch_data_.resize(2 * n);
+		batch_sizes_.resize(2 * n);
+	} catch (std::bad_alloc &e) {
+		return status::OUT_OF_MEMORY;
+	} catch (...) {
+		return status::UNKNOWN_ERROR;
+	}
+
+	size_t count;
+	auto s = static_cast<status>(pmemkv_iterator_next_batch(
+		this->get_raw_it(), n, batch_data_.data(), batch_sizes_.data(),
+		batch_data_.data() + n, batch_sizes_.data() + n, &count));
+	if (s != status::OK)
+		return s;
+
+	try {
+		batch.reserve(count);
+	} catch (std::bad_alloc &e) {
+		return status::OUT_OF_MEMORY;
+	} catch (...) {
+		return status::UNKNOWN_ERROR;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		batch.emplace_back(string_view(batch_data_[i], batch_sizes_[i]),
+				   string_view(batch_data_[n + i], batch_sizes_[n + i]));
+
+	return status::OK;
+}
+
 /**
  * Returns value's range (pmem::obj::slice<db::iterator::OutputIterator<char>>) to modify,
  * in pmem::kv::result.
@@ -1686,6 +2076,39 @@ inline pmemkv_config *config::release() noexcept
 	return this->config_.release();
 }
 
+/**
+ * Constructs handle to a value from a C pmemkv_value_ref. It is used by
+ * db::get_ref(), there's no need to call it directly.
+ */
+inline value_ref::value_ref(pmemkv_value_ref *ref) noexcept
+    : ref_(ref, &pmemkv_value_ref_delete)
+{
+	const char *data;
+	size_t size;
+	pmemkv_value_ref_get(ref_.get(), &data, &size);
+	value_ = string_view(data, size);
+}
+
+/**
+ * Returns the referenced value. After release() an empty string_view is returned.
+ *
+ * @return pmem::kv::string_view
+ */
+inline string_view value_ref::value() const noexcept
+{
+	return value_;
+}
+
+/**
+ * Releases the value (and all locks held to protect it) before the handle
+ * is destroyed.
+ */
+inline void value_ref::release() noexcept
+{
+	ref_.reset();
+	value_ = string_view();
+}
+
 /**
  * Constructs C++ tx object from a C pmemkv_tx pointer
  */
@@ -1767,6 +2190,61 @@ static inline void call_get_copy(const char *v, size_t vb, void *arg)
 	auto c = reinterpret_cast<std::string *>(arg);
 	c->assign(v, vb);
 }
+
+static inline void call_append_copy(const char *v, size_t vb, void *arg)
+{
+	auto c = reinterpret_cast<std::vector<std::string> *>(arg);
+	c->emplace_back(v, vb);
+}
+
+static inline int call_bulk_load_function(const char **key, size_t *keybytes,
+					  const char **value, size_t *valuebytes,
+					  void *arg)
+{
+	string_view k, v;
+	auto ret = (*reinterpret_cast<std::function<bulk_load_function> *>(arg))(k, v);
+	if (ret == 0) {
+		*key = k.data();
+		*keybytes = k.size();
+		*value = v.data();
+		*valuebytes = v.size();
+	}
+	return ret;
+}
+
+/* Completion callbacks of asynchronous operations, called (once) with an
+ * allocated std::function, which is freed afterwards. */
+static inline void call_async_get_function(int s, const char *value, size_t valuebytes,
+					   void *arg)
+{
+	std::unique_ptr<std::function<async_get_function>> f(
+		reinterpret_cast<std::function<async_get_function> *>(arg));
+	try {
+		(*f)(static_cast<status>(s), string_view(value, valuebytes));
+	} catch (...) {
+		/* exceptions cannot be propagated to the executor */
+	}
+}
+
+static inline void call_async_function(int s, const char *, size_t, void *arg)
+{
+	std::unique_ptr<std::function<async_function>> f(
+		reinterpret_cast<std::function<async_function> *>(arg));
+	try {
+		(*f)(static_cast<status>(s));
+	} catch (...) {
+		/* exceptions cannot be propagated to the executor */
+	}
+}
+
+static inline int call_change_function(uint64_t seq, int type, const char *key,
+				       size_t keybytes, const char *value,
+				       size_t valuebytes, void *arg)
+{
+	return (*reinterpret_cast<std::function<change_function> *>(arg))(
+		seq, static_cast<change_type>(type), string_view(key, keybytes),
+		string_view(value, valuebytes));
+}
 }
 
 /**
@@ -1776,6 +2254,10 @@ inline db::db() noexcept : db_(nullptr, &pmemkv_close)
 {
 }
 
+inline db::db(pmemkv_db *db) noexcept : db_(db, &pmemkv_close)
+{
+}
+
 /**
  * Opens the pmemkv database with specified config.
  *
@@ -1897,6 +2379,21 @@ inline status db::count_between(string_view key1, string_view key2,
 							key2.size(), &cnt));
 }
 
+/**
+ * It returns number of currently stored elements in pmem::kv::db, whose keys
+ * start with the *prefix* (keys are compared byte-wise).
+ *
+ * @param[in] prefix prefix of the keys to be counted
+ * @param[out] cnt number of records in pmem::kv::db matching query
+ *
+ * @return pmem::kv::status
+ */
+inline status db::count_prefix(string_view prefix, std::size_t &cnt) noexcept
+{
+	return static_cast<status>(pmemkv_count_prefix(this->db_.get(), prefix.data(),
+						       prefix.size(), &cnt));
+}
+
 /**
  * Executes (C-like) *callback* function for every record stored in pmem::kv::db.
  * Arguments passed to the callback function are: pointer to a key, size of the
@@ -1930,6 +2427,25 @@ inline status db::get_all(std::function<get_kv_function> f) noexcept
 		pmemkv_get_all(this->db_.get(), call_get_kv_function, &f));
 }
 
+/**
+ * Executes function for every record stored in pmem::kv::db.
+ * Callback can stop iteration by returning non-zero value. In that case *get_all()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_all(F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_all(this->db_.get(), internal::call_get_kv_callable<F>, &f));
+}
+
 /**
  * Executes (C-like) callback function for every record stored in pmem::kv::db,
  * whose keys are greater than the given *key*.
@@ -1973,6 +2489,30 @@ inline status db::get_above(string_view key, std::function<get_kv_function> f) n
 		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
 }
 
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are
+ * greater than the given *key*.
+ * Callback can stop iteration by returning non-zero value. In that case *get_above()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_above(string_view key, F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_above(this->db_.get(), key.data(), key.size(),
+				 internal::call_get_kv_callable<F>, &f));
+}
+
 /**
  * Executes (C-like) callback function for every record stored in pmem::kv::db,
  * whose keys are greater than or equal to the given *key*.
@@ -2019,6 +2559,32 @@ inline status db::get_equal_above(string_view key,
 		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
 }
 
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are
+ * greater than or equal to the given *key*.
+ * Callback can stop iteration by returning non-zero value. In that case
+ **get_equal_above()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ *iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_equal_above(string_view key,
+							       F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_equal_above(this->db_.get(), key.data(), key.size(),
+				       internal::call_get_kv_callable<F>, &f));
+}
+
 /**
  * Executes (C-like) callback function for every record stored in pmem::kv::db,
  * whose keys are lower than or equal to the given *key*.
@@ -2065,6 +2631,32 @@ inline status db::get_equal_below(string_view key,
 		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
 }
 
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are
+ * lower than or equal to the given *key*.
+ * Callback can stop iteration by returning non-zero value. In that case
+ **get_equal_below()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ *iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_equal_below(string_view key,
+							       F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_equal_below(this->db_.get(), key.data(), key.size(),
+				       internal::call_get_kv_callable<F>, &f));
+}
+
 /**
  * Executes (C-like) callback function for every record stored in pmem::kv::db,
  * whose keys are lower than the given *key*.
@@ -2109,10 +2701,56 @@ inline status db::get_below(string_view key, std::function<get_kv_function> f) n
 }
 
 /**
- * Executes (C-like) callback function for every record stored in pmem::kv::db,
- * whose keys are greater than the *key1* and less than the *key2*.
- * Arguments passed to the callback function are: pointer to a key, size of the
- * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Executes function for every record stored in pmem::kv::db, whose keys are
+ * less than the given *key*.
+ * Callback can stop iteration by returning non-zero value. In that case *get_below()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_below(string_view key, F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_below(this->db_.get(), key.data(), key.size(),
+				 internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) callback function for every record stored in pmem::kv::db,
+ * whose keys are greater than the *key1* and less than the *key2*.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case *get_between()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key1 sets the lower bound for querying
+ * @param[in] key2 sets the upper bound for querying
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_between(string_view key1, string_view key2,
+			      get_kv_callback *callback, void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_between(this->db_.get(), key1.data(),
+						      key1.size(), key2.data(),
+						      key2.size(), callback, arg));
+}
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys
+ * are greater than the *key1* and less than the *key2*.
  * Callback can stop iteration by returning non-zero value. In that case *get_between()*
  * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
  *
@@ -2120,39 +2758,592 @@ inline status db::get_below(string_view key, std::function<get_kv_function> f) n
  *
  * @param[in] key1 sets the lower bound for querying
  * @param[in] key2 sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_between(string_view key1, string_view key2,
+			      std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_between(this->db_.get(), key1.data(), key1.size(), key2.data(),
+				   key2.size(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys
+ * are greater than the *key1* and less than the *key2*.
+ * Callback can stop iteration by returning non-zero value. In that case *get_between()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key1 sets the lower bound for querying
+ * @param[in] key2 sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_between(string_view key1,
+							   string_view key2, F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_between(this->db_.get(), key1.data(), key1.size(), key2.data(),
+				   key2.size(), internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) callback function for every record stored in pmem::kv::db,
+ * whose keys start with the *prefix* (keys are compared byte-wise).
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case *get_prefix()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Records are visited in the order specified by a comparator.
+ *
+ * @param[in] prefix prefix of the keys of returned records
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_prefix(string_view prefix, get_kv_callback *callback,
+			     void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_prefix(this->db_.get(), prefix.data(),
+						     prefix.size(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys
+ * start with the *prefix* (keys are compared byte-wise).
+ * Callback can stop iteration by returning non-zero value. In that case *get_prefix()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Records are visited in the order specified by a comparator.
+ *
+ * @param[in] prefix prefix of the keys of returned records
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_prefix(string_view prefix,
+			     std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_prefix(this->db_.get(), prefix.data(),
+						     prefix.size(), call_get_kv_function,
+						     &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys
+ * start with the *prefix* (keys are compared byte-wise).
+ * Callback can stop iteration by returning non-zero value. In that case *get_prefix()*
+ * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ *
+ * Records are visited in the order specified by a comparator.
+ *
+ * @param[in] prefix prefix of the keys of returned records
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_prefix(string_view prefix,
+							  F f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_prefix(this->db_.get(), prefix.data(), prefix.size(),
+				  internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, in
+ * descending order of keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_all_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_all_desc(get_kv_callback *callback, void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_all_desc(
+		this->db_.get(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, in descending order of
+ * keys.
+ * See db::get_all_desc(get_kv_callback *, void *) for details.
+ *
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_all_desc(std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_all_desc(
+		this->db_.get(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, in descending order of
+ * keys.
+ * See db::get_all_desc(get_kv_callback *, void *) for details.
+ *
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_all_desc(F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_all_desc(
+		this->db_.get(), internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, whose
+ * keys are greater than the given *key*, in descending order of keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_above_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_above_desc(string_view key, get_kv_callback *callback,
+				 void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_above_desc(
+		this->db_.get(), key.data(), key.size(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than the given *key*, in descending order of keys.
+ * See db::get_above_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_above_desc(string_view key,
+				 std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_above_desc(
+		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than the given *key*, in descending order of keys.
+ * See db::get_above_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_above_desc(string_view key,
+							      F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_above_desc(
+		this->db_.get(), key.data(), key.size(),
+		internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, whose
+ * keys are greater than or equal to the given *key*, in descending order of keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_equal_above_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_equal_above_desc(string_view key, get_kv_callback *callback,
+				       void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_above_desc(
+		this->db_.get(), key.data(), key.size(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than or equal to the given *key*, in descending order of keys.
+ * See db::get_equal_above_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_equal_above_desc(string_view key,
+				       std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_above_desc(
+		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than or equal to the given *key*, in descending order of keys.
+ * See db::get_equal_above_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the lower bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_equal_above_desc(string_view key,
+								    F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_above_desc(
+		this->db_.get(), key.data(), key.size(),
+		internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, whose
+ * keys are lower than or equal to the given *key*, in descending order of keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_equal_below_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_equal_below_desc(string_view key, get_kv_callback *callback,
+				       void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_below_desc(
+		this->db_.get(), key.data(), key.size(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are lower than
+ * or equal to the given *key*, in descending order of keys.
+ * See db::get_equal_below_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_equal_below_desc(string_view key,
+				       std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_below_desc(
+		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are lower than
+ * or equal to the given *key*, in descending order of keys.
+ * See db::get_equal_below_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_equal_below_desc(string_view key,
+								    F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_equal_below_desc(
+		this->db_.get(), key.data(), key.size(),
+		internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, whose
+ * keys are lower than the given *key*, in descending order of keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_below_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] callback function to be called for each returned element
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_below_desc(string_view key, get_kv_callback *callback,
+				 void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_below_desc(
+		this->db_.get(), key.data(), key.size(), callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are lower than
+ * the given *key*, in descending order of keys.
+ * See db::get_below_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_below_desc(string_view key,
+				 std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_below_desc(
+		this->db_.get(), key.data(), key.size(), call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are lower than
+ * the given *key*, in descending order of keys.
+ * See db::get_below_desc(string_view, get_kv_callback *, void *) for details.
+ *
+ * @param[in] key sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_below_desc(string_view key,
+							      F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_below_desc(
+		this->db_.get(), key.data(), key.size(),
+		internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db, whose
+ * keys are greater than the *key1* and less than the *key2*, in descending order of
+ * keys.
+ * Arguments passed to the callback function are: pointer to a key, size of the
+ * key, pointer to a value, size of the value and *arg* specified by the user.
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_between_desc()* returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues
+ * iteration. Records are read from the end of the range, so e.g. the last N
+ * of them are found without visiting the rest.
+ *
+ * Keys are sorted in order specified by a comparator.
+ *
+ * @param[in] key1 sets the lower bound for querying
+ * @param[in] key2 sets the upper bound for querying
  * @param[in] callback function to be called for each returned element
  * @param[in] arg additional arguments to be passed to callback
  *
  * @return pmem::kv::status
  */
-inline status db::get_between(string_view key1, string_view key2,
-			      get_kv_callback *callback, void *arg) noexcept
+inline status db::get_between_desc(string_view key1, string_view key2,
+				   get_kv_callback *callback, void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_get_between_desc(
+		this->db_.get(), key1.data(), key1.size(), key2.data(), key2.size(),
+		callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than the *key1* and less than the *key2*, in descending order of keys.
+ * See db::get_between_desc(string_view, string_view, get_kv_callback *, void *) for
+ * details.
+ *
+ * @param[in] key1 sets the lower bound for querying
+ * @param[in] key2 sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_between_desc(string_view key1, string_view key2,
+				   std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_between_desc(
+		this->db_.get(), key1.data(), key1.size(), key2.data(), key2.size(),
+		call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, whose keys are greater
+ * than the *key1* and less than the *key2*, in descending order of keys.
+ * See db::get_between_desc(string_view, string_view, get_kv_callback *, void *) for
+ * details.
+ *
+ * @param[in] key1 sets the lower bound for querying
+ * @param[in] key2 sets the upper bound for querying
+ * @param[in] f function called for each returned element, it is called with params:
+ *				key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F> db::get_between_desc(string_view key1,
+								string_view key2,
+								F f) noexcept
+{
+	return static_cast<status>(pmemkv_get_between_desc(
+		this->db_.get(), key1.data(), key1.size(), key2.data(), key2.size(),
+		internal::call_get_kv_callable<F>, &f));
+}
+
+/**
+ * Executes (C-like) *callback* function for every record stored in pmem::kv::db,
+ * scanning *num_partitions* disjoint parts of the db in parallel, each on a separate
+ * thread. Arguments passed to the callback function are: pointer to a key, size of
+ * the key, pointer to a value, size of the value and *arg* specified by the user.
+ *
+ * The callback is called concurrently from multiple threads, so it has to be
+ * thread-safe. Records of a single partition are visited in the same order as
+ * in get_all(), there is no ordering between partitions. Engine may use fewer
+ * partitions than requested (e.g. for a small db).
+ *
+ * Callback can stop iteration by returning non-zero value. In that case
+ * *get_all_parallel()* returns pmem::kv::status::STOPPED_BY_CB and the callback
+ * is not called anymore in any partition. Returning 0 continues iteration.
+ *
+ * @param[in] num_partitions maximal number of partitions scanned in parallel
+ * @param[in] callback function to be called for every element stored in db
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_all_parallel(std::size_t num_partitions, get_kv_callback *callback,
+				   void *arg) noexcept
+{
+	return static_cast<status>(
+		pmemkv_get_all_parallel(this->db_.get(), num_partitions, callback, arg));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, scanning
+ * *num_partitions* disjoint parts of the db in parallel.
+ * See db::get_all_parallel(std::size_t, get_kv_callback *, void *) for details.
+ *
+ * @param[in] num_partitions maximal number of partitions scanned in parallel
+ * @param[in] f thread-safe function called for each element, it is called with
+ *				params: key and value
+ *
+ * @return pmem::kv::status
+ */
+inline status db::get_all_parallel(std::size_t num_partitions,
+				   std::function<get_kv_function> f) noexcept
+{
+	return static_cast<status>(pmemkv_get_all_parallel(
+		this->db_.get(), num_partitions, call_get_kv_function, &f));
+}
+
+/**
+ * Executes function for every record stored in pmem::kv::db, scanning
+ * *num_partitions* disjoint parts of the db in parallel.
+ * See db::get_all_parallel(std::size_t, get_kv_callback *, void *) for details.
+ *
+ * @param[in] num_partitions maximal number of partitions scanned in parallel
+ * @param[in] f thread-safe function called for each element, it is called with
+ *				params: key and value
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_kv_callable_status<F>
+db::get_all_parallel(std::size_t num_partitions, F f) noexcept
 {
-	return static_cast<status>(pmemkv_get_between(this->db_.get(), key1.data(),
-						      key1.size(), key2.data(),
-						      key2.size(), callback, arg));
+	return static_cast<status>(pmemkv_get_all_parallel(
+		this->db_.get(), num_partitions, internal::call_get_kv_callable<F>, &f));
 }
+
 /**
- * Executes function for every record stored in pmem::kv::db, whose keys
- * are greater than the *key1* and less than the *key2*.
- * Callback can stop iteration by returning non-zero value. In that case *get_between()*
- * returns pmem::kv::status::STOPPED_BY_CB. Returning 0 continues iteration.
+ * Appends to *points* up to *n - 1* ascending keys which split the db into
+ * ranges of similar size. The first range contains keys lower than the first
+ * point, the i-th range starts at the (i - 1)-th point (inclusive) and the last
+ * one contains the rest of the keys. Such ranges can be then processed
+ * independently, e.g. using iterators.
  *
- * Keys are sorted in order specified by a comparator.
+ * It is supported only by sorted engines.
  *
- * @param[in] key1 sets the lower bound for querying
- * @param[in] key2 sets the upper bound for querying
- * @param[in] f function called for each returned element, it is called with params:
- *				key and value
+ * @param[in] n number of ranges
+ * @param[out] points split keys
  *
  * @return pmem::kv::status
  */
-inline status db::get_between(string_view key1, string_view key2,
-			      std::function<get_kv_function> f) noexcept
+inline status db::split_points(std::size_t n, std::vector<std::string> &points) noexcept
 {
 	return static_cast<status>(
-		pmemkv_get_between(this->db_.get(), key1.data(), key1.size(), key2.data(),
-				   key2.size(), call_get_kv_function, &f));
+		pmemkv_split_points(this->db_.get(), n, call_append_copy, &points));
 }
 
 /**
@@ -2208,6 +3399,26 @@ inline status db::get(string_view key, std::function<get_v_function> f) noexcept
 					      call_get_v_function, &f));
 }
 
+/**
+ * Executes function for record with given *key*. If record is present and
+ * no error occurred the function returns pmem::kv::status::OK. If record does
+ * not exist pmem::kv::status::NOT_FOUND is returned.
+ *
+ * @param[in] key record's key to query for
+ * @param[in] f function called for returned element, it is called with only
+ *				one param - value (key is known)
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::get_v_callable_status<F> db::get(string_view key, F f) noexcept
+{
+	return static_cast<status>(pmemkv_get(this->db_.get(), key.data(), key.size(),
+					      internal::call_get_v_callable<F>, &f));
+}
+
 /**
  * Gets value copy of record with given *key*. In absence of any errors,
  * pmem::kv::status::OK is returned.
@@ -2224,6 +3435,31 @@ inline status db::get(string_view key, std::string *value) noexcept
 					      call_get_copy, value));
 }
 
+/**
+ * Gets a handle to the value of record with given *key*, without copying the
+ * value (see pmem::kv::value_ref for the handle's lifetime rules). If record
+ * is present and no errors occurred, returns the handle in pmem::kv::result,
+ * otherwise pmem::kv::status::NOT_FOUND (or other status described in
+ * pmem::kv::status) is returned.
+ *
+ * Engines which cannot expose values in place return a handle to a copy.
+ *
+ * @param[in] key record's key to query for
+ *
+ * @return pmem::kv::result<pmem::kv::value_ref>
+ */
+inline result<value_ref> db::get_ref(string_view key) noexcept
+{
+	pmemkv_value_ref *ref;
+	auto s = static_cast<status>(
+		pmemkv_get_ref(this->db_.get(), key.data(), key.size(), &ref));
+
+	if (s == status::OK)
+		return result<value_ref>(value_ref(ref));
+	else
+		return result<value_ref>(s);
+}
+
 /**
  * Inserts a key-value pair into pmemkv database.
  * This function is guaranteed to be implemented by all engines.
@@ -2239,6 +3475,30 @@ inline status db::put(string_view key, string_view value) noexcept
 					      value.data(), value.size()));
 }
 
+/**
+ * Inserts a key-value pair which expires after ttl_ms milliseconds. Expired
+ * record is not visible for point reads (get, exists, get_ref, iterator's seek)
+ * and it is removed in the background shortly after its deadline. Putting
+ * the key again (with db::put or db::put_with_ttl) replaces its deadline.
+ *
+ * Supported only by cmap and stree engines opened with "path" config item.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's key
+ * @param[in] value data to be inserted
+ * @param[in] ttl_ms time to live in milliseconds, must be greater than 0
+ *
+ * @return pmem::kv::status
+ */
+inline status db::put_with_ttl(string_view key, string_view value,
+			       uint64_t ttl_ms) noexcept
+{
+	return static_cast<status>(pmemkv_put_with_ttl(this->db_.get(), key.data(),
+						       key.size(), value.data(),
+						       value.size(), ttl_ms));
+}
+
 /**
  * Removes from database record with given *key*.
  * This function is guaranteed to be implemented by all engines.
@@ -2253,6 +3513,40 @@ inline status db::remove(string_view key) noexcept
 		pmemkv_remove(this->db_.get(), key.data(), key.size()));
 }
 
+/**
+ * Removes from database all records with keys greater than or equal to *key1*
+ * and less than *key2*. Keys are compared with the comparator of the database.
+ * Removal is not atomic: if it is interrupted (e.g. by a crash), part of the
+ * range may remain in the database.
+ * It is supported by sorted engines: vsmap, csmap, stree and radix.
+ *
+ * @param[in] key1 lower bound of the range (inclusive)
+ * @param[in] key2 upper bound of the range (exclusive)
+ *
+ * @return pmem::kv::status
+ */
+inline status db::remove_range(string_view key1, string_view key2) noexcept
+{
+	return static_cast<status>(pmemkv_remove_range(this->db_.get(), key1.data(),
+						       key1.size(), key2.data(),
+						       key2.size()));
+}
+
+/**
+ * Removes from database all records with keys starting with *prefix*.
+ * Like remove_range, the removal is not atomic.
+ * It is supported by sorted engines: vsmap, csmap, stree and radix.
+ *
+ * @param[in] prefix prefix of keys to be removed
+ *
+ * @return pmem::kv::status
+ */
+inline status db::remove_prefix(string_view prefix) noexcept
+{
+	return static_cast<status>(
+		pmemkv_remove_prefix(this->db_.get(), prefix.data(), prefix.size()));
+}
+
 /**
  * Defragments approximately 'amount_percent' percent of elements
  * in the database starting from 'start_percent' percent of elements.
@@ -2268,6 +3562,294 @@ inline status db::defrag(double start_percent, double amount_percent)
 		pmemkv_defrag(this->db_.get(), start_percent, amount_percent));
 }
 
+/**
+ * Reports memory footprint of the database: total size of keys and values,
+ * memory allocated for the engine's structures and by the allocator itself,
+ * and the free (also fragmented) space. Helps to size the pool and to decide
+ * when to defragment it.
+ *
+ * Sizes of keys and values are counted by iterating over all elements, so
+ * this function is as expensive as get_all(). Other figures come from
+ * statistics of the allocator: libpmemobj for pmemobj based engines (they
+ * cover the whole pool, including objects not allocated by the engine)
+ * and memkind for vsmap and vcmap (they cover all memkind kinds used in
+ * the process).
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[out] stats memory footprint of the database
+ *
+ * @return pmem::kv::status
+ */
+inline status db::memory_usage(memory_stats &stats) noexcept
+{
+	return static_cast<status>(pmemkv_memory_usage(this->db_.get(), &stats));
+}
+
+/**
+ * Submits an asynchronous get of the value for the given *key*. The function
+ * returns immediately; callback *f* is called (in a thread of the executor)
+ * with the status of the operation and, if it is status::OK, the value.
+ * The value is valid only during the callback.
+ *
+ * Operations are run by the executor of the database, started on the first
+ * asynchronous operation. Its number of threads and size of batches can be
+ * set by "async_threads" and "async_batch_size" config items, see
+ * libpmemkv(7). Operations on the same key complete in order of submission.
+ * db::close() waits for all submitted operations to complete.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier to query for
+ * @param[in] f function called with the status and the value
+ *
+ * @return pmem::kv::status of the submission, if it is not status::OK,
+ * the callback is not called
+ */
+inline status db::async_get(string_view key, std::function<async_get_function> f) noexcept
+{
+	std::unique_ptr<std::function<async_get_function>> cb;
+	try {
+		cb.reset(new std::function<async_get_function>(std::move(f)));
+	} catch (std::bad_alloc &) {
+		return status::OUT_OF_MEMORY;
+	}
+
+	auto s = static_cast<status>(pmemkv_async_get(this->db_.get(), key.data(),
+						      key.size(), nullptr,
+						      call_async_get_function, cb.get()));
+	if (s == status::OK)
+		cb.release();
+
+	return s;
+}
+
+/**
+ * Submits an asynchronous put of the *value* for the given *key*. The function
+ * returns immediately; callback *f* is called (in a thread of the executor)
+ * with the status of the operation. See db::async_get() for details.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier
+ * @param[in] value data to be inserted into this new database record
+ * @param[in] f function called with the status of the operation
+ *
+ * @return pmem::kv::status of the submission, if it is not status::OK,
+ * the callback is not called
+ */
+inline status db::async_put(string_view key, string_view value,
+			    std::function<async_function> f) noexcept
+{
+	std::unique_ptr<std::function<async_function>> cb;
+	try {
+		cb.reset(new std::function<async_function>(std::move(f)));
+	} catch (std::bad_alloc &) {
+		return status::OUT_OF_MEMORY;
+	}
+
+	auto s = static_cast<status>(pmemkv_async_put(
+		this->db_.get(), key.data(), key.size(), value.data(), value.size(),
+		nullptr, call_async_function, cb.get()));
+	if (s == status::OK)
+		cb.release();
+
+	return s;
+}
+
+/**
+ * Submits an asynchronous removal of the record for the given *key*. The
+ * function returns immediately; callback *f* is called (in a thread of the
+ * executor) with the status of the operation. See db::async_get() for details.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier to remove
+ * @param[in] f function called with the status of the operation
+ *
+ * @return pmem::kv::status of the submission, if it is not status::OK,
+ * the callback is not called
+ */
+inline status db::async_remove(string_view key, std::function<async_function> f) noexcept
+{
+	std::unique_ptr<std::function<async_function>> cb;
+	try {
+		cb.reset(new std::function<async_function>(std::move(f)));
+	} catch (std::bad_alloc &) {
+		return status::OUT_OF_MEMORY;
+	}
+
+	auto s = static_cast<status>(pmemkv_async_remove(this->db_.get(), key.data(),
+							 key.size(), nullptr,
+							 call_async_function, cb.get()));
+	if (s == status::OK)
+		cb.release();
+
+	return s;
+}
+
+/**
+ * Submits an asynchronous get of the value for the given *key*, see
+ * db::async_get(string_view, std::function<async_get_function>).
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier to query for
+ *
+ * @return future of pmem::kv::result with the value or the status of
+ * the operation (or of the submission, if it failed)
+ */
+inline std::future<result<std::string>> db::async_get(string_view key)
+{
+	auto promise = std::make_shared<std::promise<result<std::string>>>();
+	auto future = promise->get_future();
+
+	auto submitted = async_get(key, [promise](status s, string_view value) {
+		if (s == status::OK)
+			promise->set_value(result<std::string>(
+				std::string(value.data(), value.size())));
+		else
+			promise->set_value(result<std::string>(s));
+	});
+	if (submitted != status::OK)
+		promise->set_value(result<std::string>(submitted));
+
+	return future;
+}
+
+/**
+ * Submits an asynchronous put of the *value* for the given *key*, see
+ * db::async_put(string_view, string_view, std::function<async_function>).
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier
+ * @param[in] value data to be inserted into this new database record
+ *
+ * @return future of pmem::kv::status of the operation (or of the submission,
+ * if it failed)
+ */
+inline std::future<status> db::async_put(string_view key, string_view value)
+{
+	auto promise = std::make_shared<std::promise<status>>();
+	auto future = promise->get_future();
+
+	auto submitted =
+		async_put(key, value, [promise](status s) { promise->set_value(s); });
+	if (submitted != status::OK)
+		promise->set_value(submitted);
+
+	return future;
+}
+
+/**
+ * Submits an asynchronous removal of the record for the given *key*, see
+ * db::async_remove(string_view, std::function<async_function>).
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] key record's identifier to remove
+ *
+ * @return future of pmem::kv::status of the operation (or of the submission,
+ * if it failed)
+ */
+inline std::future<status> db::async_remove(string_view key)
+{
+	auto promise = std::make_shared<std::promise<status>>();
+	auto future = promise->get_future();
+
+	auto submitted =
+		async_remove(key, [promise](status s) { promise->set_value(s); });
+	if (submitted != status::OK)
+		promise->set_value(submitted);
+
+	return future;
+}
+
+/**
+ * Loads key-value pairs produced by (C-like) *callback* into the database.
+ * The callback is called with pointers to a key, size of the key, a value,
+ * size of the value (all to be set by the callback) and *arg* specified by
+ * the user. It should return 0 when it set the next element or non-zero
+ * value when there are no more elements. The data set by the callback has
+ * to stay valid until the next call.
+ *
+ * Keys have to be produced in strictly ascending order (as defined by
+ * the comparator), otherwise pmem::kv::status::INVALID_ARGUMENT is returned
+ * and elements loaded before the first misplaced key are kept. Engines build
+ * their structures in bulk, which is much faster than calling put() for
+ * each element. Existing keys are overwritten.
+ *
+ * @param[in] callback function producing elements to be loaded
+ * @param[in] arg additional arguments to be passed to callback
+ *
+ * @return pmem::kv::status
+ */
+inline status db::bulk_load(bulk_load_callback *callback, void *arg) noexcept
+{
+	return static_cast<status>(pmemkv_bulk_load(this->db_.get(), callback, arg));
+}
+
+/**
+ * Loads key-value pairs produced by function *f* into the database.
+ * See db::bulk_load(bulk_load_callback *, void *) for details.
+ *
+ * @param[in] f function setting key and value of the next element and
+ *				returning 0, or returning non-zero when there are no more elements
+ *
+ * @return pmem::kv::status
+ */
+inline status db::bulk_load(std::function<bulk_load_function> f) noexcept
+{
+	return static_cast<status>(
+		pmemkv_bulk_load(this->db_.get(), call_bulk_load_function, &f));
+}
+
+/**
+ * Loads key-value pairs produced by function *f* into the database.
+ * See db::bulk_load(bulk_load_callback *, void *) for details.
+ *
+ * @param[in] f function setting key and value of the next element and
+ *				returning 0, or returning non-zero when there are no more elements
+ *
+ * *f* is called directly, without wrapping it in std::function.
+ *
+ * @return pmem::kv::status
+ */
+template <typename F>
+inline internal::bulk_load_callable_status<F> db::bulk_load(F f) noexcept
+{
+	return static_cast<status>(pmemkv_bulk_load(
+		this->db_.get(), internal::call_bulk_load_callable<F>, &f));
+}
+
+/**
+ * Loads key-value pairs from range [first, last) into the database.
+ * Dereferenced iterator has to provide *first* and *second* members
+ * (key and value) convertible to pmem::kv::string_view, e.g. iterator
+ * of std::map<std::string, std::string>.
+ * See db::bulk_load(bulk_load_callback *, void *) for details.
+ *
+ * @param[in] first beginning of the range of sorted elements
+ * @param[in] last end of the range of sorted elements
+ *
+ * @return pmem::kv::status
+ */
+template <typename InputIt>
+inline status db::bulk_load(InputIt first, InputIt last) noexcept
+{
+	return bulk_load([&](string_view &key, string_view &value) {
+		if (first == last)
+			return 1;
+
+		key = string_view(first->first);
+		value = string_view(first->second);
+		++first;
+
+		return 0;
+	});
+}
+
 /**
  * Returns new write iterator in pmem::kv::result.
  *
@@ -2336,6 +3918,119 @@ inline result<tx> db::tx_begin() noexcept
 		return result<tx>(s);
 }
 
+/**
+ * Takes a point-in-time snapshot of the database. Snapshot is a read-only
+ * database (writes return status::NOT_SUPPORTED): its reads, range queries
+ * and read iterators see the data as it was when the snapshot was taken,
+ * while writers keep modifying the database. Snapshot has to be closed
+ * before the database.
+ *
+ * It is supported by stree engine.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @return pmem::kv::result<db> with the snapshot or an error status
+ */
+inline result<db> db::snapshot() noexcept
+{
+	pmemkv_db *snapshot;
+	auto s = static_cast<status>(pmemkv_snapshot(db_.get(), &snapshot));
+
+	if (s == status::OK)
+		return result<db>(db(snapshot));
+	else
+		return result<db>(s);
+}
+
+/**
+ * Writes all key-value pairs of the database to fd (at its current offset),
+ * in a block-oriented, checksummed format independent of the engine. Ranges
+ * of keys (or partitions of sorted engines) are read by many threads and
+ * written as separate runs of blocks.
+ *
+ * Dump contains neither TTLs of keys nor the engine's configuration.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] fd file descriptor opened for writing (e.g. a file, pipe or socket)
+ *
+ * @return pmem::kv::status
+ */
+inline status db::dump(int fd) noexcept
+{
+	return static_cast<status>(pmemkv_dump(this->db_.get(), fd));
+}
+
+/**
+ * Puts all key-value pairs of a dump read from fd (at its current offset) into
+ * the database, overwriting existing keys. Regular files are mapped and read
+ * without copying. A dump of a sorted engine is bulk loaded if the database
+ * is empty and supports bulk_load; concurrent engines are written by many
+ * threads.
+ *
+ * The whole dump is validated first - if it is corrupted,
+ * status::INVALID_ARGUMENT is returned and the database is not modified.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] fd file descriptor opened for reading
+ *
+ * @return pmem::kv::status
+ */
+inline status db::restore(int fd) noexcept
+{
+	return static_cast<status>(pmemkv_restore(this->db_.get(), fd));
+}
+
+/**
+ * Calls f for every mutation recorded in the change log with sequence number
+ * greater than *since_seq*, in order of sequence numbers. Puts (also with TTL,
+ * bulk loaded ones and values modified by write iterators) and successful
+ * removes are recorded once they are committed; records of a transaction share
+ * a sequence number and are recorded together. Expiration of keys is not
+ * recorded.
+ *
+ * If there are no such records, it waits for them up to *timeout_ms*
+ * milliseconds, so the log can be tailed by calling it in a loop with the
+ * sequence number of the last seen record.
+ *
+ * The log is enabled by "change_log_size" config item. It is a ring buffer
+ * (kept in the pool by pmemobj engines), so the oldest records are overwritten
+ * when it is full - status::NOT_FOUND is returned if some of the requested
+ * records are not available anymore.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[in] since_seq sequence number of the last record already seen
+ *			(0 to read all available)
+ * @param[in] f function called for each record
+ * @param[in] timeout_ms time to wait for new records
+ *
+ * @return pmem::kv::status
+ */
+inline status db::changes(uint64_t since_seq, std::function<change_function> f,
+			  uint64_t timeout_ms) noexcept
+{
+	return static_cast<status>(pmemkv_changes(this->db_.get(), since_seq, timeout_ms,
+						  call_change_function, &f));
+}
+
+/**
+ * Gets the sequence number of the newest record in the change log (0 if it is
+ * empty). A consumer can take it before copying the whole database (e.g. with
+ * dump()) and then tail the log from it.
+ *
+ * __This API is EXPERIMENTAL and might change.__
+ *
+ * @param[out] seq sequence number of the newest record
+ *
+ * @return pmem::kv::status
+ */
+inline status db::changes_last_seq(uint64_t &seq) noexcept
+{
+	return static_cast<status>(pmemkv_changes_last_seq(this->db_.get(), &seq));
+}
+
 } /* namespace kv */
 } /* namespace pmem */
 
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_PARALLEL_H
+#define LIBPMEMKV_PARALLEL_H
+
+#include "libpmemkv.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/*
+ * Runs f(0) .. f(n - 1) on at most hardware_concurrency threads (the calling
+ * one included) and rethrows first caught exception. If a thread cannot be
+ * started, its share of the work is done by the threads already running.
+ * Memory used does not depend on n, only on the number of threads.
+ */
+template <typename F>
+void parallel_exec(std::size_t n, F f)
+{
+	auto cores = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	auto count = std::min(n, cores);
+
+	/* first exception caught by each thread */
+	std::vector<std::exception_ptr> errors(count);
+	std::atomic<std::size_t> next(0);
+	auto worker = [&](std::size_t t) {
+		for (auto i = next++; i < n; i = next++) {
+			try {
+				f(i);
+			} catch (...) {
+				if (!errors[t])
+					errors[t] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	try {
+		for (std::size_t t = 1; t < count; t++)
+			threads.emplace_back(worker, t);
+	} catch (...) {
+		/* run with fewer threads */
+	}
+
+	worker(0);
+	for (auto &t : threads)
+		t.join();
+	for (auto &e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
+
+/**
+ * Helper for get_all_parallel() implementations. Calls scan(i, callback, arg)
+ * for every partition i in [0, n), in parallel (see parallel_exec). The callback
+ * passed to scan wraps the user's one - after any call returns non-zero value,
+ * callbacks in all partitions return non-zero without calling the user's
+ * callback, so every scan stops at its next element.
+ */
+template <typename Scan>
+status parallel_scan(std::size_t n, get_kv_callback *callback, void *arg, Scan scan)
+{
+	struct scan_state {
+		get_kv_callback *callback;
+		void *arg;
+		std::atomic<bool> stopped;
+	} state;
+	state.callback = callback;
+	state.arg = arg;
+	state.stopped.store(false);
+
+	auto wrapper = [](const char *k, size_t kb, const char *v, size_t vb,
+			  void *a) -> int {
+		auto s = static_cast<scan_state *>(a);
+		if (s->stopped.load(std::memory_order_relaxed))
+			return 1;
+
+		if (s->callback(k, kb, v, vb, s->arg) != 0) {
+			s->stopped.store(true, std::memory_order_relaxed);
+			return 1;
+		}
+
+		return 0;
+	};
+	get_kv_callback *wrapper_ptr = wrapper;
+
+	parallel_exec(n, [&](std::size_t i) { scan(i, wrapper_ptr, &state); });
+
+	return state.stopped.load() ? status::STOPPED_BY_CB : status::OK;
+}
+
+/**
+ * Splits range [first, last) with 'size' elements into at most n subranges
+ * of similar size. Returns boundaries of the subranges (first and last included).
+ * It walks the range, so it should be used only when the container cannot
+ * provide boundaries on its own.
+ */
+template <typename It>
+std::vector<It> split_range(It first, It last, std::size_t size, std::size_t n)
+{
+	std::vector<It> bounds;
+	bounds.push_back(first);
+
+	auto parts = std::min(n, size);
+	auto it = first;
+	std::size_t pos = 0;
+	for (std::size_t i = 1; i < parts; i++) {
+		auto next = size * i / parts;
+		for (; pos < next && it != last; ++pos)
+			++it;
+		if (it == last)
+			break;
+		bounds.push_back(it);
+	}
+
+	bounds.push_back(last);
+
+	return bounds;
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_PARALLEL_H */
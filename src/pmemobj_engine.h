@@ -4,9 +4,15 @@
 #ifndef LIBPMEMKV_PMEMOBJ_ENGINE_H
 #define LIBPMEMKV_PMEMOBJ_ENGINE_H
 
+#include "alloc_classes.h"
+#include "defrag_scheduler.h"
 #include "engine.h"
 #include "libpmemkv.h"
+#include "thread_arenas.h"
+#include <libpmemobj++/container/string.hpp>
+#include <libpmemobj++/make_persistent.hpp>
 #include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
 
 namespace pmem
 {
@@ -25,12 +31,27 @@ namespace kv
 template <typename EngineData>
 class pmemobj_engine_base : public engine_base {
 public:
+	/*
+	 * Engines which allocate with custom allocation classes (see
+	 * init_alloc_classes) set alloc_classes_supported, the others
+	 * reject "alloc_classes" config item.
+	 */
 	pmemobj_engine_base(const std::unique_ptr<internal::config> &cfg,
-			    const std::string &layout)
+			    const std::string &layout,
+			    bool alloc_classes_supported = false)
 	{
 		const char *path = nullptr;
 		PMEMoid *oid;
 
+		if (!alloc_classes_supported && internal::alloc_classes::enabled(*cfg))
+			throw internal::not_supported(
+				"Config item \"alloc_classes\" is not supported by this engine");
+
+		auto arenas_enabled = internal::thread_arenas::enabled(*cfg);
+		auto arenas_params = internal::thread_arenas::from_config(*cfg);
+		uint64_t memory_stats = 0;
+		cfg->get_uint64("memory_stats", &memory_stats);
+
 		auto is_path = cfg->get_string("path", &path);
 		auto is_oid = cfg->get_object("oid", (void **)&oid);
 
@@ -82,33 +103,299 @@ public:
 				}
 			}
 
-			root_oid = static_cast<pmem::obj::pool<Root>>(pmpool)
-					   .root()
-					   ->ptr.raw_ptr();
+			auto root = static_cast<pmem::obj::pool<Root>>(pmpool).root();
+			root_oid = root->ptr.raw_ptr();
+			expiry_oid = root->expiry.raw_ptr();
+			codec_oid = root->codec.raw_ptr();
+			alloc_classes_oid = root->alloc_classes.raw_ptr();
+			change_log_oid = root->change_log.raw_ptr();
 
 		} else if (is_oid) {
 			pmpool = pmem::obj::pool_base(pmemobj_pool_by_ptr(oid));
 			root_oid = oid;
 		}
+
+		/* otherwise heap statistics are enabled by the first memory_usage() */
+		if (memory_stats)
+			enable_heap_stats(true);
+
+		try {
+			if (arenas_enabled)
+				arenas.reset(new internal::thread_arenas(pmpool.handle(),
+									 arenas_params));
+		} catch (...) {
+			if (cfg_by_path)
+				pmpool.close();
+			throw;
+		}
 	}
 
 	~pmemobj_engine_base()
 	{
+		/* classes fitted in the adaptive mode are recorded on close */
+		try {
+			record_alloc_classes();
+		} catch (...) {
+			/* they will be fitted again after reopen */
+		}
+
 		if (cfg_by_path)
 			pmpool.close();
 	}
 
+	status get_codec_state(std::string &state) override
+	{
+		if (!codec_oid)
+			return status::NOT_SUPPORTED;
+
+		state = read_string(codec_oid);
+
+		return status::OK;
+	}
+
+	status set_codec_state(string_view state) override
+	{
+		if (!codec_oid)
+			return status::NOT_SUPPORTED;
+
+		/* abort of the outer transaction would roll the state back */
+		if (pmemobj_tx_stage() != TX_STAGE_NONE)
+			return status::TRANSACTION_SCOPE_ERROR;
+
+		write_string(codec_oid, state);
+
+		return status::OK;
+	}
+
+	/* change log is kept in the pool, so it survives reopen */
+	internal::change_log *open_change_log(std::size_t size) override
+	{
+		if (!change_log_oid) {
+			if (size == 0)
+				return nullptr;
+			throw internal::not_supported(
+				"Change log is not supported in this engine (or config)");
+		}
+
+		if (OID_IS_NULL(*change_log_oid)) {
+			if (size == 0)
+				return nullptr;
+			check_outside_tx();
+
+			pmem::obj::transaction::run(pmpool, [&] {
+				pmem::obj::transaction::snapshot(change_log_oid);
+				*change_log_oid = pmemobj_tx_zalloc(
+					internal::change_log::header_size + size, 0);
+			});
+		}
+
+		/* size of a log created earlier is recorded in its header */
+		auto region_size = pmemobj_alloc_usable_size(*change_log_oid);
+		auto pop = pmpool.handle();
+		return new internal::change_log(
+			static_cast<char *>(pmemobj_direct(*change_log_oid)),
+			region_size - internal::change_log::header_size,
+			[pop](const void *addr, std::size_t len) {
+				pmemobj_persist(pop, addr, len);
+			});
+	}
+
+	/*
+	 * Memory allocated in the pool comes from heap statistics of libpmemobj
+	 * (the pool is not walked, so writes may run concurrently). They cover
+	 * also objects not allocated by the engine and count only allocations
+	 * made since they were enabled - at open if "memory_stats" is set in
+	 * config, otherwise by the first call.
+	 */
+	status memory_usage(memory_stats &stats) override
+	{
+		check_outside_tx();
+		enable_heap_stats(true);
+
+		auto s = count_data_size(stats);
+		if (s != status::OK)
+			return s;
+
+		auto heap_size = pmpool.ctl_get<uint64_t>("heap.size.granted");
+		/* includes headers, wraps if objects allocated earlier were freed */
+		auto allocated = pmpool.ctl_get<uint64_t>("stats.heap.curr_allocated");
+		if (allocated > heap_size)
+			allocated = 0;
+
+		/* every element takes at least one allocation */
+		stats.allocator_overhead = stats.count * allocation_header_size;
+		auto known = stats.keys + stats.values + stats.allocator_overhead;
+		stats.metadata = allocated > known ? allocated - known : 0;
+
+		auto active = pmpool.ctl_get<uint64_t>("stats.heap.run_active");
+		auto run_allocated = pmpool.ctl_get<uint64_t>("stats.heap.run_allocated");
+		stats.fragmented = active > run_allocated ? active - run_allocated : 0;
+
+		auto used = allocated + stats.fragmented;
+		stats.free = heap_size > used ? heap_size - used : 0;
+
+		if (arenas) {
+			stats.arenas = arenas->count();
+			stats.arena_threads = arenas->threads();
+			stats.arena_contended_writes = arenas->contended_writes();
+		}
+
+		set_bytes_per_key(stats);
+
+		return status::OK;
+	}
+
 protected:
+	/* size of the (compact) header of objects allocated by libpmemobj */
+	static constexpr uint64_t allocation_header_size = 16;
+
+	/*
+	 * Starts background defragmentation (driven by engine's defrag()) if it is
+	 * enabled in config. Must be called at the end of engine's constructor and
+	 * stopped (by stop_defrag_scheduler) at the beginning of its destructor.
+	 */
+	void start_defrag_scheduler(internal::config &cfg)
+	{
+		if (!internal::defrag_scheduler::enabled(cfg))
+			return;
+
+		auto params = internal::defrag_scheduler::from_config(cfg);
+		enable_heap_stats(false);
+
+		defrag_sched.reset(new internal::defrag_scheduler(
+			params, [&] { return fragmentation(); },
+			[&](double start_percent, double amount_percent) {
+				return defrag(start_percent, amount_percent);
+			}));
+	}
+
+	void stop_defrag_scheduler()
+	{
+		defrag_sched.reset();
+	}
+
+	/*
+	 * Registers custom allocation classes, if enabled in config or recorded
+	 * in the pool (then they are registered even if not in config).
+	 */
+	void init_alloc_classes(internal::config &cfg)
+	{
+		auto recorded = alloc_classes_oid ? read_string(alloc_classes_oid) : "";
+		if (!internal::alloc_classes::enabled(cfg) && recorded.empty())
+			return;
+
+		alloc_cls.reset(new internal::alloc_classes(
+			pmpool.handle(), internal::alloc_classes::from_config(cfg),
+			recorded));
+		record_alloc_classes();
+	}
+
+	/*
+	 * Assigns own arena to the calling thread (on its first call), if enabled.
+	 * The returned object has to live until the end of the write.
+	 */
+	internal::thread_arenas::writer assign_arena()
+	{
+		if (arenas)
+			return arenas->assign();
+		return internal::thread_arenas::writer(nullptr);
+	}
+
+	/*
+	 * Enables transient heap statistics of libpmemobj (and persistent ones,
+	 * if requested), keeping the ones which are already enabled.
+	 */
+	void enable_heap_stats(bool persistent)
+	{
+		auto enabled = pmpool.ctl_get<enum pobj_stats_enabled>("stats.enabled");
+		if (enabled == POBJ_STATS_ENABLED_BOTH)
+			return;
+
+		if (persistent || enabled == POBJ_STATS_ENABLED_PERSISTENT)
+			enabled = POBJ_STATS_ENABLED_BOTH;
+		else
+			enabled = POBJ_STATS_ENABLED_TRANSIENT;
+		pmpool.ctl_set<enum pobj_stats_enabled>("stats.enabled", enabled);
+	}
+
+	/* ratio of free space in runs (used for small allocations) to their size */
+	double fragmentation()
+	{
+		auto allocated = pmpool.ctl_get<uint64_t>("stats.heap.run_allocated");
+		auto active = pmpool.ctl_get<uint64_t>("stats.heap.run_active");
+		if (active == 0 || allocated > active)
+			return 0;
+
+		return 1.0 - static_cast<double>(allocated) / static_cast<double>(active);
+	}
+
 	struct Root {
 		/* field ptr used when path is specified */
 		pmem::obj::persistent_ptr<EngineData> ptr;
+		/*
+		 * field expiry used (when path is specified) by engines which keep
+		 * deadlines of expiring keys; root of pools created before it was
+		 * added is extended (and zeroed) by libpmemobj on open
+		 */
+		pmem::obj::persistent_ptr<EngineData> expiry;
+		/* field codec holds state of the value codec (when path is specified) */
+		pmem::obj::persistent_ptr<pmem::obj::string> codec;
+		/* sizes of custom allocation classes (when path is specified) */
+		pmem::obj::persistent_ptr<pmem::obj::string> alloc_classes;
+		/* region of the change log (when path is specified) */
+		pmem::obj::persistent_ptr<char[]> change_log;
 	};
 
 	pmem::obj::pool_base pmpool;
 	PMEMoid *root_oid;
+	/* nullptr when opened by oid */
+	PMEMoid *expiry_oid = nullptr;
+	PMEMoid *codec_oid = nullptr;
+	PMEMoid *alloc_classes_oid = nullptr;
+	PMEMoid *change_log_oid = nullptr;
+	std::unique_ptr<internal::defrag_scheduler> defrag_sched;
+	/* custom allocation classes, nullptr if not enabled */
+	std::unique_ptr<internal::alloc_classes> alloc_cls;
+	/* per-thread arenas, nullptr if not enabled */
+	std::unique_ptr<internal::thread_arenas> arenas;
 	bool cfg_by_path = false;
 
 private:
+	/* reads persistent string pointed by oid (empty if oid is null) */
+	std::string read_string(PMEMoid *oid)
+	{
+		if (OID_IS_NULL(*oid))
+			return "";
+
+		auto s = static_cast<pmem::obj::string *>(pmemobj_direct(*oid));
+		return std::string(s->cdata(), s->size());
+	}
+
+	/* writes persistent string pointed by oid, allocates it if oid is null */
+	void write_string(PMEMoid *oid, string_view value)
+	{
+		pmem::obj::transaction::run(pmpool, [&] {
+			if (OID_IS_NULL(*oid)) {
+				pmem::obj::transaction::snapshot(oid);
+				*oid = pmem::obj::make_persistent<pmem::obj::string>()
+					       .raw();
+			}
+			auto s = static_cast<pmem::obj::string *>(pmemobj_direct(*oid));
+			s->assign(value.data(), value.size());
+		});
+	}
+
+	/* records sizes of allocation classes if they differ from recorded ones */
+	void record_alloc_classes()
+	{
+		if (!alloc_cls || !alloc_classes_oid)
+			return;
+
+		auto state = alloc_cls->state();
+		if (!state.empty() && state != read_string(alloc_classes_oid))
+			write_string(alloc_classes_oid, state);
+	}
+
 	pmem::obj::pool<Root> create_or_fail(const char *path, const std::size_t size,
 					     const std::string &layout)
 	{
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "thread_arenas.h"
+#include "exceptions.h"
+
+#include <libpmemobj.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <thread>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+bool thread_arenas::enabled(config &cfg)
+{
+	uint64_t enabled = 0;
+	cfg.get_uint64("thread_arenas", &enabled);
+	return enabled != 0;
+}
+
+thread_arenas::params thread_arenas::from_config(config &cfg)
+{
+	params p;
+	p.count = std::max(1U, std::thread::hardware_concurrency());
+	cfg.get_uint64("thread_arenas_count", &p.count);
+
+	if (p.count == 0 || p.count > max_count)
+		throw internal::invalid_argument(
+			"Config item \"thread_arenas_count\" must be in range [1, " +
+			std::to_string(max_count) + "]");
+
+	return p;
+}
+
+thread_arenas::writer::writer(std::atomic<uint64_t> *writers) : writers(writers)
+{
+}
+
+thread_arenas::writer::writer(writer &&other) : writers(other.writers)
+{
+	other.writers = nullptr;
+}
+
+thread_arenas::writer::~writer()
+{
+	if (writers)
+		writers->fetch_sub(1, std::memory_order_relaxed);
+}
+
+thread_arenas::thread_arenas(PMEMobjpool *pop, params p)
+    : pop(pop),
+      arenas_count(p.count),
+      arenas(new arena[p.count]),
+      assigned(0),
+      contended(0)
+{
+	static std::atomic<uint64_t> instances(0);
+	instance_id = ++instances;
+
+	for (uint64_t i = 0; i < p.count; i++) {
+		unsigned arena_id;
+		if (pmemobj_ctl_exec(pop, "heap.arena.create", &arena_id) != 0)
+			throw internal::error(std::string("Cannot create arena: ") +
+					      pmemobj_errormsg());
+
+		int automatic = 0;
+		auto name = "heap.arena." + std::to_string(arena_id) + ".automatic";
+		if (pmemobj_ctl_set(pop, name.c_str(), &automatic) != 0)
+			throw internal::error(std::string("Cannot set arena: ") +
+					      pmemobj_errormsg());
+
+		arenas[i].writers.store(0);
+		arenas[i].id = arena_id;
+	}
+}
+
+thread_arenas::writer thread_arenas::assign()
+{
+	/* assignments made for this thread, the most recent first */
+	static thread_local std::array<cached_assignment, cache_size> cache = {};
+
+	auto it = std::find_if(cache.begin(), cache.end(),
+			       [&](const cached_assignment &c) {
+				       return c.instance_id == instance_id;
+			       });
+
+	uint64_t arena_idx;
+	if (it != cache.end()) {
+		arena_idx = it->arena;
+		std::rotate(cache.begin(), it, it + 1);
+	} else {
+		/* the assignment could have been dropped from the cache */
+		arena_idx = thread_arena();
+		if (arena_idx == arenas_count) {
+			arena_idx = assigned++ % arenas_count;
+			auto arena_id = arenas[arena_idx].id;
+			if (pmemobj_ctl_set(pop, "heap.thread.arena_id", &arena_id) != 0)
+				throw internal::error(
+					std::string("Cannot assign arena: ") +
+					pmemobj_errormsg());
+		}
+
+		/* the least recently used assignment is dropped */
+		std::rotate(cache.begin(), cache.end() - 1, cache.end());
+		cache[0] = {instance_id, arena_idx};
+	}
+
+	auto &a = arenas[arena_idx];
+	if (a.writers.fetch_add(1, std::memory_order_relaxed) != 0)
+		contended.fetch_add(1, std::memory_order_relaxed);
+
+	return writer(&a.writers);
+}
+
+uint64_t thread_arenas::thread_arena() const
+{
+	unsigned arena_id;
+	if (pmemobj_ctl_get(pop, "heap.thread.arena_id", &arena_id) != 0)
+		throw internal::error(std::string("Cannot read arena of the thread: ") +
+				      pmemobj_errormsg());
+
+	uint64_t i = 0;
+	while (i < arenas_count && arenas[i].id != arena_id)
+		i++;
+
+	return i;
+}
+
+uint64_t thread_arenas::count() const
+{
+	return arenas_count;
+}
+
+uint64_t thread_arenas::threads() const
+{
+	return assigned.load();
+}
+
+uint64_t thread_arenas::contended_writes() const
+{
+	return contended.load();
+}
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
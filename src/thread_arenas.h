@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_THREAD_ARENAS_H
+#define LIBPMEMKV_THREAD_ARENAS_H
+
+#include "config.h"
+
+#include <libpmemobj/base.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * Arenas of the libpmemobj heap (created by "heap.arena.create" ctl) assigned
+ * to threads writing to the engine, so that concurrent allocations do not
+ * contend on shared arenas. Each thread gets an arena on its first write,
+ * in round-robin order; threads share arenas only if there are more threads
+ * than arenas.
+ *
+ * Assignments are cached per thread for a few instances it wrote to most
+ * recently; a thread which writes to more instances finds its arena by asking
+ * libpmemobj which arena the thread uses.
+ * libpmemobj does not report waits for arena locks, so contention is measured
+ * by writes which start while another thread writes through the same arena.
+ *
+ * Created arenas are not used for automatic assignment by libpmemobj.
+ */
+class thread_arenas {
+public:
+	struct params {
+		/* number of arenas, by default the number of cores */
+		uint64_t count = 0;
+	};
+
+	/* Marks the thread as writing through its arena, as long as it lives. */
+	class writer {
+	public:
+		explicit writer(std::atomic<uint64_t> *writers);
+		writer(writer &&other);
+		~writer();
+
+		writer(const writer &) = delete;
+		writer &operator=(const writer &) = delete;
+
+	private:
+		std::atomic<uint64_t> *writers;
+	};
+
+	/* Returns true if per-thread arenas are enabled in the config. */
+	static bool enabled(config &cfg);
+	static params from_config(config &cfg);
+
+	thread_arenas(PMEMobjpool *pop, params p);
+
+	thread_arenas(const thread_arenas &) = delete;
+	thread_arenas &operator=(const thread_arenas &) = delete;
+
+	/*
+	 * Assigns an arena to the calling thread, if not done yet. The write
+	 * lasts until the returned object is destroyed.
+	 */
+	writer assign();
+
+	/* number of created arenas */
+	uint64_t count() const;
+	/* number of threads arenas were assigned to */
+	uint64_t threads() const;
+	/* number of writes started while the arena was used by another thread */
+	uint64_t contended_writes() const;
+
+private:
+	/* libpmemobj limit */
+	static constexpr uint64_t max_count = 1024;
+	/* number of instances whose assignments are cached by a thread */
+	static constexpr std::size_t cache_size = 8;
+
+	struct arena {
+		/* threads writing through the arena at the moment */
+		std::atomic<uint64_t> writers;
+		unsigned id;
+		/* counters of different arenas are not in the same cache line */
+		char padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(unsigned)];
+	};
+
+	struct cached_assignment {
+		uint64_t instance_id;
+		uint64_t arena;
+	};
+
+	/* index of the arena used by the calling thread, arenas_count if none */
+	uint64_t thread_arena() const;
+
+	PMEMobjpool *pop;
+	uint64_t arenas_count;
+	std::unique_ptr<arena[]> arenas;
+	std::atomic<uint64_t> assigned;
+	std::atomic<uint64_t> contended;
+	/* distinguishes instances in threads' caches of assignments */
+	uint64_t instance_id;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_THREAD_ARENAS_H */
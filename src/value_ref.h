@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#ifndef LIBPMEMKV_VALUE_REF_H
+#define LIBPMEMKV_VALUE_REF_H
+
+#include "libpmemkv.hpp"
+
+#include <string>
+#include <utility>
+
+namespace pmem
+{
+namespace kv
+{
+namespace internal
+{
+
+/**
+ * value_ref_base exposes a value stored in an engine without copying it.
+ * The value stays valid (and unmodified) as long as the object exists - engines
+ * which have to protect it from concurrent writers keep the guard (a lock or
+ * an accessor) in a derived class.
+ */
+class value_ref_base {
+public:
+	value_ref_base() = default;
+	value_ref_base(string_view value) : value_(value)
+	{
+	}
+	virtual ~value_ref_base() = default;
+
+	value_ref_base(const value_ref_base &) = delete;
+	value_ref_base &operator=(const value_ref_base &) = delete;
+
+	string_view value() const
+	{
+		return value_;
+	}
+
+protected:
+	string_view value_;
+};
+
+/**
+ * Holds the guard of type Guard for the whole lifetime of the reference.
+ * The guard has to be set up (e.g. a lock acquired) before set_value() is called.
+ */
+template <typename Guard>
+class guarded_value_ref : public value_ref_base {
+public:
+	void set_value(string_view value)
+	{
+		value_ = value;
+	}
+
+	Guard guard;
+};
+
+/**
+ * Owns a copy of the value. Used by engines which cannot pin values in place.
+ */
+class value_copy_ref : public value_ref_base {
+public:
+	value_copy_ref(std::string &&copy) : copy_(std::move(copy))
+	{
+		value_ = string_view(copy_.data(), copy_.size());
+	}
+
+private:
+	std::string copy_;
+};
+
+} /* namespace internal */
+} /* namespace kv */
+} /* namespace pmem */
+
+#endif /* LIBPMEMKV_VALUE_REF_H */
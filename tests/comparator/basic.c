@@ -62,6 +62,18 @@ static void test_valid_comparator(const char *engine, pmemkv_config *cfg)
 	UT_ASSERTeq(memcmp(keys[1], "223", 3), 0);
 	UT_ASSERTeq(memcmp(keys[2], "123", 3), 0);
 
+	/* keys sharing a prefix are not adjacent in custom order */
+	size_t cnt;
+	s = pmemkv_count_prefix(db, "1", 1, &cnt);
+	UT_ASSERTeq(s, PMEMKV_STATUS_NOT_SUPPORTED);
+	s = pmemkv_get_prefix(db, "1", 1, &get_callback, NULL);
+	UT_ASSERTeq(s, PMEMKV_STATUS_NOT_SUPPORTED);
+	UT_ASSERTeq(keys_count, 3);
+	s = pmemkv_remove_prefix(db, "1", 1);
+	UT_ASSERTeq(s, PMEMKV_STATUS_NOT_SUPPORTED);
+	s = pmemkv_exists(db, "123", 3);
+	UT_ASSERTeq(s, PMEMKV_STATUS_OK);
+
 	pmemkv_close(db);
 }
 
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <atomic>
+#include <future>
+#include <thread>
+
+/**
+ * Tests asynchronous get, put and remove - completed by futures, callbacks
+ * and through a completion queue.
+ */
+
+using namespace pmem::kv;
+
+static const size_t n_entries = 1000;
+
+static std::string value(size_t i)
+{
+	return entry_from_number(i, "", "_value");
+}
+
+static void FuturesTest(pmem::kv::db &kv)
+{
+	std::vector<std::future<status>> puts;
+	for (size_t i = 0; i < n_entries; i++)
+		puts.emplace_back(kv.async_put(entry_from_number(i), value(i)));
+	for (auto &f : puts)
+		ASSERT_STATUS(f.get(), status::OK);
+
+	std::vector<std::future<result<std::string>>> gets;
+	for (size_t i = 0; i < n_entries; i++)
+		gets.emplace_back(kv.async_get(entry_from_number(i)));
+	for (size_t i = 0; i < n_entries; i++) {
+		auto res = gets[i].get();
+		ASSERT_STATUS(res.get_status(), status::OK);
+		UT_ASSERT(res.get_value() == value(i));
+	}
+
+	ASSERT_STATUS(kv.async_get(entry_from_number(n_entries)).get().get_status(),
+		      status::NOT_FOUND);
+
+	std::vector<std::future<status>> removes;
+	for (size_t i = 0; i < n_entries; i += 2)
+		removes.emplace_back(kv.async_remove(entry_from_number(i)));
+	for (auto &f : removes)
+		ASSERT_STATUS(f.get(), status::OK);
+
+	size_t cnt;
+	ASSERT_STATUS(kv.count_all(cnt), status::OK);
+	UT_ASSERTeq(cnt, n_entries / 2);
+	for (size_t i = 0; i < n_entries; i++)
+		ASSERT_STATUS(kv.exists(entry_from_number(i)),
+			      i % 2 ? status::OK : status::NOT_FOUND);
+}
+
+static void CallbacksTest(pmem::kv::db &kv)
+{
+	std::atomic<size_t> completed(0);
+	std::atomic<size_t> failed(0);
+
+	for (size_t i = 0; i < n_entries; i++)
+		ASSERT_STATUS(kv.async_put(entry_from_number(i), value(i),
+					   [&](status s) {
+						   if (s != status::OK)
+							   ++failed;
+						   ++completed;
+					   }),
+			      status::OK);
+	while (completed != n_entries)
+		std::this_thread::yield();
+	UT_ASSERTeq(failed.load(), 0);
+
+	completed = 0;
+	for (size_t i = 0; i < n_entries; i++) {
+		auto expected = value(i);
+		ASSERT_STATUS(kv.async_get(entry_from_number(i),
+					   [&, expected](status s, string_view v) {
+						   if (s != status::OK ||
+						       v.compare(expected) != 0)
+							   ++failed;
+						   ++completed;
+					   }),
+			      status::OK);
+	}
+	while (completed != n_entries)
+		std::this_thread::yield();
+	UT_ASSERTeq(failed.load(), 0);
+}
+
+/* operations on the same key complete in order of submission */
+static void OrderTest(pmem::kv::db &kv)
+{
+	const size_t n_keys = 10;
+	const size_t n_rounds = 101;
+
+	std::vector<std::future<status>> ops;
+	for (size_t r = 0; r < n_rounds; r++) {
+		for (size_t k = 0; k < n_keys; k++) {
+			auto key = entry_from_number(k);
+			ops.emplace_back(kv.async_put(key, value(r)));
+			if (r % 3 == 0)
+				ops.emplace_back(kv.async_remove(key));
+		}
+	}
+
+	std::vector<std::future<result<std::string>>> gets;
+	for (size_t k = 0; k < n_keys; k++)
+		gets.emplace_back(kv.async_get(entry_from_number(k)));
+
+	for (auto &f : ops)
+		ASSERT_STATUS(f.get(), status::OK);
+	for (auto &f : gets) {
+		auto res = f.get();
+		ASSERT_STATUS(res.get_status(), status::OK);
+		UT_ASSERT(res.get_value() == value(n_rounds - 1));
+	}
+}
+
+static void CompletionQueueTest(std::string engine, std::string json)
+{
+	pmemkv_db *db = nullptr;
+	auto cfg = CONFIG_FROM_JSON(json);
+	UT_ASSERTeq(pmemkv_open(engine.c_str(), cfg.release(), &db), PMEMKV_STATUS_OK);
+
+	auto cq = pmemkv_completion_queue_new();
+	UT_ASSERT(cq != nullptr);
+
+	/* exactly one of queue and callback has to be set */
+	UT_ASSERTeq(pmemkv_async_remove(db, "a", 1, nullptr, nullptr, nullptr),
+		    PMEMKV_STATUS_INVALID_ARGUMENT);
+	UT_ASSERTeq(pmemkv_async_remove(
+			    db, "a", 1, cq,
+			    [](int, const char *, size_t, void *) {}, nullptr),
+		    PMEMKV_STATUS_INVALID_ARGUMENT);
+	UT_ASSERTeq(pmemkv_async_remove(nullptr, "a", 1, cq, nullptr, nullptr),
+		    PMEMKV_STATUS_INVALID_ARGUMENT);
+
+	std::vector<std::string> keys;
+	for (size_t i = 0; i < n_entries; i++)
+		keys.emplace_back(entry_from_number(i));
+	/* args of operations point to their keys */
+	auto index_of = [&](void *arg) {
+		return static_cast<size_t>(static_cast<std::string *>(arg) - keys.data());
+	};
+
+	for (size_t i = 0; i < n_entries; i++) {
+		auto val = value(i);
+		UT_ASSERTeq(pmemkv_async_put(db, keys[i].data(), keys[i].size(),
+					     val.data(), val.size(), cq, nullptr,
+					     &keys[i]),
+			    PMEMKV_STATUS_OK);
+	}
+
+	std::vector<pmemkv_completion> completions(64);
+	std::vector<bool> done(n_entries, false);
+	size_t polled = 0;
+	while (polled < n_entries) {
+		size_t count;
+		UT_ASSERTeq(pmemkv_completion_queue_poll(cq, completions.data(),
+							 completions.size(), &count,
+							 1000),
+			    PMEMKV_STATUS_OK);
+		for (size_t c = 0; c < count; c++) {
+			UT_ASSERTeq(completions[c].status, PMEMKV_STATUS_OK);
+			auto i = index_of(completions[c].arg);
+			UT_ASSERT(i < n_entries && !done[i]);
+			done[i] = true;
+		}
+		polled += count;
+	}
+
+	for (size_t i = 0; i < n_entries; i++)
+		UT_ASSERTeq(pmemkv_async_get(db, keys[i].data(), keys[i].size(), cq,
+					     nullptr, &keys[i]),
+			    PMEMKV_STATUS_OK);
+
+	polled = 0;
+	while (polled < n_entries) {
+		size_t count;
+		UT_ASSERTeq(pmemkv_completion_queue_poll(cq, completions.data(),
+							 completions.size(), &count,
+							 1000),
+			    PMEMKV_STATUS_OK);
+		for (size_t c = 0; c < count; c++) {
+			UT_ASSERTeq(completions[c].status, PMEMKV_STATUS_OK);
+			auto i = index_of(completions[c].arg);
+			UT_ASSERT(std::string(completions[c].value,
+					      completions[c].valuebytes) == value(i));
+		}
+		polled += count;
+	}
+
+	/* nothing left, poll times out */
+	size_t count;
+	UT_ASSERTeq(pmemkv_completion_queue_poll(cq, completions.data(),
+						 completions.size(), &count, 10),
+		    PMEMKV_STATUS_OK);
+	UT_ASSERTeq(count, 0);
+
+	pmemkv_close(db);
+	pmemkv_completion_queue_delete(cq);
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 3)
+		UT_FATAL("usage: %s engine json_config", argv[0]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 FuturesTest,
+				 CallbacksTest,
+				 OrderTest,
+			 });
+
+	CompletionQueueTest(argv[1], argv[2]);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
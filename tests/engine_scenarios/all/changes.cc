@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Tests the change log - puts, removes and transactions are recorded in order
+ * of commits, the log can be tailed, the oldest records are overwritten when
+ * it is full and (in persistent engines) it survives reopen.
+ */
+
+using namespace pmem::kv;
+
+struct change {
+	uint64_t seq;
+	change_type type;
+	std::string key;
+	std::string value;
+};
+
+static const size_t log_size = 64 * 1024;
+
+static std::vector<change> read_changes(pmem::kv::db &kv, uint64_t since,
+					status expected = status::OK)
+{
+	std::vector<change> result;
+	auto collect = [&](uint64_t seq, change_type type, string_view k, string_view v) {
+		result.push_back({seq, type, std::string(k.data(), k.size()),
+				  std::string(v.data(), v.size())});
+		return 0;
+	};
+	ASSERT_STATUS(kv.changes(since, collect), expected);
+	return result;
+}
+
+static pmem::kv::db open_with_log(std::string engine, std::string json, size_t size)
+{
+	auto cfg = CONFIG_FROM_JSON(json);
+	if (size)
+		ASSERT_STATUS(cfg.put_uint64("change_log_size", size), status::OK);
+	return INITIALIZE_KV(engine, std::move(cfg));
+}
+
+static void NotEnabledTest(std::string engine, std::string json)
+{
+	auto kv = INITIALIZE_KV(engine, CONFIG_FROM_JSON(json));
+	ASSERT_STATUS(kv.put("key", "value"), status::OK);
+	uint64_t seq;
+	ASSERT_STATUS(kv.changes_last_seq(seq), status::NOT_SUPPORTED);
+	read_changes(kv, 0, status::NOT_SUPPORTED);
+	CLEAR_KV(kv);
+	kv.close();
+}
+
+static void OrderTest(pmem::kv::db &kv)
+{
+	uint64_t start;
+	ASSERT_STATUS(kv.changes_last_seq(start), status::OK);
+
+	ASSERT_STATUS(kv.put("a", "1"), status::OK);
+	ASSERT_STATUS(kv.put("b", "2"), status::OK);
+	ASSERT_STATUS(kv.put("a", "3"), status::OK);
+	ASSERT_STATUS(kv.remove("b"), status::OK);
+	/* failed remove is not recorded */
+	ASSERT_STATUS(kv.remove("b"), status::NOT_FOUND);
+
+	auto changes = read_changes(kv, start);
+	UT_ASSERTeq(changes.size(), 4);
+	for (size_t i = 0; i < changes.size(); i++)
+		UT_ASSERTeq(changes[i].seq, start + i + 1);
+	UT_ASSERT(changes[0].type == change_type::PUT && changes[0].key == "a" &&
+		  changes[0].value == "1");
+	UT_ASSERT(changes[2].type == change_type::PUT && changes[2].key == "a" &&
+		  changes[2].value == "3");
+	UT_ASSERT(changes[3].type == change_type::REMOVE && changes[3].key == "b" &&
+		  changes[3].value.empty());
+
+	uint64_t last;
+	ASSERT_STATUS(kv.changes_last_seq(last), status::OK);
+	UT_ASSERTeq(last, start + 4);
+	UT_ASSERT(read_changes(kv, last).empty());
+
+	/* reading stops when callback returns non-zero */
+	size_t calls = 0;
+	ASSERT_STATUS(kv.changes(start,
+				 [&](uint64_t, change_type, string_view, string_view) {
+					 return ++calls == 2 ? 1 : 0;
+				 }),
+		      status::STOPPED_BY_CB);
+	UT_ASSERTeq(calls, 2);
+}
+
+static void TransactionTest(pmem::kv::db &kv)
+{
+	auto res = kv.tx_begin();
+	if (res.get_status() == status::NOT_SUPPORTED)
+		return;
+	ASSERT_STATUS(res.get_status(), status::OK);
+
+	uint64_t start;
+	ASSERT_STATUS(kv.changes_last_seq(start), status::OK);
+
+	auto &tx = res.get_value();
+	ASSERT_STATUS(tx.put("x", "1"), status::OK);
+	ASSERT_STATUS(tx.put("y", "2"), status::OK);
+	/* nothing is recorded before commit */
+	UT_ASSERT(read_changes(kv, start).empty());
+	ASSERT_STATUS(tx.commit(), status::OK);
+
+	auto changes = read_changes(kv, start);
+	UT_ASSERTeq(changes.size(), 2);
+	UT_ASSERT(changes[0].seq == start + 1 && changes[1].seq == start + 1);
+	UT_ASSERT(changes[0].key == "x" && changes[1].key == "y");
+}
+
+static void RemoveRangeTest(pmem::kv::db &kv)
+{
+	uint64_t start;
+	ASSERT_STATUS(kv.changes_last_seq(start), status::OK);
+
+	ASSERT_STATUS(kv.put("p1", "1"), status::OK);
+	ASSERT_STATUS(kv.put("p2", "2"), status::OK);
+	auto s = kv.remove_range("p1", "p3");
+	if (s == status::NOT_SUPPORTED)
+		return;
+	ASSERT_STATUS(s, status::OK);
+	ASSERT_STATUS(kv.remove_prefix("p"), status::OK);
+
+	/* a removal of many keys is recorded as a single record */
+	auto changes = read_changes(kv, start);
+	UT_ASSERTeq(changes.size(), 4);
+	UT_ASSERT(changes[2].type == change_type::REMOVE_RANGE &&
+		  changes[2].key == "p1" && changes[2].value == "p3");
+	UT_ASSERT(changes[3].type == change_type::REMOVE_PREFIX &&
+		  changes[3].key == "p" && changes[3].value.empty());
+}
+
+static void TailTest(pmem::kv::db &kv)
+{
+	const size_t n = 200;
+
+	uint64_t since;
+	ASSERT_STATUS(kv.changes_last_seq(since), status::OK);
+
+	std::thread writer([&] {
+		for (size_t i = 0; i < n; i++)
+			ASSERT_STATUS(kv.put(entry_from_number(i), entry_from_number(i)),
+				      status::OK);
+	});
+
+	size_t seen = 0;
+	auto check = [&](uint64_t seq, change_type type, string_view k, string_view v) {
+		UT_ASSERTeq(seq, since + 1);
+		UT_ASSERT(k.compare(entry_from_number(seen)) == 0);
+		since = seq;
+		++seen;
+		return 0;
+	};
+	while (seen < n)
+		ASSERT_STATUS(kv.changes(since, check, 1000), status::OK);
+
+	writer.join();
+}
+
+static void OverwriteTest(pmem::kv::db &kv)
+{
+	uint64_t start;
+	ASSERT_STATUS(kv.changes_last_seq(start), status::OK);
+
+	/* much more than fits in the log */
+	std::string value(1024, 'x');
+	for (size_t i = 0; i < 4 * log_size / value.size(); i++)
+		ASSERT_STATUS(kv.put(entry_from_number(i), value), status::OK);
+
+	read_changes(kv, start, status::NOT_FOUND);
+
+	uint64_t last;
+	ASSERT_STATUS(kv.changes_last_seq(last), status::OK);
+	auto changes = read_changes(kv, last - 10);
+	UT_ASSERTeq(changes.size(), 10);
+	UT_ASSERTeq(changes.back().seq, last);
+
+	/* a record which can never fit is rejected before it is written */
+	ASSERT_STATUS(kv.put("big", std::string(log_size, 'b')),
+		      status::INVALID_ARGUMENT);
+	ASSERT_STATUS(kv.exists("big"), status::NOT_FOUND);
+}
+
+static void ReopenTest(std::string engine, std::string json)
+{
+	uint64_t last;
+	{
+		auto kv = open_with_log(engine, json, log_size);
+		ASSERT_STATUS(kv.put("reopen", "value"), status::OK);
+		ASSERT_STATUS(kv.changes_last_seq(last), status::OK);
+		kv.close();
+	}
+
+	/* log recorded in the pool is used without the config item */
+	auto kv = open_with_log(engine, json, 0);
+	uint64_t seq;
+	ASSERT_STATUS(kv.changes_last_seq(seq), status::OK);
+	UT_ASSERTeq(seq, last);
+
+	auto changes = read_changes(kv, last - 1);
+	UT_ASSERTeq(changes.size(), 1);
+	UT_ASSERT(changes[0].key == "reopen" && changes[0].value == "value");
+
+	ASSERT_STATUS(kv.remove("reopen"), status::OK);
+	changes = read_changes(kv, last);
+	UT_ASSERTeq(changes.size(), 1);
+	UT_ASSERT(changes[0].seq == last + 1 && changes[0].type == change_type::REMOVE);
+	kv.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config persistent", argv[0]);
+
+	std::string engine = argv[1];
+	std::string json = argv[2];
+	bool persistent = std::stoull(argv[3]) != 0;
+
+	NotEnabledTest(engine, json);
+
+	{
+		auto kv = open_with_log(engine, json, log_size);
+		for (auto &t : {OrderTest, TransactionTest, RemoveRangeTest, TailTest,
+				OverwriteTest}) {
+			t(kv);
+			CLEAR_KV(kv);
+		}
+		kv.close();
+	}
+
+	if (persistent)
+		ReopenTest(engine, json);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * Tests dump and restore - through a (mapped) file and a pipe, into empty and
+ * not empty databases, and restore of a corrupted dump.
+ */
+
+using namespace pmem::kv;
+
+using kv_list = std::vector<std::pair<std::string, std::string>>;
+
+/* every 50th value is big, so partitions are dumped in many blocks */
+static std::string value(size_t i)
+{
+	if (i % 50 == 0)
+		return std::string(64 * 1024, static_cast<char>('a' + i % 26));
+	return entry_from_number(i, "", "_value");
+}
+
+static void insert_items(pmem::kv::db &kv, size_t items)
+{
+	for (size_t i = 0; i < items; i++)
+		ASSERT_STATUS(kv.put(entry_from_number(i), value(i)), status::OK);
+}
+
+static kv_list get_items(pmem::kv::db &kv)
+{
+	kv_list result;
+	ASSERT_STATUS(kv.get_all([&](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return 0;
+	}),
+		      status::OK);
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+/* Dumps the database to a temporary file, returns the file rewound. */
+static FILE *dump_to_file(pmem::kv::db &kv)
+{
+	auto f = std::tmpfile();
+	UT_ASSERT(f != nullptr);
+	ASSERT_STATUS(kv.dump(fileno(f)), status::OK);
+	UT_ASSERTeq(lseek(fileno(f), 0, SEEK_SET), 0);
+	return f;
+}
+
+static std::string read_file(FILE *f)
+{
+	std::string content;
+	char buf[4096];
+	ssize_t ret;
+	while ((ret = read(fileno(f), buf, sizeof(buf))) > 0)
+		content.append(buf, static_cast<size_t>(ret));
+	UT_ASSERTeq(lseek(fileno(f), 0, SEEK_SET), 0);
+	return content;
+}
+
+static void DumpRestoreFileTest(pmem::kv::db &kv, size_t items)
+{
+	insert_items(kv, items);
+	auto expected = get_items(kv);
+	auto f = dump_to_file(kv);
+
+	CLEAR_KV(kv);
+	ASSERT_STATUS(kv.restore(fileno(f)), status::OK);
+	UT_ASSERT(get_items(kv) == expected);
+
+	/* file offset is moved past the dump */
+	UT_ASSERTeq(lseek(fileno(f), 0, SEEK_CUR), lseek(fileno(f), 0, SEEK_END));
+
+	/* restore into not empty database overwrites existing keys */
+	ASSERT_STATUS(kv.put(entry_from_number(1), "other"), status::OK);
+	ASSERT_STATUS(kv.put("extra_key", "extra_value"), status::OK);
+	UT_ASSERTeq(lseek(fileno(f), 0, SEEK_SET), 0);
+	ASSERT_STATUS(kv.restore(fileno(f)), status::OK);
+
+	expected.emplace_back("extra_key", "extra_value");
+	std::sort(expected.begin(), expected.end());
+	UT_ASSERT(get_items(kv) == expected);
+
+	fclose(f);
+}
+
+static void DumpRestorePipeTest(pmem::kv::db &kv, size_t items)
+{
+	insert_items(kv, items);
+	auto expected = get_items(kv);
+	auto f = dump_to_file(kv);
+	auto content = read_file(f);
+	fclose(f);
+
+	CLEAR_KV(kv);
+
+	int fds[2];
+	UT_ASSERTeq(pipe(fds), 0);
+	std::thread writer([&] {
+		size_t written = 0;
+		while (written < content.size()) {
+			auto ret = write(fds[1], content.data() + written,
+					 content.size() - written);
+			UT_ASSERT(ret > 0);
+			written += static_cast<size_t>(ret);
+		}
+		close(fds[1]);
+	});
+
+	ASSERT_STATUS(kv.restore(fds[0]), status::OK);
+	writer.join();
+	close(fds[0]);
+
+	UT_ASSERT(get_items(kv) == expected);
+}
+
+static void DumpRestoreEmptyTest(pmem::kv::db &kv, size_t items)
+{
+	auto f = dump_to_file(kv);
+	ASSERT_STATUS(kv.restore(fileno(f)), status::OK);
+	fclose(f);
+
+	size_t cnt;
+	ASSERT_STATUS(kv.count_all(cnt), status::OK);
+	UT_ASSERTeq(cnt, 0);
+
+	ASSERT_STATUS(kv.dump(-1), status::INVALID_ARGUMENT);
+	ASSERT_STATUS(kv.restore(-1), status::INVALID_ARGUMENT);
+}
+
+static void RestoreCorruptedTest(pmem::kv::db &kv, size_t items)
+{
+	insert_items(kv, items);
+	auto f = dump_to_file(kv);
+	auto content = read_file(f);
+	fclose(f);
+
+	CLEAR_KV(kv);
+
+	/* damaged byte in the middle, truncated dump and wrong magic */
+	std::vector<std::string> corrupted(3, content);
+	corrupted[0][corrupted[0].size() / 2] ^= 1;
+	corrupted[1].resize(corrupted[1].size() - 1);
+	corrupted[2][0] = 'X';
+
+	for (auto &c : corrupted) {
+		f = std::tmpfile();
+		UT_ASSERT(f != nullptr);
+		UT_ASSERTeq(write(fileno(f), c.data(), c.size()),
+			    static_cast<ssize_t>(c.size()));
+		UT_ASSERTeq(lseek(fileno(f), 0, SEEK_SET), 0);
+
+		ASSERT_STATUS(kv.restore(fileno(f)), status::INVALID_ARGUMENT);
+		fclose(f);
+
+		size_t cnt;
+		ASSERT_STATUS(kv.count_all(cnt), status::OK);
+		UT_ASSERTeq(cnt, 0);
+	}
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(DumpRestoreFileTest, _1, items),
+				 std::bind(DumpRestorePipeTest, _1, items),
+				 std::bind(DumpRestoreEmptyTest, _1, items),
+				 std::bind(RestoreCorruptedTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
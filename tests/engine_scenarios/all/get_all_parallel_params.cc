@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+/**
+ * Tests get_all_parallel method. Since we cannot assume any order (partitions
+ * are scanned concurrently), results are sorted before comparing.
+ */
+
+using namespace pmem::kv;
+
+using test_kv = std::pair<std::string, std::string>;
+using test_kv_list = std::vector<test_kv>;
+
+struct collector {
+	std::mutex mtx;
+	test_kv_list list;
+};
+
+static test_kv_list sort(test_kv_list list)
+{
+	std::sort(list.begin(), list.end(), [](const test_kv &lhs, const test_kv &rhs) {
+		return lhs.first < rhs.first;
+	});
+
+	return list;
+}
+
+static test_kv_list insert_items(pmem::kv::db &kv, size_t items)
+{
+	test_kv_list expected;
+	for (size_t i = 0; i < items; i++) {
+		auto key = entry_from_number(i);
+		auto value = entry_from_number(i, "", "!");
+		ASSERT_STATUS(kv.put(key, value), status::OK);
+		expected.emplace_back(key, value);
+	}
+
+	return sort(expected);
+}
+
+static void GetAllParallelTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: get_all_parallel should return all elements in db exactly once,
+	 * regardless of number of partitions
+	 */
+	collector c;
+	auto cpp_cb = [&](string_view k, string_view v) {
+		std::unique_lock<std::mutex> lock(c.mtx);
+		c.list.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return 0;
+	};
+
+	ASSERT_STATUS(kv.get_all_parallel(4, cpp_cb), status::OK);
+	UT_ASSERT(c.list.empty());
+
+	auto expected = insert_items(kv, items);
+
+	/* huge number of partitions is limited by the engine */
+	for (size_t partitions : std::vector<size_t>{1, 2, 3, 8, 64,
+						     std::numeric_limits<size_t>::max()}) {
+		c.list.clear();
+		ASSERT_STATUS(kv.get_all_parallel(partitions, cpp_cb), status::OK);
+		UT_ASSERT(sort(c.list) == expected);
+	}
+
+	/* get_all_parallel with C-like API */
+	c.list.clear();
+	auto s = kv.get_all_parallel(
+		4,
+		[](const char *k, size_t kb, const char *v, size_t vb, void *arg) {
+			auto col = static_cast<collector *>(arg);
+			std::unique_lock<std::mutex> lock(col->mtx);
+			col->list.emplace_back(std::string(k, kb), std::string(v, vb));
+			return 0;
+		},
+		&c);
+	ASSERT_STATUS(s, status::OK);
+	UT_ASSERT(sort(c.list) == expected);
+
+	ASSERT_STATUS(kv.get_all_parallel(0, cpp_cb), status::INVALID_ARGUMENT);
+}
+
+static void GetAllParallelStopTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: callback returning non-zero value stops all partitions
+	 */
+	insert_items(kv, items);
+
+	const size_t partitions = 8;
+	std::atomic<size_t> calls(0);
+	auto s = kv.get_all_parallel(partitions, [&](string_view, string_view) {
+		calls++;
+		return 1;
+	});
+	ASSERT_STATUS(s, status::STOPPED_BY_CB);
+	/* every partition could call the callback once before the stop was noticed */
+	UT_ASSERT(calls.load() >= 1);
+	UT_ASSERT(calls.load() <= partitions);
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(GetAllParallelTest, _1, items),
+				 std::bind(GetAllParallelStopTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
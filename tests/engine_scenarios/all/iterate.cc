@@ -68,6 +68,30 @@ static void GetAllTest(pmem::kv::db &kv)
 	UT_ASSERT((sort(result) == sort(expected)));
 	result = {};
 
+	/* get_all with std::function */
+	std::function<get_kv_function> f = [&](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return 0;
+	};
+	ASSERT_STATUS(kv.get_all(f), status::OK);
+	UT_ASSERT((sort(result) == sort(expected)));
+	result = {};
+
+	/* get_all with a functor; it is called directly, not through std::function */
+	struct collector {
+		test_kv_list *list;
+		int operator()(string_view k, string_view v)
+		{
+			list->emplace_back(std::string(k.data(), k.size()),
+					   std::string(v.data(), v.size()));
+			return list->size() == 2 ? 1 : 0;
+		}
+	};
+	ASSERT_STATUS(kv.get_all(collector{&result}), status::STOPPED_BY_CB);
+	UT_ASSERT(result.size() == 2);
+	result = {};
+
 	/* get_all with C-like API */
 	s = kv.get_all(
 		[](const char *k, size_t kb, const char *v, size_t vb, void *arg) {
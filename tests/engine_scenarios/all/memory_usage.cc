@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <cmath>
+
+/**
+ * Tests memory_usage - sizes of keys and values are exact, allocator
+ * based ones are consistent with them.
+ */
+
+using namespace pmem::kv;
+
+static const size_t n_entries = 1000;
+
+static void check_data(pmem::kv::db &kv, size_t count, size_t keys, size_t values)
+{
+	memory_stats stats;
+	ASSERT_STATUS(kv.memory_usage(stats), status::OK);
+
+	UT_ASSERTeq(stats.count, count);
+	UT_ASSERTeq(stats.keys, keys);
+	UT_ASSERTeq(stats.values, values);
+
+	if (count == 0) {
+		UT_ASSERT(stats.bytes_per_key == 0);
+		return;
+	}
+
+	auto used = stats.keys + stats.values + stats.metadata + stats.allocator_overhead;
+	auto expected = static_cast<double>(used) / static_cast<double>(count);
+	UT_ASSERT(std::abs(stats.bytes_per_key - expected) < 0.001);
+	UT_ASSERT(stats.bytes_per_key >=
+		  static_cast<double>(keys + values) / static_cast<double>(count));
+}
+
+static void MemoryUsageTest(pmem::kv::db &kv)
+{
+	check_data(kv, 0, 0, 0);
+
+	size_t keys = 0, values = 0;
+	for (size_t i = 0; i < n_entries; i++) {
+		auto key = entry_from_number(i);
+		auto value = std::string(i % 100, 'v');
+		ASSERT_STATUS(kv.put(key, value), status::OK);
+		keys += key.size();
+		values += value.size();
+	}
+	check_data(kv, n_entries, keys, values);
+
+	/* overwrite with longer values */
+	for (size_t i = 0; i < n_entries; i += 2) {
+		auto value = std::string(i % 100, 'v');
+		ASSERT_STATUS(kv.put(entry_from_number(i), value + value), status::OK);
+		values += value.size();
+	}
+	check_data(kv, n_entries, keys, values);
+
+	for (size_t i = 0; i < n_entries; i++) {
+		auto key = entry_from_number(i);
+		ASSERT_STATUS(kv.remove(key), status::OK);
+	}
+	check_data(kv, 0, 0, 0);
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 3)
+		UT_FATAL("usage: %s engine json_config", argv[0]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 MemoryUsageTest,
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
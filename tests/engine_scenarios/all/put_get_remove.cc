@@ -122,6 +122,42 @@ static void GetNonexistentTest(pmem::kv::db &kv)
 	ASSERT_STATUS(kv.get(entry_from_string("waldo"), &value), status::NOT_FOUND);
 }
 
+static void GetRefTest(pmem::kv::db &kv)
+{
+	ASSERT_STATUS(kv.get_ref(entry_from_string("key1")).get_status(),
+		      status::NOT_FOUND);
+
+	auto big_value = std::string(64 * 1024, 'x');
+	ASSERT_STATUS(kv.put(entry_from_string("key1"), entry_from_string("value1")),
+		      status::OK);
+	ASSERT_STATUS(kv.put(entry_from_string("key2"), big_value), status::OK);
+
+	{
+		auto ref1 = kv.get_ref(entry_from_string("key1"));
+		ASSERT_STATUS(ref1.get_status(), status::OK);
+		UT_ASSERT(ref1.get_value().value() == entry_from_string("value1"));
+		ref1.get_value().release();
+		UT_ASSERT(ref1.get_value().value().size() == 0);
+
+		/* handle is released on destruction */
+		auto ref2 = kv.get_ref(entry_from_string("key2"));
+		ASSERT_STATUS(ref2.get_status(), status::OK);
+		UT_ASSERT(ref2.get_value().value() == big_value);
+	}
+
+	/* record can be modified after its handle is released */
+	ASSERT_STATUS(kv.put(entry_from_string("key1"), entry_from_string("value2")),
+		      status::OK);
+	auto ref = kv.get_ref(entry_from_string("key1"));
+	ASSERT_STATUS(ref.get_status(), status::OK);
+	UT_ASSERT(ref.get_value().value() == entry_from_string("value2"));
+	ref.get_value().release();
+
+	ASSERT_STATUS(kv.remove(entry_from_string("key1")), status::OK);
+	ASSERT_STATUS(kv.get_ref(entry_from_string("key1")).get_status(),
+		      status::NOT_FOUND);
+}
+
 static void PutTest(pmem::kv::db &kv)
 {
 	std::size_t cnt = std::numeric_limits<std::size_t>::max();
@@ -337,6 +373,7 @@ static void test(int argc, char *argv[])
 			GetMultipleTest,
 			GetMultiple2Test,
 			GetNonexistentTest,
+			GetRefTest,
 			PutTest,
 			RemoveAllTest,
 			RemoveAndInsertTest,
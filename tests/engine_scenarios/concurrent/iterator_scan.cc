@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+/**
+ * Tests scans with iterators of unsorted, concurrent engines - every key is
+ * visited exactly once, also when other keys are modified during the scan.
+ * Keys and values are created with entry_from_number, so the test can be run
+ * on engines with fixed-size entries.
+ */
+
+#include "../iterator.hpp"
+
+#include <atomic>
+#include <set>
+#include <vector>
+
+static void init_keys(pmem::kv::db &kv, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		ASSERT_STATUS(kv.put(entry_from_number(i), entry_from_number(i)),
+			      pmem::kv::status::OK);
+}
+
+template <bool IsConst>
+static std::vector<std::string> scan(iterator<IsConst> &it)
+{
+	std::vector<std::string> result;
+
+	auto s = it.seek_to_first();
+	if (s == pmem::kv::status::NOT_FOUND)
+		return result;
+	ASSERT_STATUS(s, pmem::kv::status::OK);
+
+	do {
+		auto res = it.key();
+		UT_ASSERT(res.is_ok());
+		result.emplace_back(res.get_value().data(), res.get_value().size());
+
+		s = it.is_next();
+		ASSERT_STATUS(it.next(), s);
+	} while (s == pmem::kv::status::OK);
+	ASSERT_STATUS(s, pmem::kv::status::NOT_FOUND);
+
+	return result;
+}
+
+static void scan_test(const size_t n, pmem::kv::db &kv)
+{
+	auto it = new_iterator<true>(kv);
+	UT_ASSERT(scan<true>(it).empty());
+	ASSERT_STATUS(it.seek(entry_from_number(0)), pmem::kv::status::NOT_FOUND);
+
+	init_keys(kv, n);
+
+	auto keys = scan<true>(it);
+	UT_ASSERTeq(keys.size(), n);
+	std::set<std::string> unique(keys.begin(), keys.end());
+	UT_ASSERTeq(unique.size(), n);
+	for (size_t i = 0; i < n; i++)
+		UT_ASSERT(unique.count(entry_from_number(i)) == 1);
+
+	/* seek continues the scan from the found key */
+	for (size_t i = 0; i < n; i += n / 10 + 1) {
+		ASSERT_STATUS(it.seek(keys[i]), pmem::kv::status::OK);
+		verify_key<true>(it, keys[i]);
+		verify_value<true>(it, keys[i]);
+		if (i + 1 < n) {
+			ASSERT_STATUS(it.next(), pmem::kv::status::OK);
+			verify_key<true>(it, keys[i + 1]);
+		}
+	}
+	ASSERT_STATUS(it.seek(entry_from_number(n)), pmem::kv::status::NOT_FOUND);
+}
+
+static void write_test(const size_t n, pmem::kv::db &kv)
+{
+	init_keys(kv, n);
+
+	{
+		auto it = new_iterator<false>(kv);
+		auto s = it.seek_to_first();
+		while (s == pmem::kv::status::OK) {
+			auto res = it.write_range();
+			UT_ASSERT(res.is_ok());
+			for (auto &c : res.get_value())
+				c = 'x';
+			ASSERT_STATUS(it.commit(), pmem::kv::status::OK);
+
+			s = it.next();
+		}
+		ASSERT_STATUS(s, pmem::kv::status::NOT_FOUND);
+
+		/* aborted changes are not visible */
+		ASSERT_STATUS(it.seek(entry_from_number(0)), pmem::kv::status::OK);
+		auto res = it.write_range(0, 1);
+		UT_ASSERT(res.is_ok());
+		res.get_value()[0] = 'a';
+		it.abort();
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		std::string value;
+		ASSERT_STATUS(kv.get(entry_from_number(i), &value), pmem::kv::status::OK);
+		UT_ASSERT(value == std::string(entry_from_number(i).size(), 'x'));
+	}
+}
+
+static void concurrent_scan_test(const size_t n, const size_t threads_number,
+				 pmem::kv::db &kv)
+{
+	init_keys(kv, n);
+
+	std::atomic<size_t> finished_scans(0);
+
+	parallel_exec(threads_number + 2, [&](size_t thread_id) {
+		/* scanners - keys which are never modified are visited exactly once */
+		if (thread_id < 2) {
+			while (finished_scans.load() < 2 * 4) {
+				auto it = new_iterator<true>(kv);
+				auto keys = scan<true>(it);
+				std::multiset<std::string> visited(keys.begin(),
+								   keys.end());
+				for (size_t i = 0; i < n; i += 2)
+					UT_ASSERTeq(visited.count(entry_from_number(i)),
+						    1);
+				for (size_t i = 1; i < n; i += 2)
+					UT_ASSERT(visited.count(entry_from_number(i)) <=
+						  1);
+				finished_scans++;
+			}
+			return;
+		}
+
+		/* writers - odd keys are removed and put again, new keys are added */
+		for (size_t i = 2 * (thread_id - 2) + 1; i < n; i += 2 * threads_number) {
+			auto key = entry_from_number(i);
+			ASSERT_STATUS(kv.remove(key), pmem::kv::status::OK);
+			ASSERT_STATUS(kv.put(key, key), pmem::kv::status::OK);
+			ASSERT_STATUS(kv.put(entry_from_number(n + i), key),
+				      pmem::kv::status::OK);
+		}
+	});
+
+	size_t cnt;
+	ASSERT_STATUS(kv.count_all(cnt), pmem::kv::status::OK);
+	auto it = new_iterator<true>(kv);
+	UT_ASSERTeq(scan<true>(it).size(), cnt);
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 5)
+		UT_FATAL("usage: %s engine json_config items threads", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+	size_t threads_number = std::stoull(argv[4]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(scan_test, items, _1),
+				 std::bind(write_test, items, _1),
+				 std::bind(concurrent_scan_test, items, threads_number,
+					   _1),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
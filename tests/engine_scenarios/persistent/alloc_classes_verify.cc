@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "../put_get_std_map.hpp"
+
+/**
+ * Tests custom allocation classes (given in config or fitted in the adaptive
+ * mode) - data allocated with them is read back unchanged, also after reopen
+ * (with classes recorded in the pool and not given in config).
+ */
+
+static const size_t n_entries = 1000;
+static const size_t key_length = 16;
+
+/* sizes of values for which classes are fitted */
+static const size_t value_sizes[] = {72, 300};
+
+/* Inserter for PutToMapTest which only builds the expected state */
+struct expected_state {
+	status put(string_view, string_view)
+	{
+		return status::OK;
+	}
+};
+
+static void check_invalid(std::string engine, std::string json, std::string classes)
+{
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_string("alloc_classes", classes), status::OK);
+	pmem::kv::db kv;
+	ASSERT_STATUS(kv.open(engine, std::move(cfg)), status::INVALID_ARGUMENT);
+}
+
+static void insert(std::string engine, std::string json, std::string classes)
+{
+	check_invalid(engine, json, "");
+	check_invalid(engine, json, "abc");
+	check_invalid(engine, json, "72,,300");
+	check_invalid(engine, json, "0");
+	check_invalid(engine, json, "1000000");
+
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_uint64("layout_version", 2), status::OK);
+	ASSERT_STATUS(cfg.put_string("alloc_classes", classes), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("alloc_classes_samples", n_entries * 3 / 2),
+		      status::OK);
+	auto kv = INITIALIZE_KV(engine, std::move(cfg));
+
+	/* in the adaptive mode classes are fitted in the middle of the second pass */
+	auto proto = PutToMapTest(n_entries, key_length, value_sizes[0], kv);
+	VerifyKv(proto, kv);
+
+	proto = PutToMapTest(n_entries, key_length, value_sizes[1], kv);
+	VerifyKv(proto, kv);
+
+	kv.close();
+}
+
+static void check(std::string engine, std::string json)
+{
+	auto kv = INITIALIZE_KV(engine, CONFIG_FROM_JSON(json));
+
+	/* state left by insert */
+	expected_state expected;
+	auto proto = PutToMapTest(n_entries, key_length, value_sizes[1], expected);
+	VerifyKv(proto, kv);
+
+	proto = PutToMapTest(n_entries, key_length, value_sizes[0] * 2, kv);
+	VerifyKv(proto, kv);
+
+	size_t i = 0;
+	for (auto it = proto.begin(); it != proto.end(); i++) {
+		if (i % 2 != 0) {
+			++it;
+			continue;
+		}
+
+		ASSERT_STATUS(kv.remove(it->first), status::OK);
+		it = proto.erase(it);
+	}
+	VerifyKv(proto, kv);
+
+	kv.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 5)
+		UT_FATAL("usage: %s engine json_config insert/check alloc_classes", argv[0]);
+
+	std::string mode = argv[3];
+	if (mode == "insert")
+		insert(argv[1], argv[2], argv[4]);
+	else if (mode == "check")
+		check(argv[1], argv[2]);
+	else
+		UT_FATAL("usage: %s engine json_config insert/check alloc_classes", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "../put_get_std_map.hpp"
+
+/**
+ * Tests data created in one layout version and reopened with config requesting
+ * another one - the layout of existing data is used and data is read unchanged.
+ * Values are overwritten with shorter and longer ones (also in place, by
+ * the iterator) before and after reopen.
+ */
+
+static const size_t n_entries = 200;
+
+static std::map<std::string, std::string> entries()
+{
+	std::map<std::string, std::string> result;
+	for (size_t i = 0; i < n_entries; i++) {
+		/* short and long (not fitting in SSO) keys and values */
+		auto key = entry_from_number(i, "", std::string(i % 40, 'k'));
+		result[key] = entry_from_number(i, "", std::string(i % 70, 'v'));
+	}
+
+	return result;
+}
+
+/*
+ * Overwrites every 3rd value with a longer one and every 5th with a shorter one,
+ * removes the first entry and modifies (in place) the first non-empty value.
+ * Only the expected state (proto) is updated if kv is nullptr.
+ */
+static void modify(std::map<std::string, std::string> &proto, pmem::kv::db *kv)
+{
+	size_t i = 0;
+	for (auto &e : proto) {
+		if (i % 3 == 0)
+			e.second += std::string(100, 'l');
+		else if (i % 5 == 0)
+			e.second = e.second.substr(0, e.second.size() / 2);
+		++i;
+
+		if (kv)
+			ASSERT_STATUS(kv->put(e.first, e.second), status::OK);
+	}
+
+	auto first = proto.begin();
+	if (kv)
+		ASSERT_STATUS(kv->remove(first->first), status::OK);
+	proto.erase(first);
+
+	auto it = proto.begin();
+	while (it->second.empty())
+		++it;
+	it->second[0] = 'X';
+	if (!kv)
+		return;
+
+	auto res = kv->new_write_iterator();
+	ASSERT_STATUS(res.get_status(), status::OK);
+	auto &w_it = res.get_value();
+	ASSERT_STATUS(w_it.seek(it->first), status::OK);
+	auto range = w_it.write_range(0, 1);
+	ASSERT_STATUS(range.get_status(), status::OK);
+	*range.get_value().begin() = 'X';
+	ASSERT_STATUS(w_it.commit(), status::OK);
+}
+
+static void insert(std::string engine, std::string json, uint64_t version)
+{
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_uint64("layout_version", version), status::OK);
+	auto kv = INITIALIZE_KV(engine, std::move(cfg));
+
+	auto proto = entries();
+	for (auto &e : proto)
+		ASSERT_STATUS(kv.put(e.first, e.second), status::OK);
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	modify(proto, &kv);
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	kv.close();
+}
+
+static void check(std::string engine, std::string json, uint64_t version)
+{
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_uint64("layout_version", version), status::OK);
+	auto kv = INITIALIZE_KV(engine, std::move(cfg));
+
+	/* state left by insert */
+	auto proto = entries();
+	modify(proto, nullptr);
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	modify(proto, &kv);
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	kv.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 6)
+		UT_FATAL("usage: %s engine json_config insert/check create_version open_version",
+			 argv[0]);
+
+	std::string mode = argv[3];
+	if (mode == "insert")
+		insert(argv[1], argv[2], std::stoull(argv[4]));
+	else if (mode == "check")
+		check(argv[1], argv[2], std::stoull(argv[5]));
+	else
+		UT_FATAL("usage: %s engine json_config insert/check create_version open_version",
+			 argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+#include <chrono>
+#include <thread>
+
+/**
+ * Tests put_with_ttl method - expired records are not visible for reads and
+ * are removed in the background (or by following writes and reads, in stree). Deadlines
+ * are checked also after reopen.
+ */
+
+using namespace pmem::kv;
+
+static void sleep_ms(size_t ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/* waits (with a timeout) for expired records to be removed */
+static void wait_for_count(pmem::kv::db &kv, size_t expected)
+{
+	std::size_t cnt;
+	for (int i = 0; i < 500; i++) {
+		/* engines without the background thread expire keys on writes */
+		ASSERT_STATUS(kv.remove("not_present"), status::NOT_FOUND);
+		ASSERT_STATUS(kv.count_all(cnt), status::OK);
+		if (cnt == expected)
+			return;
+		sleep_ms(10);
+	}
+	UT_ASSERTeq(cnt, expected);
+}
+
+static void insert(pmem::kv::db &kv)
+{
+	ASSERT_STATUS(kv.put_with_ttl("key1", "value1", 0), status::INVALID_ARGUMENT);
+
+	ASSERT_STATUS(kv.put_with_ttl("short", "value", 100), status::OK);
+	ASSERT_STATUS(kv.put_with_ttl("long", "value", 3600 * 1000), status::OK);
+	/* put without ttl clears the deadline */
+	ASSERT_STATUS(kv.put_with_ttl("plain", "value", 100), status::OK);
+	ASSERT_STATUS(kv.put("plain", "VALUE"), status::OK);
+	/* put_with_ttl replaces the deadline */
+	ASSERT_STATUS(kv.put_with_ttl("extended", "value", 100), status::OK);
+	ASSERT_STATUS(kv.put_with_ttl("extended", "VALUE", 3600 * 1000), status::OK);
+	ASSERT_STATUS(kv.put_with_ttl("removed", "value", 3600 * 1000), status::OK);
+	ASSERT_STATUS(kv.remove("removed"), status::OK);
+
+	std::string value;
+	ASSERT_STATUS(kv.get("short", &value), status::OK);
+	UT_ASSERT(value == "value");
+
+	sleep_ms(200);
+
+	ASSERT_STATUS(kv.get("short", &value), status::NOT_FOUND);
+	ASSERT_STATUS(kv.exists("short"), status::NOT_FOUND);
+	ASSERT_STATUS(kv.exists("long"), status::OK);
+	ASSERT_STATUS(kv.get("plain", &value), status::OK);
+	UT_ASSERT(value == "VALUE");
+	ASSERT_STATUS(kv.get("extended", &value), status::OK);
+	UT_ASSERT(value == "VALUE");
+	ASSERT_STATUS(kv.exists("removed"), status::NOT_FOUND);
+
+	/* expired records are skipped by scans, even before they are removed */
+	std::size_t cnt = 0;
+	ASSERT_STATUS(kv.get_all([&](string_view k, string_view v) {
+		UT_ASSERT(k.compare("short") != 0);
+		cnt++;
+		return 0;
+	}),
+		      status::OK);
+	UT_ASSERTeq(cnt, 3);
+
+	wait_for_count(kv, 3);
+
+	/* this one expires after reopen */
+	ASSERT_STATUS(kv.put_with_ttl("reopen", "value", 500), status::OK);
+}
+
+static void check(pmem::kv::db &kv)
+{
+	ASSERT_STATUS(kv.exists("short"), status::NOT_FOUND);
+	ASSERT_STATUS(kv.exists("long"), status::OK);
+	ASSERT_STATUS(kv.exists("plain"), status::OK);
+	ASSERT_STATUS(kv.exists("extended"), status::OK);
+
+	sleep_ms(600);
+
+	ASSERT_STATUS(kv.exists("reopen"), status::NOT_FOUND);
+	wait_for_count(kv, 3);
+
+	/* the key can be put again, without a deadline */
+	ASSERT_STATUS(kv.put("reopen", "value"), status::OK);
+	sleep_ms(100);
+	ASSERT_STATUS(kv.exists("reopen"), status::OK);
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config insert/check", argv[0]);
+
+	std::string mode = argv[3];
+	if (mode != "insert" && mode != "check")
+		UT_FATAL("usage: %s engine json_config insert/check", argv[0]);
+
+	auto kv = INITIALIZE_KV(argv[1], CONFIG_FROM_JSON(argv[2]));
+
+	if (mode == "insert") {
+		insert(kv);
+	} else {
+		check(kv);
+	}
+
+	kv.close();
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
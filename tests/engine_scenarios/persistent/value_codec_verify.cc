@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "../put_get_std_map.hpp"
+
+/**
+ * Tests value codec - values (small, compressible and incompressible ones)
+ * are read back unchanged, also after reopen without the codec in config.
+ * The codec cannot be changed for an existing pool.
+ */
+
+static const size_t n_values = 100;
+
+static std::map<std::string, std::string> values()
+{
+	std::map<std::string, std::string> result;
+	for (size_t i = 0; i < n_values; i++) {
+		std::string v = "{\"id\": " + std::to_string(i) +
+			", \"name\": \"user" + std::to_string(i % 7) +
+			"\", \"tags\": [\"alpha\", \"beta\"], \"active\": true}";
+		result["json" + std::to_string(i)] = v;
+	}
+
+	result["small"] = "x";
+	result["empty"] = "";
+	std::string noise;
+	for (size_t i = 0; i < 1000; i++)
+		noise.push_back(static_cast<char>((i * 7919) ^ (i >> 3)));
+	result["noise"] = noise;
+	result["long"] = std::string(100000, 'a');
+
+	return result;
+}
+
+static void insert(std::string engine, std::string json)
+{
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_string("value_codec", "lz_dict"), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("value_codec_min_size", 16), status::OK);
+	/* dictionary is trained in the middle of inserts */
+	ASSERT_STATUS(cfg.put_uint64("value_codec_dict_samples", n_values / 2),
+		      status::OK);
+	auto kv = INITIALIZE_KV(engine, std::move(cfg));
+
+	auto proto = values();
+	for (auto &e : proto)
+		ASSERT_STATUS(kv.put(e.first, e.second), status::OK);
+
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	ASSERT_STATUS(kv.remove("small"), status::OK);
+	ASSERT_STATUS(kv.put("json0", "overwritten"), status::OK);
+
+	kv.close();
+}
+
+static void check(std::string engine, std::string json)
+{
+	{
+		/* other codec than the recorded one */
+		auto cfg = CONFIG_FROM_JSON(json);
+		ASSERT_STATUS(cfg.put_string("value_codec", "lz"), status::OK);
+		pmem::kv::db kv;
+		ASSERT_STATUS(kv.open(engine, std::move(cfg)), status::INVALID_ARGUMENT);
+	}
+
+	auto kv = INITIALIZE_KV(engine, CONFIG_FROM_JSON(json));
+
+	auto proto = values();
+	proto.erase("small");
+	proto["json0"] = "overwritten";
+	VerifyKv(proto, kv);
+	VerifyGetAll(proto, kv);
+
+	kv.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config insert/check", argv[0]);
+
+	std::string mode = argv[3];
+	if (mode == "insert")
+		insert(argv[1], argv[2]);
+	else if (mode == "check")
+		check(argv[1], argv[2]);
+	else
+		UT_FATAL("usage: %s engine json_config insert/check", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "../put_get_std_map.hpp"
+
+#include <chrono>
+#include <thread>
+
+/**
+ * Tests background defragmentation - data stays intact while the scheduler
+ * defragments the engine concurrently with foreground operations.
+ */
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 6)
+		UT_FATAL("usage: %s engine json_config n_inserts key_length value_length",
+			 argv[0]);
+
+	auto n_inserts = std::stoull(argv[3]);
+	auto key_length = std::stoull(argv[4]);
+	auto value_length = std::stoull(argv[5]);
+
+	auto cfg = CONFIG_FROM_JSON(argv[2]);
+	ASSERT_STATUS(cfg.put_uint64("defrag_background", 1), status::OK);
+	/* start a pass regardless of the fragmentation */
+	ASSERT_STATUS(cfg.put_uint64("defrag_threshold", 0), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("defrag_steps", 10), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("defrag_cpu_budget", 100), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("defrag_interval_ms", 1), status::OK);
+
+	auto kv = INITIALIZE_KV(argv[1], std::move(cfg));
+
+	auto proto = PutToMapTest(n_inserts, key_length, value_length, kv);
+
+	/* make holes in the heap */
+	for (auto it = proto.begin(); it != proto.end();) {
+		ASSERT_STATUS(kv.remove(it->first), status::OK);
+		it = proto.erase(it);
+		if (it != proto.end())
+			++it;
+	}
+
+	for (int i = 0; i < 10; i++) {
+		VerifyKv(proto, kv);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	kv.close();
+
+	/* invalid parameters */
+	cfg = CONFIG_FROM_JSON(argv[2]);
+	ASSERT_STATUS(cfg.put_uint64("defrag_background", 1), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("defrag_cpu_budget", 0), status::OK);
+
+	pmem::kv::db db;
+	ASSERT_STATUS(db.open(argv[1], std::move(cfg)), status::INVALID_ARGUMENT);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
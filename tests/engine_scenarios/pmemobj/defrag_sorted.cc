@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "../put_get_std_map.hpp"
+
+#include <algorithm>
+
+/**
+ * Tests defrag of sorted engines - after removing most of the elements (which
+ * leaves underfull nodes behind), the engine is defragmented in steps and
+ * order of elements, their values and size are verified.
+ */
+
+static void VerifyOrder(const std::map<std::string, std::string> &prototype,
+			pmem::kv::db &kv)
+{
+	auto it = prototype.begin();
+	auto s = kv.get_all([&](string_view key, string_view value) {
+		UT_ASSERT(it != prototype.end());
+		UT_ASSERT(key.compare(it->first) == 0);
+		UT_ASSERT(value.compare(it->second) == 0);
+		++it;
+		return 0;
+	});
+	ASSERT_STATUS(s, status::OK);
+	UT_ASSERT(it == prototype.end());
+}
+
+static void DefragInSteps(pmem::kv::db &kv, size_t steps)
+{
+	double amount = 100.0 / static_cast<double>(steps);
+	for (size_t i = 0; i < steps; i++) {
+		double start = amount * static_cast<double>(i);
+		ASSERT_STATUS(kv.defrag(start, std::min(amount, 100 - start)), status::OK);
+	}
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 6)
+		UT_FATAL("usage: %s engine json_config n_inserts key_length value_length",
+			 argv[0]);
+
+	auto n_inserts = std::stoull(argv[3]);
+	auto key_length = std::stoull(argv[4]);
+	auto value_length = std::stoull(argv[5]);
+
+	auto kv = INITIALIZE_KV(argv[1], CONFIG_FROM_JSON(argv[2]));
+
+	/* defrag of an empty engine */
+	ASSERT_STATUS(kv.defrag(0, 100), status::OK);
+
+	auto proto = PutToMapTest(n_inserts, key_length, value_length, kv);
+
+	/* keep every fourth element */
+	size_t i = 0;
+	for (auto it = proto.begin(); it != proto.end(); i++) {
+		if (i % 4 == 0) {
+			++it;
+			continue;
+		}
+		ASSERT_STATUS(kv.remove(it->first), status::OK);
+		it = proto.erase(it);
+	}
+
+	DefragInSteps(kv, 7);
+	VerifyKv(proto, kv);
+	VerifyOrder(proto, kv);
+
+	/* all but the first element */
+	for (auto it = std::next(proto.begin()); it != proto.end();) {
+		ASSERT_STATUS(kv.remove(it->first), status::OK);
+		it = proto.erase(it);
+	}
+	/* range smaller than a single element */
+	ASSERT_STATUS(kv.defrag(50, 0.001), status::OK);
+	DefragInSteps(kv, 3);
+	VerifyKv(proto, kv);
+
+	/* engine is still usable */
+	auto more = PutToMapTest(n_inserts, key_length + 1, value_length, kv);
+	proto.insert(more.begin(), more.end());
+	DefragInSteps(kv, 1);
+	VerifyKv(proto, kv);
+	VerifyOrder(proto, kv);
+
+	kv.close();
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "unittest.hpp"
+
+/**
+ * Tests per-thread arenas - every thread writing to the engine is assigned
+ * an arena (reported in memory_usage stats) and its data is written correctly.
+ */
+
+using namespace pmem::kv;
+
+static const size_t thread_items = 500;
+
+static std::string value(size_t i)
+{
+	return entry_from_number(i, "", std::string(i % 200, '!'));
+}
+
+static void put_verify(pmem::kv::db &kv, size_t threads_number, size_t first)
+{
+	parallel_exec(threads_number, [&](size_t thread_id) {
+		size_t begin = first + thread_id * thread_items;
+		size_t end = begin + thread_items;
+		for (auto i = begin; i < end; i++) {
+			std::string key = entry_from_number(i);
+			std::string val = value(i);
+			ASSERT_STATUS(kv.put(key, val), status::OK);
+		}
+		for (auto i = begin; i < end; i += 2) {
+			std::string key = entry_from_number(i);
+			ASSERT_STATUS(kv.remove(key), status::OK);
+		}
+		for (auto i = begin + 1; i < end; i += 2) {
+			std::string key = entry_from_number(i);
+			std::string val = value(i);
+			std::string value;
+			ASSERT_STATUS(kv.get(key, &value), status::OK);
+			UT_ASSERT(value == val);
+		}
+	});
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 5)
+		UT_FATAL("usage: %s engine json_config threads arenas", argv[0]);
+
+	std::string engine = argv[1];
+	std::string json = argv[2];
+	size_t threads_number = std::stoull(argv[3]);
+	size_t arenas = std::stoull(argv[4]);
+
+	{
+		auto cfg = CONFIG_FROM_JSON(json);
+		ASSERT_STATUS(cfg.put_uint64("thread_arenas", 1), status::OK);
+		ASSERT_STATUS(cfg.put_uint64("thread_arenas_count", 0), status::OK);
+		pmem::kv::db kv;
+		ASSERT_STATUS(kv.open(engine, std::move(cfg)), status::INVALID_ARGUMENT);
+	}
+
+	{
+		/* not enabled */
+		auto kv = INITIALIZE_KV(engine, CONFIG_FROM_JSON(json));
+		ASSERT_STATUS(kv.put("key", "value"), status::OK);
+		memory_stats stats;
+		ASSERT_STATUS(kv.memory_usage(stats), status::OK);
+		UT_ASSERTeq(stats.arenas, 0);
+		UT_ASSERTeq(stats.arena_threads, 0);
+		UT_ASSERTeq(stats.arena_contended_writes, 0);
+		kv.close();
+	}
+
+	auto cfg = CONFIG_FROM_JSON(json);
+	ASSERT_STATUS(cfg.put_uint64("thread_arenas", 1), status::OK);
+	ASSERT_STATUS(cfg.put_uint64("thread_arenas_count", arenas), status::OK);
+	auto kv = INITIALIZE_KV(engine, std::move(cfg));
+
+	put_verify(kv, threads_number, 0);
+
+	memory_stats stats;
+	ASSERT_STATUS(kv.memory_usage(stats), status::OK);
+	UT_ASSERTeq(stats.arenas, arenas);
+	UT_ASSERTeq(stats.arena_threads, threads_number);
+	UT_ASSERTeq(stats.count, threads_number * thread_items / 2 + 1);
+
+	/* new threads get arenas too */
+	put_verify(kv, threads_number, threads_number * thread_items);
+
+	ASSERT_STATUS(kv.memory_usage(stats), status::OK);
+	UT_ASSERTeq(stats.arena_threads, 2 * threads_number);
+	UT_ASSERTeq(stats.count, threads_number * thread_items + 1);
+
+	/* threads which do not share arenas never contend */
+	if (2 * threads_number <= arenas)
+		UT_ASSERTeq(stats.arena_contended_writes, 0);
+
+	kv.close();
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -57,3 +57,18 @@ void VerifyKv(const std::map<std::string, std::string> &prototype, pmem::kv::db
 		ASSERT_STATUS(s, status::OK);
 	}
 }
+
+/* Checks that get_all visits every element of prototype once, in any order */
+void VerifyGetAll(const std::map<std::string, std::string> &prototype, pmem::kv::db &kv)
+{
+	size_t visited = 0;
+	auto s = kv.get_all([&](string_view key, string_view value) {
+		auto it = prototype.find(std::string(key.data(), key.size()));
+		UT_ASSERT(it != prototype.end());
+		UT_ASSERT(value.compare(it->second) == 0);
+		++visited;
+		return 0;
+	});
+	ASSERT_STATUS(s, status::OK);
+	UT_ASSERTeq(visited, prototype.size());
+}
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+#include <map>
+
+/**
+ * Tests for bulk_load method for sorted engines.
+ */
+
+static std::string gen_key(size_t i)
+{
+	std::string num = std::to_string(i);
+	return std::string(10 - num.size(), '0') + num;
+}
+
+static std::map<std::string, std::string> gen_sorted_map(size_t items,
+							  std::string value_postfix = "")
+{
+	std::map<std::string, std::string> elements;
+	for (size_t i = 0; i < items; i++)
+		elements.emplace(gen_key(i), std::to_string(i) + value_postfix);
+
+	return elements;
+}
+
+static void BulkLoadTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: load sorted elements into an empty db and check that it is fully
+	 * functional afterwards.
+	 */
+	auto elements = gen_sorted_map(items);
+	ASSERT_STATUS(kv.bulk_load(elements.begin(), elements.end()), status::OK);
+
+	auto expected = kv_list(elements.begin(), elements.end());
+	verify_get_all(kv, items, expected);
+
+	for (auto &e : elements) {
+		std::string value;
+		ASSERT_STATUS(kv.get(e.first, &value), status::OK);
+		UT_ASSERT(value == e.second);
+	}
+
+	/* put and remove work on top of loaded data */
+	ASSERT_STATUS(kv.put("A", "new"), status::OK);
+	ASSERT_STATUS(kv.remove(gen_key(0)), status::OK);
+
+	expected.erase(expected.begin());
+	expected.emplace_back("A", "new");
+	verify_get_all(kv, items, kv_sort(expected));
+}
+
+static void BulkLoadNonEmptyTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: load sorted elements into a db which already contains some of
+	 * them - existing values have to be overwritten.
+	 */
+	for (size_t i = 0; i < items; i += 2) {
+		ASSERT_STATUS(kv.put(gen_key(i), "old"), status::OK);
+	}
+
+	auto elements = gen_sorted_map(items, "_new");
+	auto it = elements.begin();
+	auto s = kv.bulk_load([&](string_view &key, string_view &value) {
+		if (it == elements.end())
+			return 1;
+
+		key = it->first;
+		value = it->second;
+		++it;
+
+		return 0;
+	});
+	ASSERT_STATUS(s, status::OK);
+
+	verify_get_all(kv, items, kv_list(elements.begin(), elements.end()));
+}
+
+static void BulkLoadUnsortedTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: keys not in strictly ascending order are rejected, elements
+	 * preceding the misplaced key are kept.
+	 */
+	auto elements = kv_list();
+	for (size_t i = 0; i < items; i++)
+		elements.emplace_back(gen_key(i), std::to_string(i));
+	elements.emplace_back(gen_key(items / 2), "misplaced");
+	elements.emplace_back(gen_key(items), std::to_string(items));
+
+	ASSERT_STATUS(kv.bulk_load(elements.begin(), elements.end()),
+		      status::INVALID_ARGUMENT);
+
+	auto expected = kv_list(elements.begin(), elements.begin() + items);
+	verify_get_all(kv, items, expected);
+
+	/* duplicated key is not allowed either */
+	CLEAR_KV(kv);
+	auto duplicated = kv_list{{"A", "1"}, {"B", "2"}, {"B", "3"}};
+	ASSERT_STATUS(kv.bulk_load(duplicated.begin(), duplicated.end()),
+		      status::INVALID_ARGUMENT);
+	verify_get_all(kv, 2, kv_list{{"A", "1"}, {"B", "2"}});
+}
+
+static void BulkLoadCTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: load elements using C-like callback.
+	 */
+	auto elements = kv_list();
+	for (size_t i = 0; i < items; i++)
+		elements.emplace_back(gen_key(i), std::to_string(i));
+
+	struct load_state {
+		kv_list::iterator it;
+		kv_list::iterator end;
+	} state{elements.begin(), elements.end()};
+
+	auto s = kv.bulk_load(
+		[](const char **k, size_t *kb, const char **v, size_t *vb, void *arg) {
+			auto st = static_cast<load_state *>(arg);
+			if (st->it == st->end)
+				return 1;
+
+			*k = st->it->first.data();
+			*kb = st->it->first.size();
+			*v = st->it->second.data();
+			*vb = st->it->second.size();
+			++st->it;
+
+			return 0;
+		},
+		&state);
+	ASSERT_STATUS(s, status::OK);
+
+	verify_get_all_c(kv, items, elements);
+
+	/* empty input is not an error */
+	CLEAR_KV(kv);
+	ASSERT_STATUS(kv.bulk_load(elements.end(), elements.end()), status::OK);
+	verify_get_all(kv, 0, kv_list());
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(BulkLoadTest, _1, items),
+				 std::bind(BulkLoadNonEmptyTest, _1, items),
+				 std::bind(BulkLoadUnsortedTest, _1, items),
+				 std::bind(BulkLoadCTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
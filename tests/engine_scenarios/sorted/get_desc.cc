@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+/**
+ * Tests get_*_desc methods for sorted engines - records are passed in
+ * descending order of keys and reading stops when the callback returns
+ * non-zero.
+ */
+
+static kv_list insert_items(pmem::kv::db &kv, const size_t items)
+{
+	auto expected = kv_list();
+	for (size_t i = 0; i < items; i++) {
+		auto key = entry_from_number(i);
+		ASSERT_STATUS(kv.put(key, key), status::OK);
+		expected.emplace_back(key, key);
+	}
+
+	return kv_sort(expected);
+}
+
+static kv_list reversed(kv_list::const_iterator first, kv_list::const_iterator last)
+{
+	return kv_list(kv_list::const_reverse_iterator(last),
+		       kv_list::const_reverse_iterator(first));
+}
+
+/* Collects records in the list and stops after 'limit' of them */
+static std::function<int(string_view, string_view)> collect(kv_list &result,
+							    size_t limit = SIZE_MAX)
+{
+	return [&result, limit](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return result.size() >= limit ? 1 : 0;
+	};
+}
+
+static void GetDescTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: every get_*_desc method returns the same records as its
+	 * ascending counterpart, in reverse order.
+	 */
+	kv_list result;
+	ASSERT_STATUS(kv.get_all_desc(collect(result)), status::OK);
+	UT_ASSERT(result.empty());
+	ASSERT_STATUS(kv.get_below_desc(MAX_KEY, collect(result)), status::OK);
+	UT_ASSERT(result.empty());
+
+	auto expected = insert_items(kv, items);
+	auto first = expected.cbegin();
+	auto last = expected.cend();
+
+	ASSERT_STATUS(kv.get_all_desc(collect(result)), status::OK);
+	UT_ASSERT(result == reversed(first, last));
+
+	for (size_t i = 0; i < items; i += items / 10 + 1) {
+		auto key = expected[i].first;
+		auto pos = first + static_cast<long>(i);
+
+		result.clear();
+		ASSERT_STATUS(kv.get_above_desc(key, collect(result)), status::OK);
+		UT_ASSERT(result == reversed(pos + 1, last));
+
+		result.clear();
+		ASSERT_STATUS(kv.get_equal_above_desc(key, collect(result)), status::OK);
+		UT_ASSERT(result == reversed(pos, last));
+
+		result.clear();
+		ASSERT_STATUS(kv.get_equal_below_desc(key, collect(result)), status::OK);
+		UT_ASSERT(result == reversed(first, pos + 1));
+
+		result.clear();
+		ASSERT_STATUS(kv.get_below_desc(key, collect(result)), status::OK);
+		UT_ASSERT(result == reversed(first, pos));
+
+		result.clear();
+		ASSERT_STATUS(kv.get_between_desc(key, MAX_KEY, collect(result)),
+			      status::OK);
+		UT_ASSERT(result == reversed(pos + 1, last));
+	}
+
+	/* keys which are not present in the engine */
+	auto absent = expected[1].first + MIN_KEY;
+	result.clear();
+	ASSERT_STATUS(kv.get_below_desc(absent, collect(result)), status::OK);
+	UT_ASSERT(result == reversed(first, first + 2));
+
+	result.clear();
+	ASSERT_STATUS(kv.get_equal_above_desc(MAX_KEY, collect(result)), status::OK);
+	UT_ASSERT(result.empty());
+
+	/* empty and inverted ranges */
+	result.clear();
+	ASSERT_STATUS(kv.get_between_desc(expected[1].first, expected[1].first,
+					  collect(result)),
+		      status::OK);
+	ASSERT_STATUS(kv.get_between_desc(expected[2].first, expected[1].first,
+					  collect(result)),
+		      status::OK);
+	UT_ASSERT(result.empty());
+
+	result.clear();
+	ASSERT_STATUS(kv.get_between_desc(expected[0].first, expected[3].first,
+					  collect(result)),
+		      status::OK);
+	UT_ASSERT(result == reversed(first + 1, first + 3));
+}
+
+static void GetDescStopTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: reading stops as soon as the callback returns non-zero, so
+	 * the last K records of a range can be read.
+	 */
+	auto expected = insert_items(kv, items);
+	auto first = expected.cbegin();
+	auto last = expected.cend();
+	const size_t k = 5;
+
+	kv_list result;
+	ASSERT_STATUS(kv.get_all_desc(collect(result, k)), status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(last - k, last));
+
+	auto mid = first + static_cast<long>(items / 2);
+	result.clear();
+	ASSERT_STATUS(kv.get_below_desc(mid->first, collect(result, k)),
+		      status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(mid - k, mid));
+
+	result.clear();
+	ASSERT_STATUS(kv.get_equal_below_desc(mid->first, collect(result, 1)),
+		      status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(mid, mid + 1));
+
+	result.clear();
+	ASSERT_STATUS(kv.get_between_desc(first->first, mid->first, collect(result, k)),
+		      status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(mid - k, mid));
+
+	result.clear();
+	ASSERT_STATUS(kv.get_above_desc(mid->first, collect(result, k)),
+		      status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(last - k, last));
+
+	result.clear();
+	ASSERT_STATUS(kv.get_equal_above_desc((last - 1)->first, collect(result, 1)),
+		      status::STOPPED_BY_CB);
+	UT_ASSERT(result == reversed(last - 1, last));
+
+	/* callback which never stops reads the whole range */
+	result.clear();
+	ASSERT_STATUS(kv.get_all_desc(collect(result, items + 1)), status::OK);
+	UT_ASSERTeq(result.size(), items);
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+	if (items < 20)
+		UT_FATAL("items has to be at least 20");
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(GetDescTest, _1, items),
+				 std::bind(GetDescStopTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+/**
+ * Basic + generated tests for get_prefix and count_prefix methods for sorted engines.
+ * get_prefix method returns all elements in db with keys starting with given prefix
+ * (count returns the number of such records).
+ */
+
+static kv_list filter_prefix(const kv_list &list, const std::string &prefix)
+{
+	kv_list result;
+	for (auto &e : list) {
+		if (e.first.compare(0, prefix.size(), prefix) == 0)
+			result.emplace_back(e);
+	}
+
+	return result;
+}
+
+static void GetPrefixTest(std::string engine, pmem::kv::config &&config)
+{
+	/**
+	 * TEST: Basic test with hardcoded, hierarchical strings.
+	 * It's NOT suitable to test with custom comparator.
+	 */
+	auto kv = INITIALIZE_KV(engine, std::move(config));
+	verify_get_prefix(kv, EMPTY_KEY, 0, kv_list());
+	verify_get_prefix(kv, "A", 0, kv_list());
+
+	auto all = kv_list{{"t1", "0"},	     {"t1/a", "1"},	{"t1/a/r1", "2"},
+			   {"t1/a/r2", "3"},  {"t1/ab/r1", "4"}, {"t1/b/r1", "5"},
+			   {"t10/a/r1", "6"}, {"t2/a/r1", "7"},	{"t2/b", "8"},
+			   {"u", "9"},	      {"记!/a", "RR"}};
+	for (auto &e : all)
+		ASSERT_STATUS(kv.put(e.first, e.second), status::OK);
+	all = kv_sort(all);
+
+	for (std::string prefix :
+	     {"", "t", "t1", "t1/", "t1/a", "t1/a/", "t1/a/r1", "t10", "t2/", "u", "记",
+	      "t1/c", "t3", "v", "t1/a/r1/x", "\xff"}) {
+		auto expected = filter_prefix(all, prefix);
+		verify_get_prefix(kv, prefix, expected.size(), expected);
+		verify_get_prefix_c(kv, prefix, expected.size(), expected);
+	}
+
+	/* stop iteration in the middle of the prefix */
+	auto expected = filter_prefix(all, "t1/");
+	kv_list result;
+	auto s = kv.get_prefix("t1/", [&](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return result.size() == 2 ? 1 : 0;
+	});
+	ASSERT_STATUS(s, status::STOPPED_BY_CB);
+	UT_ASSERT(result == kv_list(expected.begin(), expected.begin() + 2));
+
+	/* remove keys, the prefix range shrinks */
+	ASSERT_STATUS(kv.remove("t1/a/r1"), status::OK);
+	ASSERT_STATUS(kv.remove("t1/a"), status::OK);
+	verify_get_prefix(kv, "t1/a", 2, kv_list{{"t1/a/r2", "3"}, {"t1/ab/r1", "4"}});
+
+	CLEAR_KV(kv);
+	kv.close();
+}
+
+static void GetPrefixRandTest(std::string engine, pmem::kv::config &&config,
+			      const size_t items, const size_t max_key_len)
+{
+	/**
+	 * TEST: Randomly generated keys. Every prefix of every key (and some
+	 * nonexistent ones) is checked against the expected list.
+	 */
+	auto kv = INITIALIZE_KV(engine, std::move(config));
+
+	std::vector<std::string> keys = gen_rand_keys(items, max_key_len);
+	auto expected = kv_list();
+	for (size_t i = 0; i < items; i++) {
+		auto value = std::to_string(i);
+		ASSERT_STATUS(kv.put(keys[i], value), status::OK);
+		expected.emplace_back(keys[i], value);
+	}
+	expected = kv_sort(expected);
+
+	for (auto &key : keys) {
+		for (size_t len = 1; len <= key.size(); len++) {
+			auto prefix = key.substr(0, len);
+			auto exp = filter_prefix(expected, prefix);
+			UT_ASSERT(exp.size() > 0);
+			verify_get_prefix(kv, prefix, exp.size(), exp);
+		}
+
+		verify_get_prefix(kv, key + "~", 0, kv_list());
+	}
+
+	CLEAR_KV(kv);
+	kv.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	if (argc < 5)
+		UT_FATAL("usage: %s engine json_config items max_key_len", argv[0]);
+
+	auto engine = std::string(argv[1]);
+	size_t items = std::stoull(argv[3]);
+	size_t max_key_len = std::stoull(argv[4]);
+
+	auto seed = unsigned(std::time(0));
+	printf("rand seed: %u\n", seed);
+	std::srand(seed);
+
+	GetPrefixTest(engine, CONFIG_FROM_JSON(argv[2]));
+	GetPrefixRandTest(engine, CONFIG_FROM_JSON(argv[2]), items, max_key_len);
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -226,6 +226,30 @@ inline void verify_get_between_c(pmem::kv::db &kv, const std::string key1,
 	UT_ASSERT(result == sorted_exp_result);
 }
 
+inline void verify_get_prefix(pmem::kv::db &kv, const std::string prefix,
+			      const size_t exp_cnt, const kv_list &sorted_exp_result)
+{
+	std::size_t cnt;
+	kv_list result;
+	ASSERT_STATUS(kv.count_prefix(prefix, cnt), status::OK);
+	UT_ASSERT(cnt == exp_cnt);
+	auto s = KV_GET_1KEY_CPP_CB_LST(get_prefix, prefix, result);
+	ASSERT_STATUS(s, status::OK);
+	UT_ASSERT(result == sorted_exp_result);
+}
+
+inline void verify_get_prefix_c(pmem::kv::db &kv, const std::string prefix,
+				const size_t exp_cnt, const kv_list &sorted_exp_result)
+{
+	std::size_t cnt;
+	kv_list result;
+	ASSERT_STATUS(kv.count_prefix(prefix, cnt), status::OK);
+	UT_ASSERT(cnt == exp_cnt);
+	auto s = KV_GET_1KEY_C_CB_LST(get_prefix, prefix, result);
+	ASSERT_STATUS(s, status::OK);
+	UT_ASSERT(result == sorted_exp_result);
+}
+
 const char charset[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"
 		       "abcdefghijklmnopqrstuvwxyz";
 const size_t charset_size = strlen(charset);
@@ -103,6 +103,39 @@ static void seek_higher_eq_test(pmem::kv::db &kv)
 	});
 }
 
+template <bool IsConst>
+static void seek_prefix_test(pmem::kv::db &kv)
+{
+	auto it = new_iterator<IsConst>(kv);
+
+	std::for_each(keys.begin(), keys.end(), [&](pair p) {
+		ASSERT_STATUS(it.seek_prefix(p.first.substr(0, 1)),
+			      pmem::kv::status::NOT_FOUND);
+	});
+
+	insert_keys(kv);
+
+	std::for_each(keys.begin(), keys.end(), [&](pair p) {
+		ASSERT_STATUS(it.seek_prefix(p.first.substr(0, 1)), pmem::kv::status::OK);
+		verify_key<IsConst>(it, p.first);
+		verify_value<IsConst>(it, p.second);
+
+		ASSERT_STATUS(it.seek_prefix(p.first), pmem::kv::status::OK);
+		verify_key<IsConst>(it, p.first);
+	});
+
+	/* keys higher than the prefix, but not starting with it */
+	std::for_each(keys.begin(), keys.end(), [&](pair p) {
+		ASSERT_STATUS(it.seek_prefix(p.first + "a"), pmem::kv::status::NOT_FOUND);
+		ASSERT_STATUS(it.seek_prefix(p.first.substr(0, 2) + "0"),
+			      pmem::kv::status::NOT_FOUND);
+	});
+
+	/* empty prefix matches every key */
+	ASSERT_STATUS(it.seek_prefix(""), pmem::kv::status::OK);
+	verify_key<IsConst>(it, keys.front().first);
+}
+
 template <bool IsConst>
 static void next_test(pmem::kv::db &kv)
 {
@@ -125,6 +158,52 @@ static void next_test(pmem::kv::db &kv)
 	ASSERT_STATUS(it.next(), pmem::kv::status::NOT_FOUND);
 }
 
+template <bool IsConst>
+static void next_batch_test(pmem::kv::db &kv)
+{
+	auto it = new_iterator<IsConst>(kv);
+
+	insert_keys(kv);
+
+	std::vector<std::pair<pmem::kv::string_view, pmem::kv::string_view>> batch;
+	for (size_t batch_size : {1, 2, 3, 7, 10}) {
+		ASSERT_STATUS(it.seek_to_first(), pmem::kv::status::OK);
+
+		size_t pos = 0;
+		do {
+			ASSERT_STATUS(it.next_batch(batch_size, batch), pmem::kv::status::OK);
+			UT_ASSERT(batch.size() > 0 && batch.size() <= batch_size);
+
+			for (auto &e : batch) {
+				UT_ASSERT(pos < keys.size());
+				UT_ASSERTeq(e.first.compare(keys[pos].first), 0);
+				UT_ASSERTeq(e.second.compare(keys[pos].second), 0);
+				pos++;
+			}
+
+			/* iterator is left on the last record read */
+			verify_key<IsConst>(it, keys[pos - 1].first);
+
+			if (batch.size() < batch_size)
+				break;
+		} while (it.next() == pmem::kv::status::OK);
+
+		UT_ASSERTeq(pos, keys.size());
+	}
+
+	/* batch starting in the middle */
+	ASSERT_STATUS(it.seek(keys[2].first), pmem::kv::status::OK);
+	ASSERT_STATUS(it.next_batch(2, batch), pmem::kv::status::OK);
+	UT_ASSERTeq(batch.size(), 2);
+	UT_ASSERTeq(batch[0].first.compare(keys[2].first), 0);
+	UT_ASSERTeq(batch[1].first.compare(keys[3].first), 0);
+	verify_key<IsConst>(it, keys[3].first);
+
+	ASSERT_STATUS(it.next_batch(0, batch), pmem::kv::status::OK);
+	UT_ASSERT(batch.empty());
+	verify_key<IsConst>(it, keys[3].first);
+}
+
 template <bool IsConst>
 static void prev_test(pmem::kv::db &kv)
 {
@@ -185,6 +264,42 @@ static void seek_to_last_test(pmem::kv::db &kv)
 	});
 }
 
+/* last element is found also after keys are added at the end or removed */
+static void seek_to_last_modified_test(pmem::kv::db &kv)
+{
+	insert_keys(kv);
+
+	auto verify_last = [&](pmem::kv::string_view expected) {
+		auto it = new_iterator<true>(kv);
+		ASSERT_STATUS(it.seek_to_last(), pmem::kv::status::OK);
+		verify_key<true>(it, expected);
+	};
+
+	verify_last(keys.back().first);
+
+	ASSERT_STATUS(kv.put("zzz", "8"), pmem::kv::status::OK);
+	verify_last("zzz");
+
+	ASSERT_STATUS(kv.remove("zzz"), pmem::kv::status::OK);
+	verify_last(keys.back().first);
+
+	/* removal of other keys does not change the last one */
+	ASSERT_STATUS(kv.remove(keys.front().first), pmem::kv::status::OK);
+	verify_last(keys.back().first);
+
+	auto s = kv.remove_range(keys[4].first, "zzz");
+	if (s == pmem::kv::status::OK)
+		verify_last(keys[3].first);
+	else
+		ASSERT_STATUS(s, pmem::kv::status::NOT_SUPPORTED);
+
+	for (auto &p : keys)
+		kv.remove(p.first);
+
+	auto it = new_iterator<true>(kv);
+	ASSERT_STATUS(it.seek_to_last(), pmem::kv::status::NOT_FOUND);
+}
+
 static void seek_to_first_write_test(pmem::kv::db &kv)
 {
 	auto it = new_iterator<false>(kv);
@@ -260,8 +375,12 @@ static void test(int argc, char *argv[])
 				 seek_higher_test<false>,
 				 seek_higher_eq_test<true>,
 				 seek_higher_eq_test<false>,
+				 seek_prefix_test<true>,
+				 seek_prefix_test<false>,
 				 next_test<true>,
 				 next_test<false>,
+				 next_batch_test<true>,
+				 next_batch_test<false>,
 				 seek_to_first_test<true>,
 				 seek_to_first_test<false>,
 				 seek_to_first_write_test,
@@ -276,6 +395,7 @@ static void test(int argc, char *argv[])
 					 seek_to_last_test<true>,
 					 seek_to_last_test<false>,
 					 seek_to_last_write_test,
+					 seek_to_last_modified_test,
 				 });
 }
 
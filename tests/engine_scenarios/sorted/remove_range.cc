@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+/**
+ * Tests remove_range and remove_prefix methods for sorted engines.
+ */
+
+static kv_list insert_items(pmem::kv::db &kv, const size_t items)
+{
+	auto expected = kv_list();
+	for (size_t i = 0; i < items; i++) {
+		auto key = entry_from_number(i);
+		ASSERT_STATUS(kv.put(key, key), status::OK);
+		expected.emplace_back(key, key);
+	}
+
+	return kv_sort(expected);
+}
+
+static void RemoveRangeTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: keys in [key1, key2) are removed, keys outside are left intact.
+	 */
+	auto expected = insert_items(kv, items);
+
+	auto first = expected.begin() + static_cast<long>(items / 4);
+	auto last = expected.begin() + static_cast<long>(items / 2);
+	ASSERT_STATUS(kv.remove_range(first->first, last->first), status::OK);
+	expected.erase(first, last);
+	verify_get_all(kv, expected.size(), expected);
+
+	/* empty and inverted ranges remove nothing */
+	ASSERT_STATUS(kv.remove_range(expected[1].first, expected[1].first), status::OK);
+	ASSERT_STATUS(kv.remove_range(expected[2].first, expected[1].first), status::OK);
+	verify_get_all(kv, expected.size(), expected);
+
+	/* range beyond the last key */
+	auto tail = expected.end() - 3;
+	ASSERT_STATUS(kv.remove_range(tail->first, MAX_KEY), status::OK);
+	expected.erase(tail, expected.end());
+	verify_get_all(kv, expected.size(), expected);
+
+	/* whole db */
+	ASSERT_STATUS(kv.remove_range("", MAX_KEY), status::OK);
+	verify_get_all(kv, 0, kv_list());
+
+	/* removed keys can be inserted again */
+	expected = insert_items(kv, items);
+	verify_get_all(kv, items, expected);
+}
+
+static void RemovePrefixTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: only keys starting with the prefix are removed.
+	 */
+	auto expected = kv_list();
+	for (auto prefix : {"a", "ab", "abc", "b"}) {
+		for (size_t i = 0; i < items; i++) {
+			auto key = prefix + entry_from_number(i);
+			ASSERT_STATUS(kv.put(key, key), status::OK);
+			expected.emplace_back(key, key);
+		}
+	}
+	ASSERT_STATUS(kv.put("ab", "ab"), status::OK);
+	expected.emplace_back("ab", "ab");
+	expected = kv_sort(expected);
+
+	ASSERT_STATUS(kv.remove_prefix("ab"), status::OK);
+	expected.erase(std::remove_if(expected.begin(), expected.end(),
+				      [](const kv_pair &p) {
+					      return p.first.compare(0, 2, "ab") == 0;
+				      }),
+		       expected.end());
+	verify_get_all(kv, expected.size(), expected);
+
+	/* prefix which is not present */
+	ASSERT_STATUS(kv.remove_prefix("c"), status::OK);
+	verify_get_all(kv, expected.size(), expected);
+
+	/* empty prefix matches all keys */
+	ASSERT_STATUS(kv.remove_prefix(""), status::OK);
+	verify_get_all(kv, 0, kv_list());
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(RemoveRangeTest, _1, items),
+				 std::bind(RemovePrefixTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Tests snapshots - reads, range queries and iterators of a snapshot see
+ * the data as it was when the snapshot was taken, regardless of later writes.
+ */
+
+static kv_list insert_items(pmem::kv::db &kv, const size_t items)
+{
+	auto expected = kv_list();
+	for (size_t i = 0; i < items; i++) {
+		auto key = entry_from_number(i);
+		auto value = std::to_string(i);
+		ASSERT_STATUS(kv.put(key, value), status::OK);
+		expected.emplace_back(key, value);
+	}
+
+	return kv_sort(expected);
+}
+
+/* updates every second key, removes every third and adds new ones */
+static void modify_items(pmem::kv::db &kv, const size_t items)
+{
+	for (size_t i = 0; i < items; i += 2)
+		ASSERT_STATUS(kv.put(entry_from_number(i), "updated"), status::OK);
+	for (size_t i = 0; i < items; i += 3)
+		ASSERT_STATUS(kv.remove(entry_from_number(i)), status::OK);
+	for (size_t i = items; i < items + items / 2; i++)
+		ASSERT_STATUS(kv.put(entry_from_number(i), "new"), status::OK);
+}
+
+static void verify_snapshot(pmem::kv::db &snapshot, const kv_list &expected)
+{
+	std::size_t cnt;
+	ASSERT_STATUS(snapshot.count_all(cnt), status::OK);
+	UT_ASSERTeq(cnt, expected.size());
+
+	auto result = kv_list();
+	ASSERT_STATUS(snapshot.get_all([&](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return 0;
+	}),
+		      status::OK);
+	UT_ASSERT(result == expected);
+
+	auto collect = [&](string_view k, string_view v) {
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.data(), v.size()));
+		return 0;
+	};
+
+	result.clear();
+	ASSERT_STATUS(snapshot.get_all_desc(collect), status::OK);
+	std::reverse(result.begin(), result.end());
+	UT_ASSERT(result == expected);
+
+	for (auto &e : expected) {
+		std::string value;
+		ASSERT_STATUS(snapshot.get(e.first, &value), status::OK);
+		UT_ASSERT(value == e.second);
+	}
+
+	if (expected.size() < 2)
+		return;
+
+	auto &first = expected.front().first;
+	auto &last = expected.back().first;
+	ASSERT_STATUS(snapshot.count_between(first, last, cnt), status::OK);
+	UT_ASSERTeq(cnt, expected.size() - 2);
+	ASSERT_STATUS(snapshot.count_above(first, cnt), status::OK);
+	UT_ASSERTeq(cnt, expected.size() - 1);
+	ASSERT_STATUS(snapshot.count_equal_below(last, cnt), status::OK);
+	UT_ASSERTeq(cnt, expected.size());
+
+	result.clear();
+	ASSERT_STATUS(snapshot.get_between_desc(first, last, collect), status::OK);
+	std::reverse(result.begin(), result.end());
+	UT_ASSERT(result == kv_list(expected.begin() + 1, expected.end() - 1));
+
+	/* forward and backward iteration */
+	auto res_it = snapshot.new_read_iterator();
+	UT_ASSERT(res_it.is_ok());
+	auto &it = res_it.get_value();
+
+	result.clear();
+	ASSERT_STATUS(it.seek_to_first(), status::OK);
+	do {
+		auto k = it.key().get_value();
+		auto v = it.read_range().get_value();
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.begin(), v.end()));
+	} while (it.next() == status::OK);
+	UT_ASSERT(result == expected);
+
+	result.clear();
+	ASSERT_STATUS(it.seek_to_last(), status::OK);
+	do {
+		auto k = it.key().get_value();
+		auto v = it.read_range().get_value();
+		result.emplace_back(std::string(k.data(), k.size()),
+				    std::string(v.begin(), v.end()));
+	} while (it.prev() == status::OK);
+	std::reverse(result.begin(), result.end());
+	UT_ASSERT(result == expected);
+
+	ASSERT_STATUS(it.seek_higher(first), status::OK);
+	UT_ASSERT(it.key().get_value().compare(expected[1].first) == 0);
+	ASSERT_STATUS(it.seek_lower(last), status::OK);
+	UT_ASSERT(it.key().get_value().compare(expected[expected.size() - 2].first) ==
+		  0);
+	ASSERT_STATUS(it.seek_lower(first), status::NOT_FOUND);
+}
+
+static void SnapshotTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: snapshot is not affected by updates, removals and inserts done
+	 * after it was taken, the database is.
+	 */
+	auto expected = insert_items(kv, items);
+
+	auto res = kv.snapshot();
+	UT_ASSERT(res.is_ok());
+	auto snapshot = std::move(res).get_value();
+
+	modify_items(kv, items);
+	ASSERT_STATUS(kv.defrag(), status::OK);
+
+	verify_snapshot(snapshot, expected);
+	ASSERT_STATUS(snapshot.exists(entry_from_number(items)), status::NOT_FOUND);
+	ASSERT_STATUS(snapshot.put("key", "value"), status::NOT_SUPPORTED);
+	ASSERT_STATUS(snapshot.remove(expected.front().first), status::NOT_SUPPORTED);
+
+	/* the second snapshot sees modified data */
+	auto current = kv_list();
+	ASSERT_STATUS(kv.get_all([&](string_view k, string_view v) {
+		current.emplace_back(std::string(k.data(), k.size()),
+				     std::string(v.data(), v.size()));
+		return 0;
+	}),
+		      status::OK);
+
+	res = kv.snapshot();
+	UT_ASSERT(res.is_ok());
+	auto second = std::move(res).get_value();
+
+	CLEAR_KV(kv);
+	insert_items(kv, items / 2);
+
+	verify_snapshot(snapshot, expected);
+	verify_snapshot(second, current);
+
+	second.close();
+	snapshot.close();
+}
+
+static void SnapshotConcurrentWriterTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: snapshot is read in one thread while another one writes.
+	 */
+	auto expected = insert_items(kv, items);
+
+	auto res = kv.snapshot();
+	UT_ASSERT(res.is_ok());
+	auto snapshot = std::move(res).get_value();
+
+	std::atomic<bool> done(false);
+	std::thread writer([&] {
+		while (!done) {
+			modify_items(kv, items);
+			CLEAR_KV(kv);
+			insert_items(kv, items);
+		}
+	});
+
+	for (int i = 0; i < 10; i++)
+		verify_snapshot(snapshot, expected);
+
+	done = true;
+	writer.join();
+	snapshot.close();
+}
+
+static void SnapshotBulkLoadTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: keys loaded into an empty database are not in its snapshot.
+	 */
+	auto res = kv.snapshot();
+	UT_ASSERT(res.is_ok());
+	auto snapshot = std::move(res).get_value();
+
+	auto elements = kv_list();
+	for (size_t i = 0; i < items; i++)
+		elements.emplace_back(entry_from_number(i), std::to_string(i));
+	elements = kv_sort(elements);
+	ASSERT_STATUS(kv.bulk_load(elements.begin(), elements.end()), status::OK);
+
+	verify_snapshot(snapshot, kv_list());
+	snapshot.close();
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(SnapshotTest, _1, items),
+				 std::bind(SnapshotConcurrentWriterTest, _1, items),
+				 std::bind(SnapshotBulkLoadTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2021, Intel Corporation */
+
+#include "iterate.hpp"
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * Tests for split_points and get_all_parallel methods for sorted engines.
+ * In sorted engines every partition of get_all_parallel is a contiguous,
+ * ascending range of keys.
+ */
+
+static kv_list insert_items(pmem::kv::db &kv, const size_t items)
+{
+	auto expected = kv_list();
+	for (size_t i = 0; i < items; i++) {
+		auto key = entry_from_number(i);
+		auto value = std::to_string(i);
+		ASSERT_STATUS(kv.put(key, value), status::OK);
+		expected.emplace_back(key, value);
+	}
+
+	return kv_sort(expected);
+}
+
+static void SplitPointsTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: split points are ascending and every range between them is
+	 * non-empty; ranges together cover the whole db.
+	 */
+	std::vector<std::string> points;
+	ASSERT_STATUS(kv.split_points(4, points), status::OK);
+	UT_ASSERT(points.empty());
+
+	insert_items(kv, items);
+
+	for (size_t n : {1, 2, 4, 16}) {
+		points.clear();
+		ASSERT_STATUS(kv.split_points(n, points), status::OK);
+		UT_ASSERT(points.size() <= n - 1);
+
+		size_t total = 0;
+		std::size_t cnt;
+		for (size_t i = 0; i <= points.size(); i++) {
+			if (points.size() == 0) {
+				ASSERT_STATUS(kv.count_all(cnt), status::OK);
+			} else if (i == 0) {
+				ASSERT_STATUS(kv.count_below(points[i], cnt), status::OK);
+			} else if (i == points.size()) {
+				ASSERT_STATUS(kv.count_equal_above(points[i - 1], cnt),
+					      status::OK);
+			} else {
+				UT_ASSERT(points[i - 1] < points[i]);
+				ASSERT_STATUS(kv.count_equal_above(points[i - 1], cnt),
+					      status::OK);
+				std::size_t above;
+				ASSERT_STATUS(kv.count_equal_above(points[i], above),
+					      status::OK);
+				cnt -= above;
+			}
+
+			UT_ASSERT(cnt > 0);
+			total += cnt;
+		}
+		UT_ASSERT(total == items);
+	}
+
+	ASSERT_STATUS(kv.split_points(0, points), status::INVALID_ARGUMENT);
+}
+
+static void GetAllParallelSortedTest(pmem::kv::db &kv, const size_t items)
+{
+	/**
+	 * TEST: every partition is scanned by a single thread in ascending order,
+	 * so joining partitions (ordered by their first keys) gives sorted db.
+	 */
+	auto expected = insert_items(kv, items);
+
+	for (size_t partitions : {1, 2, 4, 16}) {
+		std::mutex mtx;
+		std::map<std::thread::id, kv_list> results;
+		auto s = kv.get_all_parallel(partitions, [&](string_view k, string_view v) {
+			std::unique_lock<std::mutex> lock(mtx);
+			results[std::this_thread::get_id()].emplace_back(
+				std::string(k.data(), k.size()),
+				std::string(v.data(), v.size()));
+			return 0;
+		});
+		ASSERT_STATUS(s, status::OK);
+		UT_ASSERT(results.size() <= partitions);
+
+		std::vector<kv_list> parts;
+		for (auto &r : results) {
+			UT_ASSERT(r.second == kv_sort(r.second));
+			parts.emplace_back(std::move(r.second));
+		}
+		std::sort(parts.begin(), parts.end(),
+			  [](const kv_list &lhs, const kv_list &rhs) {
+				  return lhs.front().first < rhs.front().first;
+			  });
+
+		kv_list joined;
+		for (auto &p : parts)
+			joined.insert(joined.end(), p.begin(), p.end());
+		UT_ASSERT(joined == expected);
+	}
+}
+
+static void test(int argc, char *argv[])
+{
+	using namespace std::placeholders;
+
+	if (argc < 4)
+		UT_FATAL("usage: %s engine json_config items", argv[0]);
+
+	size_t items = std::stoull(argv[3]);
+
+	run_engine_tests(argv[1], argv[2],
+			 {
+				 std::bind(SplitPointsTest, _1, items),
+				 std::bind(GetAllParallelSortedTest, _1, items),
+			 });
+}
+
+int main(int argc, char *argv[])
+{
+	return run_test([&] { test(argc, argv); });
+}